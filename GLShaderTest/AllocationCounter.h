@@ -0,0 +1,118 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+// Counts heap allocations made through operator new, so benchmarks can report how many allocations and how many
+// bytes a piece of code needs. Only with COUNT_ALLOCATIONS defined: that replaces the global operator new/delete, which
+// costs every allocation of the program a header and a few atomics, so it is meant for benchmark builds only and the
+// define may only be set for one translation unit (main.cpp, which includes this through ModelBenchmarks.h; the rest
+// of the project is C). The Profile|Win32 configuration sets it, so its timings include that cost. Without it nothing
+// is counted and AllocationScope reports 0 for everything.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+struct AllocationStats {
+	std::atomic<size_t> allocations{ 0 };
+	std::atomic<size_t> liveBytes{ 0 };
+	std::atomic<size_t> peakBytes{ 0 };
+};
+
+inline AllocationStats& allocationStats()
+{
+	static AllocationStats stats;
+	return stats;
+}
+
+#ifdef COUNT_ALLOCATIONS
+const bool ALLOCATION_COUNTING = true;
+#else
+const bool ALLOCATION_COUNTING = false;
+#endif
+
+// a window over which allocations are counted, peak is the highest live heap size seen since begin()
+struct AllocationScope {
+	size_t startAllocations;
+	size_t startBytes;
+
+	AllocationScope() : startAllocations(0), startBytes(0) { begin(); }
+
+	void begin()
+	{
+		if (!ALLOCATION_COUNTING)
+			return;
+		AllocationStats &stats = allocationStats();
+		startAllocations = stats.allocations.load();
+		startBytes = stats.liveBytes.load();
+		stats.peakBytes = startBytes;
+	}
+	size_t allocations() const { return ALLOCATION_COUNTING ? allocationStats().allocations.load() - startAllocations : 0; }
+	// growth of the live heap at its highest point since begin()
+	size_t peakBytes() const { return ALLOCATION_COUNTING ? allocationStats().peakBytes.load() - startBytes : 0; }
+};
+
+// peak resident set size of the whole process so far, in bytes
+inline size_t peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+#ifdef COUNT_ALLOCATIONS
+// every block carries its size in front so delete can keep liveBytes right; 16 bytes keeps the payload aligned
+const size_t ALLOCATION_HEADER = 16;
+
+inline void* countedAllocate(size_t size)
+{
+	void *block = malloc(size + ALLOCATION_HEADER);
+	if (!block)
+		throw std::bad_alloc();
+	*(size_t*)block = size;
+	AllocationStats &stats = allocationStats();
+	stats.allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t live = stats.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = stats.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !stats.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+	return (char*)block + ALLOCATION_HEADER;
+}
+
+inline void countedFree(void *ptr)
+{
+	if (!ptr)
+		return;
+	void *block = (char*)ptr - ALLOCATION_HEADER;
+	allocationStats().liveBytes.fetch_sub(*(size_t*)block, std::memory_order_relaxed);
+	free(block);
+}
+
+void* operator new(size_t size) { return countedAllocate(size); }
+void* operator new[](size_t size) { return countedAllocate(size); }
+void operator delete(void *ptr) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr); }
+void operator delete(void *ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { countedFree(ptr); }
+#endif
+#endif
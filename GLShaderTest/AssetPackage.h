@@ -0,0 +1,401 @@
+#ifndef ASSET_PACKAGE_H
+#define ASSET_PACKAGE_H
+
+// An asset package puts the files the demo loads (shaders, images, cubemap faces, baked textures and model caches) into
+// one file that is mapped once. The loaders look a path up in assetPackage() before going to the disk: images are
+// decoded straight from the mapping (SOIL_load_image_from_memory), model caches and baked textures are used in place,
+// and the package's hash of an image stands in for hashing the file. --pack-assets writes one (packAssets). Entries
+// whose loose file was edited after packing can be skipped (skipEditedEntries), the loaders then read the loose file.
+// Layout (native little endian):
+//   AssetPackageHeader
+//   AssetPackageEntry entries[entryCount]    sorted by name
+//   char              names[namesSize]
+//   blobs, each at a multiple of ASSET_PACKAGE_ALIGNMENT
+// An entry flagged ASSET_LZ4 holds an LZ4 block (LZ4.h) of its file. Those are the entries that shrank by at least
+// an eighth; they're decompressed on every read, the others are read without a copy.
+
+#include "SOIL2/SOIL2.h"
+
+#include "FileUtils.h"
+#include "LZ4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const uint32_t ASSET_PACKAGE_MAGIC = 0x4B434150; // "PACK"
+const uint32_t ASSET_PACKAGE_VERSION = 1;
+const uint64_t ASSET_PACKAGE_ALIGNMENT = 64;
+
+// what an entry holds, decided by the extension when packing
+enum AssetType {
+	ASSET_FILE = 0,
+	ASSET_SHADER,
+	ASSET_IMAGE,
+	ASSET_BAKED_TEXTURE,	// "<image>.dds" / "<image>.ktx", CompressedTexture.h
+	ASSET_MODEL_CACHE,		// "<model>.meshcache", ModelCache.h
+};
+
+const uint32_t ASSET_LZ4 = 1 << 0;
+
+struct AssetPackageHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t namesSize;
+	uint64_t fileSize;
+};
+
+struct AssetPackageEntry {
+	uint64_t offset;		// of the blob
+	uint64_t storedSize;	// of the blob
+	uint64_t size;			// of the file
+	uint64_t hash;			// FNV-1a of the file (hashBytes)
+	uint32_t nameOffset;	// into names
+	uint32_t nameLength;
+	uint32_t type;			// AssetType
+	uint32_t flags;			// ASSET_LZ4
+};
+
+// paths as the package stores them: '/' separated, without a leading "./"
+inline std::string assetName(const std::string &path)
+{
+	std::string name = path;
+	std::replace(name.begin(), name.end(), '\\', '/');
+	while (name.compare(0, 2, "./") == 0)
+		name.erase(0, 2);
+	return name;
+}
+
+inline AssetType assetType(const std::string &path)
+{
+	std::string extension = fileExtension(path);
+	if (extension == "vs" || extension == "fs" || extension == "gs")
+		return ASSET_SHADER;
+	if (extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "tga" || extension == "bmp")
+		return ASSET_IMAGE;
+	if (extension == "dds" || extension == "ktx")
+		return ASSET_BAKED_TEXTURE;
+	if (extension == "meshcache")
+		return ASSET_MODEL_CACHE;
+	return ASSET_FILE;
+}
+
+// the bytes of an entry: a view into the package's mapping, or for a compressed entry a buffer of its own. a view is
+// valid as long as the package stays open.
+struct AssetData {
+	const unsigned char *bytes = nullptr;
+	size_t size = 0;
+	std::vector<unsigned char> buffer;
+};
+
+// read side: maps a package and looks entries up by name. reading is safe from any thread once it's open.
+class AssetPackage
+{
+public:
+	bool open(const std::string &path)
+	{
+		close();
+		if (!file.open(path) || file.size() < sizeof(AssetPackageHeader))
+			return fail();
+		this->path = path;
+		header = (const AssetPackageHeader*)file.data();
+		if (header->magic != ASSET_PACKAGE_MAGIC || header->version != ASSET_PACKAGE_VERSION || header->fileSize != file.size())
+			return fail();
+		uint64_t namesOffset = sizeof(AssetPackageHeader) + (uint64_t)header->entryCount * sizeof(AssetPackageEntry);
+		if (!inRange(namesOffset, header->namesSize))
+			return fail();
+		entries = (const AssetPackageEntry*)(file.data() + sizeof(AssetPackageHeader));
+		names = (const char*)file.data() + namesOffset;
+		for (uint32_t i = 0; i < header->entryCount; i++)
+		{
+			const AssetPackageEntry &entry = entries[i];
+			if ((uint64_t)entry.nameOffset + entry.nameLength > header->namesSize || !inRange(entry.offset, entry.storedSize) ||
+				(!(entry.flags & ASSET_LZ4) && entry.storedSize != entry.size))
+				return fail();
+		}
+		return true;
+	}
+
+	void close()
+	{
+		file.close();
+		path.clear();
+		edited.clear();
+		header = nullptr;
+		entries = nullptr;
+		names = nullptr;
+	}
+
+	bool isOpen() const { return header != nullptr; }
+	unsigned int entryCount() const { return header ? header->entryCount : 0; }
+	const AssetPackageEntry& entry(unsigned int i) const { return entries[i]; }
+	std::string name(const AssetPackageEntry &entry) const { return std::string(names + entry.nameOffset, entry.nameLength); }
+
+	// marks the entries whose loose file differs from what was packed, so find() and the loaders leave them to the
+	// file: a different size, or a file written after the package whose hash differs. files as they were packed are
+	// only hashed if they're newer than the package, a shipped package without loose files costs nothing. returns how
+	// many entries are skipped.
+	unsigned int skipEditedEntries()
+	{
+		uint64_t packageSize;
+		int64_t packageModified;
+		if (!header || !fileStatus(path, packageSize, packageModified))
+			return 0;
+		edited.assign(header->entryCount, false);
+		unsigned int count = 0;
+		for (uint32_t i = 0; i < header->entryCount; i++)
+		{
+			std::string loose = name(entries[i]);
+			uint64_t size, hash;
+			int64_t modified;
+			if (!fileStatus(loose, size, modified))
+				continue;
+			if (size != entries[i].size || (modified > packageModified && (!hashFile(loose, hash) || hash != entries[i].hash)))
+			{
+				edited[i] = true;
+				count++;
+			}
+		}
+		return count;
+	}
+
+	// the entry of path, NULL if the package doesn't have it (or isn't open, or skips it)
+	const AssetPackageEntry* find(const std::string &path) const
+	{
+		if (!header)
+			return nullptr;
+		std::string key = assetName(path);
+		const AssetPackageEntry *end = entries + header->entryCount;
+		const AssetPackageEntry *it = std::lower_bound(entries, end, key, [this](const AssetPackageEntry &entry, const std::string &key) {
+			return compareName(entry, key) < 0;
+		});
+		if (it == end || compareName(*it, key) != 0 || (!edited.empty() && edited[it - entries]))
+			return nullptr;
+		return it;
+	}
+
+	// the bytes of path's file, false if it isn't in the package or doesn't decompress
+	bool read(const std::string &path, AssetData &data) const
+	{
+		const AssetPackageEntry *entry = find(path);
+		return entry && read(*entry, data);
+	}
+
+	bool read(const AssetPackageEntry &entry, AssetData &data) const
+	{
+		const unsigned char *blob = file.data() + entry.offset;
+		if (!(entry.flags & ASSET_LZ4))
+		{
+			data.buffer.clear();
+			data.bytes = blob;
+			data.size = (size_t)entry.size;
+			return true;
+		}
+		data.buffer.resize((size_t)entry.size);
+		if (!lz4Decompress(blob, (size_t)entry.storedSize, data.buffer.data(), data.buffer.size()))
+			return false;
+		data.bytes = data.buffer.data();
+		data.size = data.buffer.size();
+		return true;
+	}
+
+private:
+	MappedFile file;
+	std::string path;
+	std::vector<bool> edited;	// by entry, empty until skipEditedEntries
+	const AssetPackageHeader *header = nullptr;
+	const AssetPackageEntry *entries = nullptr;
+	const char *names = nullptr;
+
+	bool fail()
+	{
+		close();
+		return false;
+	}
+
+	bool inRange(uint64_t offset, uint64_t size) const
+	{
+		return offset <= file.size() && size <= file.size() - offset;
+	}
+
+	int compareName(const AssetPackageEntry &entry, const std::string &key) const
+	{
+		int order = memcmp(names + entry.nameOffset, key.data(), std::min<size_t>(entry.nameLength, key.size()));
+		if (order != 0)
+			return order;
+		return entry.nameLength < key.size() ? -1 : (entry.nameLength > key.size() ? 1 : 0);
+	}
+};
+
+// the package the loaders look in, main opens it (--package <file>, else "assets.pack" if there is one)
+inline AssetPackage& assetPackage()
+{
+	static AssetPackage package;
+	return package;
+}
+
+// the hash of path's file, from the package if it has it
+inline bool assetHash(const std::string &path, uint64_t &hash)
+{
+	if (const AssetPackageEntry *entry = assetPackage().find(path))
+	{
+		hash = entry->hash;
+		return true;
+	}
+	return hashFile(path, hash);
+}
+
+// the text of path's file from the package, false if it isn't in there
+inline bool readPackagedText(const std::string &path, std::string &text)
+{
+	AssetData data;
+	if (!assetPackage().read(path, data))
+		return false;
+	text.assign((const char*)data.bytes, data.size);
+	return true;
+}
+
+// SOIL_load_image that decodes from the package when it has the image
+inline unsigned char* loadImage(const std::string &path, int *width, int *height, int *channels, int forceChannels)
+{
+	AssetData data;
+	if (assetPackage().read(path, data))
+		return SOIL_load_image_from_memory(data.bytes, (int)data.size, width, height, channels, forceChannels);
+	return SOIL_load_image(path.c_str(), width, height, channels, forceChannels);
+}
+
+// write side: packs the files at paths (stored under assetName(path)) into a package at path. with compress, the
+// entries LZ4 shrinks by at least an eighth are stored compressed. returns false if a file can't be read or the
+// package can't be written.
+inline bool writeAssetPackage(const std::string &path, const std::vector<std::string> &paths, bool compress)
+{
+	struct Packed {
+		std::string name;
+		AssetPackageEntry entry;
+		std::vector<unsigned char> blob;
+	};
+	std::vector<Packed> packed;
+	for (const std::string &source : paths)
+	{
+		MappedFile file;
+		Packed item;
+		item.name = assetName(source);
+		memset(&item.entry, 0, sizeof(item.entry));
+		item.entry.type = assetType(source);
+		if (file.open(source))
+		{
+			item.entry.size = file.size();
+			item.entry.hash = hashBytes(file.data(), file.size());
+			std::vector<unsigned char> compressed;
+			if (compress)
+				compressed = lz4Compress(file.data(), file.size());
+			if (compress && compressed.size() <= file.size() - file.size() / 8)
+			{
+				item.entry.flags = ASSET_LZ4;
+				item.blob.swap(compressed);
+			}
+			else
+				item.blob.assign(file.data(), file.data() + file.size());
+		}
+		else if (fileExists(source))
+			item.entry.hash = hashBytes(NULL, 0);	// MappedFile doesn't map empty files
+		else
+			return false;
+		item.entry.storedSize = item.blob.size();
+		packed.push_back(std::move(item));
+	}
+	std::sort(packed.begin(), packed.end(), [](const Packed &a, const Packed &b) { return a.name < b.name; });
+	for (size_t i = 1; i < packed.size(); i++)
+		if (packed[i].name == packed[i - 1].name)
+			return false;
+
+	std::string names;
+	for (Packed &item : packed)
+	{
+		item.entry.nameOffset = (uint32_t)names.size();
+		item.entry.nameLength = (uint32_t)item.name.size();
+		names += item.name;
+	}
+	auto align = [](uint64_t offset) { return (offset + ASSET_PACKAGE_ALIGNMENT - 1) & ~(ASSET_PACKAGE_ALIGNMENT - 1); };
+	uint64_t offset = sizeof(AssetPackageHeader) + packed.size() * sizeof(AssetPackageEntry) + names.size();
+	for (Packed &item : packed)
+	{
+		item.entry.offset = offset = align(offset);
+		offset += item.blob.size();
+	}
+
+	AssetPackageHeader header;
+	header.magic = ASSET_PACKAGE_MAGIC;
+	header.version = ASSET_PACKAGE_VERSION;
+	header.entryCount = (uint32_t)packed.size();
+	header.namesSize = (uint32_t)names.size();
+	header.fileSize = offset;
+
+	FILE *out = fopen(path.c_str(), "wb");
+	if (!out)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	for (const Packed &item : packed)
+		ok = ok && fwrite(&item.entry, sizeof(item.entry), 1, out) == 1;
+	ok = ok && fwrite(names.data(), 1, names.size(), out) == names.size();
+	uint64_t written = sizeof(AssetPackageHeader) + packed.size() * sizeof(AssetPackageEntry) + names.size();
+	static const unsigned char zeros[ASSET_PACKAGE_ALIGNMENT] = {};
+	for (const Packed &item : packed)
+	{
+		ok = ok && fwrite(zeros, 1, (size_t)(item.entry.offset - written), out) == item.entry.offset - written;
+		ok = ok && fwrite(item.blob.data(), 1, item.blob.size(), out) == item.blob.size();
+		written = item.entry.offset + item.blob.size();
+	}
+	return fclose(out) == 0 && ok;
+}
+
+// the files --pack-assets puts in a package: the shaders, the images and baked textures under model/ and pic/, and
+// the model caches. the models themselves stay out, they're only read when their cache is stale.
+inline std::vector<std::string> assetFiles()
+{
+	std::vector<std::string> paths, found;
+	listFiles(".", { "vs", "fs", "gs" }, found);
+	paths.insert(paths.end(), found.begin(), found.end());
+	for (const char *directory : { "model", "pic" })
+	{
+		found.clear();
+		listFiles(directory, { "jpg", "jpeg", "png", "tga", "bmp", "dds", "ktx", "meshcache" }, found);
+		paths.insert(paths.end(), found.begin(), found.end());
+	}
+	return paths;
+}
+
+// --pack-assets: writes assetFiles() into a package at path and prints what went in
+inline bool packAssets(const std::string &path, bool compress)
+{
+	std::vector<std::string> paths = assetFiles();
+	if (!writeAssetPackage(path, paths, compress))
+	{
+		printf("could not write %s\n", path.c_str());
+		return false;
+	}
+	AssetPackage package;
+	if (!package.open(path))
+	{
+		printf("%s doesn't read back\n", path.c_str());
+		return false;
+	}
+	const char *typeNames[] = { "file", "shader", "image", "baked", "meshcache" };
+	printf("%-64s %10s %10s %10s\n", "entry", "type", "KB", "stored KB");
+	uint64_t size = 0, stored = 0;
+	for (unsigned int i = 0; i < package.entryCount(); i++)
+	{
+		const AssetPackageEntry &entry = package.entry(i);
+		printf("%-64s %10s %10.1f %10.1f%s\n", package.name(entry).c_str(), typeNames[entry.type], entry.size / 1024.0, entry.storedSize / 1024.0,
+			(entry.flags & ASSET_LZ4) ? " lz4" : "");
+		size += entry.size;
+		stored += entry.storedSize;
+	}
+	printf("%u entries, %.1f MB in %.1f MB\n", package.entryCount(), size / (1024.0 * 1024.0), stored / (1024.0 * 1024.0));
+	return true;
+}
+#endif
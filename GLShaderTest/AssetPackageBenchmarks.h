@@ -0,0 +1,95 @@
+#ifndef ASSET_PACKAGE_BENCHMARKS_H
+#define ASSET_PACKAGE_BENCHMARKS_H
+
+// Benchmark of reading out of the asset package (--pack-assets) against the loose files. CPU only, no GL.
+
+#include "SOIL2/SOIL2.h"
+
+#include "AssetPackage.h"
+#include "BenchmarkUtils.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --bench-package: every entry of the open asset package (--pack-assets writes one) read from its loose file (fopen
+// and fread) against out of the package, and for the images decoded from the file against from the package. best of
+// 3, summed per type of entry.
+inline void benchmarkAssetPackage()
+{
+	AssetPackage &package = assetPackage();
+	if (!package.isOpen())
+	{
+		printf("no asset package, run --pack-assets first\n");
+		return;
+	}
+	const char *typeNames[] = { "file", "shader", "image", "baked", "meshcache" };
+	const int types = 5, repeats = 3;
+	double fileMs[types] = {}, packageMs[types] = {}, decodeFileMs[types] = {}, decodePackageMs[types] = {};
+	size_t counts[types] = {}, lz4Bytes = 0;
+	double lz4Ms = 0.0;
+	uint64_t checksum = 0;
+	for (unsigned int i = 0; i < package.entryCount(); i++)
+	{
+		const AssetPackageEntry &entry = package.entry(i);
+		string path = package.name(entry);
+		unsigned int type = min<unsigned int>(entry.type, types - 1);
+		double bestFile = 1e30, bestPackage = 1e30, bestDecodeFile = 1e30, bestDecodePackage = 1e30;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			auto start = chrono::steady_clock::now();
+			vector<unsigned char> bytes((size_t)entry.size);
+			if (FILE *file = fopen(path.c_str(), "rb"))
+			{
+				size_t read = fread(bytes.data(), 1, bytes.size(), file);
+				(void)read;
+				fclose(file);
+			}
+			checksum ^= hashBytes(bytes.data(), bytes.size());
+			bestFile = min(bestFile, elapsedMs(start));
+
+			start = chrono::steady_clock::now();
+			AssetData data;
+			package.read(entry, data);
+			// hash it so every page is touched, a view alone costs nothing until it's used (the file read is hashed too below)
+			checksum ^= hashBytes(data.bytes, data.size);
+			bestPackage = min(bestPackage, elapsedMs(start));
+
+			if (entry.type == ASSET_IMAGE)
+			{
+				int width, height, channels;
+				start = chrono::steady_clock::now();
+				SOIL_free_image_data(SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO));
+				bestDecodeFile = min(bestDecodeFile, elapsedMs(start));
+				start = chrono::steady_clock::now();
+				SOIL_free_image_data(SOIL_load_image_from_memory(data.bytes, (int)data.size, &width, &height, &channels, SOIL_LOAD_AUTO));
+				bestDecodePackage = min(bestDecodePackage, elapsedMs(start));
+			}
+		}
+		fileMs[type] += bestFile;
+		packageMs[type] += bestPackage;
+		if (entry.type == ASSET_IMAGE)
+		{
+			decodeFileMs[type] += bestDecodeFile;
+			decodePackageMs[type] += bestDecodePackage;
+		}
+		if (entry.flags & ASSET_LZ4)
+		{
+			lz4Bytes += (size_t)entry.size;
+			lz4Ms += bestPackage;
+		}
+		counts[type]++;
+	}
+	printf("%-10s %8s %12s %12s %14s %14s\n", "type", "entries", "file ms", "package ms", "decode file", "decode package");
+	for (int type = 0; type < types; type++)
+		if (counts[type])
+			printf("%-10s %8zu %12.2f %12.2f %14.2f %14.2f\n", typeNames[type], counts[type], fileMs[type], packageMs[type], decodeFileMs[type],
+				decodePackageMs[type]);
+	if (lz4Bytes)
+		printf("LZ4 entries: %.1f MB read at %.0f MB/s\n", lz4Bytes / (1024.0 * 1024.0), lz4Bytes / (1024.0 * 1024.0) / (lz4Ms / 1000.0));
+	// file and package bytes are the same, so every entry cancels out of the checksum (each repeat twice)
+	printf("checksum %s\n", checksum == 0 ? "ok" : "MISMATCH");
+}
+#endif
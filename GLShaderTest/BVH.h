@@ -0,0 +1,394 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over axis aligned boxes, built with the surface area heuristic. Boxes are referred to by
+// their index in the vector given to build(). Moving a box doesn't need a rebuild: refit() grows and shrinks the
+// nodes above it, which keeps queries correct but lets the tree get worse the further things move from where they
+// were at build time. Empty boxes (emptyBounds()) are never found; build() leaves them out of the tree.
+
+inline float surfaceArea(const Bounds &bounds)
+{
+	glm::vec3 size = bounds.max - bounds.min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+inline Bounds mergeBounds(const Bounds &a, const Bounds &b)
+{
+	Bounds merged;
+	merged.min = glm::min(a.min, b.min);
+	merged.max = glm::max(a.max, b.max);
+	return merged;
+}
+
+// slab test, returns the distance along the ray where it enters the box (negative if it starts inside)
+inline bool rayIntersectsBounds(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const Bounds &bounds, float maxDistance, float &enter)
+{
+	float tMin = -FLT_MAX, tMax = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float t0 = (bounds.min[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (bounds.max[axis] - origin[axis]) * inverseDirection[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		// NaN from 0 * inf (a ray in the plane of a face) keeps the previous bound
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+	}
+	enter = tMin;
+	return tMin <= tMax && tMax >= 0.0f;
+}
+
+struct BVHNode {
+	Bounds bounds;
+	uint32_t first;	// leaf: first entry in the primitive order, inner node: index of the left child (the right one follows it)
+	uint32_t count;	// primitives of a leaf, 0 for inner nodes
+};
+
+class BVH
+{
+public:
+	static const uint32_t MAX_LEAF_SIZE = 4;
+	static const int BIN_COUNT = 16;
+	static const int MAX_DEPTH = 48;	// deeper nodes stay leaves, which bounds the traversal stacks below
+
+	void build(const std::vector<Bounds> &primitiveBounds)
+	{
+		boxes = primitiveBounds;
+		order.clear();
+		centroids.resize(boxes.size());
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (isEmpty(boxes[i]))
+				continue;
+			order.push_back((uint32_t)i);
+			centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+		}
+		nodes.clear();
+		parents.clear();
+		leafOf.assign(boxes.size(), UINT32_MAX);
+		size_t count = order.size();
+		if (count == 0)
+			return;
+		nodes.reserve(2 * count);
+		parents.reserve(2 * count);
+
+		nodes.push_back(BVHNode());
+		parents.push_back(UINT32_MAX);
+		nodes[0].first = 0;
+		nodes[0].count = (uint32_t)count;
+		std::vector<std::pair<uint32_t, int>> stack(1, std::make_pair(0u, 0));
+		while (!stack.empty())
+		{
+			uint32_t index = stack.back().first;
+			int depth = stack.back().second;
+			stack.pop_back();
+			updateNodeBounds(index);
+			uint32_t left;
+			if (depth >= MAX_DEPTH || !split(index, left))
+			{
+				for (uint32_t i = 0; i < nodes[index].count; i++)
+					leafOf[order[nodes[index].first + i]] = index;
+				continue;
+			}
+			stack.push_back(std::make_pair(left, depth + 1));
+			stack.push_back(std::make_pair(left + 1, depth + 1));
+		}
+	}
+
+	// moves one primitive and fixes the boxes on the way up, stopping where they no longer change. a box that becomes
+	// empty stays in its leaf and merges into nothing; one that was empty at build time isn't in the tree, refit
+	// returns false if it no longer is and the tree has to be built again to find it.
+	bool refit(uint32_t primitive, const Bounds &bounds)
+	{
+		boxes[primitive] = bounds;
+		uint32_t index = leafOf[primitive];
+		if (index == UINT32_MAX)
+			return isEmpty(bounds);
+		while (index != UINT32_MAX)
+		{
+			const BVHNode &node = nodes[index];
+			Bounds updated;
+			if (node.count)
+			{
+				updated = boxes[order[node.first]];
+				for (uint32_t i = 1; i < node.count; i++)
+					updated = mergeBounds(updated, boxes[order[node.first + i]]);
+			}
+			else
+				updated = mergeBounds(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+			if (updated.min == node.bounds.min && updated.max == node.bounds.max)
+				break;
+			nodes[index].bounds = updated;
+			index = parents[index];
+		}
+		return true;
+	}
+
+	// appends every primitive whose box isn't completely outside the frustum. subtrees completely inside are
+	// taken as a whole without testing their boxes.
+	void queryFrustum(const Frustum &frustum, std::vector<uint32_t> &out) const
+	{
+		if (nodes.empty())
+			return;
+		uint32_t stack[64];
+		bool inside[64];
+		int size = 0;
+		stack[size] = 0;
+		inside[size++] = false;
+		while (size > 0)
+		{
+			size--;
+			const BVHNode &node = nodes[stack[size]];
+			bool nodeInside = inside[size];
+			if (!nodeInside)
+			{
+				int result = classify(frustum, node.bounds);
+				if (result < 0)
+					continue;
+				nodeInside = result > 0;
+			}
+			if (node.count)
+			{
+				for (uint32_t i = 0; i < node.count; i++)
+				{
+					uint32_t primitive = order[node.first + i];
+					// a box refit to empty is still in its leaf
+					if (nodeInside ? !isEmpty(boxes[primitive]) : classify(frustum, boxes[primitive]) >= 0)
+						out.push_back(primitive);
+				}
+				continue;
+			}
+			stack[size] = node.first;
+			inside[size++] = nodeInside;
+			stack[size] = node.first + 1;
+			inside[size++] = nodeInside;
+		}
+	}
+
+	// nearest primitive the ray enters within maxDistance, direction doesn't need to be normalized (distance is then
+	// in units of its length). Boxes the ray starts inside of don't count, so a click from within a large box (the
+	// street around the camera) still finds the object in front of it.
+	bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, uint32_t &primitive, float &distance) const
+	{
+		if (nodes.empty())
+			return false;
+		glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float nearest = maxDistance;
+		bool hit = false;
+		float enter;
+		if (!rayIntersectsBounds(origin, inverseDirection, nodes[0].bounds, nearest, enter))
+			return false;
+		// nodes on the stack were hit, with the distance they were entered at
+		uint32_t stack[64];
+		float stackEnter[64];
+		int size = 0;
+		stack[size] = 0;
+		stackEnter[size++] = enter;
+		while (size > 0)
+		{
+			size--;
+			const BVHNode &node = nodes[stack[size]];
+			if (stackEnter[size] > nearest)
+				continue;
+			if (node.count)
+			{
+				for (uint32_t i = 0; i < node.count; i++)
+				{
+					uint32_t candidate = order[node.first + i];
+					if (!isEmpty(boxes[candidate]) && rayIntersectsBounds(origin, inverseDirection, boxes[candidate], nearest, enter) &&
+						enter >= 0.0f && enter < nearest)
+					{
+						nearest = enter;
+						primitive = candidate;
+						hit = true;
+					}
+				}
+				continue;
+			}
+			// visit the nearer child first so the far one is usually rejected by nearest
+			float enterLeft, enterRight;
+			bool left = rayIntersectsBounds(origin, inverseDirection, nodes[node.first].bounds, nearest, enterLeft);
+			bool right = rayIntersectsBounds(origin, inverseDirection, nodes[node.first + 1].bounds, nearest, enterRight);
+			if (left && right && enterLeft > enterRight)
+			{
+				stack[size] = node.first;
+				stackEnter[size++] = enterLeft;
+				left = false;
+			}
+			if (right)
+			{
+				stack[size] = node.first + 1;
+				stackEnter[size++] = enterRight;
+			}
+			if (left)
+			{
+				stack[size] = node.first;
+				stackEnter[size++] = enterLeft;
+			}
+		}
+		distance = nearest;
+		return hit;
+	}
+
+	size_t nodeCount() const { return nodes.size(); }
+	size_t primitiveCount() const { return boxes.size(); }
+	const Bounds& primitiveBounds(uint32_t primitive) const { return boxes[primitive]; }
+
+	// expected cost of a query relative to testing the root, what the build minimizes: inner nodes cost a box test,
+	// leaves one test per primitive, each weighted by the chance (surface area ratio) of being reached
+	float sahCost() const
+	{
+		if (nodes.empty())
+			return 0.0f;
+		float rootArea = surfaceArea(nodes[0].bounds);
+		if (rootArea <= 0.0f)
+			return (float)boxes.size();
+		float cost = 0.0f;
+		for (const BVHNode &node : nodes)
+			cost += surfaceArea(node.bounds) / rootArea * (node.count ? (float)node.count : 1.0f);
+		return cost;
+	}
+
+private:
+	std::vector<BVHNode> nodes;
+	std::vector<uint32_t> parents;	// per node, UINT32_MAX for the root
+	std::vector<uint32_t> order;	// primitive indices, each leaf owns a contiguous range
+	std::vector<uint32_t> leafOf;	// per primitive
+	std::vector<Bounds> boxes;		// per primitive
+	std::vector<glm::vec3> centroids;
+
+	// -1 outside, 0 intersecting, 1 inside every plane
+	static int classify(const Frustum &frustum, const Bounds &bounds)
+	{
+		if (isEmpty(bounds))
+			return -1;
+		glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+		int result = 1;
+		for (const glm::vec4 &plane : frustum.planes)
+		{
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+			if (distance + radius < 0.0f)
+				return -1;
+			if (distance - radius < 0.0f)
+				result = 0;
+		}
+		return result;
+	}
+
+	void updateNodeBounds(uint32_t index)
+	{
+		BVHNode &node = nodes[index];
+		node.bounds = boxes[order[node.first]];
+		for (uint32_t i = 1; i < node.count; i++)
+			node.bounds = mergeBounds(node.bounds, boxes[order[node.first + i]]);
+	}
+
+	// binned SAH over the centroids on all three axes. returns false if keeping the node as a leaf is cheaper,
+	// otherwise partitions its primitives and appends the two children.
+	bool split(uint32_t index, uint32_t &left)
+	{
+		BVHNode node = nodes[index];
+		if (node.count <= 1)
+			return false;
+
+		Bounds centroidBounds;
+		centroidBounds.min = centroidBounds.max = centroids[order[node.first]];
+		for (uint32_t i = 1; i < node.count; i++)
+		{
+			centroidBounds.min = glm::min(centroidBounds.min, centroids[order[node.first + i]]);
+			centroidBounds.max = glm::max(centroidBounds.max, centroids[order[node.first + i]]);
+		}
+
+		float bestCost = FLT_MAX;
+		int bestAxis = -1, bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float low = centroidBounds.min[axis], high = centroidBounds.max[axis];
+			if (high <= low)
+				continue;
+			struct Bin {
+				Bounds bounds;
+				uint32_t count = 0;
+			} bins[BIN_COUNT];
+			float scale = BIN_COUNT / (high - low);
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				uint32_t primitive = order[node.first + i];
+				int bin = std::min(BIN_COUNT - 1, (int)((centroids[primitive][axis] - low) * scale));
+				bins[bin].bounds = bins[bin].count ? mergeBounds(bins[bin].bounds, boxes[primitive]) : boxes[primitive];
+				bins[bin].count++;
+			}
+			// sweep from the right to get the cost of everything right of each split, then from the left
+			float rightArea[BIN_COUNT - 1];
+			uint32_t rightCount[BIN_COUNT - 1];
+			Bounds accumulated;
+			uint32_t count = 0;
+			for (int i = BIN_COUNT - 1; i > 0; i--)
+			{
+				if (bins[i].count)
+					accumulated = count ? mergeBounds(accumulated, bins[i].bounds) : bins[i].bounds;
+				count += bins[i].count;
+				rightCount[i - 1] = count;
+				rightArea[i - 1] = count ? surfaceArea(accumulated) : 0.0f;
+			}
+			count = 0;
+			for (int i = 0; i < BIN_COUNT - 1; i++)
+			{
+				if (bins[i].count)
+					accumulated = count ? mergeBounds(accumulated, bins[i].bounds) : bins[i].bounds;
+				count += bins[i].count;
+				if (count == 0 || rightCount[i] == 0)
+					continue;
+				float cost = surfaceArea(accumulated) * count + rightArea[i] * rightCount[i];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+
+		// a leaf costs one test per primitive, a split one box test plus its children weighted by their area
+		float parentArea = surfaceArea(node.bounds);
+		float splitCost = 1.0f + (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+		if (bestAxis < 0 || (node.count <= MAX_LEAF_SIZE && splitCost >= (float)node.count))
+			return false;
+
+		float low = centroidBounds.min[bestAxis];
+		float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - low);
+		uint32_t *begin = &order[node.first];
+		uint32_t *middle = std::partition(begin, begin + node.count, [&](uint32_t primitive) {
+			return std::min(BIN_COUNT - 1, (int)((centroids[primitive][bestAxis] - low) * scale)) <= bestSplit;
+		});
+		uint32_t leftCount = (uint32_t)(middle - begin);
+
+		left = (uint32_t)nodes.size();
+		BVHNode child;
+		child.first = node.first;
+		child.count = leftCount;
+		nodes.push_back(child);
+		child.first = node.first + leftCount;
+		child.count = node.count - leftCount;
+		nodes.push_back(child);
+		parents.push_back(index);
+		parents.push_back(index);
+		nodes[index].first = left;
+		nodes[index].count = 0;
+		return true;
+	}
+};
+#endif
@@ -0,0 +1,132 @@
+#ifndef BVH_BENCHMARKS_H
+#define BVH_BENCHMARKS_H
+
+// Benchmarks of the BVH against the flat frustum test and brute force ray picks, on the street model and on the random
+// boxes of FrustumBenchmarks.h. CPU only, no GL.
+
+#include <glm/glm.hpp>
+
+#include "BenchmarkUtils.h"
+#include "BVH.h"
+#include "FrustumBenchmarks.h"
+#include "ModelBenchmarks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// one set of boxes through the BVH: build, frustum queries against the flat BoxBatch, ray picks against testing every
+// box, and refitting one moving box. The picks and the query sizes have to match the brute force answers.
+inline void benchmarkBVHBoxes(const char *name, const vector<Bounds> &boxes, const Frustum &frustum, const glm::vec3 &eye)
+{
+	BVH bvh;
+	auto start = chrono::steady_clock::now();
+	bvh.build(boxes);
+	double buildMs = elapsedMs(start);
+
+	const int queries = 200;
+	vector<uint32_t> visible;
+	double queryUs = averageMs(queries, [&] {
+		visible.clear();
+		bvh.queryFrustum(frustum, visible);
+	}) * 1000.0;
+
+	BoxBatch batch;
+	for (const Bounds &box : boxes)
+		batch.add((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f);
+	size_t flatVisible = 0;
+	double flatUs = averageMs(queries, [&] { flatVisible = batch.cull(frustum); }) * 1000.0;
+
+	// rays from the eye in random directions, answered by the tree and by testing every box
+	const int rays = 20000;
+	srand(2);
+	vector<glm::vec3> directions(rays);
+	for (glm::vec3 &direction : directions)
+		direction = glm::normalize(glm::vec3(rand() % 2001 - 1000.0f, rand() % 2001 - 1000.0f, rand() % 2001 - 1000.0f) + glm::vec3(0.001f));
+	vector<int> hits(rays);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < rays; i++)
+	{
+		uint32_t primitive;
+		float distance;
+		hits[i] = bvh.raycast(eye, directions[i], 1000.0f, primitive, distance) ? (int)primitive : -1;
+	}
+	double rayUs = elapsedMs(start) * 1000.0 / rays;
+	size_t mismatches = 0;
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < rays; i++)
+	{
+		glm::vec3 inverse(1.0f / directions[i].x, 1.0f / directions[i].y, 1.0f / directions[i].z);
+		float nearest = 1000.0f;
+		int found = -1;
+		for (size_t b = 0; b < boxes.size(); b++)
+		{
+			float enter;
+			if (rayIntersectsBounds(eye, inverse, boxes[b], nearest, enter) && enter >= 0.0f && enter < nearest)
+			{
+				nearest = enter;
+				found = (int)b;
+			}
+		}
+		// boxes entered at the same distance may be picked either way
+		if (found != hits[i])
+		{
+			float enter = -1.0f;
+			bool tie = found >= 0 && hits[i] >= 0 && rayIntersectsBounds(eye, inverse, boxes[hits[i]], 1000.0f, enter) && fabs(enter - nearest) < 1e-4f;
+			mismatches += !tie;
+		}
+	}
+	double bruteUs = elapsedMs(start) * 1000.0 / rays;
+
+	// one box moving in small steps, like the ball
+	const int refits = 10000;
+	Bounds moving = boxes[0];
+	double refitUs = averageMs(refits, [&] {
+		moving.min.x += 0.01f;
+		moving.max.x += 0.01f;
+		bvh.refit(0, moving);
+	}) * 1000.0;
+
+	printf("%-24s %8zu %7zu %9.3f %8.2f %9.2f %9.2f %8zu %8.3f %8.3f %8zu %8.3f\n", name, boxes.size(), bvh.nodeCount(), buildMs,
+		bvh.sahCost(), queryUs, flatUs, visible.size() == flatVisible ? visible.size() : (size_t)-1, rayUs, bruteUs, mismatches, refitUs);
+}
+
+// --bench-bvh: the meshes of the street model, once and as a grid of copies, plus random boxes, through the BVH
+// (see benchmarkBVHBoxes). Times are per call; "visible" is -1 if the tree and the flat test disagree.
+inline void benchmarkBVH()
+{
+	Frustum frustum = sceneFrustum();
+
+	printf("%-24s %8s %7s %9s %8s %9s %9s %8s %8s %8s %8s %8s\n", "boxes", "count", "nodes", "build ms", "SAH", "query us",
+		"flat us", "visible", "ray us", "brute us", "mismatch", "refit us");
+
+	vector<MeshData> meshData;
+	if (importMeshData("model/street/Street environment_V01.obj", meshData))
+	{
+		vector<Bounds> street;
+		for (const MeshData &data : meshData)
+			street.push_back(computeBounds(data.vertices.data(), data.vertices.size()));
+		Bounds all = street.empty() ? Bounds() : street[0];
+		for (const Bounds &box : street)
+			all = mergeBounds(all, box);
+		benchmarkBVHBoxes("street", street, frustum, SCENE_EYE);
+
+		// 8 x 8 streets side by side
+		vector<Bounds> grid;
+		glm::vec3 size = all.max - all.min;
+		for (int x = 0; x < 8; x++)
+			for (int z = 0; z < 8; z++)
+				for (const Bounds &box : street)
+				{
+					glm::vec3 offset((x - 4) * size.x, 0.0f, (z - 4) * size.z);
+					grid.push_back(Bounds{ box.min + offset, box.max + offset });
+				}
+		benchmarkBVHBoxes("street 8x8", grid, frustum, SCENE_EYE);
+	}
+
+	const size_t randomCounts[] = { 10000, 100000 };
+	for (size_t count : randomCounts)
+		benchmarkBVHBoxes(count == 10000 ? "random 10k" : "random 100k", randomSceneBoxes(count, 1.0f), frustum, SCENE_EYE);
+}
+#endif
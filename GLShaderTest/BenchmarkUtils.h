@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_UTILS_H
+#define BENCHMARK_UTILS_H
+
+// What the benchmarks next to the subsystems (ModelBenchmarks.h, RenderQueueBenchmarks.h, ...) share: timing, the
+// thread counts to try and the models to run on. Every benchmark is a command line mode of main.cpp that prints a small
+// table to stdout and returns.
+
+#include "FileUtils.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+using namespace std;
+
+// model formats we look for under model/
+inline vector<string> listModelFiles(const string &dir)
+{
+	vector<string> models;
+	listFiles(dir, { "obj", "fbx", "3ds", "dae", "blend" }, models);
+	return models;
+}
+
+inline double elapsedMs(chrono::steady_clock::time_point since)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+}
+
+// the fastest of repeats runs of run, in ms
+template <typename Run>
+inline double bestOfMs(int repeats, Run run)
+{
+	double bestMs = 1e30;
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		auto start = chrono::steady_clock::now();
+		run();
+		bestMs = min(bestMs, elapsedMs(start));
+	}
+	return bestMs;
+}
+
+// the mean time of repeats runs of run, in ms
+template <typename Run>
+inline double averageMs(int repeats, Run run)
+{
+	auto start = chrono::steady_clock::now();
+	for (int repeat = 0; repeat < repeats; repeat++)
+		run();
+	return elapsedMs(start) / repeats;
+}
+
+// thread counts to try: 1, 2, 4, ... up to the shared pool plus the calling thread
+inline vector<unsigned int> benchmarkThreadCounts()
+{
+	unsigned int maxThreads = sharedThreadPool().size() + 1;
+	vector<unsigned int> counts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(maxThreads);
+	return counts;
+}
+#endif
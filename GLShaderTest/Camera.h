@@ -114,6 +114,15 @@ public:
 		updateCameraVectors();
 	}
 
+	// puts the camera at position looking along yaw / pitch, e.g. from a scripted path
+	void SetPose(glm::vec3 position, float yaw, float pitch)
+	{
+		Position = position;
+		Yaw = yaw;
+		Pitch = pitch;
+		updateCameraVectors();
+	}
+
 	// processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
 	void ProcessMouseScroll(float yoffset)
 	{
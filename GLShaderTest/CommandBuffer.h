@@ -0,0 +1,277 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+// Deferred draw commands. A CommandRecorder is a RenderBackend that doesn't call GL but appends what it was asked to
+// do to a CommandBuffer as small POD commands, so any thread can execute part of a RenderQueue into one.
+// recordRenderQueue splits the sorted items into one contiguous range per thread and records them in parallel, each
+// thread into its own buffer (an arena of bytes that keeps its memory from frame to frame). replayCommandBuffers then
+// merges the buffers in order on the render thread and hands the commands to the real backend. Every range starts
+// as if nothing was bound, so merging drops the state commands that only repeat what the previous range left bound:
+// the backend sees exactly the calls RenderQueue::execute would have made (checkCommandBuffers in GLShaderTestChecks).
+
+#include <glm/glm.hpp>
+
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+enum CommandType : uint32_t {
+	COMMAND_USE_PROGRAM,
+	COMMAND_BIND_TEXTURE,
+	COMMAND_MATERIAL,
+	COMMAND_BIND_VERTEX_ARRAY,
+	COMMAND_DRAW,
+};
+
+struct UseProgramCommand {
+	Shader *shader;
+	unsigned int program;
+};
+
+struct BindTextureCommand {
+	unsigned int unit;
+	GLenum target;
+	unsigned int texture;
+};
+
+// points the samplers of material at their units, or resets the material uniforms if it is null
+struct MaterialCommand {
+	Shader *shader;
+	const RenderMaterial *material;
+};
+
+struct BindVertexArrayCommand {
+	unsigned int vao;
+};
+
+// what RenderBackend::draw reads of a DrawItem, plus the state it was recorded under for merging
+struct DrawCommand {
+	glm::mat4 model;
+	Shader *shader;
+	const RenderMaterial *material;
+	const Bounds *packedBounds;
+	GLenum indexType;
+	GLsizei count;
+	unsigned int firstIndex;
+	GLsizei instanceCount;
+};
+
+// commands back to back, each a CommandHeader and its payload, both padded to 8 bytes
+class CommandBuffer
+{
+public:
+	struct CommandHeader {
+		CommandType type;
+		uint32_t size;		// of the payload
+	};
+
+	// forgets the commands, keeps the memory
+	void clear()
+	{
+		used = 0;
+		commandCount = 0;
+	}
+
+	size_t size() const { return commandCount; }
+	size_t bytes() const { return used; }
+
+	template <typename T>
+	void push(CommandType type, const T &payload)
+	{
+		CommandHeader header = { type, (uint32_t)sizeof(T) };
+		size_t needed = used + padded(sizeof(CommandHeader)) + padded(sizeof(T));
+		if (needed > memory.size())
+			memory.resize(std::max(needed, memory.size() * 2));
+		memcpy(memory.data() + used, &header, sizeof(header));
+		memcpy(memory.data() + used + padded(sizeof(CommandHeader)), &payload, sizeof(T));
+		used = needed;
+		commandCount++;
+	}
+
+	// walks the commands in order: visit(type, payload) for each
+	template <typename Visitor>
+	void forEach(Visitor &&visit) const
+	{
+		size_t offset = 0;
+		while (offset < used)
+		{
+			CommandHeader header;
+			memcpy(&header, memory.data() + offset, sizeof(header));
+			offset += padded(sizeof(CommandHeader));
+			visit(header.type, memory.data() + offset);
+			offset += padded(header.size);
+		}
+	}
+
+	template <typename T>
+	static T read(const unsigned char *payload)
+	{
+		T value;
+		memcpy(&value, payload, sizeof(T));
+		return value;
+	}
+
+private:
+	std::vector<unsigned char> memory;
+	size_t used = 0;
+	size_t commandCount = 0;
+
+	static size_t padded(size_t size) { return (size + 7) & ~(size_t)7; }
+};
+
+// ------------------------------------------------------------------------
+// the backend a range of the queue is executed against on a worker thread, touches nothing but its buffer
+class CommandRecorder : public RenderBackend
+{
+public:
+	explicit CommandRecorder(CommandBuffer &buffer) : buffer(buffer) {}
+
+	void useProgram(const DrawItem &item)
+	{
+		buffer.push(COMMAND_USE_PROGRAM, UseProgramCommand{ item.shader, item.program });
+	}
+
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+	{
+		buffer.push(COMMAND_BIND_TEXTURE, BindTextureCommand{ unit, target, texture });
+	}
+
+	void setMaterialUniforms(const DrawItem &item)
+	{
+		buffer.push(COMMAND_MATERIAL, MaterialCommand{ item.shader, item.material });
+	}
+
+	void bindVertexArray(unsigned int vao)
+	{
+		buffer.push(COMMAND_BIND_VERTEX_ARRAY, BindVertexArrayCommand{ vao });
+	}
+
+	void draw(const DrawItem &item)
+	{
+		buffer.push(COMMAND_DRAW, DrawCommand{ item.model, item.shader, item.material, item.packedBounds,
+			item.indexType, item.count, item.firstIndex, item.instanceCount });
+	}
+
+private:
+	CommandBuffer &buffer;
+};
+
+// ranges smaller than this aren't worth a thread
+const size_t COMMAND_RECORD_MIN_ITEMS = 256;
+
+// executes the queue into buffers, one range per thread on up to maxThreads threads of pool (0 = all of them plus the
+// calling one), and clears it. buffers is resized to the number of ranges. stats count everything but the state
+// changes, which are only known once replayCommandBuffers has merged the ranges.
+inline RenderQueueStats recordRenderQueue(RenderQueue &queue, ThreadPool &pool, std::vector<CommandBuffer> &buffers, unsigned int maxThreads = 0)
+{
+	PROFILE_SCOPE("recordRenderQueue");
+	size_t count = queue.order();
+	size_t threads = maxThreads == 0 ? pool.size() + 1 : maxThreads;
+	size_t ranges = std::max<size_t>(1, std::min(threads, count / COMMAND_RECORD_MIN_ITEMS));
+	buffers.resize(ranges);
+	std::vector<RenderQueueStats> rangeStats(ranges);
+	pool.parallelFor(ranges, [&](size_t range) {
+		buffers[range].clear();
+		CommandRecorder recorder(buffers[range]);
+		rangeStats[range] = queue.executeRange(count * range / ranges, count * (range + 1) / ranges, recorder);
+	}, (unsigned int)ranges);
+
+	RenderQueueStats stats;
+	for (const RenderQueueStats &range : rangeStats)
+		stats += range;
+	stats.programs = stats.textures = stats.vaos = 0;
+	stats.culled = queue.culledCount();
+	queue.clear();
+	return stats;
+}
+
+// merges buffers in order into backend on the render thread. a state command is dropped when it only repeats the
+// state the commands before it left, which is what execute's filtering would have left out; stats gets the state
+// changes that went through.
+inline void replayCommandBuffers(const std::vector<CommandBuffer> &buffers, RenderBackend &backend, RenderQueueStats &stats)
+{
+	PROFILE_SCOPE("replayCommandBuffers");
+	DrawItem item = DrawItem();
+	bool haveProgram = false, programSet = false;
+	unsigned int program = 0;
+	const RenderMaterial *material = nullptr;	// of the last draw
+	bool haveVao = false;
+	unsigned int vao = 0;
+	BoundTexture boundTextures[RenderQueue::MAX_TEXTURE_UNITS];
+
+	for (const CommandBuffer &buffer : buffers)
+	{
+		buffer.forEach([&](CommandType type, const unsigned char *payload) {
+			switch (type)
+			{
+			case COMMAND_USE_PROGRAM:
+			{
+				UseProgramCommand command = CommandBuffer::read<UseProgramCommand>(payload);
+				if (haveProgram && command.program == program)
+					return;
+				item.shader = command.shader;
+				item.program = command.program;
+				backend.useProgram(item);
+				program = command.program;
+				haveProgram = programSet = true;
+				stats.programs++;
+				return;
+			}
+			case COMMAND_BIND_TEXTURE:
+			{
+				BindTextureCommand command = CommandBuffer::read<BindTextureCommand>(payload);
+				if (boundTextures[command.unit].holds(command.target, command.texture))
+					return;
+				backend.bindTexture(command.unit, command.target, command.texture);
+				boundTextures[command.unit].bind(command.target, command.texture);
+				stats.textures++;
+				return;
+			}
+			case COMMAND_MATERIAL:
+			{
+				MaterialCommand command = CommandBuffer::read<MaterialCommand>(payload);
+				if (!programSet && command.material == material)
+					return;
+				item.shader = command.shader;
+				item.material = command.material;
+				backend.setMaterialUniforms(item);
+				return;
+			}
+			case COMMAND_BIND_VERTEX_ARRAY:
+			{
+				BindVertexArrayCommand command = CommandBuffer::read<BindVertexArrayCommand>(payload);
+				if (haveVao && command.vao == vao)
+					return;
+				backend.bindVertexArray(command.vao);
+				vao = command.vao;
+				haveVao = true;
+				stats.vaos++;
+				return;
+			}
+			case COMMAND_DRAW:
+			{
+				DrawCommand command = CommandBuffer::read<DrawCommand>(payload);
+				item.model = command.model;
+				item.shader = command.shader;
+				item.program = program;
+				item.material = command.material;
+				item.vao = vao;
+				item.packedBounds = command.packedBounds;
+				item.indexType = command.indexType;
+				item.count = command.count;
+				item.firstIndex = command.firstIndex;
+				item.instanceCount = command.instanceCount;
+				backend.draw(item);
+				material = command.material;
+				programSet = false;
+				return;
+			}
+			}
+		});
+	}
+}
+#endif
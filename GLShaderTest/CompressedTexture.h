@@ -0,0 +1,306 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+// Precompressed textures with all their mipmaps, as --bake-textures (TextureBaker.h) writes them next to the source
+// image: "<image>.dds" holds DXT1 or DXT5, "<image>.ktx" ETC1. Both record the FNV-1a hash of the image they were baked
+// from (the DDS in its reserved words, the KTX under the key "sourceHash"), so a baked file whose source changed since
+// is ignored, like a stale model cache. Loading one is a read of the file and a glCompressedTexImage2D per level: no
+// decoding and no glGenerateMipmap. A DDS can also hold the six faces of a cubemap (CubeMap.h), one after the other.
+// Nothing in here touches OpenGL, the uploads are in TextureUpload.h.
+
+#include "SOIL2/SOIL2.h"
+
+#include "AssetPackage.h"
+#include "FileUtils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// formats of the levels, as GL enums. desktop GL has no ETC1 of its own, ETC1 data is valid ETC2 RGB8 and uploaded as
+// that. the sRGB ones are the same data, decoded to linear when sampled.
+const uint32_t COMPRESSED_FORMAT_DXT1 = 0x83F0;			// GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+const uint32_t COMPRESSED_FORMAT_DXT5 = 0x83F3;			// GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+const uint32_t COMPRESSED_FORMAT_ETC1 = 0x8D64;			// GL_ETC1_RGB8_OES
+const uint32_t COMPRESSED_FORMAT_ETC2_RGB8 = 0x9274;	// GL_COMPRESSED_RGB8_ETC2
+const uint32_t COMPRESSED_FORMAT_SRGB_DXT1 = 0x8C4C;	// GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+const uint32_t COMPRESSED_FORMAT_SRGB_DXT5 = 0x8C4F;	// GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+const uint32_t COMPRESSED_FORMAT_SRGB_ETC2_RGB8 = 0x9275;	// GL_COMPRESSED_SRGB8_ETC2
+
+// baked containers, a bit mask of them says which ones the loader may use (see supportedBakedFormats)
+const unsigned int BAKED_DDS = 1 << 0;
+const unsigned int BAKED_KTX = 1 << 1;
+
+struct CompressedTexture {
+	uint32_t format = 0;
+	int width = 0, height = 0;				// of level 0
+	std::vector<size_t> levelOffsets;		// level i is data[levelOffsets[i], levelOffsets[i + 1])
+	std::vector<unsigned char> data;
+
+	size_t levels() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+
+	void appendLevel(const unsigned char *bytes, size_t size)
+	{
+		if (levelOffsets.empty())
+			levelOffsets.push_back(0);
+		data.insert(data.end(), bytes, bytes + size);
+		levelOffsets.push_back(data.size());
+	}
+};
+
+inline size_t compressedLevelSize(uint32_t format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (format == COMPRESSED_FORMAT_DXT5 ? 16 : 8);
+}
+
+// true if the levels are all there and as large as their format and size make them
+inline bool compressedLevelsValid(const CompressedTexture &texture)
+{
+	if (texture.width < 1 || texture.height < 1 || texture.levels() == 0)
+		return false;
+	int width = texture.width, height = texture.height;
+	for (size_t level = 0; level < texture.levels(); level++)
+	{
+		if (texture.levelOffsets[level + 1] - texture.levelOffsets[level] != compressedLevelSize(texture.format, width, height))
+			return false;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return true;
+}
+
+inline std::string bakedDDSPath(const std::string &imagePath)
+{
+	return imagePath + ".dds";
+}
+
+inline std::string bakedKTXPath(const std::string &imagePath)
+{
+	return imagePath + ".ktx";
+}
+
+// DDS: "DDS ", then this header, then the levels back to back (of each face in turn for a cubemap)
+const uint32_t DDS_MAGIC = 0x20534444;			// "DDS "
+const uint32_t DDS_BAKED_MAGIC = 0x454B4142;	// "BAKE", in reserved1[0], the source hash follows in [1] and [2]
+const uint32_t DDS_FOURCC_DXT1 = 0x31545844;	// "DXT1"
+const uint32_t DDS_FOURCC_DXT5 = 0x35545844;	// "DXT5"
+const uint32_t DDS_CAPS2_CUBEMAP = 0x200 | 0xFC00;	// cubemap, with all six faces
+
+struct DDSHeader {
+	uint32_t size, flags, height, width, linearSize, depth, mipMapCount;
+	uint32_t reserved1[11];
+	uint32_t pixelFormatSize, pixelFormatFlags, fourCC, rgbBitCount, bitMasks[4];
+	uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+// writes faceCount (1, or 6 for a cubemap) textures of the same format, size and levels
+inline bool writeBakedDDS(const std::string &path, const CompressedTexture *faces, int faceCount, uint64_t sourceHash)
+{
+	const CompressedTexture &texture = faces[0];
+	if (texture.format != COMPRESSED_FORMAT_DXT1 && texture.format != COMPRESSED_FORMAT_DXT5)
+		return false;
+	for (int face = 1; face < faceCount; face++)
+		if (faces[face].format != texture.format || faces[face].width != texture.width || faces[face].height != texture.height ||
+			faces[face].levels() != texture.levels())
+			return false;
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDSHeader);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// caps, height, width, pixel format, mipmap count, linear size
+	header.height = texture.height;
+	header.width = texture.width;
+	header.linearSize = (uint32_t)compressedLevelSize(texture.format, texture.width, texture.height);
+	header.mipMapCount = (uint32_t)texture.levels();
+	header.reserved1[0] = DDS_BAKED_MAGIC;
+	header.reserved1[1] = (uint32_t)sourceHash;
+	header.reserved1[2] = (uint32_t)(sourceHash >> 32);
+	header.pixelFormatSize = 32;
+	header.pixelFormatFlags = 0x4;	// fourCC
+	header.fourCC = texture.format == COMPRESSED_FORMAT_DXT5 ? DDS_FOURCC_DXT5 : DDS_FOURCC_DXT1;
+	header.caps = 0x1000 | 0x8 | 0x400000;	// texture, complex, mipmap
+	header.caps2 = faceCount == 6 ? DDS_CAPS2_CUBEMAP : 0;
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(&DDS_MAGIC, 4, 1, file) == 1 && fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int face = 0; face < faceCount && ok; face++)
+		ok = fwrite(faces[face].data.data(), 1, faces[face].data.size(), file) == faces[face].data.size();
+	return fclose(file) == 0 && ok;
+}
+
+inline bool writeBakedDDS(const std::string &path, const CompressedTexture &texture, uint64_t sourceHash)
+{
+	return writeBakedDDS(path, &texture, 1, sourceHash);
+}
+
+// the bytes of a baked file, from the asset package if it has it
+struct BakedFile {
+	MappedFile file;
+	AssetData packaged;
+
+	bool open(const std::string &path)
+	{
+		if (assetPackage().read(path, packaged))
+			return true;
+		if (!file.open(path))
+			return false;
+		packaged.bytes = file.data();
+		packaged.size = file.size();
+		return true;
+	}
+	const unsigned char* data() const { return packaged.bytes; }
+	size_t size() const { return packaged.size; }
+};
+
+// reads a DDS the baker wrote from sourceHash into faceCount textures (1, or 6 for a cubemap), false for any other file
+// or one with another number of faces
+inline bool readBakedDDS(const std::string &path, uint64_t sourceHash, CompressedTexture *faces, int faceCount)
+{
+	BakedFile file;
+	if (!file.open(path) || file.size() < 4 + sizeof(DDSHeader))
+		return false;
+	uint32_t magic;
+	DDSHeader header;
+	memcpy(&magic, file.data(), 4);
+	memcpy(&header, file.data() + 4, sizeof(header));
+	if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) || header.reserved1[0] != DDS_BAKED_MAGIC ||
+		(header.reserved1[1] | (uint64_t)header.reserved1[2] << 32) != sourceHash)
+		return false;
+	if (header.fourCC != DDS_FOURCC_DXT1 && header.fourCC != DDS_FOURCC_DXT5)
+		return false;
+	if ((header.caps2 & DDS_CAPS2_CUBEMAP) != (faceCount == 6 ? DDS_CAPS2_CUBEMAP : 0))
+		return false;
+
+	size_t offset = 4 + sizeof(DDSHeader);
+	for (int face = 0; face < faceCount; face++)
+	{
+		CompressedTexture &texture = faces[face];
+		texture = CompressedTexture();
+		texture.format = header.fourCC == DDS_FOURCC_DXT5 ? COMPRESSED_FORMAT_DXT5 : COMPRESSED_FORMAT_DXT1;
+		texture.width = (int)header.width;
+		texture.height = (int)header.height;
+		int width = texture.width, height = texture.height;
+		for (uint32_t level = 0; level < header.mipMapCount && width > 0 && height > 0; level++)
+		{
+			size_t size = compressedLevelSize(texture.format, width, height);
+			if (offset + size > file.size())
+				return false;
+			texture.appendLevel(file.data() + offset, size);
+			offset += size;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+		if (!compressedLevelsValid(texture))
+			return false;
+	}
+	return true;
+}
+
+inline bool readBakedDDS(const std::string &path, uint64_t sourceHash, CompressedTexture &texture)
+{
+	return readBakedDDS(path, sourceHash, &texture, 1);
+}
+
+// KTX 1.1: identifier, this header, key/value data, then each level as its size and its bytes (padded to 4 bytes)
+const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct KTXHeader {
+	uint32_t endianness;
+	uint32_t glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat;
+	uint32_t pixelWidth, pixelHeight, pixelDepth;
+	uint32_t numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+// the one key/value pair: its size, "sourceHash\0", the 8 byte hash and padding to a multiple of 4
+const char KTX_SOURCE_HASH_KEY[] = "sourceHash";
+const uint32_t KTX_SOURCE_HASH_SIZE = sizeof(KTX_SOURCE_HASH_KEY) + 8;
+const uint32_t KTX_KEY_VALUE_BYTES = 4 + (KTX_SOURCE_HASH_SIZE + 3) / 4 * 4;
+
+inline bool writeBakedKTX(const std::string &path, const CompressedTexture &texture, uint64_t sourceHash)
+{
+	if (texture.format != COMPRESSED_FORMAT_ETC1)
+		return false;
+	KTXHeader header;
+	memset(&header, 0, sizeof(header));
+	header.endianness = 0x04030201;
+	header.glTypeSize = 1;
+	header.glInternalFormat = texture.format;
+	header.glBaseInternalFormat = 0x1907;	// GL_RGB
+	header.pixelWidth = texture.width;
+	header.pixelHeight = texture.height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t)texture.levels();
+	header.bytesOfKeyValueData = KTX_KEY_VALUE_BYTES;
+
+	std::vector<unsigned char> keyValue(KTX_KEY_VALUE_BYTES, 0);
+	memcpy(&keyValue[0], &KTX_SOURCE_HASH_SIZE, 4);
+	memcpy(&keyValue[4], KTX_SOURCE_HASH_KEY, sizeof(KTX_SOURCE_HASH_KEY));
+	memcpy(&keyValue[4 + sizeof(KTX_SOURCE_HASH_KEY)], &sourceHash, 8);
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER), 1, file) == 1 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(keyValue.data(), 1, keyValue.size(), file) == keyValue.size();
+	// ETC1 levels are whole 8 byte blocks, so they never need padding
+	for (size_t level = 0; ok && level < texture.levels(); level++)
+	{
+		uint32_t size = (uint32_t)(texture.levelOffsets[level + 1] - texture.levelOffsets[level]);
+		ok = fwrite(&size, 4, 1, file) == 1 && fwrite(&texture.data[texture.levelOffsets[level]], 1, size, file) == size;
+	}
+	return fclose(file) == 0 && ok;
+}
+
+// reads a KTX the baker wrote from sourceHash, false for any other file
+inline bool readBakedKTX(const std::string &path, uint64_t sourceHash, CompressedTexture &texture)
+{
+	BakedFile file;
+	if (!file.open(path) || file.size() < sizeof(KTX_IDENTIFIER) + sizeof(KTXHeader) + KTX_KEY_VALUE_BYTES)
+		return false;
+	KTXHeader header;
+	memcpy(&header, file.data() + sizeof(KTX_IDENTIFIER), sizeof(header));
+	const unsigned char *keyValue = file.data() + sizeof(KTX_IDENTIFIER) + sizeof(header);
+	uint64_t hash;
+	memcpy(&hash, keyValue + 4 + sizeof(KTX_SOURCE_HASH_KEY), 8);
+	if (memcmp(file.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != 0x04030201 ||
+		header.glInternalFormat != COMPRESSED_FORMAT_ETC1 || header.bytesOfKeyValueData != KTX_KEY_VALUE_BYTES ||
+		memcmp(keyValue + 4, KTX_SOURCE_HASH_KEY, sizeof(KTX_SOURCE_HASH_KEY)) != 0 || hash != sourceHash)
+		return false;
+
+	texture = CompressedTexture();
+	texture.format = COMPRESSED_FORMAT_ETC1;
+	texture.width = (int)header.pixelWidth;
+	texture.height = (int)header.pixelHeight;
+	size_t offset = sizeof(KTX_IDENTIFIER) + sizeof(header) + KTX_KEY_VALUE_BYTES;
+	for (uint32_t level = 0; level < header.numberOfMipmapLevels; level++)
+	{
+		uint32_t size;
+		if (offset + 4 > file.size())
+			return false;
+		memcpy(&size, file.data() + offset, 4);
+		offset += 4;
+		if (offset + size > file.size())
+			return false;
+		texture.appendLevel(file.data() + offset, size);
+		offset += (size + 3) / 4 * 4;
+	}
+	return compressedLevelsValid(texture);
+}
+
+// reads the baked file of imagePath, if there is one in formats that was baked from the image as it is now. with an
+// asset package that has the image and its baked file, neither is read from the disk.
+inline bool loadBakedTexture(const std::string &imagePath, unsigned int formats, CompressedTexture &texture)
+{
+	auto exists = [](const std::string &path) { return assetPackage().find(path) || fileExists(path); };
+	bool dds = (formats & BAKED_DDS) && exists(bakedDDSPath(imagePath));
+	bool ktx = (formats & BAKED_KTX) && exists(bakedKTXPath(imagePath));
+	uint64_t sourceHash;
+	if ((!dds && !ktx) || !assetHash(imagePath, sourceHash))
+		return false;
+	return (dds && readBakedDDS(bakedDDSPath(imagePath), sourceHash, texture)) ||
+		(ktx && readBakedKTX(bakedKTXPath(imagePath), sourceHash, texture));
+}
+#endif
@@ -0,0 +1,263 @@
+#ifndef CUBE_MAP_H
+#define CUBE_MAP_H
+
+// Cubemaps from six face images, in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i. The faces are decoded at the same
+// time by the workers of the shared pool and the loading thread, which uploads each face as soon as it is decoded into
+// storage allocated once for all six: immutable (glTexStorage2D) where the context has it, else glTexImage2D without
+// data. A cubemap --bake-textures baked from the faces as they are now ("cubemap.dds" next to them, DXT1 or DXT5, the
+// six faces in one file) is uploaded instead, with nothing to decode, as long as it can stand in for the internal format
+// asked for: an RGB(A) one, uploaded as the sRGB DXT formats when that is sRGB (and the context has them). Other
+// internal formats always decode the faces. It only has level 0, cubemaps are sampled without mipmaps here.
+
+#include <glad/glad.h>
+#include "SOIL2/SOIL2.h"
+
+#include "AssetPackage.h"
+#include "CompressedTexture.h"
+#include "FileUtils.h"
+#include "TextureUpload.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+const int CUBE_MAP_FACES = 6;
+
+// the face images of a skybox directory, in the order the skybox uses them
+inline std::vector<std::string> cubeMapFaces(const std::string &directory, const std::string &extension = "jpg")
+{
+	std::vector<std::string> faces;
+	for (const char *name : { "right", "left", "bottom", "top", "front", "back" })
+		faces.push_back(directory + "/" + name + "." + extension);
+	return faces;
+}
+
+inline std::string bakedCubeMapPath(const std::vector<std::string> &faces)
+{
+	size_t slash = faces[0].find_last_of("/\\");
+	return (slash == std::string::npos ? std::string() : faces[0].substr(0, slash + 1)) + "cubemap.dds";
+}
+
+// the hash a baked cubemap records, of the hashes of its faces in order
+inline bool cubeMapSourceHash(const std::vector<std::string> &faces, uint64_t &hash)
+{
+	hash = hashBytes(NULL, 0);
+	for (const std::string &face : faces)
+	{
+		uint64_t faceHash;
+		if (!assetHash(face, faceHash))
+			return false;
+		hash = hashBytes(&faceHash, sizeof(faceHash), hash);
+	}
+	return true;
+}
+
+// reads the baked cubemap of faces, if there is one in formats that was baked from the faces as they are now
+inline bool loadBakedCubeMap(const std::vector<std::string> &faces, unsigned int formats, CompressedTexture (&textures)[CUBE_MAP_FACES])
+{
+	if (faces.size() != CUBE_MAP_FACES || !(formats & BAKED_DDS))
+		return false;
+	std::string path = bakedCubeMapPath(faces);
+	uint64_t sourceHash;
+	return (assetPackage().find(path) || fileExists(path)) && cubeMapSourceHash(faces, sourceHash) &&
+		readBakedDDS(path, sourceHash, textures, CUBE_MAP_FACES);
+}
+
+// whether a baked cubemap can be uploaded for faces asked for as internalFormat, and if so whether as sRGB. call on
+// the GL thread.
+inline bool bakedCubeMapFormat(GLint internalFormat, bool &srgb)
+{
+	switch (internalFormat)
+	{
+	case GL_RGB: case GL_RGB8: case GL_RGBA: case GL_RGBA8:
+		srgb = false;
+		return true;
+	case GL_SRGB: case GL_SRGB8: case GL_SRGB_ALPHA: case GL_SRGB8_ALPHA8:
+		srgb = true;
+		return SOIL_GL_ExtensionSupported("GL_EXT_texture_sRGB") != 0;
+	}
+	return false;
+}
+
+typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+
+// glTexStorage2D if the context has it (GL 4.2 or ARB_texture_storage), else NULL. glad.c is generated for GL 4.0
+// core without extensions, so it has no pointer for it and it comes from SOIL's loader; the window asks for 3.3 and
+// gets it only from a newer driver or the extension. call on the GL thread.
+inline TexStorage2DProc texStorage2D()
+{
+	static TexStorage2DProc proc = [] {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		bool supported = major > 4 || (major == 4 && minor >= 2) || SOIL_GL_ExtensionSupported("GL_ARB_texture_storage");
+		return supported ? (TexStorage2DProc)SOIL_GL_GetProcAddress("glTexStorage2D") : (TexStorage2DProc)NULL;
+	}();
+	return proc;
+}
+
+// immutable storage only takes sized formats
+inline GLenum sizedTextureFormat(GLint internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_RED: return GL_R8;
+	case GL_RG: return GL_RG8;
+	case GL_RGB: return GL_RGB8;
+	case GL_RGBA: return GL_RGBA8;
+	case GL_SRGB: return GL_SRGB8;
+	case GL_SRGB_ALPHA: return GL_SRGB8_ALPHA8;
+	}
+	return (GLenum)internalFormat;
+}
+
+// level 0 of all six faces of the bound cubemap
+inline void allocateCubeMapStorage(GLint internalFormat, GLenum format, GLenum type, int size)
+{
+	if (TexStorage2DProc texStorage = texStorage2D())
+		texStorage(GL_TEXTURE_CUBE_MAP, 1, sizedTextureFormat(internalFormat), size, size);
+	else
+		for (int face = 0; face < CUBE_MAP_FACES; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, internalFormat, size, size, 0, format, type, NULL);
+}
+
+struct CubeMapFace {
+	int index = 0;
+	int width = 0, height = 0, channels = 0;
+	unsigned char *pixels = NULL;	// NULL if the image couldn't be loaded
+};
+
+// the faces being decoded: every thread takes the next face nobody took yet, the loading thread takes the decoded ones.
+// shared, so workers that only get to it after the loader returned can still look at it.
+struct CubeMapDecode {
+	std::vector<std::string> faces;
+	int loadChannels = SOIL_LOAD_AUTO;
+	std::atomic<int> next{ 0 };
+	std::mutex mutex;
+	std::condition_variable decoded;
+	std::deque<CubeMapFace> ready;
+
+	// decodes the next face, false if there is none left
+	bool decodeNext()
+	{
+		int index = next.fetch_add(1);
+		if (index >= (int)faces.size())
+			return false;
+		CubeMapFace face;
+		face.index = index;
+		face.pixels = loadImage(faces[index], &face.width, &face.height, &face.channels, loadChannels);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.push_back(face);
+		}
+		decoded.notify_one();
+		return true;
+	}
+
+	// a decoded face, waiting for one if wait is set
+	bool take(CubeMapFace &face, bool wait)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (wait)
+			decoded.wait(lock, [this] { return !ready.empty(); });
+		if (ready.empty())
+			return false;
+		face = ready.front();
+		ready.pop_front();
+		return true;
+	}
+};
+
+// decodes the faces at once and uploads them into the bound cubemap as they come, see the top of the file. false if a
+// face is missing or they aren't all square and of the same size.
+inline bool uploadCubeMapFaces(const std::vector<std::string> &faces, GLint internalFormat, GLenum format, GLenum type, int loadChannels)
+{
+	std::shared_ptr<CubeMapDecode> decode = std::make_shared<CubeMapDecode>();
+	decode->faces = faces;
+	decode->loadChannels = loadChannels;
+	ThreadPool &pool = sharedThreadPool();
+	unsigned int helpers = std::min<unsigned int>(pool.size(), (unsigned int)faces.size() - 1);
+	for (unsigned int i = 0; i < helpers; i++)
+		pool.submit([decode] { while (decode->decodeNext()); });
+
+	bool ok = true;
+	int size = 0;
+	for (size_t uploaded = 0; uploaded < faces.size(); uploaded++)
+	{
+		// upload what is decoded, else decode a face here, else wait for the workers
+		CubeMapFace face;
+		while (!decode->take(face, false))
+			if (!decode->decodeNext())
+			{
+				decode->take(face, true);
+				break;
+			}
+		if (!face.pixels)
+		{
+			std::cerr << "Error::loadCubeMapTexture could not load texture file:" << faces[face.index] << std::endl;
+			ok = false;
+		}
+		else if (face.width != face.height || (size != 0 && face.width != size))
+		{
+			std::cerr << "Error::loadCubeMapTexture faces have to be square and of one size:" << faces[face.index] << std::endl;
+			ok = false;
+		}
+		else if (ok)
+		{
+			if (size == 0)
+			{
+				size = face.width;
+				allocateCubeMapStorage(internalFormat, format, type, size);
+			}
+			glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face.index, 0, 0, 0, size, size, format, type, face.pixels);
+		}
+		SOIL_free_image_data(face.pixels);
+	}
+	return ok;
+}
+
+// a cubemap from the six faces, or 0 if they can't be loaded. bakedFormats are the baked containers it may use
+// (supportedBakedFormats, 0 to always decode the faces).
+inline GLuint loadCubeMap(const std::vector<std::string> &faces, GLint internalFormat, GLenum format, GLenum type, int loadChannels,
+	unsigned int bakedFormats)
+{
+	if (faces.size() != CUBE_MAP_FACES)
+	{
+		std::cerr << "Error::loadCubeMapTexture needs " << CUBE_MAP_FACES << " faces, got " << faces.size() << std::endl;
+		return 0;
+	}
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	CompressedTexture baked[CUBE_MAP_FACES];
+	bool ok = true, srgb = false;
+	if (bakedCubeMapFormat(internalFormat, srgb) && loadBakedCubeMap(faces, bakedFormats, baked))
+	{
+		for (int face = 0; face < CUBE_MAP_FACES; face++)
+			uploadCompressedLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, baked[face], srgb);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint)baked[0].levels() - 1);
+	}
+	else
+		ok = uploadCubeMapFaces(faces, internalFormat, format, type, loadChannels);
+	if (!ok)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+		glDeleteTextures(1, &texture);
+		return 0;
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	return texture;
+}
+#endif
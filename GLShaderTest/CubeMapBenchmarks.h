@@ -0,0 +1,62 @@
+#ifndef CUBE_MAP_BENCHMARKS_H
+#define CUBE_MAP_BENCHMARKS_H
+
+// Benchmark of loading the skybox. Needs a GL context.
+
+#include <glad/glad.h>
+#include "SOIL2/SOIL2.h"
+
+#include "BenchmarkUtils.h"
+#include "CubeMap.h"
+#include "TextureBaker.h"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// the cubemap loader from before the faces were decoded at once: decode a face, glTexImage2D it, the next face
+inline GLuint loadCubeMapOneByOne(const vector<string> &faces)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (size_t i = 0; i < faces.size(); i++)
+	{
+		int width, height, channels;
+		unsigned char *pixels = loadImage(faces[i], &width, &height, &channels, SOIL_LOAD_RGB);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		SOIL_free_image_data(pixels);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	return texture;
+}
+
+// --bench-cubemap: the skybox (pic/skyboxes/sky) loaded one face after the other, with the faces decoded at once and
+// from the baked cubemap (--bake-textures) if there is one. best of 3, up to glFinish.
+inline void benchmarkCubeMap()
+{
+	vector<string> faces = cubeMapFaces("pic/skyboxes/sky");
+	CompressedTexture baked[CUBE_MAP_FACES];
+	unsigned int formats = supportedBakedFormats();
+	bool haveBaked = loadBakedCubeMap(faces, formats, baked);
+	const int repeats = 3;
+	auto best = [&](const function<GLuint()> &load) {
+		vector<GLuint> textures;
+		double ms = bestOfMs(repeats, [&] {
+			textures.push_back(load());
+			glFinish();
+		});
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+		return ms;
+	};
+	printf("%u threads, %s storage\n", sharedThreadPool().size() + 1, texStorage2D() ? "immutable" : "glTexImage2D");
+	printf("%-28s %10.1f ms\n", "one face after the other", best([&] { return loadCubeMapOneByOne(faces); }));
+	printf("%-28s %10.1f ms\n", "faces decoded at once", best([&] { return loadCubeMap(faces, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, SOIL_LOAD_RGB, 0); }));
+	if (haveBaked)
+		printf("%-28s %10.1f ms\n", "baked cubemap", best([&] { return loadCubeMap(faces, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE, SOIL_LOAD_RGB, formats); }));
+	else
+		printf("no baked cubemap, run --bake-textures first\n");
+}
+#endif
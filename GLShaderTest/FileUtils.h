@@ -0,0 +1,234 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A read-only view of a whole file mapped into memory. The mapping stays valid until close() or destruction.
+class MappedFile
+{
+public:
+	MappedFile() : bytes(nullptr), length(0)
+	{
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		fd = -1;
+#endif
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// maps the file at path, returns false if it doesn't exist or is empty
+	bool open(const std::string &path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			close();
+			return false;
+		}
+		bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		length = (size_t)fileSize.QuadPart;
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		bytes = ptr == MAP_FAILED ? nullptr : (const unsigned char*)ptr;
+		length = (size_t)st.st_size;
+#endif
+		if (bytes == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes)
+			UnmapViewOfFile(bytes);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes)
+			munmap((void*)bytes, length);
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+	bool isOpen() const { return bytes != nullptr; }
+
+private:
+	const unsigned char *bytes;
+	size_t length;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+// 64-bit FNV-1a, used to detect when a cached/baked asset no longer matches its source.
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// hashes the whole content of a file, returns false if it can't be read
+inline bool hashFile(const std::string &path, uint64_t &hash)
+{
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+	hash = hashBytes(file.data(), file.size());
+	return true;
+}
+
+inline bool fileExists(const std::string &path)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f)
+		return false;
+	fclose(f);
+	return true;
+}
+
+// size and time of the last write of a file, false if there is none. the time only compares with other fileStatus times.
+inline bool fileStatus(const std::string &path, uint64_t &size, int64_t &modified)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	modified = (int64_t)((((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) / 10000000ULL);
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || S_ISDIR(st.st_mode))
+		return false;
+	size = (uint64_t)st.st_size;
+	modified = (int64_t)st.st_mtime;
+#endif
+	return true;
+}
+
+// lower-cased extension without the dot ("Street environment_V01.FBX" -> "fbx")
+inline std::string fileExtension(const std::string &path)
+{
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return "";
+	std::string ext = path.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return ext;
+}
+
+// recursively collects the files under dir whose extension is in extensions (lower case, no dot), sorted by path
+inline void listFiles(const std::string &dir, const std::vector<std::string> &extensions, std::vector<std::string> &out)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((dir + "/*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = findData.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = dir + '/' + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			listFiles(path, extensions, out);
+		else if (std::find(extensions.begin(), extensions.end(), fileExtension(name)) != extensions.end())
+			out.push_back(path);
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (dirent *entry = readdir(d))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = dir + '/' + name;
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			listFiles(path, extensions, out);
+		else if (std::find(extensions.begin(), extensions.end(), fileExtension(name)) != extensions.end())
+			out.push_back(path);
+	}
+	closedir(d);
+#endif
+	std::sort(out.begin(), out.end());
+}
+#endif
@@ -0,0 +1,152 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include "VertexFormat.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// SSE2 is always there on x64 and with MSVC's default /arch for x86; anything else takes the scalar path
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#else
+#define FRUSTUM_SSE 0
+#endif
+
+// The six planes of a view frustum, pointing inwards. A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum {
+	glm::vec4 planes[6];	// left, right, bottom, top, near, far
+};
+
+// Gribb / Hartmann: the planes are sums and differences of the rows of projection * view
+inline Frustum extractFrustum(const glm::mat4 &viewProjection)
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (glm::vec4 &plane : frustum.planes)
+	{
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane = plane * (1.0f / length);
+	}
+	return frustum;
+}
+
+// ------------------------------------------------------------------------
+// world space AABB of a local one after model, as center and half extent (Arvo: the extent goes through |M|)
+inline void transformBounds(const Bounds &bounds, const glm::mat4 &model, glm::vec3 &center, glm::vec3 &extent)
+{
+	glm::vec3 localCenter = (bounds.min + bounds.max) * 0.5f;
+	glm::vec3 localExtent = (bounds.max - bounds.min) * 0.5f;
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	for (int i = 0; i < 3; i++)
+		extent[i] = std::fabs(model[0][i]) * localExtent.x + std::fabs(model[1][i]) * localExtent.y + std::fabs(model[2][i]) * localExtent.z;
+}
+
+// false only if the box is completely outside one of the planes. boxes crossing a corner of the frustum
+// outside of it still count as visible, which is the usual price for testing planes one at a time.
+inline bool boxVisible(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extent)
+{
+	for (const glm::vec4 &plane : frustum.planes)
+	{
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (distance + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+inline bool sphereVisible(const Frustum &frustum, const BoundingSphere &sphere)
+{
+	for (const glm::vec4 &plane : frustum.planes)
+		if (plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w < -sphere.radius)
+			return false;
+	return true;
+}
+
+// ------------------------------------------------------------------------
+// Many boxes at once, stored as structure of arrays so SSE tests four of them per instruction. Fill it with add(),
+// cull() writes visible[i] for every box.
+class BoxBatch
+{
+public:
+	std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+	std::vector<uint8_t> visible;
+
+	void clear()
+	{
+		centerX.clear(); centerY.clear(); centerZ.clear();
+		extentX.clear(); extentY.clear(); extentZ.clear();
+		visible.clear();
+	}
+	size_t size() const { return centerX.size(); }
+
+	void add(const glm::vec3 &center, const glm::vec3 &extent)
+	{
+		centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+		extentX.push_back(extent.x); extentY.push_back(extent.y); extentZ.push_back(extent.z);
+	}
+
+	// returns the number of visible boxes
+	size_t cull(const Frustum &frustum)
+	{
+		size_t count = size();
+		visible.resize(count);
+		size_t i = 0;
+		size_t visibleCount = 0;
+#if FRUSTUM_SSE
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+			absX[p] = _mm_andnot_ps(signMask, planeX[p]);
+			absY[p] = _mm_andnot_ps(signMask, planeY[p]);
+			absZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+					_mm_mul_ps(planeZ[p], cz)), planeW[p]);
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+			int mask = _mm_movemask_ps(outside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visible[i + lane] = !(mask & (1 << lane));
+				visibleCount += visible[i + lane];
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			visible[i] = boxVisible(frustum, glm::vec3(centerX[i], centerY[i], centerZ[i]), glm::vec3(extentX[i], extentY[i], extentZ[i]));
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+};
+#endif
@@ -0,0 +1,82 @@
+#ifndef FRUSTUM_BENCHMARKS_H
+#define FRUSTUM_BENCHMARKS_H
+
+// Benchmark of the frustum tests, and the camera and boxes the culling benchmarks (BVHBenchmarks.h too) run on.
+// CPU only, no GL.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchmarkUtils.h"
+#include "Frustum.h"
+#include "VertexFormat.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// where the demo scene's camera starts (main.cpp), looking down -z
+const glm::vec3 SCENE_EYE(0.0f, 5.0f, 3.0f);
+
+// the frustum of the demo scene's camera at SCENE_EYE: 45 degrees, 1920 x 1080, near 0.1, far 100
+inline Frustum sceneFrustum()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1920.0f / 1080.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(SCENE_EYE, SCENE_EYE + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return extractFrustum(projection * view);
+}
+
+// boxes scattered over 200 x 20 x 200 around the camera, half extents from 0.01 to maxExtent. the same boxes every call.
+inline vector<Bounds> randomSceneBoxes(size_t count, float maxExtent)
+{
+	srand(1);
+	vector<Bounds> boxes(count);
+	for (Bounds &box : boxes)
+	{
+		glm::vec3 center((float)(rand() % 20000) / 100.0f - 100.0f, (float)(rand() % 2000) / 100.0f, (float)(rand() % 20000) / 100.0f - 100.0f);
+		glm::vec3 extent((float)(rand() % 100) / 100.0f * maxExtent + 0.01f);
+		box.min = center - extent;
+		box.max = center + extent;
+	}
+	return boxes;
+}
+
+// --bench-frustum-culling: random boxes around the camera of the demo scene tested against its frustum, one at a time
+// with boxVisible and four at a time with BoxBatch (SSE where available). Both have to agree on every box.
+inline void benchmarkFrustumCulling()
+{
+	const size_t boxCounts[] = { 1000, 100000, 1000000, 4000000 };
+	Frustum frustum = sceneFrustum();
+
+	printf("%10s %8s %10s %16s %10s %10s\n", "boxes", "test", "ms", "boxes/s", "visible", "mismatch");
+	for (size_t boxCount : boxCounts)
+	{
+		BoxBatch batch;
+		for (const Bounds &box : randomSceneBoxes(boxCount, 2.0f))
+			batch.add((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f);
+		int repeats = (int)max<size_t>(1, 20000000 / boxCount);
+
+		vector<uint8_t> scalar(boxCount);
+		size_t scalarVisible = 0;
+		double scalarMs = averageMs(repeats, [&] {
+			scalarVisible = 0;
+			for (size_t i = 0; i < boxCount; i++)
+			{
+				scalar[i] = boxVisible(frustum, glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]),
+					glm::vec3(batch.extentX[i], batch.extentY[i], batch.extentZ[i]));
+				scalarVisible += scalar[i];
+			}
+		});
+
+		size_t batchVisible = 0;
+		double batchMs = averageMs(repeats, [&] { batchVisible = batch.cull(frustum); });
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < boxCount; i++)
+			mismatches += scalar[i] != batch.visible[i];
+		printf("%10zu %8s %10.3f %16.0f %10zu %10s\n", boxCount, "scalar", scalarMs, boxCount / (scalarMs / 1000.0), scalarVisible, "");
+		printf("%10zu %8s %10.3f %16.0f %10zu %10zu\n", boxCount, FRUSTUM_SSE ? "sse" : "batch", batchMs, boxCount / (batchMs / 1000.0),
+			batchVisible, mismatches);
+	}
+}
+#endif
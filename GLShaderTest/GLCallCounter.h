@@ -0,0 +1,117 @@
+#ifndef GL_CALL_COUNTER_H
+#define GL_CALL_COUNTER_H
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Counts calls into OpenGL for the functions the render loop uses. glad keeps every entry point in a global
+// function pointer (glad_glUniform1i and so on), so counting is done by swapping those pointers for wrappers that
+// bump a counter and forward to the driver. Nothing is counted unless installGLCallCounter() was called after
+// gladLoadGLLoader.
+struct GLCallStats {
+	std::vector<std::string> names;		// hooked functions, in install order
+	std::vector<unsigned long long> calls;	// calls per function since the last reset
+	bool installed = false;
+
+	unsigned long long total() const
+	{
+		unsigned long long sum = 0;
+		for (unsigned long long count : calls)
+			sum += count;
+		return sum;
+	}
+	void reset()
+	{
+		for (unsigned long long &count : calls)
+			count = 0;
+	}
+};
+
+inline GLCallStats& glCallStats()
+{
+	static GLCallStats stats;
+	return stats;
+}
+
+// one wrapper per glad pointer: Slot is the address of the pointer, Proc its type
+template <typename Proc, Proc *Slot>
+struct GLCallHook;
+
+template <typename Ret, typename... Args, Ret (APIENTRYP *Slot)(Args...)>
+struct GLCallHook<Ret (APIENTRYP)(Args...), Slot>
+{
+	static Ret (APIENTRYP original)(Args...);
+	static size_t counter;
+
+	static Ret APIENTRY call(Args... args)
+	{
+		glCallStats().calls[counter]++;
+		return original(args...);
+	}
+
+	static void install(const char *name)
+	{
+		if (*Slot == &call)
+			return;
+		GLCallStats &stats = glCallStats();
+		counter = stats.calls.size();
+		stats.names.push_back(name);
+		stats.calls.push_back(0);
+		original = *Slot;
+		*Slot = &call;
+	}
+};
+
+template <typename Ret, typename... Args, Ret (APIENTRYP *Slot)(Args...)>
+Ret (APIENTRYP GLCallHook<Ret (APIENTRYP)(Args...), Slot>::original)(Args...) = nullptr;
+template <typename Ret, typename... Args, Ret (APIENTRYP *Slot)(Args...)>
+size_t GLCallHook<Ret (APIENTRYP)(Args...), Slot>::counter = 0;
+
+#define GL_CALL_HOOK(function) GLCallHook<decltype(glad_##function), &glad_##function>::install(#function)
+
+inline void installGLCallCounter()
+{
+	// uniforms
+	GL_CALL_HOOK(glGetUniformLocation);
+	GL_CALL_HOOK(glUniform1i);
+	GL_CALL_HOOK(glUniform1f);
+	GL_CALL_HOOK(glUniform2f);
+	GL_CALL_HOOK(glUniform2fv);
+	GL_CALL_HOOK(glUniform3f);
+	GL_CALL_HOOK(glUniform3fv);
+	GL_CALL_HOOK(glUniform4f);
+	GL_CALL_HOOK(glUniform4fv);
+	GL_CALL_HOOK(glUniformMatrix2fv);
+	GL_CALL_HOOK(glUniformMatrix3fv);
+	GL_CALL_HOOK(glUniformMatrix4fv);
+	// state
+	GL_CALL_HOOK(glUseProgram);
+	GL_CALL_HOOK(glActiveTexture);
+	GL_CALL_HOOK(glBindTexture);
+	GL_CALL_HOOK(glBindVertexArray);
+	GL_CALL_HOOK(glBindBuffer);
+	GL_CALL_HOOK(glDepthFunc);
+	GL_CALL_HOOK(glClear);
+	GL_CALL_HOOK(glClearColor);
+	// draws
+	GL_CALL_HOOK(glDrawElements);
+	GL_CALL_HOOK(glDrawArrays);
+	GL_CALL_HOOK(glDrawElementsInstanced);
+	glCallStats().installed = true;
+}
+
+// prints the average calls per frame over the last frameCount frames, per function with at least one call
+inline void printGLCallStats(unsigned int frameCount)
+{
+	const GLCallStats &stats = glCallStats();
+	if (frameCount == 0)
+		return;
+	printf("GL calls per frame: %.1f\n", (double)stats.total() / frameCount);
+	for (size_t i = 0; i < stats.names.size(); i++)
+		if (stats.calls[i] > 0)
+			printf("  %-22s %8.1f\n", stats.names[i].c_str(), (double)stats.calls[i] / frameCount);
+}
+#endif
@@ -0,0 +1,263 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// --headless: the scene rendered without a visible window, for repeatable benchmark runs. Frames go into an offscreen
+// framebuffer of any size, the camera follows a scripted path instead of the mouse, each frame can be saved as an image,
+// and the CPU and GPU time of every frame are written as JSON at the end.
+//
+// It still needs a GL 3.3 context, and the only build is the Visual Studio project (Windows, GLFW 3.3), where GLFW
+// creates one on a hidden window of the desktop. Running on a Linux machine without a display or a GPU (GLFW 3.4's
+// null platform on surfaceless EGL with Mesa's llvmpipe, see main.cpp) is written for but has no build here: there
+// is no Linux project, so that is unsupported until one exists. The checks that don't need GL run anywhere the
+// code compiles, before GLFW is even initialized.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "SOIL2/SOIL2.h"
+
+#include "Camera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// headless frames advance the scene by a fixed step, so runs are repeatable however fast the machine renders
+const float HEADLESS_FRAME_TIME = 1.0f / 60.0f;
+
+// ------------------------------------------------------------------------
+// framebuffer object with an RGBA8 color and a depth/stencil renderbuffer, stands in for the window's framebuffer
+class OffscreenTarget
+{
+public:
+	bool create(int width, int height)
+	{
+		this->width = width;
+		this->height = height;
+		glGenFramebuffers(1, &fbo);
+		glGenRenderbuffers(1, &color);
+		glGenRenderbuffers(1, &depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		// touched once here, so the first measured frame doesn't also pay for the first use of the buffers
+		// (llvmpipe even reports a garbage GL_TIME_ELAPSED for a query around that)
+		if (complete)
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return complete;
+	}
+
+	void release()
+	{
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(1, &color);
+		glDeleteRenderbuffers(1, &depth);
+		fbo = color = depth = 0;
+	}
+
+	// draws go here until another framebuffer is bound
+	void bind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glViewport(0, 0, width, height);
+	}
+
+	// reads the color buffer back and writes it with SOIL_save_image, the type follows the extension (.bmp, .tga, else PNG)
+	bool save(const std::string &path)
+	{
+		std::vector<unsigned char> pixels((size_t)width * height * 4);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		// GL's first row is the bottom one, image files start at the top
+		size_t rowBytes = (size_t)width * 4;
+		for (int y = 0; y < height / 2; y++)
+			std::swap_ranges(pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes, pixels.begin() + (height - 1 - y) * rowBytes);
+
+		int type = SOIL_SAVE_TYPE_PNG;
+		std::string extension = path.substr(path.find_last_of('.') + 1);
+		if (extension == "bmp")
+			type = SOIL_SAVE_TYPE_BMP;
+		else if (extension == "tga")
+			type = SOIL_SAVE_TYPE_TGA;
+		return SOIL_save_image(path.c_str(), type, width, height, 4, pixels.data()) != 0;
+	}
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+private:
+	unsigned int fbo = 0, color = 0, depth = 0;
+	int width = 0, height = 0;
+};
+
+// ------------------------------------------------------------------------
+// camera poses over time, linearly interpolated and held at both ends
+struct CameraKey {
+	float time;		// seconds
+	glm::vec3 position;
+	float yaw, pitch;	// degrees, like Camera
+};
+
+class CameraPath
+{
+public:
+	// reads one key per line, "time x y z yaw pitch", in increasing time. empty lines and lines starting with # are skipped.
+	bool load(const std::string &path)
+	{
+		std::ifstream file(path);
+		if (!file)
+			return false;
+		keys.clear();
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+			std::istringstream fields(line);
+			CameraKey key;
+			if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch))
+				return false;
+			keys.push_back(key);
+		}
+		return !keys.empty();
+	}
+
+	// one turn around center at radius and height above it, always looking at center
+	static CameraPath orbit(const glm::vec3 &center, float radius, float height, float seconds)
+	{
+		CameraPath path;
+		const int steps = 72;
+		for (int i = 0; i <= steps; i++)
+		{
+			float angle = glm::radians(360.0f * i / steps);
+			CameraKey key;
+			key.time = seconds * i / steps;
+			key.position = center + glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle));
+			glm::vec3 toCenter = glm::normalize(center - key.position);
+			// the yaw keeps growing instead of wrapping, so interpolating between keys never turns the long way round
+			key.yaw = 180.0f + 360.0f * i / steps;
+			key.pitch = glm::degrees(std::asin(toCenter.y));
+			path.keys.push_back(key);
+		}
+		return path;
+	}
+
+	void apply(Camera &camera, float time) const
+	{
+		if (keys.empty())
+			return;
+		size_t next = 0;
+		while (next < keys.size() && keys[next].time < time)
+			next++;
+		if (next == 0 || next == keys.size())
+		{
+			const CameraKey &key = keys[next == 0 ? 0 : keys.size() - 1];
+			camera.SetPose(key.position, key.yaw, key.pitch);
+			return;
+		}
+		const CameraKey &a = keys[next - 1], &b = keys[next];
+		float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0f;
+		camera.SetPose(glm::mix(a.position, b.position, t), a.yaw + (b.yaw - a.yaw) * t, a.pitch + (b.pitch - a.pitch) * t);
+	}
+
+private:
+	std::vector<CameraKey> keys;
+};
+
+// ------------------------------------------------------------------------
+// CPU time of each frame, and its GPU time from a GL_TIME_ELAPSED query. the queries are only read back in writeJson,
+// so measuring never makes the CPU wait for the GPU.
+class FrameTimings
+{
+public:
+	void begin()
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		queries.push_back(query);
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		cpuStart = std::chrono::steady_clock::now();
+	}
+
+	void end()
+	{
+		cpuMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count());
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	void release()
+	{
+		glDeleteQueries((GLsizei)queries.size(), queries.data());
+		queries.clear();
+	}
+
+	// every frame plus mean / median / 95th percentile / max of both times
+	bool writeJson(const std::string &path, int width, int height)
+	{
+		std::vector<double> gpuMs(queries.size());
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+			gpuMs[i] = nanoseconds / 1e6;
+		}
+
+		FILE *f = fopen(path.c_str(), "w");
+		if (!f)
+			return false;
+		const GLubyte *renderer = glGetString(GL_RENDERER);
+		fprintf(f, "{\n  \"renderer\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %zu,\n",
+			jsonEscape(renderer ? (const char*)renderer : "").c_str(), width, height, cpuMs.size());
+		writeSummary(f, "cpu_ms", cpuMs);
+		writeSummary(f, "gpu_ms", gpuMs);
+		fprintf(f, "  \"frame_times\": [\n");
+		for (size_t i = 0; i < cpuMs.size(); i++)
+			fprintf(f, "    { \"frame\": %zu, \"cpu_ms\": %.4f, \"gpu_ms\": %.4f }%s\n", i, cpuMs[i], gpuMs[i], i + 1 < cpuMs.size() ? "," : "");
+		fprintf(f, "  ]\n}\n");
+		return fclose(f) == 0;
+	}
+
+private:
+	std::vector<GLuint> queries;
+	std::vector<double> cpuMs;
+	std::chrono::steady_clock::time_point cpuStart;
+
+	static void writeSummary(FILE *f, const char *name, std::vector<double> values)
+	{
+		double mean = 0.0;
+		for (double value : values)
+			mean += value;
+		mean = values.empty() ? 0.0 : mean / values.size();
+		std::sort(values.begin(), values.end());
+		auto percentile = [&values](double p) { return values.empty() ? 0.0 : values[(size_t)(p * (values.size() - 1) + 0.5)]; };
+		fprintf(f, "  \"%s\": { \"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"max\": %.4f },\n",
+			name, mean, percentile(0.5), percentile(0.95), values.empty() ? 0.0 : values.back());
+	}
+
+	static std::string jsonEscape(const std::string &text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			if ((unsigned char)c >= 0x20)
+				escaped += c;
+		}
+		return escaped;
+	}
+};
+#endif
@@ -0,0 +1,187 @@
+#ifndef INPUT_RECORDING_H
+#define INPUT_RECORDING_H
+
+// --record / --replay: everything that moves the camera and the ball in one frame is gathered into a FrameInput, which
+// can be written to a file and later played back instead of the live input. A replay steps by the recorded deltaTime
+// rather than the clock, so every run of it renders the same sequence of views however fast the machine is.
+// Layout (native little endian):
+//   InputRecordingHeader
+//   per frame: float deltaTime, uint16_t keys, uint8_t fields, then the fields present in this order:
+//     INPUT_FIELD_MOUSE  float x, float y     mouse offset, already reversed in y like mouse_callback does
+//     INPUT_FIELD_SCROLL float scroll
+//     INPUT_FIELD_CLICKS uint8_t clicks[3]    left / right / middle presses
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+const uint32_t INPUT_RECORDING_MAGIC = 0x54504E49; // "INPT"
+const uint32_t INPUT_RECORDING_VERSION = 1;
+
+enum InputField {
+	INPUT_FIELD_MOUSE = 1 << 0,
+	INPUT_FIELD_SCROLL = 1 << 1,
+	INPUT_FIELD_CLICKS = 1 << 2,
+};
+
+// bits of FrameInput::keys. the camera keys are FORWARD..DOWN and SHIFT_PRESS for shift held, the ball keys FORWARD..RIGHT.
+inline uint16_t cameraKey(Movement movement) { return (uint16_t)(1 << movement); }
+inline uint16_t ballKey(Movement movement) { return (uint16_t)(1 << (8 + movement)); }
+
+struct FrameInput {
+	float deltaTime = 0.0f;
+	uint16_t keys = 0;
+	float mouseX = 0.0f, mouseY = 0.0f;
+	float scroll = 0.0f;
+	uint8_t clicks[3] = { 0, 0, 0 };
+};
+
+struct InputRecordingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frameCount;	// 0 if the recording wasn't closed, then the frames run to the end of the file
+	uint32_t reserved;
+	float position[3];		// the camera when the recording started
+	float yaw, pitch, zoom;
+};
+
+class InputRecorder
+{
+public:
+	~InputRecorder()
+	{
+		close();
+	}
+
+	bool open(const std::string &path, const Camera &camera)
+	{
+		close();
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		InputRecordingHeader header = { INPUT_RECORDING_MAGIC, INPUT_RECORDING_VERSION, 0, 0,
+			{ camera.Position.x, camera.Position.y, camera.Position.z }, camera.Yaw, camera.Pitch, camera.Zoom };
+		fwrite(&header, sizeof(header), 1, file);
+		frameCount = 0;
+		return true;
+	}
+
+	bool isOpen() const { return file != NULL; }
+
+	void record(const FrameInput &input)
+	{
+		uint8_t fields = 0;
+		if (input.mouseX != 0.0f || input.mouseY != 0.0f)
+			fields |= INPUT_FIELD_MOUSE;
+		if (input.scroll != 0.0f)
+			fields |= INPUT_FIELD_SCROLL;
+		if (input.clicks[0] || input.clicks[1] || input.clicks[2])
+			fields |= INPUT_FIELD_CLICKS;
+		fwrite(&input.deltaTime, sizeof(float), 1, file);
+		fwrite(&input.keys, sizeof(uint16_t), 1, file);
+		fwrite(&fields, sizeof(uint8_t), 1, file);
+		if (fields & INPUT_FIELD_MOUSE)
+		{
+			fwrite(&input.mouseX, sizeof(float), 1, file);
+			fwrite(&input.mouseY, sizeof(float), 1, file);
+		}
+		if (fields & INPUT_FIELD_SCROLL)
+			fwrite(&input.scroll, sizeof(float), 1, file);
+		if (fields & INPUT_FIELD_CLICKS)
+			fwrite(input.clicks, sizeof(uint8_t), 3, file);
+		frameCount++;
+	}
+
+	// fills in the frame count, returns false if anything failed to write
+	bool close()
+	{
+		if (!file)
+			return true;
+		bool ok = ferror(file) == 0;
+		fseek(file, offsetof(InputRecordingHeader, frameCount), SEEK_SET);
+		ok = fwrite(&frameCount, sizeof(uint32_t), 1, file) == 1 && ok;
+		ok = fclose(file) == 0 && ok;
+		file = NULL;
+		return ok;
+	}
+
+private:
+	FILE *file = NULL;
+	uint32_t frameCount = 0;
+};
+
+class InputReplayer
+{
+public:
+	~InputReplayer()
+	{
+		close();
+	}
+
+	// returns false if the file is missing or not a recording of this version
+	bool open(const std::string &path)
+	{
+		close();
+		file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION)
+		{
+			close();
+			return false;
+		}
+		framesRead = 0;
+		return true;
+	}
+
+	bool isOpen() const { return file != NULL; }
+
+	// 0 for a recording that was cut short, see InputRecordingHeader
+	unsigned int frameCount() const { return header.frameCount; }
+
+	// puts the camera where it was when the recording started
+	void restoreCamera(Camera &camera) const
+	{
+		camera.SetPose(glm::vec3(header.position[0], header.position[1], header.position[2]), header.yaw, header.pitch);
+		camera.Zoom = header.zoom;
+	}
+
+	// the next frame, false at the end of the recording
+	bool next(FrameInput &input)
+	{
+		if (!file || (header.frameCount && framesRead == header.frameCount))
+			return false;
+		input = FrameInput();
+		uint8_t fields = 0;
+		bool ok = fread(&input.deltaTime, sizeof(float), 1, file) == 1 &&
+			fread(&input.keys, sizeof(uint16_t), 1, file) == 1 &&
+			fread(&fields, sizeof(uint8_t), 1, file) == 1;
+		if (ok && (fields & INPUT_FIELD_MOUSE))
+			ok = fread(&input.mouseX, sizeof(float), 1, file) == 1 && fread(&input.mouseY, sizeof(float), 1, file) == 1;
+		if (ok && (fields & INPUT_FIELD_SCROLL))
+			ok = fread(&input.scroll, sizeof(float), 1, file) == 1;
+		if (ok && (fields & INPUT_FIELD_CLICKS))
+			ok = fread(input.clicks, sizeof(uint8_t), 3, file) == 3;
+		if (ok)
+			framesRead++;
+		return ok;
+	}
+
+	void close()
+	{
+		if (file)
+			fclose(file);
+		file = NULL;
+	}
+
+private:
+	FILE *file = NULL;
+	InputRecordingHeader header = {};
+	uint32_t framesRead = 0;
+};
+#endif
@@ -0,0 +1,251 @@
+#ifndef INSTANCED_MODEL_H
+#define INSTANCED_MODEL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "models.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Many copies of one model drawn with a single glDrawElementsInstanced per mesh. The meshes are loaded once, each copy
+// only adds a model matrix to the instance buffer, which selfDefinedVertexShader.vs reads as attributes 5 to 8 when
+// "instanced" is set.
+
+// where one instance stands, packed into its model matrix when the instance buffer is filled
+struct InstanceTransform {
+	glm::vec3 position;
+	float yaw;	// degrees around y
+	glm::vec3 scale;
+};
+
+// translate(position) * rotate(yaw, y) * scale(scale), written out directly instead of multiplying three matrices
+inline void packInstanceTransforms(const InstanceTransform *instances, size_t count, glm::mat4 *out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const InstanceTransform &instance = instances[i];
+		float radians = instance.yaw * 0.01745329251994f;
+		float s = std::sin(radians), c = std::cos(radians);
+		glm::mat4 &m = out[i];
+		m[0] = glm::vec4(c * instance.scale.x, 0.0f, -s * instance.scale.x, 0.0f);
+		m[1] = glm::vec4(0.0f, instance.scale.y, 0.0f, 0.0f);
+		m[2] = glm::vec4(s * instance.scale.z, 0.0f, c * instance.scale.z, 0.0f);
+		m[3] = glm::vec4(instance.position, 1.0f);
+	}
+}
+
+// ------------------------------------------------------------------------
+// Per-instance model matrices. GL 4.0 has no persistent mapping (glBufferStorage is 4.4), so every update orphans:
+// glBufferData with NULL gives the buffer fresh storage while draws still queued on the GPU keep reading the old one,
+// and the matrices are packed straight into the mapping of the new storage without a CPU side copy.
+class InstanceBuffer
+{
+public:
+	static const GLuint FIRST_ATTRIBUTE = 5;	// a mat4 takes four attribute slots, one per column
+
+	InstanceBuffer() : count(0)
+	{
+		glGenBuffers(1, &buffer);
+	}
+
+	// deletes the GL buffer, like Mesh::releaseGpuData this has to happen while the context is still alive
+	void release()
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	size_t size() const { return count; }
+
+	void update(const InstanceTransform *instances, size_t instanceCount)
+	{
+		size_t bytes = instanceCount * sizeof(glm::mat4);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		if (instanceCount)
+		{
+			void *target = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (target)
+			{
+				packInstanceTransforms(instances, instanceCount, (glm::mat4*)target);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		count = instanceCount;
+	}
+
+	// adds the matrix attributes to the VAO that is currently bound, advancing once per instance
+	void attach() const
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(FIRST_ATTRIBUTE + column);
+			glVertexAttribPointer(FIRST_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(FIRST_ATTRIBUTE + column, 1);
+		}
+	}
+
+private:
+	GLuint buffer;
+	size_t count;
+};
+
+// ------------------------------------------------------------------------
+class InstancedModel : public BaseModel
+{
+public:
+	InstancedModel(glm::vec3 pos, glm::vec3 scale, std::string modelPath, Shader* shader) :BaseModel(pos, scale, modelPath, shader) {
+		dirty = false;
+		bounds = emptyBounds();
+		maxInstanceScale = 0.0f;
+		// every mesh gets a VAO of its own buffers plus the instance buffer, the meshes' VAOs stay as they are
+		for (const Mesh &mesh : model->meshes) {
+			GLuint vao = mesh.createVertexArray();
+			glBindVertexArray(vao);
+			instanceBuffer.attach();
+			glBindVertexArray(0);
+			instanceVAOs.push_back(vao);
+		}
+		currentLods.assign(instanceVAOs.size(), 0);
+	}
+
+	~InstancedModel() {}
+
+	// deletes the VAOs and the instance buffer while the context is alive, the model is deleted with the object
+	void release() {
+		glDeleteVertexArrays((GLsizei)instanceVAOs.size(), instanceVAOs.data());
+		instanceVAOs.clear();
+		instanceBuffer.release();
+	}
+
+	void setInstances(std::vector<InstanceTransform> instances) {
+		this->instances = std::move(instances);
+		dirty = true;
+	}
+
+	void addInstance(const InstanceTransform &instance) {
+		instances.push_back(instance);
+		dirty = true;
+	}
+
+	void setInstance(size_t i, const InstanceTransform &instance) {
+		instances[i] = instance;
+		dirty = true;
+	}
+
+	size_t instanceCount() const {
+		return instances.size();
+	}
+
+	void draw() {
+		RenderQueue queue;
+		GLRenderBackend backend;
+		submit(queue, getModel(), Position, 1.0f, nullptr);
+		queue.execute(backend);
+		backend.finish();
+	}
+
+	// one item per mesh covering all instances, modelMatrix moves the whole group. all instances draw the same level
+	// of detail, picked for the nearest point of the group so that no instance gets a level too coarse for it
+	void submit(RenderQueue &queue, const glm::mat4 &modelMatrix, const glm::vec3 &eye, float farPlane, const uint8_t* visibleMeshes) {
+		update();
+		if (instances.empty())
+			return;
+		float depth = glm::length(glm::vec3(modelMatrix[3]) - eye);
+		glm::vec3 center, extent;
+		transformBounds(bounds, modelMatrix, center, extent);
+		float distance = distanceToBox(eye, center, extent);
+		float scale = maxScale(modelMatrix) * maxInstanceScale;
+		for (size_t i = 0; i < instanceVAOs.size(); i++) {
+			if (visibleMeshes && !visibleMeshes[i])
+				continue;
+			const Mesh &mesh = model->meshes[i];
+			currentLods[i] = selectLod(mesh.lods.data(), mesh.lods.size(), currentLods[i], scale, distance, lodSettings());
+			DrawItem item;
+			item.center = center;
+			item.extent = extent;
+			item.key = makeSortKey(0, shader->serial, mesh.material.id, instanceVAOs[i], depth, farPlane);
+			item.shader = shader;
+			item.program = shader->ID;
+			item.material = &mesh.material;
+			item.vao = instanceVAOs[i];
+			item.indexType = mesh.indexType;
+			item.count = (GLsizei)mesh.lods[currentLods[i]].indexCount;
+			item.firstIndex = mesh.lods[currentLods[i]].firstIndex;
+			item.model = modelMatrix;
+			item.packedBounds = mesh.layout == VERTEX_LAYOUT_PACKED ? &mesh.bounds : nullptr;
+			item.instanceCount = (GLsizei)instances.size();
+			queue.submit(item);
+		}
+	}
+
+	// every mesh is culled with the box around all instances, empty without instances
+	Bounds meshBounds(size_t i) {
+		update();
+		return bounds;
+	}
+
+	glm::mat4 getModel() {
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, Position);
+		model = glm::scale(model, scale_value);
+		return model;
+	}
+
+	void ProcessKeyboard(Movement direction, float deltaTime) {
+
+	}
+
+	void ProcessMouse(MOUSE_EVENT event) {
+
+	}
+
+	// fills the instance buffer and the bounds after the instances changed. submit does it when needed, but that
+	// touches GL, so code submitting from another thread calls this on the render thread first.
+	void update() {
+		if (!dirty)
+			return;
+		instanceBuffer.update(instances.data(), instances.size());
+		updateBounds();
+		dirty = false;
+	}
+
+private:
+	// the box around every mesh of every instance, culling only drops the group as a whole
+	void updateBounds() {
+		bool first = true;
+		bounds = emptyBounds();
+		maxInstanceScale = 0.0f;
+		for (const InstanceTransform &instance : instances) {
+			maxInstanceScale = std::max(maxInstanceScale, std::max(std::fabs(instance.scale.x), std::max(std::fabs(instance.scale.y), std::fabs(instance.scale.z))));
+			glm::mat4 matrix;
+			packInstanceTransforms(&instance, 1, &matrix);
+			for (const Mesh &mesh : model->meshes) {
+				glm::vec3 center, extent;
+				transformBounds(mesh.bounds, matrix, center, extent);
+				bounds.min = first ? center - extent : glm::min(bounds.min, center - extent);
+				bounds.max = first ? center + extent : glm::max(bounds.max, center + extent);
+				first = false;
+			}
+		}
+	}
+
+	std::vector<InstanceTransform> instances;
+	Bounds bounds;	// of all instances, before the model matrix
+	float maxInstanceScale;	// largest scale of any instance, what level of detail selection has to assume
+	bool dirty;	// instances changed since the buffer was last filled
+	InstanceBuffer instanceBuffer;
+	std::vector<GLuint> instanceVAOs;	// per mesh
+	std::vector<unsigned int> currentLods;	// per mesh, the level submitted last
+};
+#endif
@@ -0,0 +1,54 @@
+#ifndef INSTANCED_MODEL_BENCHMARKS_H
+#define INSTANCED_MODEL_BENCHMARKS_H
+
+// Benchmark of turning instance transforms into the matrices InstancedModel uploads. CPU only, no GL.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchmarkUtils.h"
+#include "Camera.h" // models.h, under InstancedModel.h, needs Movement
+#include "InstancedModel.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// --bench-instance-packing: how fast InstanceTransforms turn into the model matrices of the instance buffer, with
+// packInstanceTransforms and with the glm::translate / rotate / scale chain the other models use in getModel().
+// Packs into plain memory, the upload itself is left to the driver.
+inline void benchmarkInstancePacking()
+{
+	const size_t instanceCounts[] = { 1000, 10000, 100000, 1000000 };
+	printf("%10s %8s %10s %14s %10s\n", "instances", "packing", "ms", "instances/s", "MB/s");
+	for (size_t instanceCount : instanceCounts)
+	{
+		srand(1);
+		vector<InstanceTransform> instances(instanceCount);
+		for (InstanceTransform &instance : instances)
+		{
+			instance.position = glm::vec3((float)(rand() % 2000) / 50.0f - 20.0f, 0.0f, (float)(rand() % 2000) / 50.0f - 20.0f);
+			instance.yaw = (float)(rand() % 360);
+			instance.scale = glm::vec3(0.1f);
+		}
+		vector<glm::mat4> matrices(instanceCount);
+		int repeats = (int)max<size_t>(1, 10000000 / instanceCount);
+
+		for (int method = 0; method < 2; method++)
+		{
+			double ms = averageMs(repeats, [&] {
+				if (method == 0)
+					packInstanceTransforms(instances.data(), instances.size(), matrices.data());
+				else
+					for (size_t i = 0; i < instanceCount; i++)
+					{
+						glm::mat4 model = glm::translate(glm::mat4(1.0f), instances[i].position);
+						model = glm::rotate(model, glm::radians(instances[i].yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+						matrices[i] = glm::scale(model, instances[i].scale);
+					}
+			});
+			printf("%10zu %8s %10.3f %14.0f %10.1f\n", instanceCount, method == 0 ? "direct" : "glm", ms,
+				instanceCount / (ms / 1000.0), instanceCount * sizeof(glm::mat4) / (ms / 1000.0) / (1024.0 * 1024.0));
+		}
+	}
+}
+#endif
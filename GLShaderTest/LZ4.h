@@ -0,0 +1,165 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+// A small codec for the LZ4 block format (no frames), used for the compressed entries of asset packages
+// (AssetPackage.h). A block is a list of sequences: a token (4 bits literal length, 4 bits match length - 4, 15 meaning
+// "more bytes follow, each adding up to 255"), the literals, a 2 byte little endian offset back into the output and the
+// match. The last sequence only has literals; the last 5 bytes are always literals and no match starts in the last 12,
+// as the format asks. The compressor is the greedy one with a hash table of 4 byte sequences, any LZ4 decoder reads
+// its output.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const int LZ4_HASH_BITS = 16;
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;
+const size_t LZ4_MATCH_SAFE_DISTANCE = 12;
+const size_t LZ4_MAX_OFFSET = 65535;
+
+// the most a block of size bytes can grow to
+inline size_t lz4CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+inline uint32_t lz4Read32(const unsigned char *p)
+{
+	uint32_t value;
+	memcpy(&value, p, 4);
+	return value;
+}
+
+inline uint32_t lz4Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+// writes length - 15 as the extra bytes of a token field that is 15
+inline unsigned char* lz4WriteLength(unsigned char *out, size_t length)
+{
+	for (length -= 15; length >= 255; length -= 255)
+		*out++ = 255;
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+inline unsigned char* lz4WriteSequence(unsigned char *out, const unsigned char *literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+	unsigned char *token = out++;
+	*token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15)
+		out = lz4WriteLength(out, literalLength);
+	memcpy(out, literals, literalLength);
+	out += literalLength;
+	if (matchLength == 0)
+		return out;
+	*out++ = (unsigned char)offset;
+	*out++ = (unsigned char)(offset >> 8);
+	matchLength -= LZ4_MIN_MATCH;
+	*token |= (unsigned char)(matchLength >= 15 ? 15 : matchLength);
+	if (matchLength >= 15)
+		out = lz4WriteLength(out, matchLength);
+	return out;
+}
+
+// compresses size bytes of input into a block
+inline std::vector<unsigned char> lz4Compress(const unsigned char *input, size_t size)
+{
+	std::vector<unsigned char> output(lz4CompressBound(size));
+	unsigned char *out = output.data();
+	size_t anchor = 0;
+	if (size > LZ4_MATCH_SAFE_DISTANCE)
+	{
+		// positions + 1, 0 means nothing seen yet
+		std::vector<uint32_t> table((size_t)1 << LZ4_HASH_BITS, 0);
+		size_t matchLimit = size - LZ4_LAST_LITERALS;
+		for (size_t position = 0; position < size - LZ4_MATCH_SAFE_DISTANCE;)
+		{
+			uint32_t sequence = lz4Read32(input + position);
+			uint32_t &entry = table[lz4Hash(sequence)];
+			size_t candidate = entry;
+			entry = (uint32_t)position + 1;
+			if (candidate == 0 || position - (candidate - 1) > LZ4_MAX_OFFSET || lz4Read32(input + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+			size_t reference = candidate - 1;
+			size_t length = LZ4_MIN_MATCH;
+			while (position + length < matchLimit && input[reference + length] == input[position + length])
+				length++;
+			out = lz4WriteSequence(out, input + anchor, position - anchor, position - reference, length);
+			position += length;
+			anchor = position;
+		}
+	}
+	out = lz4WriteSequence(out, input + anchor, size - anchor, 0, 0);
+	output.resize(out - output.data());
+	return output;
+}
+
+// reads a field's extra length bytes, false if they run past the end
+inline bool lz4ReadLength(const unsigned char *&in, const unsigned char *end, size_t &length)
+{
+	unsigned char byte;
+	do
+	{
+		if (in >= end)
+			return false;
+		byte = *in++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+// decompresses a block into exactly outputSize bytes at output. false if the block is damaged or doesn't decompress to
+// that size, it never reads or writes out of bounds.
+inline bool lz4Decompress(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize)
+{
+	const unsigned char *in = input, *inEnd = input + inputSize;
+	unsigned char *out = output, *outEnd = output + outputSize;
+	while (in < inEnd)
+	{
+		unsigned char token = *in++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !lz4ReadLength(in, inEnd, literalLength))
+			return false;
+		if (literalLength > (size_t)(inEnd - in) || literalLength > (size_t)(outEnd - out))
+			return false;
+		memcpy(out, in, literalLength);
+		in += literalLength;
+		out += literalLength;
+		if (in == inEnd)
+			break;
+
+		if (inEnd - in < 2)
+			return false;
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - output))
+			return false;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !lz4ReadLength(in, inEnd, matchLength))
+			return false;
+		matchLength += LZ4_MIN_MATCH;
+		if (matchLength > (size_t)(outEnd - out))
+			return false;
+		// the match may overlap what it writes (offset < length repeats the last offset bytes), copy that in steps of
+		// offset bytes, each of which reads only what is already written
+		const unsigned char *match = out - offset;
+		if (offset >= matchLength)
+			memcpy(out, match, matchLength);
+		else if (offset >= 8)
+			for (size_t i = 0; i < matchLength; i += offset)
+				memcpy(out + i, match + i, std::min(offset, matchLength - i));
+		else
+			for (size_t i = 0; i < matchLength; i++)
+				out[i] = match[i];
+		out += matchLength;
+	}
+	return out == outEnd;
+}
+#endif
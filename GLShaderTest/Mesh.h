@@ -6,7 +6,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MeshLod.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
 #include "Shader.h"
+#include "VertexFormat.h"
 
 #include <string>
 #include <vector>
@@ -29,38 +33,211 @@ struct Texture {
 	unsigned int id;
 	string type;
 	string path;
+	int layer = -1;	// of the GL_TEXTURE_2D_ARRAY id when the texture was packed (TextureArrays.h), -1 for a GL_TEXTURE_2D
 };
 
+// a material texture as the model file names it, before it gets loaded
+struct TextureRef {
+	string type;
+	string path;
+};
+
+// CPU-side result of importing one mesh, everything needed to create the Mesh on the GL thread
+struct MeshData {
+	vector<Vertex>       vertices;
+	vector<unsigned int> indices;	// the indices of every level of detail, one after another
+	vector<TextureRef>   textures;
+	vector<MeshLod>      lods;		// empty if the mesh has no levels besides itself
+};
+
+// uploads indices into the GL_ELEMENT_ARRAY_BUFFER that is currently bound, as 16 bit if every index of a
+// vertexCount vertex mesh fits. returns the type to pass to glDrawElements.
+inline GLenum uploadIndexBuffer(const unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+	if (vertexCount <= 65536)
+	{
+		vector<unsigned short> shortIndices(indices, indices + indexCount);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+		return GL_UNSIGNED_SHORT;
+	}
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+	return GL_UNSIGNED_INT;
+}
+
 class Mesh {
 public:
 	// mesh Data
 	vector<Vertex>       vertices;
 	vector<unsigned int> indices;
 	vector<Texture>      textures;
+	vector<MeshLod>      lods;	// ranges of the index buffer, level 0 is the full mesh
 	unsigned int VAO;
+	unsigned int indexCount;	// of level 0, what Draw draws
+	unsigned int currentLod = 0;	// the level Submit picked last, selectLod only leaves it with some margin
+	GLenum indexType;	// GL_UNSIGNED_SHORT when the mesh has at most 65536 vertices, GL_UNSIGNED_INT otherwise
+	VertexLayout layout;
+	Bounds bounds;	// of the positions, packed positions are stored relative to it
+	BoundingSphere sphere;	// of the positions
+	RenderMaterial material;	// the textures with the sampler each one is bound to
 
-	// constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	// constructor, pass the vectors with std::move to hand them over without copying.
+	// lods are ranges of indices (see MeshLod.h), without any the whole index buffer is the only level.
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexLayout layout = VERTEX_LAYOUT_FLOAT,
+		vector<MeshLod> lods = vector<MeshLod>()) : layout(layout)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
+		this->textures = std::move(textures);
+		setupMaterial();
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
-		setupMesh();
+		setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), std::move(lods));
+	}
+
+	// constructor for data that already lives somewhere else (e.g. a memory mapped model cache).
+	// the buffers are uploaded straight from the given pointers and no CPU-side copy is kept.
+	Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<Texture> textures,
+		VertexLayout layout = VERTEX_LAYOUT_FLOAT, vector<MeshLod> lods = vector<MeshLod>()) : layout(layout)
+	{
+		this->textures = std::move(textures);
+		setupMaterial();
+
+		setupMesh(vertexData, vertexCount, indexData, indexCount, std::move(lods));
+	}
+
+	// frees the CPU copy of the vertices and indices once they live on the GPU, drawing only needs VAO, indexCount and indexType
+	void releaseCpuData()
+	{
+		vector<Vertex>().swap(vertices);
+		vector<unsigned int>().swap(indices);
+	}
+
+	// deletes the GL buffers, the mesh can't be drawn afterwards
+	void releaseGpuData()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		VAO = VBO = EBO = 0;
+	}
+
+	// a second VAO over the same buffers and attributes, for drawing the mesh with per-instance attributes added
+	// (see InstanceBuffer::attach). the caller deletes it.
+	unsigned int createVertexArray() const
+	{
+		unsigned int vao;
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (layout == VERTEX_LAYOUT_PACKED)
+			setPackedAttributes();
+		else
+			setFloatAttributes();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBindVertexArray(0);
+		return vao;
 	}
 
 	// render the mesh
 	void Draw(Shader &shader)
 	{
+		PROFILE_SCOPE("Mesh::Draw");
+		if (uniformShader != shader.serial)
+			lookupUniforms(shader);
+
 		// bind appropriate textures
+		for (unsigned int i = 0; i < material.textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+			// now set the sampler to the correct texture unit
+			shader.setInt(material.sampler(shader, i), i);
+			// and finally bind the texture
+			glBindTexture(material.textures[i].target, material.textures[i].texture);
+		}
+		shader.setFloat(materialLayerUniform, material.layer);
+
+		// packed vertices are decoded in the vertex shader, it needs to know the bounds they're relative to
+		if (layout == VERTEX_LAYOUT_PACKED)
+		{
+			shader.setInt(packedVerticesUniform, 1);
+			shader.setVec3(positionOffsetUniform, bounds.min);
+			shader.setVec3(positionScaleUniform, bounds.max - bounds.min);
+		}
+
+		// draw mesh
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+		glBindVertexArray(0);
+
+		// everything else drawn with this shader uses plain float vertices
+		if (layout == VERTEX_LAYOUT_PACKED)
+			shader.setInt(packedVerticesUniform, 0);
+
+		// always good practice to set everything back to defaults once configured.
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// queue the mesh instead of drawing it now, model is the matrix Draw would have been called with.
+	// the level of detail is the coarsest one whose error stays under a pixel or so seen from eye (lodSettings())
+	void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const glm::vec3 &eye, float farPlane, unsigned int layer = 0)
+	{
+		DrawItem item;
+		transformBounds(bounds, model, item.center, item.extent);
+		currentLod = selectLod(lods.data(), lods.size(), currentLod, maxScale(model), distanceToBox(eye, item.center, item.extent), lodSettings());
+		glm::vec3 center = glm::vec3(model * glm::vec4(sphere.center, 1.0f));
+		item.key = makeSortKey(layer, shader.serial, material.id, VAO, glm::length(center - eye), farPlane);
+		item.shader = &shader;
+		item.program = shader.ID;
+		item.material = &material;
+		item.vao = VAO;
+		item.indexType = indexType;
+		item.count = (GLsizei)lods[currentLod].indexCount;
+		item.firstIndex = lods[currentLod].firstIndex;
+		item.model = model;
+		item.packedBounds = layout == VERTEX_LAYOUT_PACKED ? &bounds : nullptr;
+		item.instanceCount = 0;
+		queue.submit(item);
+	}
+
+private:
+	// render data 
+	unsigned int VBO, EBO;
+
+	// handles into the shader this mesh was last drawn with (by Shader::serial), looked up again if that changes
+	unsigned int uniformShader = 0;
+	UniformHandle packedVerticesUniform, positionOffsetUniform, positionScaleUniform, materialLayerUniform;
+
+	void lookupUniforms(const Shader &shader)
+	{
+		materialLayerUniform = shader.uniform("materialLayer");
+		packedVerticesUniform = shader.uniform("packedVertices");
+		positionOffsetUniform = shader.uniform("positionOffset");
+		positionScaleUniform = shader.uniform("positionScale");
+		uniformShader = shader.serial;
+	}
+
+	void setupMaterial()
+	{
+		// sampler names follow the model convention: the type plus a number counting textures of that type,
+		// texture_diffuse1, texture_diffuse2, texture_specular1, ...
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
 		unsigned int normalNr = 1;
 		unsigned int heightNr = 1;
+		vector<MaterialTexture> materialTextures;
+		float layer = -1.0f;
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+			// a diffuse texture packed into an array goes on MATERIAL_ARRAY_UNIT (1), where the shader reads it as
+			// materialDiffuseArray; unit 0 stays empty, and the rest follow from unit 2
+			if (textures[i].layer >= 0 && materialTextures.empty())
+			{
+				materialTextures.push_back({ GL_TEXTURE_2D, 0, "" });
+				materialTextures.push_back({ GL_TEXTURE_2D_ARRAY, textures[i].id, "" });
+				layer = (float)textures[i].layer;
+				diffuseNr++;
+				continue;
+			}
 			// retrieve texture number (the N in diffuse_textureN)
 			string number;
 			string name = textures[i].type;
@@ -72,46 +249,54 @@ public:
 				number = std::to_string(normalNr++); // transfer unsigned int to stream
 			else if (name == "texture_height")
 				number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-			// now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-			// and finally bind the texture
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			materialTextures.push_back({ GL_TEXTURE_2D, textures[i].id, name + number });
 		}
-
-		// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
-		// always good practice to set everything back to defaults once configured.
-		glActiveTexture(GL_TEXTURE0);
+		material = RenderMaterial(std::move(materialTextures), layer);
 	}
 
-private:
-	// render data 
-	unsigned int VBO, EBO;
-
 	// initializes all the buffer objects/arrays
-	void setupMesh()
+	void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, vector<MeshLod> lods)
 	{
+		this->lods = std::move(lods);
+		if (this->lods.empty())
+			this->lods.push_back(MeshLod{ 0, (unsigned int)indexCount, 0.0f });
+		this->indexCount = this->lods[0].indexCount;
+		bounds = computeBounds(vertexData, vertexCount);
+		sphere = computeBoundingSphere(vertexData, vertexCount, bounds);
+
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
+
 		glBindVertexArray(VAO);
 		// load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		if (layout == VERTEX_LAYOUT_PACKED)
+			setupPackedVertices(vertexData, vertexCount);
+		else
+			setupFloatVertices(vertexData, vertexCount);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		indexType = uploadIndexBuffer(indexData, indexCount, vertexCount);
+
+		glBindVertexArray(0);
+	}
+
+	// uploads struct Vertex as is
+	void setupFloatVertices(const Vertex *vertexData, size_t vertexCount)
+	{
 		// A great thing about structs is that their memory layout is sequential for all its items.
 		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+		setFloatAttributes();
+	}
 
-		// set the vertex attribute pointers
+	// set the vertex attribute pointers for struct Vertex in the bound VBO
+	void setFloatAttributes() const
+	{
 		// vertex Positions
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -127,8 +312,31 @@ private:
 		// vertex bitangent
 		glEnableVertexAttribArray(4);
 		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+	}
 
-		glBindVertexArray(0);
+	// converts to PackedVertex (see VertexFormat.h) and uploads that, the attributes arrive in the shader as
+	// normalized floats / halfs and get decoded there
+	void setupPackedVertices(const Vertex *vertexData, size_t vertexCount)
+	{
+		vector<PackedVertex> packed = packVertices(vertexData, vertexCount, bounds);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+		setPackedAttributes();
+	}
+
+	void setPackedAttributes() const
+	{
+		// vertex Positions (xyz) and tangent handedness (w)
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+		// vertex normals, octahedral
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+		// vertex tangent, octahedral (the bitangent is rebuilt from normal, tangent and handedness)
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
 	}
 };
 #endif
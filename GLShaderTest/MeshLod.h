@@ -0,0 +1,82 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+// Discrete levels of detail of a mesh. Every level draws from the vertex buffer of the full mesh and is a range of
+// its index buffer, level 0 (the full mesh) first. The error of a level is an estimate of how far, in model units,
+// its surface is from the full one (see MeshSimplifier.h); selectLod projects it to pixels and takes the coarsest
+// level that stays under LodSettings::maxPixelError.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+const unsigned int MESH_MAX_LODS = 4;	// the full mesh and up to three simplified ones
+
+struct MeshLod {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;	// 0 for level 0
+};
+
+struct LodSettings {
+	bool enabled = true;		// off draws level 0 everywhere (--no-lod)
+	float maxPixelError = 1.0f;
+	float hysteresis = 0.25f;	// a coarser level is only taken once its error is this fraction below maxPixelError
+	float pixelsPerUnit = 0.0f;	// pixels covered by one unit at distance one, see setProjection
+
+	// from the vertical field of view (Camera::Zoom) and the height of the viewport, once per frame
+	void setProjection(float fovyDegrees, float viewportHeight)
+	{
+		pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f));
+	}
+};
+
+// what every Mesh::Submit selects with, main sets the projection each frame
+inline LodSettings& lodSettings()
+{
+	static LodSettings settings;
+	return settings;
+}
+
+// distance from point to the nearest point of the box, 0 inside
+inline float distanceToBox(const glm::vec3 &point, const glm::vec3 &center, const glm::vec3 &extent)
+{
+	return glm::length(glm::max(glm::abs(point - center) - extent, glm::vec3(0.0f)));
+}
+
+// how much a matrix stretches model units at most, the length of its longest axis
+inline float maxScale(const glm::mat4 &model)
+{
+	return std::sqrt(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+		std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+}
+
+// the level to draw. current is the level drawn last time: it is kept while its error stays under the threshold, and
+// only given up for a coarser one that is clearly under it, so a mesh at the edge of a threshold doesn't pop every frame.
+// scale is maxScale of the model matrix, distance the distance from the eye to the mesh bounds.
+inline unsigned int selectLod(const MeshLod *lods, size_t lodCount, unsigned int current, float scale, float distance, const LodSettings &settings)
+{
+	if (!settings.enabled || lodCount < 2)
+		return 0;
+	if (current >= lodCount)
+		current = 0;
+	float pixelsPerError = scale * settings.pixelsPerUnit / std::max(distance, 1e-4f);
+	// errors grow with the level, so both of these are the last level under their threshold
+	unsigned int allowed = 0, clearlyAllowed = 0;
+	for (unsigned int i = 1; i < lodCount; i++)
+	{
+		float pixels = lods[i].error * pixelsPerError;
+		if (pixels <= settings.maxPixelError)
+			allowed = i;
+		if (pixels <= settings.maxPixelError * (1.0f - settings.hysteresis))
+			clearlyAllowed = i;
+	}
+	if (allowed < current)
+		return allowed;
+	if (clearlyAllowed > current)
+		return clearlyAllowed;
+	return current;
+}
+#endif
@@ -0,0 +1,361 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+// Passes over indexed triangle lists (welding, and the optional post-import reordering), plus the post-transform
+// vertex cache simulator used to measure them. All of it is plain CPU code working on index/vertex arrays.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// ------------------------------------------------------------------------
+// Vertex welding: vertices whose components all differ by at most epsilon become one. Vertices are hashed by the
+// cell of their position on a grid of 2 * epsilon, so a match is either in the same cell or, per axis, in the
+// neighbour cell on the side the position is closer to: 8 cells to look at. The first vertex of a group is the one
+// that is kept. Vertices are read as floatsPerVertex plain floats, which fits struct Vertex as well as the
+// interleaved arrays in models.h (position first in both).
+// remap[i] is the welded index of vertex i, the return value the number of vertices left.
+inline size_t weldVertexRemap(const float *vertices, size_t vertexCount, size_t floatsPerVertex, float epsilon, std::vector<unsigned int> &remap)
+{
+	float cellSize = std::max(2.0f * epsilon, 1e-6f);
+	auto cellKey = [](long long x, long long y, long long z) {
+		return (uint64_t)x * 73856093ull ^ (uint64_t)y * 19349663ull ^ (uint64_t)z * 83492791ull;
+	};
+
+	std::unordered_multimap<uint64_t, unsigned int> grid;
+	grid.reserve(vertexCount);
+	std::vector<unsigned int> kept;		// original index of every welded vertex
+	remap.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float *v = vertices + i * floatsPerVertex;
+		long long cell[3], side[3];
+		for (int c = 0; c < 3; c++)
+		{
+			double scaled = v[c] / cellSize;
+			cell[c] = (long long)std::floor(scaled);
+			side[c] = scaled - cell[c] < 0.5 ? -1 : 1;
+		}
+
+		long long match = -1;
+		for (int n = 0; n < 8 && match < 0; n++)
+		{
+			uint64_t key = cellKey(cell[0] + ((n & 1) ? side[0] : 0), cell[1] + ((n & 2) ? side[1] : 0), cell[2] + ((n & 4) ? side[2] : 0));
+			auto range = grid.equal_range(key);
+			for (auto it = range.first; it != range.second && match < 0; ++it)
+			{
+				const float *candidate = vertices + (size_t)kept[it->second] * floatsPerVertex;
+				size_t f = 0;
+				while (f < floatsPerVertex && std::fabs(candidate[f] - v[f]) <= epsilon)
+					f++;
+				if (f == floatsPerVertex)
+					match = it->second;
+			}
+		}
+
+		if (match < 0)
+		{
+			match = (long long)kept.size();
+			grid.insert(std::make_pair(cellKey(cell[0], cell[1], cell[2]), (unsigned int)match));
+			kept.push_back((unsigned int)i);
+		}
+		remap[i] = (unsigned int)match;
+	}
+	return kept.size();
+}
+
+// welds an indexed mesh in place; VertexType must be made of floats only (like struct Vertex)
+template <typename VertexType>
+inline void weldVertices(std::vector<VertexType> &vertices, std::vector<unsigned int> &indices, float epsilon)
+{
+	static_assert(sizeof(VertexType) % sizeof(float) == 0, "weldVertices expects vertices made of floats");
+	std::vector<unsigned int> remap;
+	size_t weldedCount = weldVertexRemap((const float*)vertices.data(), vertices.size(), sizeof(VertexType) / sizeof(float), epsilon, remap);
+
+	std::vector<VertexType> welded(weldedCount);
+	for (size_t i = vertices.size(); i-- > 0; )	// backwards, so the first vertex of each group is the one that stays
+		welded[remap[i]] = vertices[i];
+	for (unsigned int &index : indices)
+		index = remap[index];
+	vertices.swap(welded);
+}
+
+// turns an unindexed interleaved float array (as drawn with glDrawArrays) into unique vertices plus indices
+inline void weldFloatVertices(const float *vertices, size_t vertexCount, size_t floatsPerVertex, float epsilon,
+	std::vector<float> &outVertices, std::vector<unsigned int> &outIndices)
+{
+	size_t weldedCount = weldVertexRemap(vertices, vertexCount, floatsPerVertex, epsilon, outIndices);
+	outVertices.resize(weldedCount * floatsPerVertex);
+	for (size_t i = vertexCount; i-- > 0; )
+		std::copy(vertices + i * floatsPerVertex, vertices + (i + 1) * floatsPerVertex, outVertices.begin() + outIndices[i] * floatsPerVertex);
+}
+
+// ------------------------------------------------------------------------
+// Post-transform cache hit/miss statistics of an index buffer on a FIFO cache of cacheSize entries.
+//   ACMR: average cache miss ratio, vertex shader invocations per triangle (0.5 is ideal for big regular meshes, 3 the worst)
+//   ATVR: average transform to vertex ratio, invocations per referenced vertex (1.0 is ideal)
+struct VertexCacheStats {
+	size_t misses = 0;
+	size_t triangles = 0;
+	size_t vertices = 0;
+	float acmr() const { return triangles ? (float)misses / triangles : 0.0f; }
+	float atvr() const { return vertices ? (float)misses / vertices : 0.0f; }
+};
+
+// a FIFO cache modelled with timestamps: a vertex is cached if it was pushed less than size pushes ago
+class FifoVertexCache
+{
+public:
+	FifoVertexCache(size_t vertexCount, unsigned int size) : pushedAt(vertexCount, 0), time(size + 1), size(size) {}
+
+	// returns true on a miss (the vertex had to be transformed)
+	bool access(unsigned int vertex)
+	{
+		if (time - pushedAt[vertex] <= size)
+			return false;
+		pushedAt[vertex] = time++;
+		return true;
+	}
+
+private:
+	std::vector<unsigned int> pushedAt;
+	unsigned int time;
+	unsigned int size;
+};
+
+inline VertexCacheStats simulateVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16)
+{
+	VertexCacheStats stats;
+	FifoVertexCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (cache.access(indices[i]))
+			stats.misses++;
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			stats.vertices++;
+		}
+	}
+	stats.triangles = indexCount / 3;
+	return stats;
+}
+
+// ------------------------------------------------------------------------
+// Triangle reordering for vertex cache locality, "Tipsify" (Sander, Nehab, Barczak 2007): fan out around a vertex,
+// then continue with the candidate that is still in the cache and has the fewest triangles left, falling back to
+// recently used vertices (dead-end stack) and finally the next vertex in input order. Linear time.
+inline void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// vertex -> triangles adjacency in one array
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + liveTriangles[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0;
+
+	auto nextInInputOrder = [&]() -> long long {
+		while (cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				return (long long)cursor;
+			cursor++;
+		}
+		return -1;
+	};
+
+	long long fanning = nextInInputOrder();
+	while (fanning >= 0)
+	{
+		candidates.clear();
+		for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[t * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+		}
+
+		// best candidate: still in cache after emitting its remaining triangles, and oldest in cache among those
+		fanning = -1;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		while (fanning < 0 && !deadEnd.empty())
+		{
+			unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0)
+				fanning = v;
+		}
+		if (fanning < 0)
+			fanning = nextInInputOrder();
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// ------------------------------------------------------------------------
+// Overdraw reduction on top of a cache optimized order ("Fast triangle reordering for vertex locality and reduced
+// overdraw", same authors): cut the triangle list into clusters where the cache restarts anyway (hard boundaries)
+// or where the cluster alone is already close to the whole mesh's ACMR (soft boundaries), then draw the clusters
+// facing away from the mesh center first so they occlude what's behind them. Clusters are made larger until the
+// reordered list stays within threshold times the ACMR it started with; if none does, the order is left alone.
+template <typename VertexType>
+inline void optimizeOverdraw(unsigned int *indices, size_t indexCount, const VertexType *vertices, size_t vertexCount,
+	unsigned int cacheSize = 16, float threshold = 1.05f)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// misses per triangle in the current order
+	std::vector<unsigned char> misses(triangleCount);
+	FifoVertexCache cache(vertexCount, cacheSize);
+	size_t totalMisses = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		misses[t] = 0;
+		for (int corner = 0; corner < 3; corner++)
+			misses[t] += cache.access(indices[t * 3 + corner]) ? 1 : 0;
+		totalMisses += misses[t];
+	}
+	float meshAcmr = (float)totalMisses / triangleCount;
+
+	// per triangle area weighted centroid and normal, summed per cluster below
+	std::vector<glm::vec3> triangleCentroids(triangleCount), triangleNormals(triangleCount);
+	std::vector<float> triangleAreas(triangleCount);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].Position;
+		const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+		const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+		triangleNormals[t] = glm::cross(p1 - p0, p2 - p0);
+		triangleAreas[t] = glm::length(triangleNormals[t]);
+		triangleCentroids[t] = (p0 + p1 + p2) * (triangleAreas[t] / 3.0f);
+		meshCentroid += triangleCentroids[t];
+		meshArea += triangleAreas[t];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid = meshCentroid * (1.0f / meshArea);
+
+	std::vector<unsigned int> output(triangleCount * 3);
+	for (size_t minClusterSize = 16; minClusterSize < triangleCount; minClusterSize *= 2)
+	{
+		std::vector<size_t> clusterStarts;
+		size_t clusterMisses = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			size_t clusterSize = clusterStarts.empty() ? 0 : t - clusterStarts.back();
+			bool hard = misses[t] == 3;
+			bool soft = clusterSize >= minClusterSize && misses[t] > 0 && (float)clusterMisses / clusterSize <= meshAcmr * threshold;
+			if (clusterStarts.empty() || hard || soft)
+			{
+				clusterStarts.push_back(t);
+				clusterMisses = 0;
+			}
+			clusterMisses += misses[t];
+		}
+		clusterStarts.push_back(triangleCount);
+		size_t clusterCount = clusterStarts.size() - 1;
+
+		std::vector<float> sortKey(clusterCount, 0.0f);
+		for (size_t c = 0; c < clusterCount; c++)
+		{
+			glm::vec3 centroid(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+			{
+				centroid += triangleCentroids[t];
+				normal += triangleNormals[t];
+				area += triangleAreas[t];
+			}
+			float length = glm::length(normal);
+			if (area > 0.0f && length > 0.0f)
+				sortKey[c] = glm::dot(centroid * (1.0f / area) - meshCentroid, normal * (1.0f / length));
+		}
+		std::vector<size_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; c++)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+		unsigned int *out = output.data();
+		for (size_t c : order)
+			out = std::copy(indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3, out);
+
+		if (simulateVertexCache(output.data(), output.size(), vertexCount, cacheSize).acmr() <= meshAcmr * threshold)
+		{
+			std::copy(output.begin(), output.end(), indices);
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+// Vertex reordering for fetch locality: vertices are renumbered in the order the index buffer first uses them,
+// unreferenced ones are dropped.
+template <typename VertexType>
+inline void optimizeVertexFetch(std::vector<VertexType> &vertices, std::vector<unsigned int> &indices)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<VertexType> reordered;
+	reordered.reserve(vertices.size());
+	for (unsigned int &index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(reordered);
+}
+#endif
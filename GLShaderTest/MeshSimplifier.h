@@ -0,0 +1,373 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+// Simplification for the levels of detail of imported meshes: quadric error metrics (Garland, Heckbert 1997) driving
+// half edge collapses. A collapse moves a vertex onto one of its neighbours, so every level reuses the vertices of
+// the full mesh and only needs indices of its own (see MeshLod.h). Vertices are read as floatsPerVertex plain floats
+// with the position first, like the welding in MeshOptimizer.h.
+
+#include <glm/glm.hpp>
+
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ------------------------------------------------------------------------
+// weighted sum of squared distances to a set of planes, v^T Q v with the symmetric 4x4 Q stored as its 10 entries
+struct Quadric {
+	double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+	double weight = 0;
+
+	// the plane dot(normal, x) + d = 0, normal of unit length
+	void addPlane(const glm::vec3 &normal, float d, double w)
+	{
+		double a = normal.x, b = normal.y, c = normal.z;
+		a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+		b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+		c2 += w * c * c; cd += w * c * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void add(const Quadric &q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	double evaluate(const glm::vec3 &v) const
+	{
+		double x = v.x, y = v.y, z = v.z;
+		return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+			b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+			c2 * z * z + 2.0 * cd * z + d2;
+	}
+};
+
+// ------------------------------------------------------------------------
+// Collapses are planned on positions, not vertices: vertices that only differ in normal or uv (the two sides of a
+// uv seam) share a position and its quadric. When a position moves onto another one, each of its vertices becomes
+// the vertex of the target that it shares a triangle with, which keeps the two sides of a seam apart. A collapse is
+// refused if that mapping isn't clear, if it would flip a triangle, or if it would pull an open border inwards.
+// Borders and seams additionally get planes perpendicular to their triangles, so collapsing along them is cheap
+// but moving them is not. Vertices on edges shared by more than two triangles never move.
+class QuadricSimplifier
+{
+public:
+	// weight of the border and seam planes relative to the triangle planes, both scaled by area
+	static constexpr double BORDER_WEIGHT = 4.0;
+
+	QuadricSimplifier(const float *vertices, size_t vertexCount, size_t floatsPerVertex, const unsigned int *indices, size_t indexCount)
+		: corners(indices, indices + indexCount / 3 * 3), liveTriangles(0), maxCost(0.0)
+	{
+		std::vector<float> vertexPositions(vertexCount * 3);
+		for (size_t i = 0; i < vertexCount; i++)
+			std::copy(vertices + i * floatsPerVertex, vertices + i * floatsPerVertex + 3, vertexPositions.begin() + i * 3);
+		size_t positionCount = weldVertexRemap(vertexPositions.data(), vertexCount, 3, 0.0f, vertexPosition);
+		positions.resize(positionCount);
+		for (size_t i = vertexCount; i-- > 0; )
+			positions[vertexPosition[i]] = glm::vec3(vertexPositions[i * 3], vertexPositions[i * 3 + 1], vertexPositions[i * 3 + 2]);
+
+		size_t triangleCount = corners.size() / 3;
+		alive.assign(triangleCount, 0);
+		positionTriangles.resize(positionCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			unsigned int a = cornerPosition(t, 0), b = cornerPosition(t, 1), c = cornerPosition(t, 2);
+			if (a == b || b == c || a == c)
+				continue;	// degenerate in position, left out of every simplified level
+			alive[t] = 1;
+			liveTriangles++;
+			for (int k = 0; k < 3; k++)
+				positionTriangles[cornerPosition(t, k)].push_back((unsigned int)t);
+		}
+
+		// every edge with the number of triangles on it and whether they agree on its vertices
+		struct Edge {
+			unsigned int triangles;
+			unsigned int firstVertex, secondVertex;	// at the lower and the higher position
+			bool seam;
+		};
+		std::unordered_map<uint64_t, Edge> edges;
+		edges.reserve(liveTriangles * 2);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v0 = corners[t * 3 + k], v1 = corners[t * 3 + (k + 1) % 3];
+				if (vertexPosition[v0] > vertexPosition[v1])
+					std::swap(v0, v1);
+				auto inserted = edges.insert(std::make_pair(edgeKey(vertexPosition[v0], vertexPosition[v1]), Edge{ 1, v0, v1, false }));
+				Edge &edge = inserted.first->second;
+				if (inserted.second)
+					continue;
+				edge.triangles++;
+				edge.seam = edge.seam || edge.firstVertex != v0 || edge.secondVertex != v1;
+			}
+		}
+
+		quadrics.resize(positionCount);
+		locked.assign(positionCount, 0);
+		border.assign(positionCount, 0);
+		for (const auto &entry : edges)
+		{
+			unsigned int p0 = (unsigned int)(entry.first >> 32), p1 = (unsigned int)entry.first;
+			if (entry.second.triangles > 2)
+				locked[p0] = locked[p1] = 1;
+			else if (entry.second.triangles == 1)
+				border[p0] = border[p1] = 1;
+		}
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (!alive[t])
+				continue;
+			const glm::vec3 &a = positions[cornerPosition(t, 0)], &b = positions[cornerPosition(t, 1)], &c = positions[cornerPosition(t, 2)];
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length <= 0.0f)
+				continue;
+			normal /= length;
+			for (int k = 0; k < 3; k++)
+				quadrics[cornerPosition(t, k)].addPlane(normal, -glm::dot(normal, a), 0.5 * length);
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int p0 = cornerPosition(t, k), p1 = cornerPosition(t, (k + 1) % 3);
+				const Edge &edge = edges[edgeKey(std::min(p0, p1), std::max(p0, p1))];
+				if (edge.triangles != 1 && !edge.seam)
+					continue;
+				glm::vec3 along = positions[p1] - positions[p0];
+				glm::vec3 across = glm::cross(along, normal);
+				float acrossLength = glm::length(across);
+				if (acrossLength <= 0.0f)
+					continue;
+				across /= acrossLength;
+				double w = BORDER_WEIGHT * glm::dot(along, along);
+				quadrics[p0].addPlane(across, -glm::dot(across, positions[p0]), w);
+				quadrics[p1].addPlane(across, -glm::dot(across, positions[p0]), w);
+			}
+		}
+
+		version.assign(positionCount, 0);
+		removed.assign(positionCount, 0);
+		for (const auto &entry : edges)
+		{
+			unsigned int p0 = (unsigned int)(entry.first >> 32), p1 = (unsigned int)entry.first;
+			pushCollapse(p0, p1);
+			pushCollapse(p1, p0);
+		}
+	}
+
+	// collapses the cheapest edges until at most targetIndexCount indices are left or nothing can collapse any more.
+	// can be called again with a lower target, the quadrics and the error carry over.
+	void simplify(size_t targetIndexCount)
+	{
+		while (liveTriangles * 3 > targetIndexCount && !collapses.empty())
+		{
+			Collapse next = collapses.top();
+			collapses.pop();
+			if (removed[next.from] || removed[next.to] || version[next.from] != next.fromVersion || version[next.to] != next.toVersion)
+				continue;	// an endpoint changed since this was queued, a newer entry covers it
+			if (collapse(next.from, next.to))
+				maxCost = std::max(maxCost, next.cost);
+		}
+	}
+
+	size_t indexCount() const { return liveTriangles * 3; }
+
+	// the largest error of any collapse so far, roughly how far the surface has moved, in the units of the positions
+	float error() const { return (float)std::sqrt(std::max(maxCost, 0.0)); }
+
+	// appends the triangles that are left, in their original order
+	void write(std::vector<unsigned int> &out) const
+	{
+		for (size_t t = 0; t < alive.size(); t++)
+			if (alive[t])
+				out.insert(out.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+	}
+
+private:
+	struct Collapse {
+		double cost;
+		unsigned int from, to;
+		unsigned int fromVersion, toVersion;
+
+		bool operator>(const Collapse &other) const { return cost > other.cost; }
+	};
+
+	std::vector<unsigned int> corners;		// 3 vertices per triangle, rewritten as collapses move them
+	std::vector<uint8_t> alive;				// per triangle
+	size_t liveTriangles;
+	std::vector<unsigned int> vertexPosition;	// per vertex
+	std::vector<glm::vec3> positions;
+	std::vector<std::vector<unsigned int>> positionTriangles;	// per position, may still list dead triangles
+	std::vector<Quadric> quadrics;
+	std::vector<uint8_t> locked, border, removed;
+	std::vector<unsigned int> version;		// per position, bumped when its quadric changes
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+	double maxCost;
+
+	static uint64_t edgeKey(unsigned int p0, unsigned int p1) { return ((uint64_t)p0 << 32) | p1; }
+
+	unsigned int cornerPosition(size_t triangle, int corner) const { return vertexPosition[corners[triangle * 3 + corner]]; }
+
+	// mean squared distance of the target to the planes of both positions
+	double collapseCost(unsigned int from, unsigned int to) const
+	{
+		Quadric sum = quadrics[from];
+		sum.add(quadrics[to]);
+		return sum.weight > 0.0 ? sum.evaluate(positions[to]) / sum.weight : 0.0;
+	}
+
+	void pushCollapse(unsigned int from, unsigned int to)
+	{
+		if (!locked[from])
+			collapses.push(Collapse{ collapseCost(from, to), from, to, version[from], version[to] });
+	}
+
+	// moves position from onto position to, returns false (and changes nothing) if that isn't allowed
+	bool collapse(unsigned int from, unsigned int to)
+	{
+		std::vector<unsigned int> &triangles = positionTriangles[from];
+		std::vector<std::pair<unsigned int, unsigned int>> vertexMap;	// vertex at from -> vertex at to
+		std::vector<unsigned int> fromVertices;
+		size_t shared = 0;
+		for (unsigned int t : triangles)
+		{
+			if (!alive[t])
+				continue;
+			int fromCorner = -1, toCorner = -1;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int p = cornerPosition(t, k);
+				fromCorner = p == from ? k : fromCorner;
+				toCorner = p == to ? k : toCorner;
+			}
+			unsigned int vertex = corners[t * 3 + fromCorner];
+			if (std::find(fromVertices.begin(), fromVertices.end(), vertex) == fromVertices.end())
+				fromVertices.push_back(vertex);
+			if (toCorner >= 0)
+			{
+				shared++;
+				unsigned int target = corners[t * 3 + toCorner];
+				auto mapped = std::find_if(vertexMap.begin(), vertexMap.end(),
+					[vertex](const std::pair<unsigned int, unsigned int> &m) { return m.first == vertex; });
+				if (mapped == vertexMap.end())
+					vertexMap.push_back(std::make_pair(vertex, target));
+				else if (mapped->second != target)
+					return false;	// one vertex would have to become two
+				continue;
+			}
+			// the triangle stays, it must not turn over
+			glm::vec3 p[3], moved[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = positions[cornerPosition(t, k)];
+				moved[k] = k == fromCorner ? positions[to] : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, before) > 0.0f && glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+				return false;
+		}
+		if (shared == 0)
+			return false;	// not an edge any more
+		if (border[from] && shared != 1)
+			return false;	// a border vertex only moves along the border
+		for (unsigned int vertex : fromVertices)
+			if (std::find_if(vertexMap.begin(), vertexMap.end(),
+				[vertex](const std::pair<unsigned int, unsigned int> &m) { return m.first == vertex; }) == vertexMap.end())
+				return false;	// a side of a seam that has no counterpart at the target
+		for (size_t i = 0; i < vertexMap.size(); i++)
+			for (size_t j = i + 1; j < vertexMap.size(); j++)
+				if (vertexMap[i].second == vertexMap[j].second)
+					return false;	// the two sides of a seam would merge
+
+		std::vector<unsigned int> &targetTriangles = positionTriangles[to];
+		for (unsigned int t : triangles)
+		{
+			if (!alive[t])
+				continue;
+			bool degenerate = false;
+			for (int k = 0; k < 3; k++)
+				degenerate = degenerate || cornerPosition(t, k) == to;
+			if (degenerate)
+			{
+				alive[t] = 0;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+				for (const std::pair<unsigned int, unsigned int> &m : vertexMap)
+					if (corners[t * 3 + k] == m.first)
+						corners[t * 3 + k] = m.second;
+			targetTriangles.push_back(t);
+		}
+		std::vector<unsigned int>().swap(triangles);
+		targetTriangles.erase(std::remove_if(targetTriangles.begin(), targetTriangles.end(),
+			[this](unsigned int t) { return !alive[t]; }), targetTriangles.end());
+		removed[from] = 1;
+		quadrics[to].add(quadrics[from]);
+		version[to]++;
+
+		// the target's quadric changed, so did the cost of every edge at it
+		std::vector<unsigned int> neighbours;
+		for (unsigned int t : targetTriangles)
+			for (int k = 0; k < 3; k++)
+				if (cornerPosition(t, k) != to)
+					neighbours.push_back(cornerPosition(t, k));
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		for (unsigned int neighbour : neighbours)
+		{
+			pushCollapse(to, neighbour);
+			pushCollapse(neighbour, to);
+		}
+		return true;
+	}
+};
+
+// ------------------------------------------------------------------------
+// appends up to MESH_MAX_LODS - 1 simplified levels to the index buffer of a mesh, each aiming at half the triangles
+// of the one before, and lists all levels in lods (level 0 is the mesh as it was). the chain ends early when a level
+// can't get to three quarters of the one before; meshes under LOD_MIN_TRIANGLES only get level 0.
+// optimizeCache runs optimizeVertexCache on each new level.
+const size_t LOD_MIN_TRIANGLES = 64;
+
+template <typename VertexType>
+inline void generateMeshLods(const std::vector<VertexType> &vertices, std::vector<unsigned int> &indices, std::vector<MeshLod> &lods, bool optimizeCache)
+{
+	static_assert(sizeof(VertexType) % sizeof(float) == 0, "generateMeshLods expects vertices made of floats");
+	lods.assign(1, MeshLod{ 0, (unsigned int)indices.size(), 0.0f });
+	if (indices.size() < LOD_MIN_TRIANGLES * 3)
+		return;
+
+	QuadricSimplifier simplifier((const float*)vertices.data(), vertices.size(), sizeof(VertexType) / sizeof(float), indices.data(), indices.size());
+	size_t previous = indices.size();
+	for (unsigned int level = 1; level < MESH_MAX_LODS; level++)
+	{
+		simplifier.simplify(previous / 6 * 3);
+		size_t count = simplifier.indexCount();
+		if (count == 0 || count > previous / 4 * 3)
+			break;
+		MeshLod lod = { (unsigned int)indices.size(), (unsigned int)count, simplifier.error() };
+		simplifier.write(indices);
+		if (optimizeCache)
+			optimizeVertexCache(indices.data() + lod.firstIndex, count, vertices.size());
+		lods.push_back(lod);
+		previous = count;
+	}
+}
+#endif
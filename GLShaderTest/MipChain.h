@@ -0,0 +1,76 @@
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+// MIPmap chains built on the CPU. Every level is SOIL2's 2x2 box filter (mipmap_image_half_rows) of the level before it,
+// not of the full image like SOIL used to, and the rows of a level are cut into chunks of MIP_CHUNK_ROWS that the
+// threads of the pool take as they go. The sizes follow OpenGL's, max(1, size / 2), down to 1 x 1.
+// installSOILParallelFor hands the shared pool to SOIL2, so the MIPmaps of SOIL_FLAG_MIPMAPS are built the same way.
+// mipmap_image_half_rows and SOIL_set_parallel_for only exist in the SOIL2 sources of this tree, which the project
+// compiles: a prebuilt SOIL2 library doesn't have them.
+
+#include "SOIL2/SOIL2.h"
+#include "SOIL2/image_helper.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+const int MIP_CHUNK_ROWS = 32;
+
+struct MipLevel {
+	int width, height;
+	std::vector<unsigned char> pixels;
+};
+
+inline int mipSize(int size)
+{
+	return size > 1 ? size / 2 : 1;
+}
+
+// the next level of pixels, made on up to maxThreads threads of pool (0 = all of them plus the calling one). with
+// srgb the color channels are averaged in linear space.
+inline MipLevel buildMipLevel(const unsigned char *pixels, int width, int height, int channels, bool srgb, ThreadPool &pool,
+	unsigned int maxThreads = 0)
+{
+	MipLevel level;
+	level.width = mipSize(width);
+	level.height = mipSize(height);
+	level.pixels.resize((size_t)level.width * level.height * channels);
+	size_t chunks = (level.height + MIP_CHUNK_ROWS - 1) / MIP_CHUNK_ROWS;
+	pool.parallelFor(chunks, [&](size_t chunk) {
+		int first = (int)chunk * MIP_CHUNK_ROWS;
+		mipmap_image_half_rows(pixels, width, height, channels, level.pixels.data(), first, std::min(MIP_CHUNK_ROWS, level.height - first),
+			srgb ? 1 : 0);
+	}, maxThreads);
+	return level;
+}
+
+// levels 1 to the 1 x 1 one of a width x height image (level 0 is pixels itself). nothing for a 1 x 1 or invalid image.
+inline std::vector<MipLevel> buildMipChain(const unsigned char *pixels, int width, int height, int channels, bool srgb, ThreadPool &pool,
+	unsigned int maxThreads = 0)
+{
+	std::vector<MipLevel> levels;
+	if (!pixels || width < 1 || height < 1 || channels < 1 || channels > 4)
+		return levels;
+	while (width > 1 || height > 1)
+	{
+		levels.push_back(buildMipLevel(pixels, width, height, channels, srgb, pool, maxThreads));
+		pixels = levels.back().pixels.data();
+		width = levels.back().width;
+		height = levels.back().height;
+	}
+	return levels;
+}
+
+// SOIL2's parallel_for on the shared pool
+inline void soilParallelFor(int count, void (*job)(void *context, int index), void *context)
+{
+	sharedThreadPool().parallelFor((size_t)count, [&](size_t index) { job(context, (int)index); });
+}
+
+inline void installSOILParallelFor()
+{
+	SOIL_set_parallel_for(soilParallelFor);
+}
+#endif
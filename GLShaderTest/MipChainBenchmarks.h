@@ -0,0 +1,97 @@
+#ifndef MIP_CHAIN_BENCHMARKS_H
+#define MIP_CHAIN_BENCHMARKS_H
+
+// Benchmark of buildMipChain against the mipmaps SOIL used to make. CPU only, no GL.
+
+#include "SOIL2/SOIL2.h"
+#include "SOIL2/image_helper.h"
+
+#include "BenchmarkUtils.h"
+#include "MipChain.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// the levels SOIL used to make for SOIL_FLAG_MIPMAPS: each one box filtered from the full image by mipmap_image
+inline vector<MipLevel> fullImageMipChain(const unsigned char *pixels, int width, int height, int channels)
+{
+	vector<MipLevel> levels;
+	for (int level = 1; (1 << level) <= width || (1 << level) <= height; level++)
+	{
+		MipLevel mip;
+		mip.width = max(1, width >> level);
+		mip.height = max(1, height >> level);
+		mip.pixels.resize((size_t)mip.width * mip.height * channels);
+		mipmap_image(pixels, width, height, channels, mip.pixels.data(), 1 << level, 1 << level);
+		levels.push_back(mip);
+	}
+	return levels;
+}
+
+// --bench-mipmaps: the mipmaps of every image under pic/ and model/, made the way SOIL used to (fullImageMipChain) and
+// chained from the level before (buildMipChain) on 1, 2, 4, ... threads, plus chained in linear space on all of them.
+// best of 3 runs over all the images. "diff" is the mean difference of a channel from the old levels.
+inline void benchmarkMipmaps()
+{
+	struct Image {
+		unsigned char *pixels;
+		int width, height, channels;
+	};
+	vector<string> paths;
+	listFiles("pic", { "jpg", "jpeg", "png", "tga", "bmp" }, paths);
+	listFiles("model", { "jpg", "jpeg", "png", "tga", "bmp" }, paths);
+	vector<Image> images;
+	double megapixels = 0.0;
+	for (const string &path : paths)
+	{
+		Image image;
+		image.pixels = SOIL_load_image(path.c_str(), &image.width, &image.height, &image.channels, SOIL_LOAD_AUTO);
+		if (!image.pixels)
+			continue;
+		images.push_back(image);
+		megapixels += image.width * image.height / 1e6;
+	}
+	printf("%zu images, %.1f MPix\n", images.size(), megapixels);
+
+	const int repeats = 3;
+	vector<vector<MipLevel>> reference(images.size());
+	printf("%-16s %8s %10s %10s %8s %8s\n", "mipmaps", "threads", "ms", "MPix/s", "speedup", "diff");
+	double baseMs = bestOfMs(repeats, [&] {
+		for (size_t i = 0; i < images.size(); i++)
+			reference[i] = fullImageMipChain(images[i].pixels, images[i].width, images[i].height, images[i].channels);
+	});
+	printf("%-16s %8u %10.2f %10.1f %7.2fx %8s\n", "full image", 1u, baseMs, megapixels * 1000.0 / baseMs, 1.0, "-");
+
+	vector<pair<unsigned int, bool>> runs;
+	for (unsigned int threads : benchmarkThreadCounts())
+		runs.push_back(make_pair(threads, false));
+	runs.push_back(make_pair(benchmarkThreadCounts().back(), true));
+	for (const pair<unsigned int, bool> &run : runs)
+	{
+		vector<vector<MipLevel>> chains(images.size());
+		double bestMs = bestOfMs(repeats, [&] {
+			for (size_t i = 0; i < images.size(); i++)
+				chains[i] = buildMipChain(images[i].pixels, images[i].width, images[i].height, images[i].channels, run.second,
+					sharedThreadPool(), run.first);
+		});
+		double difference = 0.0;
+		size_t samples = 0;
+		for (size_t i = 0; i < images.size(); i++)
+			for (size_t level = 0; level < min(chains[i].size(), reference[i].size()); level++)
+			{
+				const vector<unsigned char> &a = chains[i][level].pixels, &b = reference[i][level].pixels;
+				for (size_t k = 0; k < min(a.size(), b.size()); k++)
+					difference += abs((int)a[k] - (int)b[k]);
+				samples += min(a.size(), b.size());
+			}
+		printf("%-16s %8u %10.2f %10.1f %7.2fx %8.3f\n", run.second ? "chained, sRGB" : "chained", run.first, bestMs,
+			megapixels * 1000.0 / bestMs, baseMs / bestMs, samples ? difference / samples : 0.0);
+	}
+	for (Image &image : images)
+		SOIL_free_image_data(image.pixels);
+}
+#endif
@@ -10,7 +10,13 @@
 #include <postprocess.h>
 
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ModelCache.h"
 #include "Shader.h"
+#include "TextureArrays.h"
+#include "TextureUpload.h"
+#include "ThreadPool.h"
 
 #include <string>
 #include <fstream>
@@ -22,6 +28,40 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// post-processing applied to every imported model, also stored in the model cache so changing it invalidates old caches
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// passes over the imported meshes, stored in the model cache next to the import flags
+const unsigned int MODEL_MESH_OPTIMIZE = 1 << 0;	// triangle order for the vertex cache, vertex order for fetch
+const unsigned int MODEL_MESH_OVERDRAW = 1 << 1;	// additionally cluster the triangles front to back
+const unsigned int MODEL_MESH_WELD = 1 << 2;		// merge vertices equal up to MODEL_WELD_EPSILON
+const unsigned int MODEL_MESH_LOD = 1 << 3;			// simplified levels of detail after the full mesh (MeshSimplifier.h)
+
+// largest difference of any vertex component (position, normal, uv, ...) for two vertices to be welded.
+// the import flags leave out aiProcess_JoinIdenticalVertices, so without welding every face corner is its own vertex.
+const float MODEL_WELD_EPSILON = 1e-5f;
+
+// knobs for how a model gets loaded
+struct ModelOptions {
+	bool useCache = true;		// load from / write to "<path>.meshcache" instead of always going through Assimp
+	unsigned int importThreads = 0;	// threads converting meshes after the Assimp import, 0 = the whole shared pool
+	bool keepCpuData = true;	// keep Mesh::vertices/indices after upload, turn off to save memory if nothing reads them
+	VertexLayout vertexLayout = VERTEX_LAYOUT_FLOAT;	// VERTEX_LAYOUT_PACKED uploads 20 instead of 56 bytes per vertex
+	bool weldVertices = true;		// merge duplicate vertices, which also lets most meshes use 16 bit indices
+	bool optimizeMeshes = false;	// reorder triangles and vertices for the post-transform cache and vertex fetch
+	bool optimizeOverdraw = false;	// with optimizeMeshes: also sort triangle clusters to cut overdraw
+	bool generateLods = true;		// up to MESH_MAX_LODS - 1 simplified levels per mesh, picked by distance when drawing
+	bool textureArrays = true;		// diffuse textures of the same size become layers of a GL_TEXTURE_2D_ARRAY (TextureArrays.h)
+
+	unsigned int meshFlags() const
+	{
+		unsigned int flags = (weldVertices ? MODEL_MESH_WELD : 0) | (generateLods ? MODEL_MESH_LOD : 0);
+		if (optimizeMeshes)
+			flags |= MODEL_MESH_OPTIMIZE | (optimizeOverdraw ? MODEL_MESH_OVERDRAW : 0);
+		return flags;
+	}
+};
+
 class Model
 {
 public:
@@ -30,9 +70,12 @@ public:
 	vector<Mesh>    meshes;
 	string directory;
 	bool gammaCorrection;
+	ModelOptions options;
+	bool loadedFromCache;
+	TextureArrayStats textureArrayStats;	// how the diffuse textures packed, see ModelOptions::textureArrays
 
 	// constructor, expects a filepath to a 3D model.
-	Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+	Model(string const &path, bool gamma = false, ModelOptions options = ModelOptions()) : gammaCorrection(gamma), options(options), loadedFromCache(false)
 	{
 		loadModel(path);
 	}
@@ -40,55 +83,146 @@ public:
 	// draws the model, and thus all its meshes
 	void Draw(Shader &shader)
 	{
+		PROFILE_SCOPE("Model::Draw");
 		for (unsigned int i = 0; i < meshes.size(); i++)
 			meshes[i].Draw(shader);
 	}
 
+	// queues its meshes, see Mesh::Submit. visibleMeshes (one flag per mesh) leaves out the culled ones, NULL queues all
+	void Submit(RenderQueue &queue, Shader &shader, const glm::mat4 &model, const glm::vec3 &eye, float farPlane,
+		const uint8_t *visibleMeshes = nullptr, unsigned int layer = 0)
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			if (!visibleMeshes || visibleMeshes[i])
+				meshes[i].Submit(queue, shader, model, eye, farPlane, layer);
+	}
+
 private:
 	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 	void loadModel(string const &path)
 	{
+		// retrieve the directory path of the filepath
+		directory = path.substr(0, path.find_last_of('//'));
+
+		// a cache built from the very same source file lets us skip Assimp entirely
+		uint64_t sourceHash = 0;
+		bool cacheable = options.useCache && hashFile(path, sourceHash);
+		if (cacheable && loadFromCache(modelCachePath(path), sourceHash))
+			return;
+
 		// read file via ASSIMP
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
 		// check for errors
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 		{
 			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
 			return;
 		}
-		// retrieve the directory path of the filepath
-		directory = path.substr(0, path.find_last_of('//'));
 
 		// process ASSIMP's root node recursively
 		processNode(scene->mRootNode, scene);
+
+		if (cacheable && !writeModelCache(modelCachePath(path), sourceHash, MODEL_IMPORT_FLAGS, options.meshFlags(), meshes))
+			cout << "WARNING::MODEL_CACHE:: could not write " << modelCachePath(path) << endl;
+
+		if (!options.keepCpuData)
+			for (unsigned int i = 0; i < meshes.size(); i++)
+				meshes[i].releaseCpuData();
 	}
 
-	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode *node, const aiScene *scene)
+	// creates the meshes from a valid cache: one mapping of the file, and each mesh uploads its blobs in place.
+	bool loadFromCache(string const &cachePath, uint64_t sourceHash)
 	{
-		// process each mesh located at the current node
-		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		ModelCache cache;
+		if (!cache.open(cachePath, sourceHash, MODEL_IMPORT_FLAGS, options.meshFlags()))
+			return false;
+
+		vector<vector<TextureRef>> meshTextures(cache.meshCount());
+		for (unsigned int i = 0; i < cache.meshCount(); i++)
 		{
-			// the node object only contains indices to index the actual objects in the scene. 
-			// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+			const ModelCacheMesh &m = cache.mesh(i);
+			for (unsigned int t = 0; t < m.textureCount; t++)
+			{
+				unsigned int index = cache.meshTexture(m, t);
+				meshTextures[i].push_back(TextureRef{ cache.textureType(index), cache.texturePath(index) });
+			}
 		}
-		// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		packTextures(meshTextures);
+
+		meshes.reserve(cache.meshCount());
+		for (unsigned int i = 0; i < cache.meshCount(); i++)
 		{
-			processNode(node->mChildren[i], scene);
+			const ModelCacheMesh &m = cache.mesh(i);
+			vector<Texture> textures;
+			for (const TextureRef &ref : meshTextures[i])
+				textures.push_back(loadMaterialTexture(ref.path, ref.type));
+			meshes.push_back(Mesh(cache.vertices(m), m.vertexCount, cache.indices(m), m.indexCount, std::move(textures), options.vertexLayout, cache.lods(m)));
 		}
+		loadedFromCache = true;
+		return true;
+	}
+
+	// processes a node in a recursive fashion: converts the meshes of the whole node tree (on the thread pool),
+	// then creates the GL side of each one on this thread, in the order the tree lists them.
+	void processNode(aiNode *node, const aiScene *scene)
+	{
+		vector<const aiMesh*> sceneMeshes;
+		collectMeshes(node, scene, sceneMeshes);
 
+		vector<MeshData> meshData(sceneMeshes.size());
+		unsigned int meshFlags = options.meshFlags();
+		sharedThreadPool().parallelFor(sceneMeshes.size(), [&](size_t i) {
+			meshData[i] = processMesh(sceneMeshes[i], scene);
+			optimizeMesh(meshData[i], meshFlags);
+		}, options.importThreads);
+
+		vector<vector<TextureRef>> meshTextures(meshData.size());
+		for (unsigned int i = 0; i < meshData.size(); i++)
+			meshTextures[i] = meshData[i].textures;
+		packTextures(meshTextures);
+
+		meshes.reserve(meshes.size() + meshData.size());
+		for (unsigned int i = 0; i < meshData.size(); i++)
+			meshes.push_back(createMesh(std::move(meshData[i])));
 	}
 
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+	// the GL half of the import: loads the textures (once per model) and uploads the buffers.
+	// the vertex and index vectors are moved into the Mesh, not copied.
+	Mesh createMesh(MeshData &&data)
 	{
-		// data to fill
-		vector<Vertex> vertices;
-		vector<unsigned int> indices;
 		vector<Texture> textures;
+		textures.reserve(data.textures.size());
+		for (unsigned int i = 0; i < data.textures.size(); i++)
+			textures.push_back(loadMaterialTexture(data.textures[i].path, data.textures[i].type));
+		return Mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), options.vertexLayout, std::move(data.lods));
+	}
+
+public:
+	// lists the meshes of node and its children (if any) depth first, which is the order they end up in meshes.
+	static void collectMeshes(const aiNode *node, const aiScene *scene, vector<const aiMesh*> &out)
+	{
+		// the node object only contains indices to index the actual objects in the scene. 
+		// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+		for (unsigned int i = 0; i < node->mNumMeshes; i++)
+			out.push_back(scene->mMeshes[node->mMeshes[i]]);
+		// after we've listed all of the meshes (if any) we then recursively process each of the children nodes
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			collectMeshes(node->mChildren[i], scene, out);
+	}
+
+	// the CPU half of the import: converts an Assimp mesh into our vertex/index layout and lists its material textures.
+	// only reads the scene, so it's safe to run for several meshes at once.
+	static MeshData processMesh(const aiMesh *mesh, const aiScene *scene)
+	{
+		// data to fill
+		MeshData data;
+		vector<Vertex> &vertices = data.vertices;
+		vector<unsigned int> &indices = data.indices;
+		// exact sizes are known up front (faces are triangles after aiProcess_Triangulate), so allocate once
+		vertices.reserve(mesh->mNumVertices);
+		indices.reserve((size_t)mesh->mNumFaces * 3);
+
 
 		// walk through each of the mesh's vertices
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -136,7 +270,7 @@ private:
 		// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
 		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
-			aiFace face = mesh->mFaces[i];
+			const aiFace &face = mesh->mFaces[i];
 			// retrieve all indices of the face and store them in the indices vector
 			for (unsigned int j = 0; j < face.mNumIndices; j++)
 				indices.push_back(face.mIndices[j]);
@@ -151,53 +285,79 @@ private:
 		// normal: texture_normalN
 
 		// 1. diffuse maps
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		listMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
 		// 2. specular maps
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		listMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
 		// 3. normal maps
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		listMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
 		// 4. height maps
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+		listMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		return data;
 	}
 
-	// checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// the required info is returned as a Texture struct.
-	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+	// runs the MODEL_MESH_* passes in flags on one converted mesh. Welding comes first so the others see the shared
+	// vertices, overdraw clustering builds on the cache order and the vertex renumbering has to see the final triangle order.
+	// The levels of detail come last: they index the final vertices, and with MODEL_MESH_OPTIMIZE get a cache order of their own.
+	static void optimizeMesh(MeshData &data, unsigned int flags)
+	{
+		if (data.indices.empty())
+			return;
+		if (flags & MODEL_MESH_WELD)
+			weldVertices(data.vertices, data.indices, MODEL_WELD_EPSILON);
+		if (flags & MODEL_MESH_OPTIMIZE)
+		{
+			optimizeVertexCache(data.indices.data(), data.indices.size(), data.vertices.size());
+			if (flags & MODEL_MESH_OVERDRAW)
+				optimizeOverdraw(data.indices.data(), data.indices.size(), data.vertices.data(), data.vertices.size());
+			optimizeVertexFetch(data.vertices, data.indices);
+		}
+		if (flags & MODEL_MESH_LOD)
+			generateMeshLods(data.vertices, data.indices, data.lods, (flags & MODEL_MESH_OPTIMIZE) != 0);
+	}
+
+private:
+	// appends the paths of all material textures of a given type, in material order.
+	static void listMaterialTextures(const aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &out)
 	{
-		vector<Texture> textures;
 		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
-			// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-			bool skip = false;
-			for (unsigned int j = 0; j < textures_loaded.size(); j++)
-			{
-				if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-				{
-					textures.push_back(textures_loaded[j]);
-					skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-					break;
-				}
-			}
-			if (!skip)
-			{   // if texture hasn't been loaded already, load it
-				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str.C_Str();
-				textures.push_back(texture);
-				textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-			}
+			TextureRef ref;
+			ref.type = typeName;
+			ref.path = str.C_Str();
+			out.push_back(ref);
+		}
+	}
+
+	// with ModelOptions::textureArrays, loads the diffuse textures that pack into arrays as their layers. they go into
+	// textures_loaded, so loadMaterialTexture hands the meshes the layers instead of loading the files again.
+	void packTextures(const vector<vector<TextureRef>> &meshTextures)
+	{
+		if (!options.textureArrays)
+			return;
+		vector<Texture> layers = packTextureArrays(meshTextures, directory, textureArrayStats);
+		textures_loaded.insert(textures_loaded.end(), layers.begin(), layers.end());
+		printTextureArrayStats(directory, textureArrayStats);
+	}
+
+	// returns the texture at path (relative to the model directory), loading it only if it wasn't loaded before.
+	Texture loadMaterialTexture(string const &path, string const &typeName)
+	{
+		// check if texture was loaded before and if so, skip loading a new texture
+		for (unsigned int j = 0; j < textures_loaded.size(); j++)
+		{
+			if (textures_loaded[j].path == path)
+				return textures_loaded[j]; // a texture with the same filepath has already been loaded. (optimization)
 		}
-		return textures;
+		// if texture hasn't been loaded already, load it
+		Texture texture;
+		texture.id = TextureFromFile(path.c_str(), this->directory);
+		texture.type = typeName;
+		texture.path = path;
+		textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+		return texture;
 	}
 };
 
@@ -207,38 +367,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 	string filename = string(path);
 	filename = directory + '/' + filename;
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = SOIL_load_image(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		SOIL_free_image_data(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		SOIL_free_image_data(data);
-	}
-
-	return textureID;
+	// the image is decoded on the loader's worker threads, until it's uploaded the texture shows a placeholder
+	return loadTextureAsync(filename, gamma);
 }
 #endif
\ No newline at end of file
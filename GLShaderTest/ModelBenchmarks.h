@@ -0,0 +1,384 @@
+#ifndef MODEL_BENCHMARKS_H
+#define MODEL_BENCHMARKS_H
+
+// Benchmarks of loading models: the mesh cache, the import threads, mesh construction, the vertex formats and the
+// mesh optimization passes, each over every model under a directory.
+
+#include "Model.h"
+#include "AllocationCounter.h"
+#include "BenchmarkUtils.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+// Assimp import + CPU conversion of every mesh of a model, in draw order. returns false (and says why) on failure
+inline bool importMeshData(const string &path, vector<MeshData> &meshData)
+{
+	Assimp::Importer importer;
+	const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+	if (!scene || !scene->mRootNode)
+	{
+		printf("%s: %s\n", path.c_str(), importer.GetErrorString());
+		return false;
+	}
+	vector<const aiMesh*> sceneMeshes;
+	Model::collectMeshes(scene->mRootNode, scene, sceneMeshes);
+	meshData.resize(sceneMeshes.size());
+	sharedThreadPool().parallelFor(sceneMeshes.size(), [&](size_t i) {
+		meshData[i] = Model::processMesh(sceneMeshes[i], scene);
+	});
+	return true;
+}
+
+// --bench-model-cache: cold (Assimp import + cache write) vs warm (mapped cache) load time of every model under dir.
+// needs a current GL context since meshes and textures get uploaded.
+inline void benchmarkModelCache(const string &dir)
+{
+	vector<string> models = listModelFiles(dir);
+	printf("%-48s %10s %10s %8s\n", "model", "cold ms", "warm ms", "speedup");
+	for (const string &path : models)
+	{
+		remove(modelCachePath(path).c_str());
+
+		auto start = chrono::steady_clock::now();
+		Model cold(path);
+		double coldMs = elapsedMs(start);
+
+		start = chrono::steady_clock::now();
+		Model warm(path);
+		double warmMs = elapsedMs(start);
+		// textures decode in the background in both cases, don't let them pile up between models
+		asyncTextureLoader().finish();
+
+		printf("%-48s %10.1f %10.1f %7.1fx %s\n", path.c_str(), coldMs, warmMs, coldMs / warmMs,
+			warm.loadedFromCache ? "" : "(cache not used)");
+	}
+}
+
+// --bench-import-threads: time of the CPU half of the mesh import (Model::processMesh over every mesh of a model)
+// against the number of threads, best of 3 runs each. Doesn't touch GL.
+inline void benchmarkImportThreads(const string &dir)
+{
+	for (const string &path : listModelFiles(dir))
+	{
+		Assimp::Importer importer;
+		const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+		if (!scene || !scene->mRootNode)
+		{
+			printf("%s: %s\n", path.c_str(), importer.GetErrorString());
+			continue;
+		}
+		vector<const aiMesh*> sceneMeshes;
+		Model::collectMeshes(scene->mRootNode, scene, sceneMeshes);
+
+		printf("%s (%u meshes)\n", path.c_str(), (unsigned int)sceneMeshes.size());
+		printf("  %8s %10s %8s\n", "threads", "ms", "speedup");
+		double serialMs = 0.0;
+		for (unsigned int threads : benchmarkThreadCounts())
+		{
+			double bestMs = 1e30;
+			for (int run = 0; run < 3; run++)
+			{
+				vector<MeshData> meshData(sceneMeshes.size());
+				auto start = chrono::steady_clock::now();
+				sharedThreadPool().parallelFor(sceneMeshes.size(), [&](size_t i) {
+					meshData[i] = Model::processMesh(sceneMeshes[i], scene);
+				}, threads);
+				bestMs = min(bestMs, elapsedMs(start));
+			}
+			if (threads == 1)
+				serialMs = bestMs;
+			printf("  %8u %10.2f %7.2fx\n", threads, bestMs, serialMs / bestMs);
+		}
+	}
+}
+
+// builds the meshes of one model from already converted data, the way the loader used to (copying) or does now (moving)
+inline size_t buildMeshes(vector<MeshData> meshData, bool move, bool releaseCpuData, AllocationScope &scope)
+{
+	scope.begin();
+	vector<Mesh> meshes;
+	if (move)
+		meshes.reserve(meshData.size());
+	for (MeshData &data : meshData)
+	{
+		if (move)
+			meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), vector<Texture>()));
+		else
+		{
+			Mesh mesh(data.vertices, data.indices, vector<Texture>());
+			meshes.push_back(mesh);
+		}
+		if (releaseCpuData)
+			meshes.back().releaseCpuData();
+	}
+	size_t allocations = scope.allocations();
+	for (Mesh &mesh : meshes)
+		mesh.releaseGpuData();
+	return allocations;
+}
+
+// --bench-mesh-allocations: heap allocations and peak heap growth of creating the meshes of every model under dir
+// by copying the vertex/index vectors, by moving them, and by moving them and dropping the CPU copy after upload.
+// needs a current GL context, and a build with COUNT_ALLOCATIONS (AllocationCounter.h) to count anything.
+inline void benchmarkMeshAllocations(const string &dir)
+{
+	if (!ALLOCATION_COUNTING)
+		printf("built without COUNT_ALLOCATIONS, allocations and heap growth read 0\n");
+	printf("%-48s %-14s %12s %14s\n", "model", "path", "allocations", "peak heap KB");
+	for (const string &path : listModelFiles(dir))
+	{
+		Assimp::Importer importer;
+		const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+		if (!scene || !scene->mRootNode)
+		{
+			printf("%s: %s\n", path.c_str(), importer.GetErrorString());
+			continue;
+		}
+		vector<const aiMesh*> sceneMeshes;
+		Model::collectMeshes(scene->mRootNode, scene, sceneMeshes);
+
+		AllocationScope scope;
+		vector<MeshData> meshData;
+		meshData.reserve(sceneMeshes.size());
+		for (const aiMesh *mesh : sceneMeshes)
+			meshData.push_back(Model::processMesh(mesh, scene));
+		printf("%-48s %-14s %12zu %14zu\n", path.c_str(), "processMesh", scope.allocations(), scope.peakBytes() / 1024);
+
+		const char *names[] = { "copy", "move", "move+release" };
+		for (int mode = 0; mode < 3; mode++)
+		{
+			size_t allocations = buildMeshes(meshData, mode > 0, mode == 2, scope);
+			printf("%-48s %-14s %12zu %14zu\n", "", names[mode], allocations, scope.peakBytes() / 1024);
+		}
+	}
+	printf("process peak RSS: %zu MB\n", peakResidentBytes() / (1024 * 1024));
+}
+
+// the copy and move paths of buildMeshes on one model's converted meshes: moving has to make fewer heap allocations
+// and a lower peak heap. the peak is that of the counted heap, not the working set, which only ever grows in a process
+// and so can't tell two paths run one after the other apart.
+inline bool compareMeshAllocations(const string &name, const vector<MeshData> &meshData)
+{
+	AllocationScope scope;
+	size_t copyAllocations = buildMeshes(meshData, false, false, scope);
+	size_t copyPeak = scope.peakBytes();
+	size_t moveAllocations = buildMeshes(meshData, true, false, scope);
+	size_t movePeak = scope.peakBytes();
+	bool ok = moveAllocations < copyAllocations && movePeak < copyPeak;
+	printf("%-48s %12zu %12zu %14zu %14zu %s\n", name.c_str(), copyAllocations, moveAllocations, copyPeak / 1024, movePeak / 1024,
+		ok ? "ok" : "FAIL");
+	return ok;
+}
+
+// --check-mesh-allocations: compareMeshAllocations for every model under dir. returns false if a model doesn't improve,
+// if no model was compared, or if the build doesn't count allocations (COUNT_ALLOCATIONS, which the Profile|Win32
+// configuration defines) and every count would read 0. needs a current GL context.
+inline bool checkMeshAllocations(const string &dir)
+{
+	if (!ALLOCATION_COUNTING)
+	{
+		printf("mesh allocations: FAILED, built without COUNT_ALLOCATIONS (use the Profile configuration)\n");
+		return false;
+	}
+	printf("%-48s %12s %12s %14s %14s\n", "model", "copy allocs", "move allocs", "copy peak KB", "move peak KB");
+	bool ok = true;
+	size_t compared = 0;
+	for (const string &path : listModelFiles(dir))
+	{
+		vector<MeshData> meshData;
+		if (!importMeshData(path, meshData) || meshData.empty())
+			continue;
+		ok = compareMeshAllocations(path, meshData) && ok;
+		compared++;
+	}
+	ok = ok && compared > 0;
+	printf("mesh allocations: %zu models, %s\n", compared, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// the packing error bounds --bench-vertex-format holds the models to: half a unorm16 step of the mesh extent for
+// positions, half precision (round to nearest) relative to the value for UVs
+const float PACKED_POSITION_ERROR_BOUND = 0.5f / 65535.0f;
+const float PACKED_TEXCOORD_ERROR_BOUND = 1.0f / 2048.0f;
+
+// --bench-vertex-format: vertex memory of the float and packed layouts for every model under dir, and the largest
+// error packing introduces compared to the float data. Position error is relative to the mesh extent, UV error
+// relative to the value (below 1e-4 relative to 1e-4). returns false if a model is over PACKED_*_ERROR_BOUND; for
+// positions the float rounding of unpacking far from the origin is allowed on top.
+inline bool benchmarkVertexFormat(const string &dir)
+{
+	bool ok = true;
+	printf("%-48s %10s %10s %8s %12s %12s %12s\n", "model", "float KB", "packed KB", "saved", "pos err", "normal deg", "uv err");
+	for (const string &path : listModelFiles(dir))
+	{
+		vector<MeshData> meshData;
+		if (!importMeshData(path, meshData))
+			continue;
+
+		size_t vertexCount = 0, overBound = 0;
+		float positionError = 0.0f, normalError = 0.0f, texCoordError = 0.0f;
+		for (const MeshData &data : meshData)
+		{
+			const vector<Vertex> &vertices = data.vertices;
+			vertexCount += vertices.size();
+			Bounds bounds = computeBounds(vertices.data(), vertices.size());
+			glm::vec3 extent = bounds.max - bounds.min;
+			vector<PackedVertex> packed = packVertices(vertices.data(), vertices.size(), bounds);
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				glm::vec3 position = unpackPosition(packed[i], bounds);
+				bool over = false;
+				for (int c = 0; c < 3; c++)
+					if (extent[c] > 0.0f)
+					{
+						float error = fabs(position[c] - vertices[i].Position[c]) / extent[c];
+						float rounding = 4.0f * FLT_EPSILON * max(fabs(bounds.min[c]), fabs(bounds.max[c])) / extent[c];
+						positionError = max(positionError, error);
+						over = over || error > PACKED_POSITION_ERROR_BOUND + rounding;
+					}
+				if (glm::dot(vertices[i].Normal, vertices[i].Normal) > 0.0f)
+				{
+					float cosine = glm::dot(glm::normalize(vertices[i].Normal), unpackOct16(packed[i].normal));
+					normalError = max(normalError, glm::degrees(acos(min(1.0f, cosine))));
+				}
+				glm::vec2 texCoords = unpackTexCoords(packed[i]);
+				for (int c = 0; c < 2; c++)
+				{
+					float error = fabs(texCoords[c] - vertices[i].TexCoords[c]) / max(fabs(vertices[i].TexCoords[c]), 1e-4f);
+					texCoordError = max(texCoordError, error);
+					over = over || !(error <= PACKED_TEXCOORD_ERROR_BOUND);
+				}
+				if (over)
+					overBound++;
+			}
+		}
+		size_t floatBytes = vertexCount * sizeof(Vertex), packedBytes = vertexCount * sizeof(PackedVertex);
+		printf("%-48s %10zu %10zu %7.1f%% %12.2e %12.4f %12.2e\n", path.c_str(), floatBytes / 1024, packedBytes / 1024,
+			100.0 * (1.0 - (double)packedBytes / max<size_t>(floatBytes, 1)), positionError, normalError, texCoordError);
+		if (overBound)
+		{
+			printf("FAIL %zu vertices of %s are over the error bounds\n", overBound, path.c_str());
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// --bench-vertex-cache: ACMR / ATVR of every model under dir on a simulated 16 entry FIFO post-transform cache, in
+// import order, after optimizeMeshes and after optimizeMeshes + optimizeOverdraw. Numbers are over all meshes of a model,
+// welded in every case (an unwelded import never hits the cache).
+inline void benchmarkVertexCache(const string &dir)
+{
+	const unsigned int flags[] = { MODEL_MESH_WELD, MODEL_MESH_WELD | MODEL_MESH_OPTIMIZE, MODEL_MESH_WELD | MODEL_MESH_OPTIMIZE | MODEL_MESH_OVERDRAW };
+	const char *names[] = { "import", "optimized", "overdraw" };
+	printf("%-48s %10s %8s %8s %8s %10s\n", "model", "order", "ACMR", "ATVR", "ms", "triangles");
+	for (const string &path : listModelFiles(dir))
+	{
+		vector<MeshData> imported;
+		if (!importMeshData(path, imported))
+			continue;
+
+		for (int pass = 0; pass < 3; pass++)
+		{
+			vector<MeshData> meshData = imported;
+			auto start = chrono::steady_clock::now();
+			for (MeshData &data : meshData)
+				Model::optimizeMesh(data, flags[pass]);
+			double ms = elapsedMs(start);
+
+			VertexCacheStats total;
+			for (const MeshData &data : meshData)
+			{
+				VertexCacheStats stats = simulateVertexCache(data.indices.data(), data.indices.size(), data.vertices.size());
+				total.misses += stats.misses;
+				total.triangles += stats.triangles;
+				total.vertices += stats.vertices;
+			}
+			printf("%-48s %10s %8.3f %8.3f %8.1f %10zu\n", pass == 0 ? path.c_str() : "", names[pass],
+				total.acmr(), total.atvr(), ms, total.triangles);
+		}
+	}
+}
+
+// --bench-vertex-weld: per mesh vertex count and GPU bytes (vertices + indices) of every model under dir as imported,
+// and after welding with 16 bit indices wherever they fit.
+inline void benchmarkVertexWeld(const string &dir)
+{
+	printf("%-48s %5s %9s %9s %6s %10s %10s %8s\n", "model", "mesh", "vertices", "welded", "index", "bytes", "welded", "saved");
+	for (const string &path : listModelFiles(dir))
+	{
+		vector<MeshData> meshData;
+		if (!importMeshData(path, meshData))
+			continue;
+
+		size_t totalBytes = 0, totalWeldedBytes = 0;
+		for (size_t i = 0; i < meshData.size(); i++)
+		{
+			MeshData &data = meshData[i];
+			size_t vertexCount = data.vertices.size();
+			size_t bytes = vertexCount * sizeof(Vertex) + data.indices.size() * sizeof(unsigned int);
+			Model::optimizeMesh(data, MODEL_MESH_WELD);
+			bool shortIndices = data.vertices.size() <= 65536;
+			size_t weldedBytes = data.vertices.size() * sizeof(Vertex) +
+				data.indices.size() * (shortIndices ? sizeof(unsigned short) : sizeof(unsigned int));
+			totalBytes += bytes;
+			totalWeldedBytes += weldedBytes;
+			printf("%-48s %5zu %9zu %9zu %6s %10zu %10zu %7.1f%%\n", i == 0 ? path.c_str() : "", i, vertexCount,
+				data.vertices.size(), shortIndices ? "16" : "32", bytes, weldedBytes, 100.0 * (1.0 - (double)weldedBytes / max<size_t>(bytes, 1)));
+		}
+		printf("%-48s %5s %9s %9s %6s %10zu %10zu %7.1f%%\n", "", "all", "", "", "", totalBytes, totalWeldedBytes,
+			100.0 * (1.0 - (double)totalWeldedBytes / max<size_t>(totalBytes, 1)));
+	}
+}
+
+// --lod-report: the levels of detail the import builds for every model under dir (welded, as loading does by default).
+// per mesh and level: triangles, how many fewer than the full mesh, and the error estimate in model units and relative
+// to the mesh's bounding sphere radius. the "all" rows sum the triangles a level draws over all meshes (meshes with
+// fewer levels count their coarsest one) and give the largest error of any mesh.
+inline void reportModelLods(const string &dir)
+{
+	unsigned int flags = ModelOptions().meshFlags() | MODEL_MESH_LOD;
+	printf("%-48s %5s %5s %10s %8s %12s %10s %8s\n", "model", "mesh", "level", "triangles", "reduced", "error", "relative", "ms");
+	for (const string &path : listModelFiles(dir))
+	{
+		vector<MeshData> meshData;
+		if (!importMeshData(path, meshData))
+			continue;
+
+		auto start = chrono::steady_clock::now();
+		sharedThreadPool().parallelFor(meshData.size(), [&](size_t i) {
+			Model::optimizeMesh(meshData[i], flags);
+		});
+		double ms = elapsedMs(start);
+
+		size_t totalTriangles[MESH_MAX_LODS] = {};
+		float maxError[MESH_MAX_LODS] = {}, maxRelative[MESH_MAX_LODS] = {};
+		for (size_t i = 0; i < meshData.size(); i++)
+		{
+			const MeshData &data = meshData[i];
+			if (data.lods.empty())
+				continue;
+			Bounds bounds = computeBounds(data.vertices.data(), data.vertices.size());
+			float radius = computeBoundingSphere(data.vertices.data(), data.vertices.size(), bounds).radius;
+			size_t fullTriangles = data.lods[0].indexCount / 3;
+			for (unsigned int level = 0; level < MESH_MAX_LODS; level++)
+			{
+				const MeshLod &lod = data.lods[min<size_t>(level, data.lods.size() - 1)];
+				float relative = radius > 0.0f ? lod.error / radius : 0.0f;
+				totalTriangles[level] += lod.indexCount / 3;
+				maxError[level] = max(maxError[level], lod.error);
+				maxRelative[level] = max(maxRelative[level], relative);
+				if (level >= data.lods.size())
+					continue;
+				printf("%-48s %5zu %5u %10u %7.1f%% %12.3e %10.3e %8s\n", i == 0 && level == 0 ? path.c_str() : "", i, level, lod.indexCount / 3,
+					100.0 * (1.0 - (double)(lod.indexCount / 3) / max<size_t>(fullTriangles, 1)), lod.error, relative, "");
+			}
+		}
+		for (unsigned int level = 0; level < MESH_MAX_LODS; level++)
+			printf("%-48s %5s %5u %10zu %7.1f%% %12.3e %10.3e %8.1f\n", "", "all", level, totalTriangles[level],
+				100.0 * (1.0 - (double)totalTriangles[level] / max<size_t>(totalTriangles[0], 1)), maxError[level], maxRelative[level], level == 0 ? ms : 0.0);
+	}
+}
+#endif
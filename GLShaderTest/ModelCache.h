@@ -0,0 +1,289 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include "Mesh.h"
+#include "AssetPackage.h"
+#include "FileUtils.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+// A model cache is written next to the source asset ("<model file>.meshcache") after the first Assimp import,
+// so the next launch can map it and hand the vertex/index blobs straight to glBufferData. An asset package
+// (AssetPackage.h) that has the cache serves it instead, in place as well unless it's stored compressed.
+// Layout (native little endian, blobs 16-byte aligned so they can be used in place):
+//   ModelCacheHeader
+//   ModelCacheMesh    meshes[meshCount]
+//   ModelCacheTexture textures[textureCount]
+//   uint32_t          meshTextures[]      per-mesh indices into textures[]
+//   char              strings[]           texture types and paths
+//   Vertex / unsigned int blobs
+const uint32_t MODEL_CACHE_MAGIC = 0x4853454D; // "MESH"
+const uint32_t MODEL_CACHE_VERSION = 3;
+
+struct ModelCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;		// FNV-1a of the source model file
+	uint32_t importFlags;		// Assimp post-process flags the data was produced with
+	uint32_t meshFlags;			// our own passes run after the import (MODEL_MESH_* in Model.h)
+	uint32_t reserved;
+	uint32_t vertexSize;		// sizeof(Vertex) of the writer
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint64_t fileSize;
+};
+
+// a level of detail, a range of the mesh's indices (MeshLod)
+struct ModelCacheLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+struct ModelCacheMesh {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;		// of all levels
+	uint32_t firstTexture;		// into meshTextures[]
+	uint32_t textureCount;
+	uint32_t lodCount;			// at least 1, level 0 is the full mesh
+	uint32_t reserved;
+	ModelCacheLod lods[MESH_MAX_LODS];
+};
+
+struct ModelCacheTexture {
+	uint32_t typeOffset;
+	uint32_t typeLength;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+inline string modelCachePath(const string &modelPath)
+{
+	return modelPath + ".meshcache";
+}
+
+// read side: maps the cache file and validates it against the current source
+class ModelCache
+{
+public:
+	// returns false if the file is missing, corrupt, from another version or built from a different source
+	bool open(const string &path, uint64_t sourceHash, uint32_t importFlags, uint32_t meshFlags)
+	{
+		// from the asset package if it has it, else the file next to the model
+		if (assetPackage().read(path, packaged))
+		{
+			bytes = packaged.bytes;
+			length = packaged.size;
+		}
+		else if (file.open(path))
+		{
+			bytes = file.data();
+			length = file.size();
+		}
+		else
+			return false;
+		if (length < sizeof(ModelCacheHeader))
+			return fail();
+		header = (const ModelCacheHeader*)bytes;
+		if (header->magic != MODEL_CACHE_MAGIC || header->version != MODEL_CACHE_VERSION ||
+			header->sourceHash != sourceHash || header->importFlags != importFlags || header->meshFlags != meshFlags ||
+			header->vertexSize != sizeof(Vertex) || header->fileSize != length)
+			return fail();
+
+		uint64_t tableEnd = sizeof(ModelCacheHeader) + (uint64_t)header->meshCount * sizeof(ModelCacheMesh) +
+			(uint64_t)header->textureCount * sizeof(ModelCacheTexture);
+		if (tableEnd > length)
+			return fail();
+		meshTable = (const ModelCacheMesh*)(bytes + sizeof(ModelCacheHeader));
+		textureTable = (const ModelCacheTexture*)(meshTable + header->meshCount);
+		meshTextures = (const uint32_t*)(textureTable + header->textureCount);
+
+		// bounds check everything once so the accessors below don't have to
+		for (uint32_t i = 0; i < header->meshCount; i++)
+		{
+			const ModelCacheMesh &m = meshTable[i];
+			if (!inRange(m.vertexOffset, (uint64_t)m.vertexCount * sizeof(Vertex)) ||
+				!inRange(m.indexOffset, (uint64_t)m.indexCount * sizeof(unsigned int)) ||
+				!inRange(tableEnd + (uint64_t)m.firstTexture * sizeof(uint32_t), (uint64_t)m.textureCount * sizeof(uint32_t)))
+				return fail();
+			for (uint32_t t = 0; t < m.textureCount; t++)
+				if (meshTextures[m.firstTexture + t] >= header->textureCount)
+					return fail();
+			if (m.lodCount == 0 || m.lodCount > MESH_MAX_LODS)
+				return fail();
+			for (uint32_t l = 0; l < m.lodCount; l++)
+				if (m.lods[l].firstIndex > m.indexCount || m.lods[l].indexCount > m.indexCount - m.lods[l].firstIndex)
+					return fail();
+		}
+		for (uint32_t i = 0; i < header->textureCount; i++)
+		{
+			const ModelCacheTexture &t = textureTable[i];
+			if (!inRange(t.typeOffset, t.typeLength) || !inRange(t.pathOffset, t.pathLength))
+				return fail();
+		}
+		return true;
+	}
+
+	unsigned int meshCount() const { return header->meshCount; }
+	const ModelCacheMesh& mesh(unsigned int i) const { return meshTable[i]; }
+	const Vertex* vertices(const ModelCacheMesh &m) const { return (const Vertex*)(bytes + m.vertexOffset); }
+	const unsigned int* indices(const ModelCacheMesh &m) const { return (const unsigned int*)(bytes + m.indexOffset); }
+	vector<MeshLod> lods(const ModelCacheMesh &m) const
+	{
+		vector<MeshLod> out;
+		for (uint32_t l = 0; l < m.lodCount; l++)
+			out.push_back(MeshLod{ m.lods[l].firstIndex, m.lods[l].indexCount, m.lods[l].error });
+		return out;
+	}
+	// index into the texture table of the t-th texture of a mesh
+	unsigned int meshTexture(const ModelCacheMesh &m, unsigned int t) const { return meshTextures[m.firstTexture + t]; }
+	string textureType(unsigned int i) const { return str(textureTable[i].typeOffset, textureTable[i].typeLength); }
+	string texturePath(unsigned int i) const { return str(textureTable[i].pathOffset, textureTable[i].pathLength); }
+
+private:
+	MappedFile file;
+	AssetData packaged;
+	const unsigned char *bytes = nullptr;
+	size_t length = 0;
+	const ModelCacheHeader *header = nullptr;
+	const ModelCacheMesh *meshTable = nullptr;
+	const ModelCacheTexture *textureTable = nullptr;
+	const uint32_t *meshTextures = nullptr;
+
+	bool fail()
+	{
+		file.close();
+		packaged = AssetData();
+		bytes = nullptr;
+		length = 0;
+		header = nullptr;
+		return false;
+	}
+
+	bool inRange(uint64_t offset, uint64_t size) const
+	{
+		return offset <= length && size <= length - offset;
+	}
+
+	string str(uint32_t offset, uint32_t length) const
+	{
+		return string((const char*)bytes + offset, length);
+	}
+};
+
+// write side: serializes the CPU copy of the meshes of a freshly imported model
+inline bool writeModelCache(const string &path, uint64_t sourceHash, uint32_t importFlags, uint32_t meshFlags, const vector<Mesh> &meshes)
+{
+	// unique (type, path) texture table and the per-mesh references into it
+	vector<const Texture*> textures;
+	vector<uint32_t> meshTextures;
+	for (const Mesh &mesh : meshes)
+	{
+		for (const Texture &texture : mesh.textures)
+		{
+			uint32_t index = 0;
+			while (index < textures.size() && (textures[index]->path != texture.path || textures[index]->type != texture.type))
+				index++;
+			if (index == textures.size())
+				textures.push_back(&texture);
+			meshTextures.push_back(index);
+		}
+	}
+
+	auto align16 = [](uint64_t offset) { return (offset + 15) & ~(uint64_t)15; };
+
+	uint64_t offset = sizeof(ModelCacheHeader) + meshes.size() * sizeof(ModelCacheMesh) +
+		textures.size() * sizeof(ModelCacheTexture) + meshTextures.size() * sizeof(uint32_t);
+	vector<ModelCacheTexture> textureTable(textures.size());
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		textureTable[i].typeOffset = (uint32_t)offset;
+		textureTable[i].typeLength = (uint32_t)textures[i]->type.size();
+		offset += textures[i]->type.size();
+		textureTable[i].pathOffset = (uint32_t)offset;
+		textureTable[i].pathLength = (uint32_t)textures[i]->path.size();
+		offset += textures[i]->path.size();
+	}
+	vector<ModelCacheMesh> meshTable(meshes.size());
+	uint32_t firstTexture = 0;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		ModelCacheMesh &m = meshTable[i];
+		m.vertexCount = (uint32_t)meshes[i].vertices.size();
+		m.indexCount = (uint32_t)meshes[i].indices.size();
+		m.firstTexture = firstTexture;
+		m.textureCount = (uint32_t)meshes[i].textures.size();
+		firstTexture += m.textureCount;
+		m.lodCount = (uint32_t)min<size_t>(meshes[i].lods.size(), MESH_MAX_LODS);
+		m.reserved = 0;
+		for (uint32_t l = 0; l < MESH_MAX_LODS; l++)
+			m.lods[l] = l < m.lodCount ?
+				ModelCacheLod{ meshes[i].lods[l].firstIndex, meshes[i].lods[l].indexCount, meshes[i].lods[l].error, 0 } : ModelCacheLod{ 0, 0, 0.0f, 0 };
+		m.vertexOffset = offset = align16(offset);
+		offset += (uint64_t)m.vertexCount * sizeof(Vertex);
+		m.indexOffset = offset = align16(offset);
+		offset += (uint64_t)m.indexCount * sizeof(unsigned int);
+	}
+
+	ModelCacheHeader header;
+	header.magic = MODEL_CACHE_MAGIC;
+	header.version = MODEL_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.meshFlags = meshFlags;
+	header.reserved = 0;
+	header.vertexSize = sizeof(Vertex);
+	header.meshCount = (uint32_t)meshes.size();
+	header.textureCount = (uint32_t)textures.size();
+	header.fileSize = offset;
+
+	// write to a temporary file first so a crash never leaves a truncated cache behind
+	string tmpPath = path + ".tmp";
+	FILE *f = fopen(tmpPath.c_str(), "wb");
+	if (!f)
+		return false;
+	uint64_t written = 0;
+	auto put = [&](const void *data, size_t size) {
+		if (size)
+			fwrite(data, 1, size, f);
+		written += size;
+	};
+	auto pad = [&](uint64_t to) {
+		static const char zeros[16] = { 0 };
+		put(zeros, (size_t)(to - written));
+	};
+	put(&header, sizeof(header));
+	put(meshTable.data(), meshTable.size() * sizeof(ModelCacheMesh));
+	put(textureTable.data(), textureTable.size() * sizeof(ModelCacheTexture));
+	put(meshTextures.data(), meshTextures.size() * sizeof(uint32_t));
+	for (const Texture *texture : textures)
+	{
+		put(texture->type.data(), texture->type.size());
+		put(texture->path.data(), texture->path.size());
+	}
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		pad(meshTable[i].vertexOffset);
+		put(meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+		pad(meshTable[i].indexOffset);
+		put(meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+	}
+	bool ok = ferror(f) == 0 && written == offset;
+	ok = fclose(f) == 0 && ok;
+	if (!ok)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	remove(path.c_str());
+	return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+#endif
@@ -0,0 +1,251 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Hierarchical CPU/GPU profiler for the render thread. PROFILE_SCOPE("name") times the rest of the enclosing block on
+// the CPU with steady_clock and, inside a frame, on the GPU with two GL_TIMESTAMP queries. Timestamps rather than
+// GL_TIME_ELAPSED because elapsed-time queries can't nest, and the headless frame timings already use one around the
+// whole frame. GPU results are read back PROFILER_FRAMES_IN_FLIGHT frames later so the CPU never waits for them.
+// Every finished scope goes into a ring buffer holding the last PROFILER_MAX_EVENTS, writeChromeTrace exports it for
+// chrome://tracing or ui.perfetto.dev.
+//
+// The scopes only exist in builds with ENABLE_PROFILER defined, which the Profile|Win32 configuration of the project
+// does: Release's optimization with the libraries and include paths of Debug|Win32, and allocation counting
+// (COUNT_ALLOCATIONS, AllocationCounter.h) for --check-mesh-allocations. Without ENABLE_PROFILER PROFILE_SCOPE and
+// PROFILE_FRAME expand to nothing, so a normal build pays nothing for the scopes spread over the renderer.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+const size_t PROFILER_MAX_EVENTS = 1 << 16;
+const unsigned int PROFILER_FRAMES_IN_FLIGHT = 2;
+
+struct ProfileEvent {
+	const char *name;		// the string literal given to PROFILE_SCOPE
+	uint32_t frame;
+	uint16_t depth;			// 0 for a scope not inside another one
+	uint16_t gpu;			// 1 for the GPU time of a scope, 0 for its CPU time
+	double startMs;			// since Profiler::start, GPU times are moved onto the CPU clock
+	double durationMs;
+};
+
+class Profiler
+{
+public:
+	// needs the GL context current, as do all the other calls
+	void start()
+	{
+		events.assign(PROFILER_MAX_EVENTS, ProfileEvent());
+		head = count = 0;
+		frame = 0;
+		open.clear();
+		origin = std::chrono::steady_clock::now();
+		enabled = true;
+	}
+
+	// reads back the frames still in flight, the events stay for writeChromeTrace
+	void stop()
+	{
+		if (!enabled)
+			return;
+		while (!open.empty())
+			end();
+		current = NULL;
+		for (FrameQueries &slot : slots)
+			resolve(slot);
+		enabled = false;
+	}
+
+	bool isEnabled() const { return enabled; }
+
+	// at the top of the render loop: the GPU results of the frame that last used this frame's queries are collected,
+	// and the GPU clock is matched to the CPU one
+	void beginFrame()
+	{
+		if (!enabled)
+			return;
+		frame++;
+		current = &slots[frame % PROFILER_FRAMES_IN_FLIGHT];
+		resolve(*current);
+		current->frame = frame;
+		current->cpuBaseMs = nowMs();
+		glGetInteger64v(GL_TIMESTAMP, &current->gpuBase);
+	}
+
+	// false when not profiling, then end must not be called
+	bool begin(const char *name)
+	{
+		if (!enabled)
+			return false;
+		OpenScope scope;
+		scope.name = name;
+		scope.cpuStartMs = nowMs();
+		scope.slot = current;
+		scope.gpuScope = -1;
+		if (current)
+		{
+			FrameQueries &slot = *current;
+			if (slot.queries.size() < slot.used + 2)
+			{
+				size_t oldSize = slot.queries.size();
+				slot.queries.resize(std::max<size_t>(64, oldSize * 2));
+				glGenQueries((GLsizei)(slot.queries.size() - oldSize), slot.queries.data() + oldSize);
+			}
+			scope.gpuScope = (int)slot.scopes.size();
+			slot.scopes.push_back(GpuScope{ name, (uint16_t)open.size(), slot.queries[slot.used], slot.queries[slot.used + 1], false });
+			glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP);
+			slot.used += 2;
+		}
+		open.push_back(scope);
+		return true;
+	}
+
+	void end()
+	{
+		if (open.empty())
+			return;
+		const OpenScope &scope = open.back();
+		// a scope that outlives its frame only gets its CPU time
+		if (scope.gpuScope >= 0 && scope.slot == current)
+		{
+			glQueryCounter(current->scopes[scope.gpuScope].end, GL_TIMESTAMP);
+			current->scopes[scope.gpuScope].ended = true;
+		}
+		double endMs = nowMs();
+		push(ProfileEvent{ scope.name, frame, (uint16_t)(open.size() - 1), 0, scope.cpuStartMs, endMs - scope.cpuStartMs });
+		open.pop_back();
+	}
+
+	// everything still in the ring buffer as Chrome trace events, the CPU scopes on one track and the GPU ones on another
+	bool writeChromeTrace(const std::string &path) const
+	{
+		FILE *f = fopen(path.c_str(), "w");
+		if (!f)
+			return false;
+		fprintf(f, "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+		fprintf(f, "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": { \"name\": \"CPU\" } },\n");
+		fprintf(f, "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": { \"name\": \"GPU\" } }");
+		size_t first = (head + events.size() - count) % std::max<size_t>(events.size(), 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			const ProfileEvent &e = events[(first + i) % events.size()];
+			fprintf(f, ",\n{ \"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": { \"frame\": %u, \"depth\": %u } }",
+				e.name, e.gpu ? "gpu" : "cpu", e.gpu ? 2 : 1, e.startMs * 1000.0, e.durationMs * 1000.0, e.frame, (unsigned int)e.depth);
+		}
+		fprintf(f, "\n]\n}\n");
+		return fclose(f) == 0;
+	}
+
+	void release()
+	{
+		for (FrameQueries &slot : slots)
+		{
+			if (!slot.queries.empty())
+				glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+			slot = FrameQueries();
+		}
+		current = NULL;
+	}
+
+private:
+	struct GpuScope {
+		const char *name;
+		uint16_t depth;
+		GLuint begin, end;
+		bool ended;
+	};
+
+	// the queries of one frame, reused PROFILER_FRAMES_IN_FLIGHT frames later
+	struct FrameQueries {
+		std::vector<GLuint> queries;
+		size_t used = 0;
+		std::vector<GpuScope> scopes;
+		uint32_t frame = 0;
+		double cpuBaseMs = 0.0;
+		GLint64 gpuBase = 0;
+	};
+
+	struct OpenScope {
+		const char *name;
+		double cpuStartMs;
+		FrameQueries *slot;	// the frame it was opened in, NULL outside a frame
+		int gpuScope;		// into slot->scopes, -1 outside a frame
+	};
+
+	bool enabled = false;
+	std::vector<ProfileEvent> events;
+	size_t head = 0, count = 0;
+	uint32_t frame = 0;
+	std::vector<OpenScope> open;
+	FrameQueries slots[PROFILER_FRAMES_IN_FLIGHT];
+	FrameQueries *current = NULL;
+	std::chrono::steady_clock::time_point origin;
+
+	double nowMs() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	void push(const ProfileEvent &event)
+	{
+		events[head] = event;
+		head = (head + 1) % events.size();
+		count = std::min(count + 1, events.size());
+	}
+
+	void resolve(FrameQueries &slot)
+	{
+		for (const GpuScope &scope : slot.scopes)
+		{
+			if (!scope.ended)
+				continue;
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+			double startMs = slot.cpuBaseMs + ((GLint64)begin - slot.gpuBase) / 1e6;
+			push(ProfileEvent{ scope.name, slot.frame, scope.depth, 1, startMs, (end - begin) / 1e6 });
+		}
+		slot.scopes.clear();
+		slot.used = 0;
+	}
+};
+
+inline Profiler& profiler()
+{
+	static Profiler instance;
+	return instance;
+}
+
+// times the rest of the enclosing block
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char *name) : active(profiler().begin(name)) {}
+	~ProfileScope()
+	{
+		if (active)
+			profiler().end();
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	bool active;
+};
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() profiler().beginFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+#endif
@@ -0,0 +1,563 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include "VertexFormat.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Objects don't draw themselves any more, they submit DrawItems. Once everything is in, cull() drops the items
+// outside the view frustum, then the queue sorts the rest by a 64 bit key and executes them against a RenderBackend, leaving out every program, texture and VAO bind that
+// wouldn't change anything. The GL backend does the real calls; MockRenderBackend only counts, so sorting and
+// filtering can be measured without a context (--bench-render-queue).
+
+// ------------------------------------------------------------------------
+// textures of a material and the sampler uniforms pointing at their units (unit = position in the list)
+struct MaterialTexture {
+	GLenum target;
+	unsigned int texture;
+	std::string sampler;	// empty if the shader reads a fixed unit (materialDiffuse is always unit 0)
+};
+
+// ids of the texture sets materials use, shared by every thread that creates materials. an id lives as long as a
+// material holds it: once the last one is gone the set is forgotten, so when GL hands out the names of deleted
+// textures again the new set gets an id of its own rather than the one of textures that no longer exist.
+class MaterialIds
+{
+public:
+	unsigned int acquire(const std::vector<MaterialTexture> &textures)
+	{
+		if (textures.empty())
+			return 0;
+		std::string key;
+		for (const MaterialTexture &texture : textures)
+			key += std::to_string(texture.target) + ":" + std::to_string(texture.texture) + ":" + texture.sampler + ";";
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = sets.find(key);
+		if (it == sets.end())
+		{
+			unsigned int id;
+			if (freeIds.empty())
+			{
+				id = (unsigned int)byId.size();
+				byId.push_back(sets.end());
+			}
+			else
+			{
+				id = freeIds.back();
+				freeIds.pop_back();
+			}
+			it = sets.emplace(key, Set{ id, 0 }).first;
+			byId[id] = it;
+		}
+		it->second.users++;
+		return it->second.id;
+	}
+
+	// another material holds id (a copy)
+	void retain(unsigned int id)
+	{
+		if (id == 0)
+			return;
+		std::lock_guard<std::mutex> lock(mutex);
+		byId[id]->second.users++;
+	}
+
+	void release(unsigned int id)
+	{
+		if (id == 0)
+			return;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--byId[id]->second.users > 0)
+			return;
+		sets.erase(byId[id]);
+		byId[id] = sets.end();
+		freeIds.push_back(id);
+	}
+
+	// texture sets held by a material right now
+	size_t size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return sets.size();
+	}
+
+private:
+	struct Set {
+		unsigned int id;
+		size_t users;
+	};
+	std::mutex mutex;
+	std::map<std::string, Set> sets;
+	std::vector<std::map<std::string, Set>::iterator> byId = { sets.end() };	// id 0 is no textures
+	std::vector<unsigned int> freeIds;
+};
+
+// never destroyed, materials that outlive main's statics can still give their ids back
+inline MaterialIds& materialIds()
+{
+	static MaterialIds *ids = new MaterialIds();
+	return *ids;
+}
+
+class RenderMaterial
+{
+public:
+	unsigned int id = 0;	// equal texture sets share an id, so their draws sort next to each other; 0 = no textures
+	std::vector<MaterialTexture> textures;
+	float layer = -1.0f;	// of the texture array the diffuse texture was packed into (TextureArrays.h), -1 for none.
+							// not part of the id: the layers of an array sort together and only this uniform changes
+
+	RenderMaterial() {}
+	explicit RenderMaterial(std::vector<MaterialTexture> textures, float layer = -1.0f) : textures(std::move(textures)), layer(layer)
+	{
+		id = materialIds().acquire(this->textures);
+	}
+	RenderMaterial(const RenderMaterial &other) : id(other.id), textures(other.textures), layer(other.layer)
+	{
+		materialIds().retain(id);
+	}
+	RenderMaterial(RenderMaterial &&other) : id(other.id), textures(std::move(other.textures)), layer(other.layer)
+	{
+		other.id = 0;
+	}
+	RenderMaterial& operator=(RenderMaterial other)
+	{
+		std::swap(id, other.id);
+		std::swap(textures, other.textures);
+		std::swap(layer, other.layer);
+		uniformShader = 0;
+		return *this;
+	}
+	~RenderMaterial()
+	{
+		materialIds().release(id);
+	}
+
+	// handle of the sampler uniform of texture i in shader, looked up again when a different shader asks
+	UniformHandle sampler(const Shader &shader, size_t i) const
+	{
+		if (uniformShader != shader.serial)
+		{
+			samplerUniforms.clear();
+			for (const MaterialTexture &texture : textures)
+				samplerUniforms.push_back(texture.sampler.empty() ? UniformHandle() : shader.uniform(texture.sampler));
+			uniformShader = shader.serial;
+		}
+		return samplerUniforms[i];
+	}
+
+private:
+	mutable unsigned int uniformShader = 0;
+	mutable std::vector<UniformHandle> samplerUniforms;
+};
+
+// ------------------------------------------------------------------------
+// key layout, most significant first: layer 4 | program 8 | material 16 | VAO 16 | depth 20.
+// sorting by it groups draws by program, then by texture set, then by VAO, and front to back inside a group.
+const int SORT_KEY_DEPTH_BITS = 20;
+
+inline uint64_t makeSortKey(unsigned int layer, unsigned int program, unsigned int material, unsigned int vao, float depth, float farPlane)
+{
+	float normalized = farPlane > 0.0f ? depth / farPlane : 0.0f;
+	normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+	uint64_t depthBits = (uint64_t)(normalized * ((1 << SORT_KEY_DEPTH_BITS) - 1));
+	return ((uint64_t)(layer & 0xf) << 60) | ((uint64_t)(program & 0xff) << 52) | ((uint64_t)(material & 0xffff) << 36) |
+		((uint64_t)(vao & 0xffff) << SORT_KEY_DEPTH_BITS) | depthBits;
+}
+
+struct DrawItem {
+	uint64_t key;
+	Shader *shader;					// uniforms are set through it; the mock backend never looks at it
+	unsigned int program;			// GL program name, what state filtering compares
+	const RenderMaterial *material;	// may be NULL
+	unsigned int vao;
+	GLenum indexType;				// 0 draws arrays
+	GLsizei count;
+	unsigned int firstIndex;		// where in the index buffer the draw starts (a level of detail, see MeshLod.h)
+	glm::mat4 model;
+	const Bounds *packedBounds;		// bounds of VERTEX_LAYOUT_PACKED vertices, NULL for float vertices
+	GLsizei instanceCount;			// 0 for a plain draw, else the VAO carries an instance buffer (InstancedModel.h)
+	glm::vec3 center, extent;		// world space AABB for frustum culling, extent UNBOUNDED_EXTENT if it has none
+};
+
+// extent of draws that are never culled
+const glm::vec3 UNBOUNDED_EXTENT(FLT_MAX);
+
+inline size_t indexTypeSize(GLenum indexType)
+{
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+// ------------------------------------------------------------------------
+// what the queue asks of the API, only called for state that actually changes
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+	virtual void useProgram(const DrawItem &item) = 0;
+	virtual void bindTexture(unsigned int unit, GLenum target, unsigned int texture) = 0;
+	// points the samplers of the item's material at their units, or resets what a material sets if it has none
+	virtual void setMaterialUniforms(const DrawItem &item) = 0;
+	virtual void bindVertexArray(unsigned int vao) = 0;
+	// model matrix and vertex decoding, then the draw call
+	virtual void draw(const DrawItem &item) = 0;
+};
+
+// state changes of one execute(): issued is what reached the backend, naive what drawing every item on its own
+// (program, all of its textures and its VAO each time, like Mesh::Draw) would have cost
+struct RenderQueueStats {
+	size_t items = 0;
+	size_t instances = 0;	// objects drawn, counting every instance of an instanced item
+	size_t triangles = 0;	// over all instances
+	size_t culled = 0;		// items submitted but dropped by cull()
+	size_t programs = 0, naivePrograms = 0;
+	size_t textures = 0, naiveTextures = 0;
+	size_t vaos = 0, naiveVaos = 0;
+
+	size_t issued() const { return programs + textures + vaos; }
+	size_t naive() const { return naivePrograms + naiveTextures + naiveVaos; }
+	size_t removed() const { return naive() - issued(); }
+
+	RenderQueueStats& operator+=(const RenderQueueStats &other)
+	{
+		items += other.items;
+		instances += other.instances;
+		triangles += other.triangles;
+		culled += other.culled;
+		programs += other.programs;
+		naivePrograms += other.naivePrograms;
+		textures += other.textures;
+		naiveTextures += other.naiveTextures;
+		vaos += other.vaos;
+		naiveVaos += other.naiveVaos;
+		return *this;
+	}
+};
+
+// prints the state changes per frame, averaged over frameCount frames like printGLCallStats
+inline void printRenderQueueStats(const RenderQueueStats &stats, unsigned int frameCount)
+{
+	if (frameCount == 0)
+		return;
+	printf("render queue: %.1f draws of %.1f objects (%.0f triangles), %.1f culled, %.1f state changes per frame (%.1f removed: programs %.1f, textures %.1f, VAOs %.1f)\n",
+		(double)stats.items / frameCount, (double)stats.instances / frameCount, (double)stats.triangles / frameCount, (double)stats.culled / frameCount,
+		(double)stats.issued() / frameCount, (double)stats.removed() / frameCount,
+		(double)(stats.naivePrograms - stats.programs) / frameCount, (double)(stats.naiveTextures - stats.textures) / frameCount,
+		(double)(stats.naiveVaos - stats.vaos) / frameCount);
+}
+
+// what the queue knows a texture unit holds: nothing until it bound a texture there itself (an earlier pass, the skybox
+// or the texture loader may have left anything on it), then the target and name it bound. a unit holds one texture per
+// target, but one known binding each is enough to drop the repeats a sorted queue makes.
+struct BoundTexture {
+	bool known = false;
+	GLenum target = 0;
+	unsigned int texture = 0;
+
+	bool holds(GLenum target, unsigned int texture) const { return known && this->target == target && this->texture == texture; }
+
+	void bind(GLenum target, unsigned int texture)
+	{
+		known = true;
+		this->target = target;
+		this->texture = texture;
+	}
+};
+
+class RenderQueue
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+	void clear()
+	{
+		items.clear();
+		culled = 0;
+		sorted = false;
+	}
+	size_t size() const { return items.size(); }
+	size_t culledCount() const { return culled; }
+
+	void submit(const DrawItem &item) { items.push_back(item); }
+
+	// moves the items of other (filled on another thread, say) behind the ones already submitted
+	void append(RenderQueue &other)
+	{
+		items.insert(items.end(), other.items.begin(), other.items.end());
+		culled += other.culled;
+		other.clear();
+	}
+
+	// drops the items whose bounds are outside the frustum, all of them tested in one SSE batch
+	size_t cull(const Frustum &frustum)
+	{
+		PROFILE_SCOPE("RenderQueue::cull");
+		boxes.clear();
+		for (const DrawItem &item : items)
+			boxes.add(item.center, item.extent);
+		boxes.cull(frustum);
+		size_t kept = 0;
+		for (size_t i = 0; i < items.size(); i++)
+			if (boxes.visible[i])
+				items[kept++] = items[i];
+		size_t dropped = items.size() - kept;
+		items.resize(kept);
+		culled += dropped;
+		return dropped;
+	}
+
+	// radix sorts the submitted items by key (stable, so equal keys keep their submission order)
+	void sort()
+	{
+		PROFILE_SCOPE("RenderQueue::sort");
+		entries.resize(items.size());
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			entries[i].key = items[i].key;
+			entries[i].index = (uint32_t)i;
+		}
+		radixSort(entries, scratch);
+		sorted = true;
+	}
+
+	// runs the items (sorted if sort() was called since the last clear) and clears the queue
+	RenderQueueStats execute(RenderBackend &backend)
+	{
+		PROFILE_SCOPE("RenderQueue::execute");
+		RenderQueueStats stats = executeRange(0, order(), backend);
+		stats.culled = culled;
+		clear();
+		return stats;
+	}
+
+	// fixes the order execute runs the items in (sorted, or as submitted) and returns how many there are
+	size_t order()
+	{
+		if (!sorted)
+		{
+			entries.resize(items.size());
+			for (size_t i = 0; i < items.size(); i++)
+				entries[i].index = (uint32_t)i;
+		}
+		return entries.size();
+	}
+
+	// runs the items [begin, end) of order() as if nothing was bound before them, so separate ranges can go to
+	// separate backends at the same time (recordRenderQueue in CommandBuffer.h). doesn't clear the queue.
+	RenderQueueStats executeRange(size_t begin, size_t end, RenderBackend &backend) const
+	{
+		RenderQueueStats stats;
+		unsigned int program = 0;
+		const RenderMaterial *material = nullptr;
+		unsigned int vao = 0;
+		BoundTexture boundTextures[MAX_TEXTURE_UNITS];
+		bool first = true;
+		for (size_t i = begin; i < end; i++)
+		{
+			const DrawItem &item = items[entries[i].index];
+			size_t textureCount = item.material ? item.material->textures.size() : 0;
+			stats.items++;
+			stats.instances += item.instanceCount ? item.instanceCount : 1;
+			stats.triangles += (size_t)(item.count / 3) * (item.instanceCount ? item.instanceCount : 1);
+			stats.naivePrograms++;
+			stats.naiveTextures += textureCount;
+			stats.naiveVaos++;
+
+			bool programChanged = first || item.program != program;
+			if (programChanged)
+			{
+				backend.useProgram(item);
+				program = item.program;
+				stats.programs++;
+			}
+			if (programChanged || item.material != material)
+			{
+				for (size_t unit = 0; unit < textureCount && unit < MAX_TEXTURE_UNITS; unit++)
+				{
+					const MaterialTexture &texture = item.material->textures[unit];
+					if (!boundTextures[unit].holds(texture.target, texture.texture))
+					{
+						backend.bindTexture((unsigned int)unit, texture.target, texture.texture);
+						boundTextures[unit].bind(texture.target, texture.texture);
+						stats.textures++;
+					}
+				}
+				// also without a material, which must not keep the layer of the one before
+				backend.setMaterialUniforms(item);
+				material = item.material;
+			}
+			if (first || item.vao != vao)
+			{
+				backend.bindVertexArray(item.vao);
+				vao = item.vao;
+				stats.vaos++;
+			}
+			backend.draw(item);
+			first = false;
+		}
+		return stats;
+	}
+
+private:
+	struct SortEntry {
+		uint64_t key;
+		uint32_t index;
+	};
+
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> entries, scratch;
+	bool sorted = false;
+	BoxBatch boxes;
+	size_t culled = 0;
+
+	// LSD radix sort, 8 bits per pass. passes where every key has the same byte are skipped, which with
+	// few programs and materials is most of the high ones.
+	static void radixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch)
+	{
+		scratch.resize(entries.size());
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t counts[256] = {};
+			for (const SortEntry &entry : entries)
+				counts[(entry.key >> shift) & 0xff]++;
+			if (counts[(entries.empty() ? 0 : entries[0].key >> shift) & 0xff] == entries.size())
+				continue;
+			size_t offsets[256];
+			size_t offset = 0;
+			for (int digit = 0; digit < 256; digit++)
+			{
+				offsets[digit] = offset;
+				offset += counts[digit];
+			}
+			for (const SortEntry &entry : entries)
+				scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+			entries.swap(scratch);
+		}
+	}
+};
+
+// ------------------------------------------------------------------------
+// the real thing. Uniforms go through the shader's setters, so values that didn't change are filtered there.
+class GLRenderBackend : public RenderBackend
+{
+public:
+	void useProgram(const DrawItem &item)
+	{
+		item.shader->use();
+		ProgramUniforms &found = programs[item.shader->serial];
+		if (!found.lookedUp)
+		{
+			found.model = item.shader->uniform("model");
+			found.packedVertices = item.shader->uniform("packedVertices");
+			found.positionOffset = item.shader->uniform("positionOffset");
+			found.positionScale = item.shader->uniform("positionScale");
+			found.instanced = item.shader->uniform("instanced");
+			found.materialLayer = item.shader->uniform("materialLayer");
+			found.lookedUp = true;
+		}
+		current = &found;
+	}
+
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+	}
+
+	void setMaterialUniforms(const DrawItem &item)
+	{
+		if (!item.material)
+		{
+			// no texture array: the shader reads materialDiffuse, not a layer of materialDiffuseArray
+			item.shader->setFloat(current->materialLayer, -1.0f);
+			return;
+		}
+		for (size_t i = 0; i < item.material->textures.size(); i++)
+			item.shader->setInt(item.material->sampler(*item.shader, i), (int)i);
+		item.shader->setFloat(current->materialLayer, item.material->layer);
+	}
+
+	void bindVertexArray(unsigned int vao)
+	{
+		glBindVertexArray(vao);
+	}
+
+	void draw(const DrawItem &item)
+	{
+		item.shader->setMat4(current->model, item.model);
+		item.shader->setBool(current->packedVertices, item.packedBounds != nullptr);
+		if (item.packedBounds)
+		{
+			item.shader->setVec3(current->positionOffset, item.packedBounds->min);
+			item.shader->setVec3(current->positionScale, item.packedBounds->max - item.packedBounds->min);
+		}
+		item.shader->setBool(current->instanced, item.instanceCount > 0);
+		const void *offset = (const void*)(item.firstIndex * (item.indexType ? indexTypeSize(item.indexType) : 0));
+		if (item.instanceCount)
+			glDrawElementsInstanced(GL_TRIANGLES, item.count, item.indexType, offset, item.instanceCount);
+		else if (item.indexType)
+			glDrawElements(GL_TRIANGLES, item.count, item.indexType, offset);
+		else
+			glDrawArrays(GL_TRIANGLES, item.firstIndex, item.count);
+	}
+
+	// leaves GL the way code drawing without the queue expects it
+	void finish()
+	{
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+private:
+	struct ProgramUniforms {
+		bool lookedUp = false;
+		UniformHandle model, packedVertices, positionOffset, positionScale, instanced, materialLayer;
+	};
+	std::unordered_map<unsigned int, ProgramUniforms> programs;
+	ProgramUniforms *current = nullptr;
+};
+
+// counts what would have been sent to GL, for measuring without a context
+class MockRenderBackend : public RenderBackend
+{
+public:
+	size_t programs = 0, textures = 0, materials = 0, vaos = 0, draws = 0;
+	size_t untextured = 0;	// the setMaterialUniforms calls of those, for items without a material
+	std::vector<uint64_t> drawnKeys;	// with recordKeys, the key of every draw in the order they came
+
+	explicit MockRenderBackend(bool recordKeys = false) : recordKeys(recordKeys) {}
+
+	void useProgram(const DrawItem &item) { programs++; }
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture) { textures++; }
+	void setMaterialUniforms(const DrawItem &item)
+	{
+		materials++;
+		if (!item.material)
+			untextured++;
+	}
+	void bindVertexArray(unsigned int vao) { vaos++; }
+	void draw(const DrawItem &item)
+	{
+		draws++;
+		if (recordKeys)
+			drawnKeys.push_back(item.key);
+	}
+
+private:
+	bool recordKeys;
+};
+#endif
@@ -0,0 +1,145 @@
+#ifndef RENDER_QUEUE_BENCHMARKS_H
+#define RENDER_QUEUE_BENCHMARKS_H
+
+// Benchmarks of the render queue and of recording it into command buffers, on synthetic frames run against
+// MockRenderBackend: CPU only, no GL.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchmarkUtils.h"
+#include "CommandBuffer.h"
+#include "RenderQueue.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// materials for synthetic frames: 1 to 3 textures each, made up texture names
+inline vector<RenderMaterial> syntheticMaterials(unsigned int materialCount)
+{
+	vector<RenderMaterial> materials;
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		vector<MaterialTexture> textures;
+		for (unsigned int unit = 0; unit < 1 + i % 3; unit++)
+			textures.push_back({ GL_TEXTURE_2D, 1000 + i * 4 + unit, "" });
+		materials.push_back(RenderMaterial(std::move(textures)));
+	}
+	return materials;
+}
+
+// a synthetic frame: programs, materials and VAOs picked at random, random depth. with untextured, every 16th item
+// has no material and every 32nd is instanced. No GL involved, the items carry made up names and no shader.
+inline vector<DrawItem> syntheticDrawItems(size_t itemCount, const vector<RenderMaterial> &materials, bool untextured = false)
+{
+	const unsigned int programCount = 4, vaoCount = 256;
+	srand(1);
+	vector<DrawItem> items(itemCount);
+	for (DrawItem &item : items)
+	{
+		unsigned int program = 1 + rand() % programCount;
+		const RenderMaterial *material = &materials[rand() % materials.size()];
+		if (untextured && rand() % 16 == 0)
+			material = nullptr;
+		unsigned int vao = 1 + rand() % vaoCount;
+		float depth = (float)rand() / RAND_MAX * 100.0f;
+		item.key = makeSortKey(0, program, material ? material->id : 0, vao, depth, 100.0f);
+		item.shader = nullptr;
+		item.program = program;
+		item.material = material;
+		item.vao = vao;
+		item.indexType = GL_UNSIGNED_SHORT;
+		item.count = 36;
+		item.firstIndex = untextured ? (unsigned int)(rand() % 4) * 36 : 0;
+		item.model = glm::translate(glm::mat4(1.0f), glm::vec3(depth));
+		item.packedBounds = nullptr;
+		item.instanceCount = untextured && rand() % 32 == 0 ? 100 : 0;
+		item.center = glm::vec3(0.0f);
+		item.extent = UNBOUNDED_EXTENT;
+	}
+	return items;
+}
+
+// --bench-render-queue: a synthetic frame (see syntheticDrawItems) run through MockRenderBackend in submission order
+// and sorted, with the state changes that reach the backend and the time it takes to queue, sort and execute.
+inline void benchmarkRenderQueue()
+{
+	const size_t itemCounts[] = { 1000, 10000, 100000 };
+	const int repeats = 20;
+
+	vector<RenderMaterial> materials = syntheticMaterials(64);
+
+	printf("%8s %8s %10s %10s %10s %8s %8s %10s\n", "items", "order", "programs", "textures", "VAOs", "removed", "sort ms", "total ms");
+	for (size_t itemCount : itemCounts)
+	{
+		vector<DrawItem> items = syntheticDrawItems(itemCount, materials);
+
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			RenderQueue queue;
+			RenderQueueStats stats;
+			double sortMs = 0.0;
+			auto start = chrono::steady_clock::now();
+			for (int repeat = 0; repeat < repeats; repeat++)
+			{
+				MockRenderBackend backend;
+				for (const DrawItem &item : items)
+					queue.submit(item);
+				if (sorted)
+				{
+					auto sortStart = chrono::steady_clock::now();
+					queue.sort();
+					sortMs += elapsedMs(sortStart);
+				}
+				stats = queue.execute(backend);
+			}
+			double ms = elapsedMs(start) / repeats;
+			printf("%8zu %8s %10zu %10zu %10zu %7.1f%% %8.3f %10.3f\n", itemCount, sorted ? "sorted" : "submit",
+				stats.programs, stats.textures, stats.vaos, 100.0 * stats.removed() / max<size_t>(stats.naive(), 1), sortMs / repeats, ms);
+		}
+	}
+}
+
+// --bench-command-buffer: a sorted synthetic frame recorded into command buffers on 1, 2, 4, ... threads (best of 10),
+// then merged into MockRenderBackend. The frame is submitted and sorted again before every run, only recording is timed.
+inline void benchmarkCommandBuffers()
+{
+	const size_t itemCounts[] = { 10000, 100000, 1000000 };
+	const int repeats = 10;
+	vector<RenderMaterial> materials = syntheticMaterials(64);
+
+	printf("%8s %8s %8s %10s %12s %8s %10s %10s\n", "items", "threads", "buffers", "record ms", "Mitems/s", "speedup", "KB", "replay ms");
+	for (size_t itemCount : itemCounts)
+	{
+		vector<DrawItem> items = syntheticDrawItems(itemCount, materials, true);
+		RenderQueue queue;
+		vector<CommandBuffer> buffers;
+		double singleMs = 0.0;
+		for (unsigned int threads : benchmarkThreadCounts())
+		{
+			double bestMs = 1e30, replayMs = 0.0;
+			size_t bytes = 0;
+			for (int repeat = 0; repeat < repeats; repeat++)
+			{
+				for (const DrawItem &item : items)
+					queue.submit(item);
+				queue.sort();
+				auto start = chrono::steady_clock::now();
+				RenderQueueStats stats = recordRenderQueue(queue, sharedThreadPool(), buffers, threads);
+				bestMs = min(bestMs, elapsedMs(start));
+
+				MockRenderBackend backend;
+				start = chrono::steady_clock::now();
+				replayCommandBuffers(buffers, backend, stats);
+				replayMs += elapsedMs(start);
+			}
+			for (const CommandBuffer &buffer : buffers)
+				bytes += buffer.bytes();
+			if (threads == 1)
+				singleMs = bestMs;
+			printf("%8zu %8u %8zu %10.3f %12.1f %7.2fx %10zu %10.3f\n", itemCount, threads, buffers.size(), bestMs,
+				itemCount / bestMs / 1000.0, singleMs / bestMs, bytes / 1024, replayMs / repeats);
+		}
+	}
+}
+#endif
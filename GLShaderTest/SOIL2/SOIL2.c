@@ -121,6 +121,9 @@
 /*	error reporting	*/
 const char *result_string_pointer = "SOIL initialized";
 
+/*	set by SOIL_set_parallel_for, NULL runs jobs on the calling thread	*/
+static void (*soil_parallel_for)( int count, void (*job)( void *context, int index ), void *context ) = NULL;
+
 /*	for loading cube maps	*/
 enum{
 	SOIL_CAPABILITY_UNKNOWN = -1,
@@ -1329,6 +1332,41 @@ void check_for_GL_errors( const char *calling_location )
 }
 #endif
 
+void
+	SOIL_set_parallel_for
+	(
+		void (*parallel_for)( int count, void (*job)( void *context, int index ), void *context )
+	)
+{
+	soil_parallel_for = parallel_for;
+}
+
+/*	rows of a MIPmap level per parallel_for job	*/
+#define SOIL_MIPMAP_JOB_ROWS 32
+
+typedef struct
+{
+	const unsigned char *previous;
+	int width, height, channels;
+	unsigned char *resampled;
+	int resampled_height;
+	int srgb;
+} mipmap_level_job;
+
+static void mipmap_level_rows( void *context, int index )
+{
+	const mipmap_level_job *job = (const mipmap_level_job*)context;
+	int first_row = index * SOIL_MIPMAP_JOB_ROWS;
+	int rows = job->resampled_height - first_row;
+	if( rows > SOIL_MIPMAP_JOB_ROWS )
+	{
+		rows = SOIL_MIPMAP_JOB_ROWS;
+	}
+	mipmap_image_half_rows(
+			job->previous, job->width, job->height, job->channels,
+			job->resampled, first_row, rows, job->srgb );
+}
+
 static void createMipmaps(const unsigned char *const img,
 		int width, int height, int channels,
 		unsigned int flags,
@@ -1343,18 +1381,41 @@ static void createMipmaps(const unsigned char *const img,
 	}
 	else
 	{
+		/*	every level is filtered down from the one before it, so the
+			two buffers take turns holding the newest level	*/
 		int MIPlevel = 1;
-		int MIPwidth = (width+1) / 2;
-		int MIPheight = (height+1) / 2;
-		unsigned char *resampled = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+		int MIPwidth = (width > 1) ? width / 2 : 1;
+		int MIPheight = (height > 1) ? height / 2 : 1;
+		unsigned char *levels[2];
+		mipmap_level_job job;
+		levels[0] = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+		levels[1] = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+		job.previous = img;
+		job.width = width;
+		job.height = height;
+		job.channels = channels;
+		/*	averaging YCoCg as sRGB would make no sense	*/
+		job.srgb = ( flags & SOIL_FLAG_SRGB_COLOR_SPACE ) && !( flags & SOIL_FLAG_CoCg_Y );
+
+		while( (levels[0] != NULL) && (levels[1] != NULL) && ((job.width > 1) || (job.height > 1)) )
+		{
+			unsigned char *resampled = levels[MIPlevel & 1];
+			int jobs = (MIPheight + SOIL_MIPMAP_JOB_ROWS - 1) / SOIL_MIPMAP_JOB_ROWS;
 
-		while( ((1<<MIPlevel) <= width) || ((1<<MIPlevel) <= height) )
-		{
 			/*	do this MIPmap level	*/
-			mipmap_image(
-					img, width, height, channels,
-					resampled,
-					(1 << MIPlevel), (1 << MIPlevel) );
+			job.resampled = resampled;
+			job.resampled_height = MIPheight;
+			if( (soil_parallel_for != NULL) && (jobs > 1) )
+			{
+				soil_parallel_for( jobs, mipmap_level_rows, &job );
+			} else
+			{
+				int i;
+				for( i = 0; i < jobs; ++i )
+				{
+					mipmap_level_rows( &job, i );
+				}
+			}
 
 			/*  upload the MIPmaps	*/
 			if( DXT_mode == SOIL_CAPABILITY_PRESENT )
@@ -1400,12 +1461,16 @@ static void createMipmaps(const unsigned char *const img,
 				check_for_GL_errors( "glTexImage2D" );
 			}
 			/*	prep for the next level	*/
+			job.previous = resampled;
+			job.width = MIPwidth;
+			job.height = MIPheight;
 			++MIPlevel;
-			MIPwidth = (MIPwidth + 1) / 2;
-			MIPheight = (MIPheight + 1) / 2;
+			MIPwidth = (MIPwidth > 1) ? MIPwidth / 2 : 1;
+			MIPheight = (MIPheight > 1) ? MIPheight / 2 : 1;
 		}
 
-		SOIL_free_image_data( resampled );
+		SOIL_free_image_data( levels[0] );
+		SOIL_free_image_data( levels[1] );
 	}
 }
 
@@ -449,6 +449,20 @@ const char*
 		void
 	);
 
+/**
+	Lets SOIL spread work over threads. parallel_for must call
+	job( context, i ) for every i from 0 to count-1, in any order
+	and on any thread, and return once all of them returned.
+	The MIPmaps SOIL builds itself (SOIL_FLAG_MIPMAPS) split the
+	rows of every level this way. NULL (the default) keeps
+	everything on the calling thread.
+**/
+void
+	SOIL_set_parallel_for
+	(
+		void (*parallel_for)( int count, void (*job)( void *context, int index ), void *context )
+	);
+
 /** @return The address of the GL function proc, or NULL if the function is not found. */
 void *
 	SOIL_GL_GetProcAddress
@@ -13,6 +13,28 @@
 #include <string.h>
 #include <stdio.h>
 
+/*	SIMD compressors for x86: SSE2 does 4 blocks at a time, AVX 8.
+	which one runs is picked at runtime (get_DXT_compressor)	*/
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define DXT_HAVE_SSE2	1
+	#include <emmintrin.h>
+	#if defined(_MSC_VER) && _MSC_VER >= 1600
+		#define DXT_HAVE_AVX	1
+		#include <immintrin.h>
+		#include <intrin.h>
+	#elif defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+		#define DXT_HAVE_AVX	1
+		#include <immintrin.h>
+	#endif
+#endif
+#ifndef DXT_HAVE_SSE2
+	#define DXT_HAVE_SSE2	0
+#endif
+#ifndef DXT_HAVE_AVX
+	#define DXT_HAVE_AVX	0
+#endif
+
 /*	set this =1 if you want to use the covarince matrix method...
 	which is better than my method of using standard deviations
 	overall, except on the infintesimal chance that the power
@@ -37,6 +59,34 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+/*
+	Compress count blocks of 16 pixels (channels bytes each, back to back
+	in uncompressed) to compressed, the blocks stride bytes apart.  As many
+	as possible go through the SIMD compressor picked by get_DXT_compressor,
+	several at a time, the rest through the scalar functions above.
+*/
+static void compress_DDS_color_blocks(
+				int channels,
+				const unsigned char *const uncompressed,
+				int count,
+				unsigned char *compressed, int stride );
+static void compress_DDS_alpha_blocks(
+				const unsigned char *const uncompressed,
+				int count,
+				unsigned char *compressed, int stride );
+/*
+	Copies the 4x4 block at (x, y) to ublock, as out_channels (3 or 4)
+	bytes per pixel.  Pixels past the edge of the image repeat the first one.
+*/
+static void copy_DXT_block(
+				const unsigned char *const uncompressed,
+				int width, int height, int channels,
+				int x, int y, int out_channels,
+				unsigned char *ublock );
+
+/*	the compressor in use, -1 until the first call picks one	*/
+static int DXT_compressor = -1;
+static int best_DXT_compressor( void );
 
 /********* Actual Exposed Functions *********/
 int
@@ -104,11 +154,6 @@ unsigned char* convert_image_to_DXT1(
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*3];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -117,65 +162,12 @@ unsigned char* convert_image_to_DXT1(
 	{
 		return NULL;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
 	/*	get the RAM for the compressed image
 		(8 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 8;
 	compressed = (unsigned char*)malloc( *out_size );
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
-	{
-		for( i = 0; i < width; i += 4 )
-		{
-			/*	copy this block into a new one	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-				}
-			}
-			/*	compress the block	*/
-			++block_count;
-			compress_DDS_color_block( 3, ublock, cblock );
-			/*	copy the data from the block into the main block	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-		}
-	}
+	convert_image_rows_to_DXT1( uncompressed, width, height, channels, 0, (height+3) >> 2, compressed );
 	return compressed;
 }
 
@@ -185,11 +177,6 @@ unsigned char* convert_image_to_DXT5(
 		int *out_size )
 {
 	unsigned char *compressed;
-	int i, j, x, y;
-	unsigned char ublock[16*4];
-	unsigned char cblock[8];
-	int index = 0, chan_step = 1;
-	int block_count = 0, has_alpha;
 	/*	error check	*/
 	*out_size = 0;
 	if( (width < 1) || (height < 1) ||
@@ -198,80 +185,98 @@ unsigned char* convert_image_to_DXT5(
 	{
 		return NULL;
 	}
-	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
-	if( channels < 3 )
-	{
-		chan_step = 0;
-	}
-	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
-	has_alpha = 1 - (channels & 1);
 	/*	get the RAM for the compressed image
 		(16 bytes per 4x4 pixel block)	*/
 	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * 16;
 	compressed = (unsigned char*)malloc( *out_size );
 	/*	go through each block	*/
-	for( j = 0; j < height; j += 4 )
+	convert_image_rows_to_DXT5( uncompressed, width, height, channels, 0, (height+3) >> 2, compressed );
+	return compressed;
+}
+
+int convert_image_rows_to_DXT1(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int first_block_row, int block_rows,
+		unsigned char *compressed )
+{
+	unsigned char *ublocks;
+	int blocks_wide = (width+3) >> 2;
+	int row, i;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) || (NULL == compressed) ||
+		(channels < 1) || (channels > 4) ||
+		(first_block_row < 0) || (block_rows < 0) ||
+		(first_block_row + block_rows > ((height+3) >> 2)) )
+	{
+		return 0;
+	}
+	/*	one block row at a time: copy its blocks out, then compress them	*/
+	ublocks = (unsigned char*)malloc( blocks_wide * 16*3 );
+	for( row = first_block_row; row < first_block_row + block_rows; ++row )
 	{
-		for( i = 0; i < width; i += 4 )
+		for( i = 0; i < blocks_wide; ++i )
 		{
-			/*	local variables, and my block counter	*/
-			int idx = 0;
-			int mx = 4, my = 4;
-			if( j+4 >= height )
-			{
-				my = height - j;
-			}
-			if( i+4 >= width )
-			{
-				mx = width - i;
-			}
-			for( y = 0; y < my; ++y )
-			{
-				for( x = 0; x < mx; ++x )
-				{
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step];
-					ublock[idx++] = uncompressed[(j+y)*width*channels+(i+x)*channels+chan_step+chan_step];
-					ublock[idx++] =
-						has_alpha * uncompressed[(j+y)*width*channels+(i+x)*channels+channels-1]
-						+ (1-has_alpha)*255;
-				}
-				for( x = mx; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			for( y = my; y < 4; ++y )
-			{
-				for( x = 0; x < 4; ++x )
-				{
-					ublock[idx++] = ublock[0];
-					ublock[idx++] = ublock[1];
-					ublock[idx++] = ublock[2];
-					ublock[idx++] = ublock[3];
-				}
-			}
-			/*	now compress the alpha block	*/
-			compress_DDS_alpha_block( ublock, cblock );
-			/*	copy the data from the compressed alpha block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
-			/*	then compress the color block	*/
-			++block_count;
-			compress_DDS_color_block( 4, ublock, cblock );
-			/*	copy the data from the compressed color block into the main buffer	*/
-			for( x = 0; x < 8; ++x )
-			{
-				compressed[index++] = cblock[x];
-			}
+			copy_DXT_block( uncompressed, width, height, channels, i*4, row*4, 3, ublocks + i*16*3 );
 		}
+		compress_DDS_color_blocks( 3, ublocks, blocks_wide, compressed + row*blocks_wide*8, 8 );
 	}
-	return compressed;
+	free( ublocks );
+	return 1;
+}
+
+int convert_image_rows_to_DXT5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int first_block_row, int block_rows,
+		unsigned char *compressed )
+{
+	unsigned char *ublocks;
+	int blocks_wide = (width+3) >> 2;
+	int row, i;
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) || (NULL == compressed) ||
+		(channels < 1) || (channels > 4) ||
+		(first_block_row < 0) || (block_rows < 0) ||
+		(first_block_row + block_rows > ((height+3) >> 2)) )
+	{
+		return 0;
+	}
+	ublocks = (unsigned char*)malloc( blocks_wide * 16*4 );
+	for( row = first_block_row; row < first_block_row + block_rows; ++row )
+	{
+		for( i = 0; i < blocks_wide; ++i )
+		{
+			copy_DXT_block( uncompressed, width, height, channels, i*4, row*4, 4, ublocks + i*16*4 );
+		}
+		/*	each block is the alpha block, then the color block	*/
+		compress_DDS_alpha_blocks( ublocks, blocks_wide, compressed + row*blocks_wide*16, 16 );
+		compress_DDS_color_blocks( 4, ublocks, blocks_wide, compressed + row*blocks_wide*16 + 8, 16 );
+	}
+	free( ublocks );
+	return 1;
+}
+
+int get_DXT_compressor( void )
+{
+	if( DXT_compressor < 0 )
+	{
+		DXT_compressor = best_DXT_compressor();
+	}
+	return DXT_compressor;
+}
+
+int set_DXT_compressor( int compressor )
+{
+	int best = best_DXT_compressor();
+	if( compressor < DXT_COMPRESSOR_SCALAR )
+	{
+		compressor = DXT_COMPRESSOR_SCALAR;
+	}
+	DXT_compressor = compressor < best ? compressor : best;
+	return DXT_compressor;
 }
 
 /********* Helper Functions *********/
@@ -630,3 +635,233 @@ void
 	}
 	/*	done compressing to DXT1	*/
 }
+
+static void copy_DXT_block(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int x, int y, int out_channels,
+		unsigned char *ublock )
+{
+	int idx = 0, px, py, c;
+	int mx = 4, my = 4;
+	/*	for channels == 1 or 2, I do not step forward for R,G,B values	*/
+	int chan_step = channels < 3 ? 0 : 1;
+	/*	# channels = 1 or 3 have no alpha, 2 & 4 do have alpha	*/
+	int has_alpha = 1 - (channels & 1);
+	if( y+4 >= height )
+	{
+		my = height - y;
+	}
+	if( x+4 >= width )
+	{
+		mx = width - x;
+	}
+	for( py = 0; py < my; ++py )
+	{
+		const unsigned char *row = uncompressed + ((y+py)*width + x)*channels;
+		for( px = 0; px < mx; ++px )
+		{
+			ublock[idx++] = row[px*channels];
+			ublock[idx++] = row[px*channels+chan_step];
+			ublock[idx++] = row[px*channels+chan_step+chan_step];
+			if( out_channels == 4 )
+			{
+				ublock[idx++] =
+					has_alpha * row[px*channels+channels-1]
+					+ (1-has_alpha)*255;
+			}
+		}
+		for( px = mx; px < 4; ++px )
+		{
+			for( c = 0; c < out_channels; ++c )
+			{
+				ublock[idx++] = ublock[c];
+			}
+		}
+	}
+	for( py = my; py < 4; ++py )
+	{
+		for( px = 0; px < 4; ++px )
+		{
+			for( c = 0; c < out_channels; ++c )
+			{
+				ublock[idx++] = ublock[c];
+			}
+		}
+	}
+}
+
+/********* SIMD Block Compressors *********/
+#if DXT_HAVE_SSE2
+	#define DXT_LANES	4
+	#define DXT_TARGET
+	#define DXT_FN(name)	name##_SSE2
+	#define DXT_VF	__m128
+	#define DXT_VI	__m128i
+	#define DXT_SET1	_mm_set1_ps
+	#define DXT_LOADU	_mm_loadu_ps
+	#define DXT_STOREU	_mm_storeu_ps
+	#define DXT_ADD	_mm_add_ps
+	#define DXT_SUB	_mm_sub_ps
+	#define DXT_MUL	_mm_mul_ps
+	#define DXT_DIV	_mm_div_ps
+	#define DXT_MIN	_mm_min_ps
+	#define DXT_MAX	_mm_max_ps
+	#define DXT_RECIP_POSITIVE(v) \
+		_mm_or_ps( _mm_and_ps( _mm_cmpgt_ps( v, _mm_setzero_ps() ), _mm_div_ps( _mm_set1_ps( 1.0f ), v ) ), \
+			_mm_andnot_ps( _mm_cmpgt_ps( v, _mm_setzero_ps() ), v ) )
+	#define DXT_CVTT	_mm_cvttps_epi32
+	#define DXT_STOREI(p, v)	_mm_storeu_si128( (__m128i*)(p), v )
+	#include "image_DXT_simd_c.h"
+	#undef DXT_LANES
+	#undef DXT_TARGET
+	#undef DXT_FN
+	#undef DXT_VF
+	#undef DXT_VI
+	#undef DXT_SET1
+	#undef DXT_LOADU
+	#undef DXT_STOREU
+	#undef DXT_ADD
+	#undef DXT_SUB
+	#undef DXT_MUL
+	#undef DXT_DIV
+	#undef DXT_MIN
+	#undef DXT_MAX
+	#undef DXT_RECIP_POSITIVE
+	#undef DXT_CVTT
+	#undef DXT_STOREI
+#endif
+
+#if DXT_HAVE_AVX
+	#define DXT_LANES	8
+	#if defined(__GNUC__) || defined(__clang__)
+		#define DXT_TARGET	__attribute__((target("avx")))
+	#else
+		#define DXT_TARGET
+	#endif
+	#define DXT_FN(name)	name##_AVX
+	#define DXT_VF	__m256
+	#define DXT_VI	__m256i
+	#define DXT_SET1	_mm256_set1_ps
+	#define DXT_LOADU	_mm256_loadu_ps
+	#define DXT_STOREU	_mm256_storeu_ps
+	#define DXT_ADD	_mm256_add_ps
+	#define DXT_SUB	_mm256_sub_ps
+	#define DXT_MUL	_mm256_mul_ps
+	#define DXT_DIV	_mm256_div_ps
+	#define DXT_MIN	_mm256_min_ps
+	#define DXT_MAX	_mm256_max_ps
+	#define DXT_RECIP_POSITIVE(v) \
+		_mm256_blendv_ps( v, _mm256_div_ps( _mm256_set1_ps( 1.0f ), v ), _mm256_cmp_ps( v, _mm256_setzero_ps(), _CMP_GT_OQ ) )
+	#define DXT_CVTT	_mm256_cvttps_epi32
+	#define DXT_STOREI(p, v)	_mm256_storeu_si256( (__m256i*)(p), v )
+	#include "image_DXT_simd_c.h"
+	#undef DXT_LANES
+	#undef DXT_TARGET
+	#undef DXT_FN
+	#undef DXT_VF
+	#undef DXT_VI
+	#undef DXT_SET1
+	#undef DXT_LOADU
+	#undef DXT_STOREU
+	#undef DXT_ADD
+	#undef DXT_SUB
+	#undef DXT_MUL
+	#undef DXT_DIV
+	#undef DXT_MIN
+	#undef DXT_MAX
+	#undef DXT_RECIP_POSITIVE
+	#undef DXT_CVTT
+	#undef DXT_STOREI
+#endif
+
+static int best_DXT_compressor( void )
+{
+#if DXT_HAVE_AVX
+	#if defined(_MSC_VER)
+	/*	the CPU has AVX and the OS saves the YMM registers	*/
+	int info[4];
+	__cpuid( info, 1 );
+	if( (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv( 0 ) & 6) == 6 )
+	{
+		return DXT_COMPRESSOR_AVX;
+	}
+	#else
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx" ) )
+	{
+		return DXT_COMPRESSOR_AVX;
+	}
+	#endif
+#endif
+#if DXT_HAVE_SSE2
+	return DXT_COMPRESSOR_SSE2;
+#else
+	return DXT_COMPRESSOR_SCALAR;
+#endif
+}
+
+static void compress_DDS_color_blocks(
+		int channels,
+		const unsigned char *const uncompressed,
+		int count,
+		unsigned char *compressed, int stride )
+{
+	int compressor = get_DXT_compressor();
+	int k = 0;
+#if DXT_HAVE_AVX
+	if( compressor >= DXT_COMPRESSOR_AVX )
+	{
+		for( ; k + 8 <= count; k += 8 )
+		{
+			compress_DDS_color_blocks_AVX( channels, uncompressed + k*16*channels, compressed + k*stride, stride );
+		}
+	}
+#endif
+#if DXT_HAVE_SSE2
+	if( compressor >= DXT_COMPRESSOR_SSE2 )
+	{
+		for( ; k + 4 <= count; k += 4 )
+		{
+			compress_DDS_color_blocks_SSE2( channels, uncompressed + k*16*channels, compressed + k*stride, stride );
+		}
+	}
+#endif
+	for( ; k < count; ++k )
+	{
+		compress_DDS_color_block( channels, uncompressed + k*16*channels, compressed + k*stride );
+	}
+	(void)compressor;
+}
+
+static void compress_DDS_alpha_blocks(
+		const unsigned char *const uncompressed,
+		int count,
+		unsigned char *compressed, int stride )
+{
+	int compressor = get_DXT_compressor();
+	int k = 0;
+#if DXT_HAVE_AVX
+	if( compressor >= DXT_COMPRESSOR_AVX )
+	{
+		for( ; k + 8 <= count; k += 8 )
+		{
+			compress_DDS_alpha_blocks_AVX( uncompressed + k*16*4, compressed + k*stride, stride );
+		}
+	}
+#endif
+#if DXT_HAVE_SSE2
+	if( compressor >= DXT_COMPRESSOR_SSE2 )
+	{
+		for( ; k + 4 <= count; k += 4 )
+		{
+			compress_DDS_alpha_blocks_SSE2( uncompressed + k*16*4, compressed + k*stride, stride );
+		}
+	}
+#endif
+	for( ; k < count; ++k )
+	{
+		compress_DDS_alpha_block( uncompressed + k*16*4, compressed + k*stride );
+	}
+	(void)compressor;
+}
@@ -10,6 +10,10 @@
 #ifndef HEADER_IMAGE_DXT
 #define HEADER_IMAGE_DXT
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
 	Converts an image from an array of unsigned chars (RGB or RGBA) to
 	DXT1 or DXT5, then saves the converted image to disk.
@@ -45,6 +49,55 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	Compresses the block rows [first_block_row, first_block_row + block_rows)
+	of an image (a block row is 4 pixel rows) into compressed, which holds
+	the whole image: ((width+3)/4) * ((height+3)/4) blocks of 8 bytes for
+	DXT1, 16 for DXT5.  Separate ranges of rows can be compressed by
+	separate threads at the same time.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+convert_image_rows_to_DXT1
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int first_block_row, int block_rows,
+    unsigned char *compressed
+);
+
+int
+convert_image_rows_to_DXT5
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int first_block_row, int block_rows,
+    unsigned char *compressed
+);
+
+/**
+	The block compressors the functions above can use.  The SIMD ones
+	compress several blocks at once (SSE2 4, AVX 8) with the very same
+	float math, so all of them give bit-identical output.
+**/
+#define DXT_COMPRESSOR_SCALAR	0
+#define DXT_COMPRESSOR_SSE2	1
+#define DXT_COMPRESSOR_AVX	2
+
+/**
+	The compressor in use: the best one the CPU supports,
+	unless set_DXT_compressor asked for a lesser one.
+**/
+int
+get_DXT_compressor( void );
+
+/**
+	Uses compressor, or the best supported one below it.
+	\return the compressor now in use
+**/
+int
+set_DXT_compressor( int compressor );
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -120,4 +173,8 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* HEADER_IMAGE_DXT	*/
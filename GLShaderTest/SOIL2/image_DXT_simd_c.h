@@ -0,0 +1,239 @@
+/*
+	SIMD block compressors for image_DXT.c, included once per instruction set.
+
+	Every lane compresses its own 4x4 block and does exactly the float
+	operations of compress_DDS_color_block / compress_DDS_alpha_block,
+	in the same order, so the result is bit-identical to the scalar path.
+	(That holds as long as the compiler doesn't fuse multiply-adds, i.e.
+	no -ffp-contract=fast together with FMA code generation.)
+
+	The includer defines:
+		DXT_LANES			blocks per call
+		DXT_TARGET			function attribute enabling the instruction set
+		DXT_FN(name)		name of this instruction set's version
+		DXT_VF, DXT_VI		float / int vector types
+		DXT_SET1, DXT_LOADU, DXT_STOREU, DXT_ADD, DXT_SUB, DXT_MUL, DXT_DIV,
+		DXT_MIN, DXT_MAX	float vector operations
+		DXT_RECIP_POSITIVE	v > 0 ? 1 / v : v
+		DXT_CVTT, DXT_STOREI	truncate to int / store an int vector
+
+	public domain
+*/
+
+/*
+	Compresses DXT_LANES color blocks, block k being the 16 pixels of
+	channels bytes at uncompressed + k*16*channels, into the 8 bytes at
+	compressed + k*stride.
+*/
+static DXT_TARGET void DXT_FN(compress_DDS_color_blocks)(
+				int channels,
+				const unsigned char *const uncompressed,
+				unsigned char *compressed, int stride )
+{
+	DXT_VF r[16], g[16], b[16];
+	DXT_VF sum_r, sum_g, sum_b, sum_rr, sum_gg, sum_bb, sum_rg, sum_rb, sum_gb;
+	DXT_VF dir_r, dir_g, dir_b, x, y, z;
+	DXT_VF vec_len2, dot, dot_min, dot_max, half, sixteen;
+	DXT_VF line_r, line_g, line_b, dot_offset;
+	float lane[3][DXT_LANES];
+	int c0[3][DXT_LANES], c1[3][DXT_LANES];
+	int values[16][DXT_LANES];
+	int i, k;
+	/*	stupid order	*/
+	static const int swizzle4[] = { 0, 2, 3, 1 };
+
+	/*	one vector per pixel and channel, lane k from block k	*/
+	for( i = 0; i < 16; ++i )
+	{
+		for( k = 0; k < DXT_LANES; ++k )
+		{
+			const unsigned char *pixel = uncompressed + (k*16 + i)*channels;
+			lane[0][k] = pixel[0];
+			lane[1][k] = pixel[1];
+			lane[2][k] = pixel[2];
+		}
+		r[i] = DXT_LOADU( lane[0] );
+		g[i] = DXT_LOADU( lane[1] );
+		b[i] = DXT_LOADU( lane[2] );
+	}
+
+	/*	compute_color_line_STDEV: the covariance matrix	*/
+	sum_r = sum_g = sum_b = DXT_SET1( 0.0f );
+	sum_rr = sum_gg = sum_bb = sum_rg = sum_rb = sum_gb = DXT_SET1( 0.0f );
+	for( i = 0; i < 16; ++i )
+	{
+		sum_r = DXT_ADD( sum_r, r[i] );
+		sum_rr = DXT_ADD( sum_rr, DXT_MUL( r[i], r[i] ) );
+		sum_g = DXT_ADD( sum_g, g[i] );
+		sum_gg = DXT_ADD( sum_gg, DXT_MUL( g[i], g[i] ) );
+		sum_b = DXT_ADD( sum_b, b[i] );
+		sum_bb = DXT_ADD( sum_bb, DXT_MUL( b[i], b[i] ) );
+		sum_rg = DXT_ADD( sum_rg, DXT_MUL( r[i], g[i] ) );
+		sum_rb = DXT_ADD( sum_rb, DXT_MUL( r[i], b[i] ) );
+		sum_gb = DXT_ADD( sum_gb, DXT_MUL( g[i], b[i] ) );
+	}
+	sum_r = DXT_MUL( sum_r, DXT_SET1( 1.0f / 16.0f ) );
+	sum_g = DXT_MUL( sum_g, DXT_SET1( 1.0f / 16.0f ) );
+	sum_b = DXT_MUL( sum_b, DXT_SET1( 1.0f / 16.0f ) );
+	sixteen = DXT_SET1( 16.0f );
+	sum_rr = DXT_SUB( sum_rr, DXT_MUL( DXT_MUL( sixteen, sum_r ), sum_r ) );
+	sum_gg = DXT_SUB( sum_gg, DXT_MUL( DXT_MUL( sixteen, sum_g ), sum_g ) );
+	sum_bb = DXT_SUB( sum_bb, DXT_MUL( DXT_MUL( sixteen, sum_b ), sum_b ) );
+	sum_rg = DXT_SUB( sum_rg, DXT_MUL( DXT_MUL( sixteen, sum_r ), sum_g ) );
+	sum_rb = DXT_SUB( sum_rb, DXT_MUL( DXT_MUL( sixteen, sum_r ), sum_b ) );
+	sum_gb = DXT_SUB( sum_gb, DXT_MUL( DXT_MUL( sixteen, sum_g ), sum_b ) );
+	/*	3 iterations of the power method	*/
+	x = DXT_SET1( 1.0f );
+	y = DXT_SET1( 2.718281828f );
+	z = DXT_SET1( 3.141592654f );
+	for( i = 0; i < 3; ++i )
+	{
+		dir_r = DXT_ADD( DXT_ADD( DXT_MUL( x, sum_rr ), DXT_MUL( y, sum_rg ) ), DXT_MUL( z, sum_rb ) );
+		dir_g = DXT_ADD( DXT_ADD( DXT_MUL( x, sum_rg ), DXT_MUL( y, sum_gg ) ), DXT_MUL( z, sum_gb ) );
+		dir_b = DXT_ADD( DXT_ADD( DXT_MUL( x, sum_rb ), DXT_MUL( y, sum_gb ) ), DXT_MUL( z, sum_bb ) );
+		x = dir_r;
+		y = dir_g;
+		z = dir_b;
+	}
+
+	/*	LSE_master_colors_max_min: the extent of the block along the line	*/
+	vec_len2 = DXT_DIV( DXT_SET1( 1.0f ), DXT_ADD( DXT_ADD( DXT_ADD( DXT_SET1( 0.00001f ),
+		DXT_MUL( dir_r, dir_r ) ), DXT_MUL( dir_g, dir_g ) ), DXT_MUL( dir_b, dir_b ) ) );
+	dot_min = dot_max = DXT_ADD( DXT_ADD( DXT_MUL( dir_r, r[0] ), DXT_MUL( dir_g, g[0] ) ), DXT_MUL( dir_b, b[0] ) );
+	for( i = 1; i < 16; ++i )
+	{
+		dot = DXT_ADD( DXT_ADD( DXT_MUL( dir_r, r[i] ), DXT_MUL( dir_g, g[i] ) ), DXT_MUL( dir_b, b[i] ) );
+		dot_min = DXT_MIN( dot_min, dot );
+		dot_max = DXT_MAX( dot_max, dot );
+	}
+	dot = DXT_ADD( DXT_ADD( DXT_MUL( dir_r, sum_r ), DXT_MUL( dir_g, sum_g ) ), DXT_MUL( dir_b, sum_b ) );
+	dot_min = DXT_MUL( DXT_SUB( dot_min, dot ), vec_len2 );
+	dot_max = DXT_MUL( DXT_SUB( dot_max, dot ), vec_len2 );
+	/*	the master colors, clamping before the truncation gives the same as clamping after it	*/
+	half = DXT_SET1( 0.5f );
+	#define DXT_MASTER(out, point, dir, extent) \
+		DXT_STOREI( out, DXT_CVTT( DXT_MIN( DXT_MAX( DXT_ADD( DXT_ADD( half, point ), DXT_MUL( extent, dir ) ), \
+			DXT_SET1( 0.0f ) ), DXT_SET1( 255.0f ) ) ) )
+	DXT_MASTER( c0[0], sum_r, dir_r, dot_max );
+	DXT_MASTER( c0[1], sum_g, dir_g, dot_max );
+	DXT_MASTER( c0[2], sum_b, dir_b, dot_max );
+	DXT_MASTER( c1[0], sum_r, dir_r, dot_min );
+	DXT_MASTER( c1[1], sum_g, dir_g, dot_min );
+	DXT_MASTER( c1[2], sum_b, dir_b, dot_min );
+	#undef DXT_MASTER
+
+	/*	compress_DDS_color_block: store the 565 colors, and the colors they stand for	*/
+	for( k = 0; k < DXT_LANES; ++k )
+	{
+		unsigned char *block = compressed + k*stride;
+		int enc_c0, enc_c1, cr, cg, cb;
+		i = rgb_to_565( c0[0][k], c0[1][k], c0[2][k] );
+		enc_c1 = rgb_to_565( c1[0][k], c1[1][k], c1[2][k] );
+		enc_c0 = i > enc_c1 ? i : enc_c1;
+		enc_c1 = i > enc_c1 ? enc_c1 : i;
+		block[0] = (enc_c0 >> 0) & 255;
+		block[1] = (enc_c0 >> 8) & 255;
+		block[2] = (enc_c1 >> 0) & 255;
+		block[3] = (enc_c1 >> 8) & 255;
+		rgb_888_from_565( enc_c0, &c0[0][k], &c0[1][k], &c0[2][k] );
+		rgb_888_from_565( enc_c1, &cr, &cg, &cb );
+		lane[0][k] = (float)(cr - c0[0][k]);
+		lane[1][k] = (float)(cg - c0[1][k]);
+		lane[2][k] = (float)(cb - c0[2][k]);
+	}
+	line_r = DXT_LOADU( lane[0] );
+	line_g = DXT_LOADU( lane[1] );
+	line_b = DXT_LOADU( lane[2] );
+	vec_len2 = DXT_ADD( DXT_ADD( DXT_ADD( DXT_SET1( 0.0f ), DXT_MUL( line_r, line_r ) ), DXT_MUL( line_g, line_g ) ), DXT_MUL( line_b, line_b ) );
+	vec_len2 = DXT_RECIP_POSITIVE( vec_len2 );
+	line_r = DXT_MUL( line_r, vec_len2 );
+	line_g = DXT_MUL( line_g, vec_len2 );
+	line_b = DXT_MUL( line_b, vec_len2 );
+	for( k = 0; k < DXT_LANES; ++k )
+	{
+		lane[0][k] = (float)c0[0][k];
+		lane[1][k] = (float)c0[1][k];
+		lane[2][k] = (float)c0[2][k];
+	}
+	dot_offset = DXT_ADD( DXT_ADD( DXT_MUL( line_r, DXT_LOADU( lane[0] ) ), DXT_MUL( line_g, DXT_LOADU( lane[1] ) ) ),
+		DXT_MUL( line_b, DXT_LOADU( lane[2] ) ) );
+	/*	place every pixel on the line, mapped to [0,3]	*/
+	for( i = 0; i < 16; ++i )
+	{
+		dot = DXT_SUB( DXT_ADD( DXT_ADD( DXT_MUL( line_r, r[i] ), DXT_MUL( line_g, g[i] ) ), DXT_MUL( line_b, b[i] ) ), dot_offset );
+		dot = DXT_ADD( DXT_MUL( dot, DXT_SET1( 3.0f ) ), half );
+		DXT_STOREI( values[i], DXT_CVTT( DXT_MAX( DXT_MIN( dot, DXT_SET1( 3.0f ) ), DXT_SET1( 0.0f ) ) ) );
+	}
+	for( k = 0; k < DXT_LANES; ++k )
+	{
+		unsigned char *block = compressed + k*stride;
+		unsigned int bits = 0;
+		for( i = 0; i < 16; ++i )
+		{
+			bits |= (unsigned int)swizzle4[ values[i][k] ] << (2*i);
+		}
+		block[4] = (bits >> 0) & 255;
+		block[5] = (bits >> 8) & 255;
+		block[6] = (bits >> 16) & 255;
+		block[7] = (bits >> 24) & 255;
+	}
+}
+
+/*
+	Compresses the alpha of DXT_LANES RGBA blocks, block k being the 16
+	pixels at uncompressed + k*64, into the 8 bytes at compressed + k*stride.
+*/
+static DXT_TARGET void DXT_FN(compress_DDS_alpha_blocks)(
+				const unsigned char *const uncompressed,
+				unsigned char *compressed, int stride )
+{
+	DXT_VF a[16], a0, a1, scale_me;
+	float lane[2][DXT_LANES];
+	int values[16][DXT_LANES];
+	int i, k;
+	/*	stupid order	*/
+	static const int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+	for( i = 0; i < 16; ++i )
+	{
+		for( k = 0; k < DXT_LANES; ++k )
+		{
+			lane[0][k] = uncompressed[(k*16 + i)*4 + 3];
+		}
+		a[i] = DXT_LOADU( lane[0] );
+	}
+	/*	the alpha limits (a0 > a1)	*/
+	a0 = a1 = a[0];
+	for( i = 1; i < 16; ++i )
+	{
+		a0 = DXT_MAX( a0, a[i] );
+		a1 = DXT_MIN( a1, a[i] );
+	}
+	/*	a flat block divides by 0, like the scalar code it ends up with index 0	*/
+	scale_me = DXT_DIV( DXT_SET1( 7.9999f ), DXT_SUB( a0, a1 ) );
+	for( i = 0; i < 16; ++i )
+	{
+		DXT_STOREI( values[i], DXT_CVTT( DXT_MUL( DXT_SUB( a[i], a1 ), scale_me ) ) );
+	}
+	DXT_STOREU( lane[0], a0 );
+	DXT_STOREU( lane[1], a1 );
+	for( k = 0; k < DXT_LANES; ++k )
+	{
+		unsigned char *block = compressed + k*stride;
+		int next_bit = 8*2;
+		block[0] = (unsigned char)lane[0][k];
+		block[1] = (unsigned char)lane[1][k];
+		block[2] = block[3] = block[4] = block[5] = block[6] = block[7] = 0;
+		for( i = 0; i < 16; ++i )
+		{
+			int svalue = swizzle8[ values[i][k] & 7 ];
+			block[next_bit >> 3] |= svalue << (next_bit & 7);
+			if( (next_bit & 7) > 5 )
+			{
+				/*	spans 2 bytes, fill in the start of the 2nd byte	*/
+				block[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7) );
+			}
+			next_bit += 3;
+		}
+	}
+}
@@ -10,6 +10,91 @@
 #include <stdlib.h>
 #include <math.h>
 
+/*	SSE2 is part of every x86-64 CPU, the 2x2 MIPmap filter uses it when the
+	compiler targets it	*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define MIPMAP_HAVE_SSE2 1
+	#include <emmintrin.h>
+#endif
+
+/*	8 bit sRGB to linear, scaled to [0,65535]	*/
+static const unsigned short sRGB_to_linear16[256] =
+{
+	0, 20, 40, 60, 80, 99, 119, 139, 159, 179, 199, 219,
+	241, 264, 288, 313, 340, 367, 396, 427, 458, 491, 526, 562,
+	599, 637, 677, 718, 761, 805, 851, 898, 947, 997, 1048, 1101,
+	1156, 1212, 1270, 1330, 1391, 1453, 1517, 1583, 1651, 1720, 1790, 1863,
+	1937, 2013, 2090, 2170, 2250, 2333, 2418, 2504, 2592, 2681, 2773, 2866,
+	2961, 3058, 3157, 3258, 3360, 3464, 3570, 3678, 3788, 3900, 4014, 4129,
+	4247, 4366, 4488, 4611, 4736, 4864, 4993, 5124, 5257, 5392, 5530, 5669,
+	5810, 5953, 6099, 6246, 6395, 6547, 6700, 6856, 7014, 7174, 7335, 7500,
+	7666, 7834, 8004, 8177, 8352, 8528, 8708, 8889, 9072, 9258, 9445, 9635,
+	9828, 10022, 10219, 10417, 10619, 10822, 11028, 11235, 11446, 11658, 11873, 12090,
+	12309, 12530, 12754, 12980, 13209, 13440, 13673, 13909, 14146, 14387, 14629, 14874,
+	15122, 15371, 15623, 15878, 16135, 16394, 16656, 16920, 17187, 17456, 17727, 18001,
+	18277, 18556, 18837, 19121, 19407, 19696, 19987, 20281, 20577, 20876, 21177, 21481,
+	21787, 22096, 22407, 22721, 23038, 23357, 23678, 24002, 24329, 24658, 24990, 25325,
+	25662, 26001, 26344, 26688, 27036, 27386, 27739, 28094, 28452, 28813, 29176, 29542,
+	29911, 30282, 30656, 31033, 31412, 31794, 32179, 32567, 32957, 33350, 33745, 34143,
+	34544, 34948, 35355, 35764, 36176, 36591, 37008, 37429, 37852, 38278, 38706, 39138,
+	39572, 40009, 40449, 40891, 41337, 41785, 42236, 42690, 43147, 43606, 44069, 44534,
+	45002, 45473, 45947, 46423, 46903, 47385, 47871, 48359, 48850, 49344, 49841, 50341,
+	50844, 51349, 51858, 52369, 52884, 53401, 53921, 54445, 54971, 55500, 56032, 56567,
+	57105, 57646, 58190, 58737, 59287, 59840, 60396, 60955, 61517, 62082, 62650, 63221,
+	63795, 64372, 64952, 65535
+};
+
+/*	linear16_sRGB_rounding[k] is the smallest linear value (as above) that
+	rounds to sRGB k+1 rather than k, so the sRGB value of a linear one is the
+	number of entries not above it	*/
+static const unsigned short linear16_sRGB_rounding[255] =
+{
+	10, 30, 50, 70, 90, 110, 130, 150, 170, 189, 209, 230,
+	253, 276, 301, 327, 354, 382, 412, 443, 475, 509, 544, 580,
+	618, 657, 698, 740, 783, 828, 875, 923, 972, 1023, 1075, 1129,
+	1185, 1242, 1300, 1360, 1422, 1486, 1551, 1617, 1685, 1755, 1827, 1900,
+	1975, 2052, 2130, 2210, 2292, 2376, 2461, 2548, 2637, 2727, 2820, 2914,
+	3010, 3108, 3208, 3309, 3412, 3518, 3625, 3734, 3844, 3957, 4072, 4188,
+	4307, 4427, 4550, 4674, 4800, 4928, 5059, 5191, 5325, 5461, 5599, 5740,
+	5882, 6026, 6173, 6321, 6471, 6624, 6778, 6935, 7094, 7255, 7418, 7583,
+	7750, 7919, 8091, 8265, 8440, 8618, 8798, 8981, 9165, 9352, 9541, 9732,
+	9925, 10121, 10318, 10518, 10720, 10925, 11132, 11341, 11552, 11765, 11981, 12199,
+	12420, 12643, 12868, 13095, 13325, 13557, 13791, 14028, 14267, 14508, 14752, 14998,
+	15247, 15498, 15751, 16007, 16265, 16525, 16788, 17054, 17321, 17592, 17864, 18139,
+	18417, 18697, 18980, 19264, 19552, 19842, 20134, 20429, 20727, 21027, 21329, 21634,
+	21942, 22252, 22564, 22880, 23197, 23518, 23840, 24166, 24494, 24824, 25158, 25493,
+	25832, 26173, 26516, 26862, 27211, 27563, 27917, 28273, 28633, 28995, 29359, 29727,
+	30097, 30469, 30845, 31223, 31603, 31987, 32373, 32762, 33153, 33547, 33944, 34344,
+	34747, 35152, 35560, 35970, 36384, 36800, 37219, 37640, 38065, 38492, 38922, 39355,
+	39790, 40229, 40670, 41114, 41561, 42011, 42463, 42918, 43377, 43838, 44301, 44768,
+	45238, 45710, 46185, 46663, 47144, 47628, 48115, 48605, 49097, 49593, 50091, 50592,
+	51096, 51604, 52114, 52627, 53142, 53661, 54183, 54708, 55235, 55766, 56300, 56836,
+	57376, 57918, 58464, 59012, 59564, 60118, 60675, 61236, 61799, 62366, 62935, 63508,
+	64083, 64662, 65244
+};
+
+/*	the sRGB value of linear value 256*i (as above), where the search
+	for the sRGB value of any linear one in [256*i, 256*i+255] starts	*/
+static const unsigned char linear16_sRGB_start[256] =
+{
+	0, 13, 22, 28, 34, 38, 42, 46, 49, 53, 56, 58, 61, 64, 66, 68,
+	71, 73, 75, 77, 79, 81, 83, 85, 86, 88, 90, 91, 93, 95, 96, 98,
+	99, 101, 102, 103, 105, 106, 107, 109, 110, 111, 113, 114, 115, 116, 118, 119,
+	120, 121, 122, 123, 124, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136,
+	137, 138, 139, 140, 141, 142, 143, 144, 145, 145, 146, 147, 148, 149, 150, 151,
+	152, 153, 153, 154, 155, 156, 157, 158, 158, 159, 160, 161, 162, 162, 163, 164,
+	165, 166, 166, 167, 168, 169, 169, 170, 171, 172, 172, 173, 174, 174, 175, 176,
+	177, 177, 178, 179, 179, 180, 181, 181, 182, 183, 184, 184, 185, 186, 186, 187,
+	188, 188, 189, 189, 190, 191, 191, 192, 193, 193, 194, 195, 195, 196, 196, 197,
+	198, 198, 199, 199, 200, 201, 201, 202, 202, 203, 204, 204, 205, 205, 206, 207,
+	207, 208, 208, 209, 209, 210, 211, 211, 212, 212, 213, 213, 214, 214, 215, 216,
+	216, 217, 217, 218, 218, 219, 219, 220, 220, 221, 221, 222, 223, 223, 224, 224,
+	225, 225, 226, 226, 227, 227, 228, 228, 229, 229, 230, 230, 231, 231, 232, 232,
+	233, 233, 234, 234, 235, 235, 236, 236, 237, 237, 238, 238, 239, 239, 239, 240,
+	240, 241, 241, 242, 242, 243, 243, 244, 244, 245, 245, 246, 246, 246, 247, 247,
+	248, 248, 249, 249, 250, 250, 251, 251, 251, 252, 252, 253, 253, 254, 254, 255
+};
+
 /*	Upscaling the image uses simple bilinear interpolation	*/
 int
 	up_scale_image
@@ -151,6 +236,157 @@ int
 	return 1;
 }
 
+static int
+	linear16_to_sRGB
+	(
+		int linear
+	)
+{
+	int value = linear16_sRGB_start[linear >> 8];
+	while( (value < 255) && (linear16_sRGB_rounding[value] <= linear) )
+	{
+		++value;
+	}
+	return value;
+}
+
+int
+	mipmap_image_half_rows
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int first_row, int rows,
+		int srgb
+	)
+{
+	int mip_width, mip_height;
+	int row_bytes, color_channels;
+	int i, j, c;
+	unsigned short *sums = NULL;
+
+	/*	error check	*/
+	if( (width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) || (orig == NULL) ||
+		(resampled == NULL) || (first_row < 0) || (rows < 0) )
+	{
+		/*	nothing to do	*/
+		return 0;
+	}
+	mip_width = (width > 1) ? width / 2 : 1;
+	mip_height = (height > 1) ? height / 2 : 1;
+	if( first_row + rows > mip_height )
+	{
+		return 0;
+	}
+	row_bytes = width * channels;
+	/*	with an alpha channel (2 or 4 channels) it's the last one	*/
+	color_channels = ((channels & 1) == 0) ? channels - 1 : channels;
+	if( !srgb && (channels != 4 || width == 1) )
+	{
+		/*	the two source rows are summed first, then neighbouring pixels	*/
+		sums = (unsigned short*)malloc( row_bytes * sizeof(unsigned short) );
+		if( sums == NULL )
+		{
+			return 0;
+		}
+	}
+	for( j = first_row; j < first_row + rows; ++j )
+	{
+		/*	a 1 pixel high (or wide) image reuses its only row (or column)	*/
+		const unsigned char *row0 = orig + (2 * j) * row_bytes;
+		const unsigned char *row1 = (height > 1) ? row0 + row_bytes : row0;
+		unsigned char *out = resampled + j * mip_width * channels;
+		int right = (width > 1) ? channels : 0;
+		if( srgb )
+		{
+			/*	average the colors in linear space	*/
+			for( i = 0; i < mip_width; ++i )
+			{
+				const unsigned char *a = row0 + 2 * i * channels;
+				const unsigned char *b = row1 + 2 * i * channels;
+				for( c = 0; c < color_channels; ++c )
+				{
+					int linear = sRGB_to_linear16[a[c]] + sRGB_to_linear16[a[c + right]] +
+						sRGB_to_linear16[b[c]] + sRGB_to_linear16[b[c + right]];
+					out[i * channels + c] = (unsigned char)linear16_to_sRGB( (linear + 2) >> 2 );
+				}
+				if( color_channels < channels )
+				{
+					out[i * channels + c] = (unsigned char)((a[c] + a[c + right] + b[c] + b[c + right] + 2) >> 2);
+				}
+			}
+		} else if( sums == NULL )
+		{
+			/*	RGBA: 4 source pixels of both rows give 2 pixels of the level	*/
+			i = 0;
+#ifdef MIPMAP_HAVE_SSE2
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i two = _mm_set1_epi16( 2 );
+				for( ; i + 4 <= mip_width; i += 4 )
+				{
+					__m128i a0 = _mm_loadu_si128( (const __m128i*)(row0 + i * 8) );
+					__m128i a1 = _mm_loadu_si128( (const __m128i*)(row0 + i * 8 + 16) );
+					__m128i b0 = _mm_loadu_si128( (const __m128i*)(row1 + i * 8) );
+					__m128i b1 = _mm_loadu_si128( (const __m128i*)(row1 + i * 8 + 16) );
+					/*	pixels 0,1 and 2,3 of each group, both rows added	*/
+					__m128i low0 = _mm_add_epi16( _mm_unpacklo_epi8( a0, zero ), _mm_unpacklo_epi8( b0, zero ) );
+					__m128i high0 = _mm_add_epi16( _mm_unpackhi_epi8( a0, zero ), _mm_unpackhi_epi8( b0, zero ) );
+					__m128i low1 = _mm_add_epi16( _mm_unpacklo_epi8( a1, zero ), _mm_unpacklo_epi8( b1, zero ) );
+					__m128i high1 = _mm_add_epi16( _mm_unpackhi_epi8( a1, zero ), _mm_unpackhi_epi8( b1, zero ) );
+					/*	then the left pixel of each pair to the right one	*/
+					__m128i sum0 = _mm_add_epi16( _mm_unpacklo_epi64( low0, high0 ), _mm_unpackhi_epi64( low0, high0 ) );
+					__m128i sum1 = _mm_add_epi16( _mm_unpacklo_epi64( low1, high1 ), _mm_unpackhi_epi64( low1, high1 ) );
+					sum0 = _mm_srli_epi16( _mm_add_epi16( sum0, two ), 2 );
+					sum1 = _mm_srli_epi16( _mm_add_epi16( sum1, two ), 2 );
+					_mm_storeu_si128( (__m128i*)(out + i * 4), _mm_packus_epi16( sum0, sum1 ) );
+				}
+			}
+#endif
+			for( ; i < mip_width; ++i )
+			{
+				for( c = 0; c < 4; ++c )
+				{
+					out[i * 4 + c] = (unsigned char)((row0[i * 8 + c] + row0[i * 8 + 4 + c] +
+						row1[i * 8 + c] + row1[i * 8 + 4 + c] + 2) >> 2);
+				}
+			}
+		} else
+		{
+			int used = (width > 1) ? mip_width * 2 * channels : channels;
+			i = 0;
+#ifdef MIPMAP_HAVE_SSE2
+			{
+				const __m128i zero = _mm_setzero_si128();
+				for( ; i + 16 <= used; i += 16 )
+				{
+					__m128i a = _mm_loadu_si128( (const __m128i*)(row0 + i) );
+					__m128i b = _mm_loadu_si128( (const __m128i*)(row1 + i) );
+					_mm_storeu_si128( (__m128i*)(sums + i),
+						_mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ) );
+					_mm_storeu_si128( (__m128i*)(sums + i + 8),
+						_mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ) );
+				}
+			}
+#endif
+			for( ; i < used; ++i )
+			{
+				sums[i] = (unsigned short)(row0[i] + row1[i]);
+			}
+			for( i = 0; i < mip_width * channels; i += channels )
+			{
+				for( c = 0; c < channels; ++c )
+				{
+					out[i + c] = (unsigned char)((sums[2 * i + c] + sums[2 * i + c + right] + 2) >> 2);
+				}
+			}
+		}
+	}
+	free( sums );
+	return 1;
+}
+
 int
 	scale_image_RGB_to_NTSC_safe
 	(
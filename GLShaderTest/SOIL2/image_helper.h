@@ -43,6 +43,27 @@ int
 		int block_size_x, int block_size_y
 	);
 
+/**
+	This function makes the next MIPmap level of an image,
+	each pixel the average of a 2x2 block: the level is
+	max(1,width/2) x max(1,height/2), like OpenGL's.
+	Only the rows first_row to first_row+rows-1 of the level
+	are written, so a level can be split across threads.
+	If srgb is set the color channels are averaged in linear
+	space (alpha, the last channel of 2 and 4 channel images,
+	always is linear).
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	mipmap_image_half_rows
+	(
+		const unsigned char* const orig,
+		int width, int height, int channels,
+		unsigned char* resampled,
+		int first_row, int rows,
+		int srgb
+	);
+
 /**
 	This function takes the RGB components of the image
 	and scales each channel from [0,255] to [16,235].
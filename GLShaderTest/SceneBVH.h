@@ -0,0 +1,134 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include "BVH.h"
+#include "Frustum.h"
+#include "models.h"
+
+#include <cstdint>
+#include <vector>
+
+// A BVH over the world space box of every mesh of the scene objects. It decides which meshes get submitted each
+// frame and which object a mouse click hits. Objects that move call refit() afterwards instead of rebuilding. Meshes
+// with empty bounds (instance groups without instances) are in no box and never visible or picked.
+class SceneBVH
+{
+public:
+	struct Hit {
+		BaseModel *object;
+		size_t mesh;
+		float distance;
+	};
+
+	void build(const std::vector<BaseModel*> &sceneObjects)
+	{
+		objects = sceneObjects;
+		firstPrimitive.clear();
+		primitives.clear();
+		visible.assign(objects.size(), std::vector<uint8_t>());
+		std::vector<Bounds> boxes;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			firstPrimitive.push_back((uint32_t)primitives.size());
+			glm::mat4 model = objects[i]->getModel();
+			size_t meshCount = objects[i]->meshCount();
+			visible[i].assign(meshCount, 1);
+			for (size_t mesh = 0; mesh < meshCount; mesh++)
+			{
+				primitives.push_back(Primitive{ (uint32_t)i, (uint32_t)mesh });
+				boxes.push_back(worldBounds(objects[i], mesh, model));
+			}
+		}
+		bvh.build(boxes);
+	}
+
+	// updates the boxes of an object that moved (or whose instances changed)
+	void refit(BaseModel *object)
+	{
+		refit(object, object->getModel());
+	}
+
+	// the same for an object whose model matrix the caller already has
+	void refit(BaseModel *object, const glm::mat4 &model)
+	{
+		bool inTree = true;
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			if (objects[i] != object)
+				continue;
+			for (size_t mesh = 0; mesh < visible[i].size(); mesh++)
+				inTree = bvh.refit(firstPrimitive[i] + (uint32_t)mesh, worldBounds(object, mesh, model)) && inTree;
+		}
+		// a group that had no instances at build time got some
+		if (!inTree)
+		{
+			std::vector<BaseModel*> sceneObjects = objects;
+			build(sceneObjects);
+		}
+	}
+
+	// works out which meshes of each object are at least partly inside the frustum, returns how many are not
+	size_t cull(const Frustum &frustum)
+	{
+		for (std::vector<uint8_t> &meshes : visible)
+			std::fill(meshes.begin(), meshes.end(), 0);
+		queryResult.clear();
+		bvh.queryFrustum(frustum, queryResult);
+		for (uint32_t primitive : queryResult)
+			visible[primitives[primitive].object][primitives[primitive].mesh] = 1;
+		return primitives.size() - queryResult.size();
+	}
+
+	// per mesh of the object, as of the last cull(); what BaseModel::submit takes as visibleMeshes
+	const uint8_t* visibleMeshes(BaseModel *object) const
+	{
+		for (size_t i = 0; i < objects.size(); i++)
+			if (objects[i] == object)
+				return visible[i].data();
+		return nullptr;
+	}
+
+	// the nearest mesh box in front of origin along direction
+	bool pick(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, Hit &hit) const
+	{
+		uint32_t primitive;
+		float distance;
+		if (!bvh.raycast(origin, glm::normalize(direction), maxDistance, primitive, distance))
+			return false;
+		hit.object = objects[primitives[primitive].object];
+		hit.mesh = primitives[primitive].mesh;
+		hit.distance = distance;
+		return true;
+	}
+
+	const BVH& tree() const { return bvh; }
+
+private:
+	struct Primitive {
+		uint32_t object;
+		uint32_t mesh;
+	};
+
+	std::vector<BaseModel*> objects;
+	std::vector<uint32_t> firstPrimitive;	// per object
+	std::vector<Primitive> primitives;		// per BVH primitive
+	std::vector<std::vector<uint8_t>> visible;	// per object and mesh
+	std::vector<uint32_t> queryResult;
+	BVH bvh;
+
+	static Bounds worldBounds(BaseModel *object, size_t mesh, const glm::mat4 &model)
+	{
+		Bounds local = object->meshBounds(mesh);
+		if (isEmpty(local))
+			return local;
+		glm::vec3 center, extent;
+		transformBounds(local, model, center, extent);
+		Bounds bounds;
+		bounds.min = center - extent;
+		bounds.max = center + extent;
+		return bounds;
+	}
+};
+#endif
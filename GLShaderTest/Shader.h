@@ -4,58 +4,77 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "AssetPackage.h"
+#include "UniformBuffer.h"
+
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// An active uniform of one particular Shader, looked up once with Shader::uniform() so the setters that take it
+// do no string work and no driver lookup. Handles of one shader mean nothing to another (see Shader::serial).
+struct UniformHandle {
+	int index = -1;		// into the shader's uniform table, -1 if the program has no such active uniform
+	bool valid() const { return index >= 0; }
+};
 
 class Shader
 {
 public:
 	unsigned int ID;
+	unsigned int serial;	// unique per Shader object, unlike ID which GL may hand out again
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
 	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
 	{
-		// 1. retrieve the vertex/fragment source code from filePath
+		// 1. retrieve the vertex/fragment source code from filePath, or from the asset package if it has them all
 		std::string vertexCode;
 		std::string fragmentCode;
 		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream gShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
+		bool packaged = readPackagedText(vertexPath, vertexCode) && readPackagedText(fragmentPath, fragmentCode) &&
+			(geometryPath == nullptr || readPackagedText(geometryPath, geometryCode));
+		if (!packaged)
 		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-			// if geometry shader path is present, also load a geometry shader
-			if (geometryPath != nullptr)
+			std::ifstream vShaderFile;
+			std::ifstream fShaderFile;
+			std::ifstream gShaderFile;
+			// ensure ifstream objects can throw exceptions:
+			vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+			try
 			{
-				gShaderFile.open(geometryPath);
-				std::stringstream gShaderStream;
-				gShaderStream << gShaderFile.rdbuf();
-				gShaderFile.close();
-				geometryCode = gShaderStream.str();
+				// open files
+				vShaderFile.open(vertexPath);
+				fShaderFile.open(fragmentPath);
+				std::stringstream vShaderStream, fShaderStream;
+				// read file's buffer contents into streams
+				vShaderStream << vShaderFile.rdbuf();
+				fShaderStream << fShaderFile.rdbuf();
+				// close file handlers
+				vShaderFile.close();
+				fShaderFile.close();
+				// convert stream into string
+				vertexCode = vShaderStream.str();
+				fragmentCode = fShaderStream.str();
+				// if geometry shader path is present, also load a geometry shader
+				if (geometryPath != nullptr)
+				{
+					gShaderFile.open(geometryPath);
+					std::stringstream gShaderStream;
+					gShaderStream << gShaderFile.rdbuf();
+					gShaderFile.close();
+					geometryCode = gShaderStream.str();
+				}
+			}
+			catch (std::ifstream::failure& e)
+			{
+				std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 			}
-		}
-		catch (std::ifstream::failure& e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		}
 		const char* vShaderCode = vertexCode.c_str();
 		const char * fShaderCode = fragmentCode.c_str();
@@ -95,6 +114,9 @@ public:
 		if (geometryPath != nullptr)
 			glDeleteShader(geometry);
 
+		serial = nextSerial()++;
+		reflectUniforms();
+		bindUniformBlocks();
 	}
 	// activate the shader
 	// ------------------------------------------------------------------------
@@ -102,66 +124,238 @@ public:
 	{
 		glUseProgram(ID);
 	}
+	// uniform lookup
+	// ------------------------------------------------------------------------
+	// the handle of an active uniform, for array elements either "name[i]" or just "name" for the first one.
+	// costs a hash lookup, so do it once and keep the handle.
+	UniformHandle uniform(const std::string &name) const
+	{
+		UniformHandle handle;
+		auto it = uniformIndex.find(name);
+		if (it != uniformIndex.end())
+			handle.index = it->second;
+		return handle;
+	}
+	// turns the uniform location cache and the redundant value filter off for every shader, so each set goes to the
+	// driver with a glGetUniformLocation like it used to. only there to compare GL call counts (--no-uniform-cache).
+	static bool& uniformCacheEnabled()
+	{
+		static bool enabled = true;
+		return enabled;
+	}
 	// utility uniform functions
+	// the values last sent are shadowed per uniform, setting the same value again doesn't reach GL.
+	// that only holds as long as the uniforms of this program are never set behind the shader's back.
 	// ------------------------------------------------------------------------
+	void setBool(UniformHandle u, bool value) const
+	{
+		setInt(u, (int)value);
+	}
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		setInt(uniform(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
+	void setInt(UniformHandle u, int value) const
+	{
+		if (changed(u, &value, sizeof(value)))
+			glUniform1i(location(u), value);
+	}
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		setInt(uniform(name), value);
 	}
 	// ------------------------------------------------------------------------
+	void setFloat(UniformHandle u, float value) const
+	{
+		if (changed(u, &value, sizeof(value)))
+			glUniform1f(location(u), value);
+	}
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		setFloat(uniform(name), value);
 	}
 	// ------------------------------------------------------------------------
+	void setVec2(UniformHandle u, const glm::vec2 &value) const
+	{
+		if (changed(u, &value[0], sizeof(value)))
+			glUniform2fv(location(u), 1, &value[0]);
+	}
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		setVec2(uniform(name), value);
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		setVec2(uniform(name), glm::vec2(x, y));
 	}
 	// ------------------------------------------------------------------------
+	void setVec3(UniformHandle u, const glm::vec3 &value) const
+	{
+		if (changed(u, &value[0], sizeof(value)))
+			glUniform3fv(location(u), 1, &value[0]);
+	}
+	void setVec3(UniformHandle u, float x, float y, float z) const
+	{
+		setVec3(u, glm::vec3(x, y, z));
+	}
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		setVec3(uniform(name), value);
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		setVec3(uniform(name), glm::vec3(x, y, z));
 	}
 	// ------------------------------------------------------------------------
+	void setVec4(UniformHandle u, const glm::vec4 &value) const
+	{
+		if (changed(u, &value[0], sizeof(value)))
+			glUniform4fv(location(u), 1, &value[0]);
+	}
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		setVec4(uniform(name), value);
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		setVec4(uniform(name), glm::vec4(x, y, z, w));
 	}
 	// ------------------------------------------------------------------------
+	void setMat2(UniformHandle u, const glm::mat2 &mat) const
+	{
+		if (changed(u, &mat[0][0], sizeof(mat)))
+			glUniformMatrix2fv(location(u), 1, GL_FALSE, &mat[0][0]);
+	}
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat2(uniform(name), mat);
 	}
 	// ------------------------------------------------------------------------
+	void setMat3(UniformHandle u, const glm::mat3 &mat) const
+	{
+		if (changed(u, &mat[0][0], sizeof(mat)))
+			glUniformMatrix3fv(location(u), 1, GL_FALSE, &mat[0][0]);
+	}
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat3(uniform(name), mat);
 	}
 	// ------------------------------------------------------------------------
+	void setMat4(UniformHandle u, const glm::mat4 &mat) const
+	{
+		if (changed(u, &mat[0][0], sizeof(mat)))
+			glUniformMatrix4fv(location(u), 1, GL_FALSE, &mat[0][0]);
+	}
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat4(uniform(name), mat);
 	}
 
 private:
+	// every shadow slot holds up to a mat4
+	static const size_t UNIFORM_SHADOW_SIZE = sizeof(glm::mat4);
+
+	struct UniformInfo {
+		std::string name;
+		GLint location;
+	};
+	std::vector<UniformInfo> uniforms;
+	std::unordered_map<std::string, int> uniformIndex;
+	mutable std::vector<unsigned char> shadow;		// UNIFORM_SHADOW_SIZE bytes per uniform
+	mutable std::vector<bool> shadowValid;			// nothing was set yet, the first set always goes through
+
+	static unsigned int& nextSerial()
+	{
+		static unsigned int serial = 1;
+		return serial;
+	}
+
+	// asks the linked program for its active uniforms once. uniforms in blocks have no location and are left out,
+	// arrays get one entry per element.
+	void reflectUniforms()
+	{
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size = 0;
+			GLenum type;
+			GLsizei length = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+			std::string name(nameBuffer.data(), length);
+			GLint location = glGetUniformLocation(ID, name.c_str());
+			if (location < 0)
+				continue;
+
+			// arrays are reported as "name[0]", elements after the first are found by name
+			size_t bracket = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0 ? name.size() - 3 : std::string::npos;
+			addUniform(name, location);
+			if (bracket != std::string::npos)
+			{
+				std::string base = name.substr(0, bracket);
+				uniformIndex[base] = uniformIndex[name];
+				for (GLint element = 1; element < size; element++)
+				{
+					std::string elementName = base + "[" + std::to_string(element) + "]";
+					addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+				}
+			}
+		}
+		shadow.assign(uniforms.size() * UNIFORM_SHADOW_SIZE, 0);
+		shadowValid.assign(uniforms.size(), false);
+	}
+
+	// connects the shared uniform blocks (UniformBuffer.h) the program declares to their binding points
+	void bindUniformBlocks()
+	{
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		std::vector<GLchar> nameBuffer(maxLength + 1);
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			glGetActiveUniformBlockName(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, nameBuffer.data());
+			int binding = uniformBlockBinding(std::string(nameBuffer.data(), length));
+			if (binding >= 0)
+				glUniformBlockBinding(ID, (GLuint)i, (GLuint)binding);
+		}
+	}
+
+	void addUniform(const std::string &name, GLint location)
+	{
+		UniformInfo info;
+		info.name = name;
+		info.location = location;
+		uniformIndex[name] = (int)uniforms.size();
+		uniforms.push_back(info);
+	}
+
+	GLint location(UniformHandle u) const
+	{
+		if (!uniformCacheEnabled())
+			return glGetUniformLocation(ID, uniforms[u.index].name.c_str());
+		return uniforms[u.index].location;
+	}
+
+	// whether value has to be sent: false for uniforms the program doesn't have, and for the value it already holds
+	bool changed(UniformHandle u, const void *value, size_t size) const
+	{
+		if (!u.valid())
+			return false;
+		if (!uniformCacheEnabled())
+			return true;
+		unsigned char *slot = &shadow[u.index * UNIFORM_SHADOW_SIZE];
+		if (shadowValid[u.index] && memcmp(slot, value, size) == 0)
+			return false;
+		memcpy(slot, value, size);
+		shadowValid[u.index] = true;
+		return true;
+	}
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,309 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// The camera and the ball move in fixed steps of SIM_STEP instead of once per rendered frame, so how far they get and
+// how much the ball rolls no longer depends on the frame rate. The render thread hands each frame's input (and how
+// long the frame took) to submit(); the simulation adds that time to an accumulator and runs as many steps as fit.
+// In live play that happens on a thread of its own: the results come back through a TripleBuffer, so neither side ever
+// waits for the other. The renderer interpolates between the last two steps with the fraction of a step left in the
+// accumulator, which keeps motion smooth when the frame rate and the step rate don't match.
+// The thread is not deterministic: which steps a frame finds published depends on how the two threads are scheduled,
+// so the same input can render different views. Whatever has to be reproducible (headless runs, --record, --replay)
+// steps inline in submit() instead, where every frame shows exactly the steps its input produced.
+// The simulation owns its own Camera and, once started, the ball's movement state; the render thread only reads the
+// published SimState (see apply / ballMatrix).
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "InputRecording.h"
+#include "models.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const float SIM_STEP = 1.0f / 120.0f;
+const float SIM_MAX_FRAME_TIME = 0.25f;	// a longer frame (loading, a breakpoint) is cut to this, so there's no catching up for seconds
+
+// Lock-free hand over of the latest value from one writer thread to one reader thread. Of the three slots one is
+// written, one is read and the third holds the newest finished value; publish and update swap their slot with it.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// the writer's slot, filled before publish()
+	T& back() { return slots[backIndex]; }
+
+	void publish()
+	{
+		backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// takes the newest published value if there is one since the last call, returns whether there was
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_acquire) & FRESH))
+			return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	// the reader's slot
+	const T& front() const { return slots[frontIndex]; }
+
+private:
+	static const unsigned int INDEX = 3, FRESH = 4;
+	T slots[3];
+	std::atomic<unsigned int> middle{ 1 };
+	unsigned int backIndex = 0, frontIndex = 2;
+};
+
+// what the renderer needs of one step
+struct SimState {
+	glm::vec3 cameraPosition;
+	float cameraYaw, cameraPitch, cameraZoom;
+	glm::vec3 ballPosition;
+	float ballAngle;		// degrees about ballAxis
+	glm::vec3 ballAxis;
+};
+
+// the last two steps and how far the time handed in so far got past the later one, in steps
+struct SimFrame {
+	SimState previous, current;
+	float alpha = 0.0f;
+	unsigned long long steps = 0;
+};
+
+// a mouse click and the object it picked. stepping inline the simulation picks it itself from its own camera (see
+// Simulation::pick), on its thread the render thread has to, the scene BVH is refitted there.
+struct SimClick {
+	BaseModel *object;
+	MOUSE_EVENT event;
+};
+
+struct SimInput {
+	FrameInput input;
+	std::vector<SimClick> clicks;	// the render thread's picks of input.clicks, only when the simulation has its thread
+};
+
+// the object a click hits when the camera looks as camera does, NULL for none
+typedef std::function<BaseModel*(const Camera &camera)> SimPicker;
+
+class Simulation
+{
+public:
+	~Simulation()
+	{
+		stop();
+	}
+
+	// takes over from the current state of camera and ball. threaded false runs the steps right in submit(), which
+	// headless runs use so that which steps a frame shows never depends on thread timing, and picks the objects clicks
+	// hit with pick, from the simulation's camera as the frame's input left it.
+	void start(const Camera &camera, Ball *ball, bool threaded, SimPicker pick)
+	{
+		this->camera = camera;
+		this->ball = ball;
+		this->pick = std::move(pick);
+		ball->setOrientation(camera.Front, camera.Right);
+		accumulator = 0.0f;
+		frame = SimFrame();
+		frame.previous = frame.current = capture();
+		publish();
+		frames.update();
+		if (threaded)
+		{
+			stopping = false;
+			thread = std::thread([this] { simulationLoop(); });
+		}
+	}
+
+	// runs the inputs still queued, then joins the thread
+	void stop()
+	{
+		if (!thread.joinable())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+	void submit(SimInput input)
+	{
+		if (!thread.joinable())
+		{
+			advance(input);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			inputs.push_back(std::move(input));
+		}
+		wake.notify_one();
+	}
+
+	// whether the steps run on the simulation's thread, then submit() wants the clicks picked already
+	bool threaded() const { return thread.joinable(); }
+
+	// the newest published steps, on the render thread
+	const SimFrame& latest()
+	{
+		frames.update();
+		return frames.front();
+	}
+
+	// the state between the last two steps of frame
+	static SimState interpolate(const SimFrame &frame)
+	{
+		const SimState &a = frame.previous, &b = frame.current;
+		float t = frame.alpha;
+		SimState state = b;
+		state.cameraPosition = glm::mix(a.cameraPosition, b.cameraPosition, t);
+		state.cameraYaw = a.cameraYaw + (b.cameraYaw - a.cameraYaw) * t;
+		state.cameraPitch = a.cameraPitch + (b.cameraPitch - a.cameraPitch) * t;
+		state.cameraZoom = a.cameraZoom + (b.cameraZoom - a.cameraZoom) * t;
+		state.ballPosition = glm::mix(a.ballPosition, b.ballPosition, t);
+		// the ball turns about a new axis whenever the keys change and wraps its angle at 360, only blend a plain roll
+		if (a.ballAxis == b.ballAxis && std::fabs(b.ballAngle - a.ballAngle) < 180.0f)
+			state.ballAngle = a.ballAngle + (b.ballAngle - a.ballAngle) * t;
+		return state;
+	}
+
+	// puts the render thread's camera where the simulation's is
+	static void apply(const SimState &state, Camera &camera)
+	{
+		camera.SetPose(state.cameraPosition, state.cameraYaw, state.cameraPitch);
+		camera.Zoom = state.cameraZoom;
+	}
+
+	glm::mat4 ballMatrix(const SimState &state) const
+	{
+		return ball->poseMatrix(state.ballPosition, state.ballAngle, state.ballAxis);
+	}
+
+private:
+	Camera camera;
+	Ball *ball = NULL;
+	SimPicker pick;
+	float accumulator = 0.0f;
+	SimFrame frame;		// the newest, copied into the triple buffer by publish
+	TripleBuffer<SimFrame> frames;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<SimInput> inputs;
+	bool stopping = false;
+
+	void simulationLoop()
+	{
+		std::deque<SimInput> batch;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !inputs.empty(); });
+				if (inputs.empty())
+					return;
+				batch.swap(inputs);
+			}
+			for (const SimInput &input : batch)
+				advance(input);
+			batch.clear();
+		}
+	}
+
+	// one rendered frame's worth: the mouse acts once, the held keys in every step the frame's time covers
+	void advance(const SimInput &in)
+	{
+		const FrameInput &input = in.input;
+		if (input.mouseX != 0.0f || input.mouseY != 0.0f)
+			camera.ProcessMouseMovement(input.mouseX, input.mouseY);
+		if (input.scroll != 0.0f)
+			camera.ProcessMouseScroll(input.scroll);
+		std::vector<SimClick> clicks = in.clicks;
+		if (!threaded() && pick)
+		{
+			const MOUSE_EVENT clickEvents[3] = { LCLICK, RCLICK, MCLICK };
+			for (int button = 0; button < 3; button++)
+				for (int i = 0; i < input.clicks[button]; i++)
+					if (BaseModel *object = pick(camera))
+						clicks.push_back(SimClick{ object, clickEvents[button] });
+		}
+		for (const SimClick &click : clicks)
+			click.object->ProcessMouse(click.event);
+		// looking around and clicks act at once, there is nothing to blend them with
+		if (input.mouseX != 0.0f || input.mouseY != 0.0f || input.scroll != 0.0f || !clicks.empty())
+		{
+			SimState now = capture();
+			frame.previous.cameraYaw = now.cameraYaw;
+			frame.previous.cameraPitch = now.cameraPitch;
+			frame.previous.cameraZoom = now.cameraZoom;
+			if (!clicks.empty())
+			{
+				frame.previous.ballPosition = now.ballPosition;
+				frame.previous.ballAngle = now.ballAngle;
+				frame.previous.ballAxis = now.ballAxis;
+			}
+			frame.current = now;
+		}
+
+		accumulator += std::min(std::max(input.deltaTime, 0.0f), SIM_MAX_FRAME_TIME);
+		while (accumulator >= SIM_STEP)
+		{
+			frame.previous = frame.current;
+			step(input.keys);
+			frame.current = capture();
+			accumulator -= SIM_STEP;
+			frame.steps++;
+		}
+		frame.alpha = accumulator / SIM_STEP;
+		publish();
+	}
+
+	void publish()
+	{
+		frames.back() = frame;
+		frames.publish();
+	}
+
+	void step(uint16_t keys)
+	{
+		for (int movement = FORWARD; movement <= DOWN; movement++)
+			if (keys & cameraKey((Movement)movement))
+				camera.ProcessKeyboard((Movement)movement, SIM_STEP);
+		camera.ProcessKeyboard((keys & cameraKey(SHIFT_PRESS)) ? SHIFT_PRESS : SHIFT_RELEASE, SIM_STEP);
+
+		// the ball moves on the street plane, relative to where the camera looks
+		ball->setOrientation(camera.Front, camera.Right);
+		for (int movement = FORWARD; movement <= RIGHT; movement++)
+			if (keys & ballKey((Movement)movement))
+				ball->ProcessKeyboard((Movement)movement, SIM_STEP);
+		// settles the axis the ball rolls about for this step's keys, which drawing a frame used to do
+		ball->getModel();
+	}
+
+	SimState capture() const
+	{
+		SimState state;
+		state.cameraPosition = camera.Position;
+		state.cameraYaw = camera.Yaw;
+		state.cameraPitch = camera.Pitch;
+		state.cameraZoom = camera.Zoom;
+		state.ballPosition = ball->getPosition();
+		state.ballAngle = ball->rotateAngle;
+		state.ballAxis = ball->axis;
+		return state;
+	}
+};
+#endif
@@ -0,0 +1,193 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+// Texture arrays for model materials. Every mesh of the street has a diffuse texture of its own, so drawing it costs a
+// texture bind per mesh even after the render queue sorted by material. At import Model groups the diffuse textures
+// that have the same size into the layers of GL_TEXTURE_2D_ARRAY textures: the meshes of a group all bind the same
+// array on MATERIAL_ARRAY_UNIT and only tell the shader their layer (RenderMaterial::layer, read as materialLayer),
+// their materials share a sort id, and the queue leaves out the binds in between.
+// Arrays rather than an atlas: the street's UVs tile past [0, 1], which a region of an atlas can't repeat, the UVs
+// stay as they are, and the mipmaps of a layer never bleed into its neighbours.
+
+#include <glad/glad.h>
+#include "SOIL2/stb_image.h"
+
+#include "AssetPackage.h"
+#include "Mesh.h"
+#include "TextureUpload.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// the unit a material's array is bound on, materialDiffuse keeps unit 0 so the two samplers never share one
+const unsigned int MATERIAL_ARRAY_UNIT = 1;
+
+// a size shared by fewer textures stays with plain GL_TEXTURE_2Ds
+const size_t TEXTURE_ARRAY_MIN_LAYERS = 2;
+
+struct TextureImageInfo {
+	std::string path;		// as the model names it
+	int width, height;		// 0 if the header couldn't be read
+};
+
+// the textures that become the layers of one array, layer i is paths[i]
+struct TextureArrayGroup {
+	int width, height;
+	std::vector<std::string> paths;
+};
+
+// how well the diffuse textures of a model packed
+struct TextureArrayStats {
+	size_t textures = 0;		// diffuse textures that could go into an array
+	size_t packed = 0;			// of them, now a layer of one
+	size_t arrays = 0;
+	size_t texels = 0, packedTexels = 0;
+
+	// distinct textures a frame drawing every mesh binds, before and after packing
+	size_t bindsBefore() const { return textures; }
+	size_t bindsAfter() const { return textures - packed + arrays; }
+};
+
+inline void printTextureArrayStats(const std::string &model, const TextureArrayStats &stats)
+{
+	if (stats.textures == 0)
+		return;
+	printf("texture arrays: %s: %zu of %zu diffuse textures in %zu arrays (%.1f layers each, %.0f%% of the texels), %zu textures to bind instead of %zu\n",
+		model.c_str(), stats.packed, stats.textures, stats.arrays, stats.arrays ? (double)stats.packed / stats.arrays : 0.0,
+		stats.texels ? 100.0 * stats.packedTexels / stats.texels : 0.0, stats.bindsAfter(), stats.bindsBefore());
+}
+
+// the diffuse textures worth packing: the first diffuse texture of each mesh (the one the shader samples), unless the
+// same file is also used in any other role. meshTextures holds the material textures of every mesh.
+inline std::vector<std::string> packableTextures(const std::vector<std::vector<TextureRef>> &meshTextures)
+{
+	std::map<std::string, bool> packable;
+	for (const std::vector<TextureRef> &textures : meshTextures)
+	{
+		bool firstDiffuse = true;
+		for (const TextureRef &texture : textures)
+		{
+			bool diffuse = firstDiffuse && texture.type == "texture_diffuse";
+			if (texture.type == "texture_diffuse")
+				firstDiffuse = false;
+			auto it = packable.find(texture.path);
+			if (it == packable.end())
+				packable[texture.path] = diffuse;
+			else
+				it->second = it->second && diffuse;
+		}
+	}
+	std::vector<std::string> paths;
+	for (const auto &entry : packable)
+		if (entry.second)
+			paths.push_back(entry.first);
+	return paths;
+}
+
+// groups the images by size into arrays of at most maxLayers layers, in a fixed order. only reads images.
+inline std::vector<TextureArrayGroup> planTextureArrays(const std::vector<TextureImageInfo> &images, size_t maxLayers, TextureArrayStats &stats)
+{
+	std::map<std::pair<int, int>, std::vector<std::string>> bySize;
+	for (const TextureImageInfo &image : images)
+	{
+		stats.textures++;
+		stats.texels += (size_t)image.width * image.height;
+		if (image.width > 0 && image.height > 0)
+			bySize[std::make_pair(image.width, image.height)].push_back(image.path);
+	}
+
+	std::vector<TextureArrayGroup> groups;
+	for (const auto &size : bySize)
+	{
+		const std::vector<std::string> &paths = size.second;
+		for (size_t first = 0; first < paths.size(); first += maxLayers)
+		{
+			size_t count = std::min(maxLayers, paths.size() - first);
+			if (count < TEXTURE_ARRAY_MIN_LAYERS)
+				continue;
+			TextureArrayGroup group;
+			group.width = size.first.first;
+			group.height = size.first.second;
+			group.paths.assign(paths.begin() + first, paths.begin() + first + count);
+			groups.push_back(group);
+			stats.arrays++;
+			stats.packed += count;
+			stats.packedTexels += count * group.width * group.height;
+		}
+	}
+	return groups;
+}
+
+// reads the sizes of paths (relative to directory) from the image headers, on the shared pool
+inline std::vector<TextureImageInfo> readTextureSizes(const std::vector<std::string> &paths, const std::string &directory)
+{
+	std::vector<TextureImageInfo> images(paths.size());
+	sharedThreadPool().parallelFor(paths.size(), [&](size_t i) {
+		int channels = 0;
+		std::string path = directory + '/' + paths[i];
+		AssetData data;
+		images[i].path = paths[i];
+		bool read = assetPackage().read(path, data) ?
+			stbi_info_from_memory(data.bytes, (int)data.size, &images[i].width, &images[i].height, &channels) :
+			stbi_info(path.c_str(), &images[i].width, &images[i].height, &channels);
+		if (!read)
+			images[i].width = images[i].height = 0;
+	});
+	return images;
+}
+
+// allocates an RGBA GL_TEXTURE_2D_ARRAY for group (white until the loader fills the layers in) and queues every layer
+// for decoding. the mipmaps are built once the last layer is in.
+inline unsigned int loadTextureArrayAsync(const TextureArrayGroup &group, const std::string &directory)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, group.width, group.height, (GLsizei)group.paths.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	std::vector<unsigned char> white((size_t)group.width * group.height * 4, 255);
+	for (size_t layer = 0; layer < group.paths.size(); layer++)
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, group.width, group.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glTextureUploadSink().expectLayers(texture, group.width, group.height, (int)group.paths.size());
+	for (size_t layer = 0; layer < group.paths.size(); layer++)
+		asyncTextureLoader().request(texture, directory + '/' + group.paths[layer], false, (int)layer);
+	return texture;
+}
+
+// packs the packable diffuse textures of a model (see packableTextures) into arrays. returns a Texture for every
+// path that became a layer, to be used instead of loading the file on its own.
+inline std::vector<Texture> packTextureArrays(const std::vector<std::vector<TextureRef>> &meshTextures, const std::string &directory,
+	TextureArrayStats &stats)
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	std::vector<TextureImageInfo> images = readTextureSizes(packableTextures(meshTextures), directory);
+	std::vector<TextureArrayGroup> groups = planTextureArrays(images, (size_t)std::max(maxLayers, 1), stats);
+
+	std::vector<Texture> textures;
+	for (const TextureArrayGroup &group : groups)
+	{
+		unsigned int array = loadTextureArrayAsync(group, directory);
+		for (size_t layer = 0; layer < group.paths.size(); layer++)
+		{
+			Texture texture;
+			texture.id = array;
+			texture.type = "texture_diffuse";
+			texture.path = group.paths[layer];
+			texture.layer = (int)layer;
+			textures.push_back(texture);
+		}
+	}
+	return textures;
+}
+#endif
@@ -0,0 +1,217 @@
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+// The texture baker behind --bake-textures: turns the images under a directory into the precompressed containers of
+// CompressedTexture.h, next to each image. The mipmaps are chained with buildMipChain (MipChain.h) and every level is
+// compressed with SOIL2's encoders: DXT1 (no alpha) or DXT5 (alpha) into "<image>.dds", or with --etc1 ETC1 into
+// "<image>.ktx". ETC1 has no alpha, images with alpha still become DXT5 then. Grey images (1 or 2 channels) are not
+// baked: decoded they upload as GL_RED / GL_RG, which the RGB(A) of DXT and ETC1 can't stand in for. The images are
+// baked in parallel on the shared pool, one per thread. A directory with the six faces of a skybox (cubeMapFaces) also
+// gets its faces baked into one DDS cubemap for CubeMap.h, level 0 only and DXT even with --etc1, unless a face is grey.
+
+#include "SOIL2/SOIL2.h"
+#include "SOIL2/etc1_utils.h"
+
+#include "CompressedTexture.h"
+#include "CubeMap.h"
+#include "FileUtils.h"
+#include "MipChain.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// what baking one image gave
+struct BakedTextureInfo {
+	std::string path;			// of the source image
+	std::string bakedPath;		// empty if baking failed or was skipped
+	bool skipped = false;		// a grey image, left to be decoded
+	uint32_t format = 0;
+	int width = 0, height = 0;
+	size_t levels = 0;
+	size_t bakedBytes = 0;
+	double ms = 0.0;
+};
+
+inline const char* compressedFormatName(uint32_t format)
+{
+	switch (format)
+	{
+	case COMPRESSED_FORMAT_DXT1: return "DXT1";
+	case COMPRESSED_FORMAT_DXT5: return "DXT5";
+	case COMPRESSED_FORMAT_ETC1: return "ETC1";
+	}
+	return "-";
+}
+
+// compresses pixels and its mip chain (levels 1 and on) to format, each level on the calling thread
+inline CompressedTexture compressMipChain(const unsigned char *pixels, int width, int height, int channels, const std::vector<MipLevel> &chain,
+	uint32_t format)
+{
+	CompressedTexture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	for (size_t level = 0; level <= chain.size(); level++)
+	{
+		const unsigned char *levelPixels = level == 0 ? pixels : chain[level - 1].pixels.data();
+		int levelWidth = level == 0 ? width : chain[level - 1].width;
+		int levelHeight = level == 0 ? height : chain[level - 1].height;
+		if (format == COMPRESSED_FORMAT_ETC1)
+		{
+			std::vector<unsigned char> encoded(etc1_get_encoded_data_size(levelWidth, levelHeight));
+			etc1_encode_image(levelPixels, levelWidth, levelHeight, 3, levelWidth * 3, encoded.data());
+			texture.appendLevel(encoded.data(), encoded.size());
+		}
+		else
+		{
+			std::vector<unsigned char> encoded = compressDXT(levelPixels, levelWidth, levelHeight, channels, sharedThreadPool(), 1);
+			texture.appendLevel(encoded.data(), encoded.size());
+		}
+	}
+	return texture;
+}
+
+// bakes the image at path, see the top of the file
+inline BakedTextureInfo bakeTexture(const std::string &path, bool etc1)
+{
+	auto start = std::chrono::steady_clock::now();
+	BakedTextureInfo info;
+	info.path = path;
+	uint64_t sourceHash;
+	int channels = 0;
+	unsigned char *pixels = hashFile(path, sourceHash) ? SOIL_load_image(path.c_str(), &info.width, &info.height, &channels, SOIL_LOAD_AUTO) : NULL;
+	if (!pixels)
+		return info;
+	if (channels < 3)
+	{
+		// and no baked file of an earlier bake either, the loader would still take it
+		SOIL_free_image_data(pixels);
+		std::remove(bakedDDSPath(path).c_str());
+		std::remove(bakedKTXPath(path).c_str());
+		info.skipped = true;
+		return info;
+	}
+
+	bool alpha = dxtHasAlpha(channels);
+	uint32_t format = etc1 && !alpha ? COMPRESSED_FORMAT_ETC1 : (alpha ? COMPRESSED_FORMAT_DXT5 : COMPRESSED_FORMAT_DXT1);
+	std::vector<MipLevel> chain = buildMipChain(pixels, info.width, info.height, channels, false, sharedThreadPool(), 1);
+	CompressedTexture texture = compressMipChain(pixels, info.width, info.height, channels, chain, format);
+	SOIL_free_image_data(pixels);
+
+	std::string bakedPath = format == COMPRESSED_FORMAT_ETC1 ? bakedKTXPath(path) : bakedDDSPath(path);
+	bool written = format == COMPRESSED_FORMAT_ETC1 ? writeBakedKTX(bakedPath, texture, sourceHash) : writeBakedDDS(bakedPath, texture, sourceHash);
+	if (written)
+	{
+		info.bakedPath = bakedPath;
+		info.format = format;
+		info.levels = texture.levels();
+		info.bakedBytes = texture.data.size();
+	}
+	info.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return info;
+}
+
+// bakes the six faces into bakedCubeMapPath(faces), see the top of the file. the faces are loaded and compressed in
+// parallel, DXT5 for all of them if any has alpha.
+inline BakedTextureInfo bakeCubeMap(const std::vector<std::string> &faces)
+{
+	auto start = std::chrono::steady_clock::now();
+	BakedTextureInfo info;
+	info.path = bakedCubeMapPath(faces);
+	uint64_t sourceHash;
+	if (faces.size() != CUBE_MAP_FACES || !cubeMapSourceHash(faces, sourceHash))
+		return info;
+	struct Face {
+		unsigned char *pixels;
+		int width, height, channels;
+	};
+	std::vector<Face> images(CUBE_MAP_FACES);
+	sharedThreadPool().parallelFor(CUBE_MAP_FACES, [&](size_t i) {
+		images[i].pixels = SOIL_load_image(faces[i].c_str(), &images[i].width, &images[i].height, &images[i].channels, SOIL_LOAD_AUTO);
+	});
+	bool ok = true, alpha = false, grey = false;
+	for (const Face &face : images)
+	{
+		ok = ok && face.pixels && face.width == face.height && face.width == images[0].width;
+		alpha = alpha || (face.pixels && dxtHasAlpha(face.channels));
+		grey = grey || (face.pixels && face.channels < 3);
+	}
+	if (ok && grey)
+	{
+		for (const Face &face : images)
+			SOIL_free_image_data(face.pixels);
+		std::remove(info.path.c_str());
+		info.skipped = true;
+		return info;
+	}
+	CompressedTexture textures[CUBE_MAP_FACES];
+	uint32_t format = alpha ? COMPRESSED_FORMAT_DXT5 : COMPRESSED_FORMAT_DXT1;
+	if (ok)
+		sharedThreadPool().parallelFor(CUBE_MAP_FACES, [&](size_t i) {
+			textures[i] = compressMipChain(images[i].pixels, images[i].width, images[i].height, images[i].channels, {}, format);
+		});
+	for (const Face &face : images)
+		SOIL_free_image_data(face.pixels);
+
+	if (ok && writeBakedDDS(info.path, textures, CUBE_MAP_FACES, sourceHash))
+	{
+		info.bakedPath = info.path;
+		info.format = format;
+		info.width = textures[0].width;
+		info.height = textures[0].height;
+		info.levels = textures[0].levels();
+		info.bakedBytes = textures[0].data.size() * CUBE_MAP_FACES;
+	}
+	info.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return info;
+}
+
+// bakes every image under the directories and prints what became of each. returns false if any image failed.
+inline bool bakeTextures(const std::vector<std::string> &directories, bool etc1)
+{
+	std::vector<std::string> paths;
+	for (const std::string &directory : directories)
+		listFiles(directory, { "jpg", "jpeg", "png", "tga", "bmp" }, paths);
+	std::vector<BakedTextureInfo> baked(paths.size());
+	auto start = std::chrono::steady_clock::now();
+	sharedThreadPool().parallelFor(paths.size(), [&](size_t i) { baked[i] = bakeTexture(paths[i], etc1); });
+	// the skyboxes, found by their right face
+	for (const std::string &path : paths)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::vector<std::string> faces = cubeMapFaces(slash == std::string::npos ? "." : path.substr(0, slash), fileExtension(path));
+		if (path == faces[0] && std::all_of(faces.begin(), faces.end(), [](const std::string &face) { return fileExists(face); }))
+			baked.push_back(bakeCubeMap(faces));
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	bool ok = true;
+	size_t bytes = 0, skipped = 0;
+	printf("%-56s %6s %11s %7s %10s %10s\n", "image", "format", "size", "levels", "KB", "ms");
+	for (const BakedTextureInfo &info : baked)
+	{
+		if (info.skipped)
+		{
+			printf("%-56s skipped, grey\n", info.path.c_str());
+			skipped++;
+			continue;
+		}
+		if (info.bakedPath.empty())
+		{
+			printf("%-56s FAILED\n", info.path.c_str());
+			ok = false;
+			continue;
+		}
+		printf("%-56s %6s %5dx%-5d %7zu %10.1f %10.1f\n", info.path.c_str(), compressedFormatName(info.format), info.width, info.height,
+			info.levels, info.bakedBytes / 1024.0, info.ms);
+		bytes += info.bakedBytes;
+	}
+	printf("baked %zu images into %.1f MB in %.0f ms, %zu grey ones skipped\n", baked.size() - skipped, bytes / (1024.0 * 1024.0), ms, skipped);
+	return ok;
+}
+#endif
@@ -0,0 +1,81 @@
+#ifndef TEXTURE_BAKER_BENCHMARKS_H
+#define TEXTURE_BAKER_BENCHMARKS_H
+
+// Benchmark of the baked textures (--bake-textures) against decoding the images. Needs a GL context.
+
+#include <glad/glad.h>
+#include "SOIL2/SOIL2.h"
+
+#include "BenchmarkUtils.h"
+#include "TextureBaker.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+// --bench-baked-textures: for every image under model/ and pic/ that has a current baked file (--bake-textures), the
+// way to a sampleable texture with mipmaps from the image (decode, glTexImage2D, glGenerateMipmap) against the baked
+// file (read, a glCompressedTexImage2D per level). best of 3, GL times with glFinish.
+inline void benchmarkBakedTextures()
+{
+	vector<string> paths;
+	listFiles("model", { "jpg", "jpeg", "png", "tga", "bmp" }, paths);
+	listFiles("pic", { "jpg", "jpeg", "png", "tga", "bmp" }, paths);
+	unsigned int formats = supportedBakedFormats();
+	const int repeats = 3;
+	double totalDecode = 0.0, totalRead = 0.0, totalUpload = 0.0, totalBakedUpload = 0.0;
+	size_t count = 0;
+	printf("%-56s %6s %10s %10s %10s %10s\n", "image", "format", "decode ms", "read ms", "GL ms", "baked GL");
+	for (const string &path : paths)
+	{
+		CompressedTexture baked;
+		if (!loadBakedTexture(path, formats, baked))
+			continue;
+		double decodeMs = 1e30, readMs = 1e30, uploadMs = 1e30, bakedUploadMs = 1e30;
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			auto start = chrono::steady_clock::now();
+			int width, height, channels;
+			unsigned char *pixels = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+			decodeMs = min(decodeMs, elapsedMs(start));
+
+			start = chrono::steady_clock::now();
+			loadBakedTexture(path, formats, baked);
+			readMs = min(readMs, elapsedMs(start));
+
+			GLenum format = channels == 1 ? GL_RED : (channels == 2 ? GL_RG : (channels == 4 ? GL_RGBA : GL_RGB));
+			unsigned int textures[2];
+			glGenTextures(2, textures);
+			glFinish();
+			start = chrono::steady_clock::now();
+			glBindTexture(GL_TEXTURE_2D, textures[0]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glFinish();
+			uploadMs = min(uploadMs, elapsedMs(start));
+
+			start = chrono::steady_clock::now();
+			glBindTexture(GL_TEXTURE_2D, textures[1]);
+			uploadCompressedTexture(GL_TEXTURE_2D, baked);
+			glFinish();
+			bakedUploadMs = min(bakedUploadMs, elapsedMs(start));
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glDeleteTextures(2, textures);
+			SOIL_free_image_data(pixels);
+		}
+		printf("%-56s %6s %10.2f %10.2f %10.2f %10.2f\n", path.c_str(), compressedFormatName(baked.format), decodeMs, readMs, uploadMs, bakedUploadMs);
+		totalDecode += decodeMs;
+		totalRead += readMs;
+		totalUpload += uploadMs;
+		totalBakedUpload += bakedUploadMs;
+		count++;
+	}
+	if (count == 0)
+		printf("no baked textures, run --bake-textures first\n");
+	else
+		printf("%-56s %6s %10.2f %10.2f %10.2f %10.2f\n", "total", "", totalDecode, totalRead, totalUpload, totalBakedUpload);
+}
+#endif
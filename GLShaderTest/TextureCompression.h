@@ -0,0 +1,51 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+// DXT compression of decoded images on the thread pool. SOIL2's compressor (SOIL2/image_DXT.c) goes through an image a
+// block row (4 pixel rows) at a time and picks its SIMD version by itself; here the block rows are cut into chunks of
+// DXT_CHUNK_BLOCK_ROWS that the threads take as they go. Like save_image_as_DDS, images with alpha (2 or 4 channels)
+// become DXT5 and the others DXT1.
+
+#include "SOIL2/image_DXT.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+const int DXT_CHUNK_BLOCK_ROWS = 16;
+
+inline bool dxtHasAlpha(int channels)
+{
+	return (channels & 1) == 0;
+}
+
+// bytes of the compressed image
+inline size_t dxtSize(int width, int height, bool alpha)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8);
+}
+
+// compresses pixels (channels bytes each) on up to maxThreads threads of pool, 0 = all of them plus the calling one.
+// returns nothing for an invalid image.
+inline std::vector<unsigned char> compressDXT(const unsigned char *pixels, int width, int height, int channels, ThreadPool &pool,
+	unsigned int maxThreads = 0)
+{
+	std::vector<unsigned char> compressed;
+	if (!pixels || width < 1 || height < 1 || channels < 1 || channels > 4)
+		return compressed;
+	bool alpha = dxtHasAlpha(channels);
+	compressed.resize(dxtSize(width, height, alpha));
+	int blockRows = (height + 3) / 4;
+	size_t chunks = (blockRows + DXT_CHUNK_BLOCK_ROWS - 1) / DXT_CHUNK_BLOCK_ROWS;
+	pool.parallelFor(chunks, [&](size_t chunk) {
+		int first = (int)chunk * DXT_CHUNK_BLOCK_ROWS;
+		int count = std::min(DXT_CHUNK_BLOCK_ROWS, blockRows - first);
+		if (alpha)
+			convert_image_rows_to_DXT5(pixels, width, height, channels, first, count, compressed.data());
+		else
+			convert_image_rows_to_DXT1(pixels, width, height, channels, first, count, compressed.data());
+	}, maxThreads);
+	return compressed;
+}
+#endif
@@ -0,0 +1,176 @@
+#ifndef TEXTURE_COMPRESSION_BENCHMARKS_H
+#define TEXTURE_COMPRESSION_BENCHMARKS_H
+
+// Benchmark of the DXT compressors, and the synthetic texture and the decoder they are measured with. CPU only, no GL.
+
+#include "BenchmarkUtils.h"
+#include "TextureCompression.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// a texture like the street's facades: rows of bricks in two tones with mortar lines, a light gradient and noise, and
+// (for 2 and 4 channels) an alpha that fades across the image with a few cut out windows
+inline vector<unsigned char> syntheticTexture(int width, int height, int channels)
+{
+	srand(7);
+	vector<unsigned char> pixels((size_t)width * height * channels);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			int row = y / 12, column = (x + (row & 1) * 16) / 32;
+			bool mortar = y % 12 < 2 || (x + (row & 1) * 16) % 32 < 2;
+			bool dark = ((row * 7 + column * 13) % 5) == 0;
+			float shade = 0.75f + 0.25f * (float)y / height + (float)(rand() % 21 - 10) / 255.0f;
+			float rgb[3] = { mortar ? 190.0f : (dark ? 120.0f : 170.0f), mortar ? 185.0f : (dark ? 60.0f : 80.0f), mortar ? 175.0f : (dark ? 45.0f : 60.0f) };
+			unsigned char *pixel = &pixels[((size_t)y * width + x) * channels];
+			for (int c = 0; c < min(channels, 3); c++)
+				pixel[c] = (unsigned char)max(0.0f, min(255.0f, rgb[c] * shade));
+			if (channels == 2 || channels == 4)
+			{
+				bool window = (x / 64 + y / 64) % 3 == 0 && x % 64 > 16 && y % 64 > 16;
+				pixel[channels - 1] = window ? 0 : (unsigned char)(255 * x / max(width - 1, 1));
+			}
+		}
+	return pixels;
+}
+
+// decodes one DXT1 (8 bytes) or DXT5 (16 bytes) block to 16 RGBA pixels
+inline void decodeDXTBlock(const unsigned char *block, bool alpha, unsigned char rgba[64])
+{
+	unsigned char alphas[8] = { 255, 255, 255, 255, 255, 255, 255, 255 };
+	uint64_t alphaBits = 0;
+	if (alpha)
+	{
+		int a0 = block[0], a1 = block[1];
+		alphas[0] = (unsigned char)a0;
+		alphas[1] = (unsigned char)a1;
+		for (int i = 2; i < 8; i++)
+		{
+			if (a0 > a1)
+				alphas[i] = (unsigned char)(((8 - i) * a0 + (i - 1) * a1) / 7);
+			else
+				alphas[i] = i < 6 ? (unsigned char)(((6 - i) * a0 + (i - 1) * a1) / 5) : (i == 6 ? 0 : 255);
+		}
+		for (int i = 0; i < 6; i++)
+			alphaBits |= (uint64_t)block[2 + i] << (8 * i);
+		block += 8;
+	}
+	unsigned int c0 = block[0] | (block[1] << 8), c1 = block[2] | (block[3] << 8);
+	int colors[4][3];
+	for (int i = 0; i < 2; i++)
+	{
+		unsigned int c = i == 0 ? c0 : c1;
+		colors[i][0] = ((c >> 11) & 31) * 255 / 31;
+		colors[i][1] = ((c >> 5) & 63) * 255 / 63;
+		colors[i][2] = (c & 31) * 255 / 31;
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		if (c0 > c1 || alpha)
+		{
+			colors[2][k] = (2 * colors[0][k] + colors[1][k]) / 3;
+			colors[3][k] = (colors[0][k] + 2 * colors[1][k]) / 3;
+		}
+		else
+		{
+			colors[2][k] = (colors[0][k] + colors[1][k]) / 2;
+			colors[3][k] = 0;
+		}
+	}
+	unsigned int bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		const int *color = colors[(bits >> (2 * i)) & 3];
+		rgba[i * 4 + 0] = (unsigned char)color[0];
+		rgba[i * 4 + 1] = (unsigned char)color[1];
+		rgba[i * 4 + 2] = (unsigned char)color[2];
+		rgba[i * 4 + 3] = alphas[(alphaBits >> (3 * i)) & 7];
+	}
+}
+
+// PSNR in dB of the compressed image against pixels, over the color channels and, for DXT5, alpha
+inline double dxtPSNR(const unsigned char *pixels, int width, int height, int channels, const vector<unsigned char> &compressed)
+{
+	bool alpha = dxtHasAlpha(channels);
+	int blocksWide = (width + 3) / 4;
+	size_t blockSize = alpha ? 16 : 8;
+	double squaredError = 0.0;
+	size_t samples = 0;
+	unsigned char rgba[64];
+	for (int by = 0; by < (height + 3) / 4; by++)
+		for (int bx = 0; bx < blocksWide; bx++)
+		{
+			decodeDXTBlock(&compressed[((size_t)by * blocksWide + bx) * blockSize], alpha, rgba);
+			for (int y = by * 4; y < min(by * 4 + 4, height); y++)
+				for (int x = bx * 4; x < min(bx * 4 + 4, width); x++)
+				{
+					const unsigned char *pixel = &pixels[((size_t)y * width + x) * channels];
+					const unsigned char *decoded = &rgba[((y - by * 4) * 4 + (x - bx * 4)) * 4];
+					// 1 and 2 channel images are compressed as grey
+					int colorChannels = channels < 3 ? 1 : 3;
+					for (int c = 0; c < colorChannels; c++)
+					{
+						double d = (double)pixel[c] - decoded[c];
+						squaredError += d * d;
+						samples++;
+					}
+					if (alpha)
+					{
+						double d = (double)pixel[channels - 1] - decoded[3];
+						squaredError += d * d;
+						samples++;
+					}
+				}
+		}
+	double mse = squaredError / max<size_t>(samples, 1);
+	return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+inline const char* dxtCompressorName(int compressor)
+{
+	return compressor == DXT_COMPRESSOR_AVX ? "AVX" : (compressor == DXT_COMPRESSOR_SSE2 ? "SSE2" : "scalar");
+}
+
+// --bench-dxt: a 2048 x 2048 synthetic facade (see syntheticTexture) compressed to DXT1 (RGB) and DXT5 (RGBA) by every
+// compressor on one thread, then by the best one on 1, 2, 4, ... threads, best of 5 runs each. PSNR is of the decoded
+// result against the source; "exact" says whether the output is byte for byte the scalar compressor's.
+inline void benchmarkDXTCompressors()
+{
+	const int width = 2048, height = 2048, repeats = 5;
+	int best = set_DXT_compressor(DXT_COMPRESSOR_AVX);
+	printf("%6s %8s %8s %10s %10s %8s %8s %6s\n", "format", "SIMD", "threads", "ms", "MPix/s", "speedup", "PSNR", "exact");
+	for (int channels : { 3, 4 })
+	{
+		vector<unsigned char> pixels = syntheticTexture(width, height, channels);
+		vector<unsigned char> reference;
+		double scalarMs = 0.0;
+		vector<pair<int, unsigned int>> runs;
+		for (int compressor = DXT_COMPRESSOR_SCALAR; compressor <= best; compressor++)
+			runs.push_back(make_pair(compressor, 1u));
+		for (unsigned int threads : benchmarkThreadCounts())
+			if (threads > 1)
+				runs.push_back(make_pair(best, threads));
+		for (const pair<int, unsigned int> &run : runs)
+		{
+			set_DXT_compressor(run.first);
+			vector<unsigned char> compressed;
+			double bestMs = bestOfMs(repeats, [&] { compressed = compressDXT(pixels.data(), width, height, channels, sharedThreadPool(), run.second); });
+			if (run.first == DXT_COMPRESSOR_SCALAR)
+			{
+				reference = compressed;
+				scalarMs = bestMs;
+			}
+			printf("%6s %8s %8u %10.2f %10.1f %7.2fx %8.2f %6s\n", channels == 4 ? "DXT5" : "DXT1", dxtCompressorName(run.first), run.second,
+				bestMs, (double)width * height / bestMs / 1000.0, scalarMs / bestMs, dxtPSNR(pixels.data(), width, height, channels, compressed),
+				compressed == reference ? "yes" : "NO");
+		}
+	}
+	set_DXT_compressor(best);
+}
+#endif
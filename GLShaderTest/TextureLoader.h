@@ -0,0 +1,147 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "SOIL2/SOIL2.h"
+
+#include "AssetPackage.h"
+#include "CompressedTexture.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+// An image decoded on a worker thread, waiting to be uploaded into the texture handle that was handed out for it.
+struct DecodedImage {
+	unsigned int texture;
+	std::string path;
+	bool gamma;					// sRGB, uploaded into an sRGB internal format
+	int layer;					// -1 for a GL_TEXTURE_2D, else the layer of the GL_TEXTURE_2D_ARRAY it goes into
+	int width, height, channels;
+	unsigned char *pixels;		// NULL if decoding failed or the image came baked; owned by the loader, freed after upload
+	CompressedTexture compressed;	// the levels of a baked file (CompressedTexture.h) used instead of the image, if any
+};
+
+// Receives decoded images on the thread that calls TextureLoader::processUploads. Nothing in this file touches OpenGL:
+// the GL implementation is in TextureUpload.h, and anything else (the recorder of GLShaderTestChecks) can stand in
+// for it without a context.
+class TextureUploadSink
+{
+public:
+	virtual ~TextureUploadSink() {}
+	virtual void upload(const DecodedImage &image) = 0;
+	virtual void failed(const DecodedImage &image)
+	{
+		std::cout << "Texture failed to load at path: " << image.path << std::endl;
+	}
+};
+
+// Decodes images on a thread pool and queues them for upload. Callers get their texture handle right away
+// (see TextureFromFile) and the real pixels replace the placeholder once processUploads gets to them.
+// With bakedFormats (BAKED_* of CompressedTexture.h) a current baked file of an image is read instead of decoding it.
+class TextureLoader
+{
+public:
+	TextureLoader(ThreadPool &pool, TextureUploadSink &sink, unsigned int bakedFormats = 0) : pool(pool), sink(sink), bakedFormats(bakedFormats),
+		decoding(0) {}
+
+	~TextureLoader()
+	{
+		// workers may still hold a pointer to us, let them finish before the queue goes away
+		while (decoding.load() > 0)
+			std::this_thread::yield();
+		for (DecodedImage &image : ready)
+			SOIL_free_image_data(image.pixels);
+	}
+
+	// queues path for decoding, the result will be uploaded into texture. with a layer it goes into that layer of an
+	// array texture (TextureArrays.h) instead, and is decoded as RGBA whatever the file holds (never read baked, the
+	// arrays are uncompressed).
+	void request(unsigned int texture, const std::string &path, bool gamma = false, int layer = -1)
+	{
+		decoding++;
+		pool.submit([this, texture, path, gamma, layer] {
+			DecodedImage image;
+			image.texture = texture;
+			image.path = path;
+			image.gamma = gamma;
+			image.layer = layer;
+			image.pixels = NULL;
+			if (layer < 0 && bakedFormats && loadBakedTexture(path, bakedFormats, image.compressed))
+			{
+				image.width = image.compressed.width;
+				image.height = image.compressed.height;
+				image.channels = image.compressed.format == COMPRESSED_FORMAT_DXT5 ? 4 : 3;
+			}
+			else
+				image.pixels = loadImage(path, &image.width, &image.height, &image.channels, layer >= 0 ? SOIL_LOAD_RGBA : SOIL_LOAD_AUTO);
+			if (layer >= 0)
+				image.channels = 4;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ready.push_back(std::move(image));
+			}
+			decoding--;
+		});
+	}
+
+	// hands decoded images to the sink until budgetMs is used up (at least one image per call so we always make progress).
+	// returns the number of images handed over.
+	int processUploads(double budgetMs)
+	{
+		auto start = std::chrono::steady_clock::now();
+		int count = 0;
+		for (;;)
+		{
+			DecodedImage image;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (ready.empty())
+					break;
+				image = std::move(ready.front());
+				ready.pop_front();
+			}
+			if (image.pixels || image.compressed.levels() > 0)
+				sink.upload(image);
+			else
+				sink.failed(image);
+			SOIL_free_image_data(image.pixels);
+			count++;
+
+			if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs)
+				break;
+		}
+		return count;
+	}
+
+	// number of requested images that haven't been handed to the sink yet
+	int pending()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return decoding.load() + (int)ready.size();
+	}
+
+	// blocks until every queued image is decoded and uploaded
+	void finish()
+	{
+		while (pending() > 0)
+		{
+			if (processUploads(1e9) == 0)
+				std::this_thread::yield();
+		}
+	}
+
+private:
+	ThreadPool &pool;
+	TextureUploadSink &sink;
+	unsigned int bakedFormats;
+	std::atomic<int> decoding;
+	std::mutex mutex;
+	std::deque<DecodedImage> ready;
+};
+#endif
@@ -0,0 +1,199 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+// The OpenGL side of textures: the sink that uploads what TextureLoader decoded, the placeholder a handle shows until
+// then, the loader the models use, and the uploads of baked textures (CompressedTexture.h).
+
+#include <glad/glad.h>
+#include "SOIL2/SOIL2.h"
+
+#include "CompressedTexture.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+
+#include <string>
+#include <unordered_map>
+
+// the baked containers the current context can upload. call on the GL thread.
+inline unsigned int supportedBakedFormats()
+{
+	unsigned int formats = 0;
+	if (SOIL_GL_ExtensionSupported("GL_EXT_texture_compression_s3tc"))
+		formats |= BAKED_DDS;
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 3) || SOIL_GL_ExtensionSupported("GL_ARB_ES3_compatibility"))
+		formats |= BAKED_KTX;
+	return formats;
+}
+
+// the internal format the levels of texture are uploaded as, the sRGB variant with srgb
+inline GLenum compressedUploadFormat(const CompressedTexture &texture, bool srgb)
+{
+	switch (texture.format)
+	{
+	case COMPRESSED_FORMAT_DXT1: return srgb ? COMPRESSED_FORMAT_SRGB_DXT1 : COMPRESSED_FORMAT_DXT1;
+	case COMPRESSED_FORMAT_DXT5: return srgb ? COMPRESSED_FORMAT_SRGB_DXT5 : COMPRESSED_FORMAT_DXT5;
+	case COMPRESSED_FORMAT_ETC1: return srgb ? COMPRESSED_FORMAT_SRGB_ETC2_RGB8 : COMPRESSED_FORMAT_ETC2_RGB8;
+	}
+	return texture.format;
+}
+
+// uploads every level of texture into target (a cubemap face works as well)
+inline void uploadCompressedLevels(GLenum target, const CompressedTexture &texture, bool srgb = false)
+{
+	GLenum format = compressedUploadFormat(texture, srgb);
+	int width = texture.width, height = texture.height;
+	for (size_t level = 0; level < texture.levels(); level++)
+	{
+		glCompressedTexImage2D(target, (GLint)level, format, width, height, 0,
+			(GLsizei)(texture.levelOffsets[level + 1] - texture.levelOffsets[level]), &texture.data[texture.levelOffsets[level]]);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+}
+
+// uploads every level of texture into the bound target and limits sampling to them
+inline void uploadCompressedTexture(GLenum target, const CompressedTexture &texture, bool srgb = false)
+{
+	uploadCompressedLevels(target, texture, srgb);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels() - 1);
+}
+
+// uploads into GL_TEXTURE_2D with the same settings the synchronous loaders used, or into a layer of an array texture
+class GLTextureUploadSink : public TextureUploadSink
+{
+public:
+	void upload(const DecodedImage &image)
+	{
+		if (image.layer >= 0)
+		{
+			uploadLayer(image);
+			return;
+		}
+		if (image.compressed.levels() > 0)
+		{
+			// baked, the file has every level already
+			glBindTexture(GL_TEXTURE_2D, image.texture);
+			uploadCompressedTexture(GL_TEXTURE_2D, image.compressed, image.gamma);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return;
+		}
+		GLenum format = GL_RGB;
+		if (image.channels == 1)
+			format = GL_RED;
+		else if (image.channels == 3)
+			format = GL_RGB;
+		else if (image.channels == 4)
+			format = GL_RGBA;
+		// gamma textures are stored sRGB, so sampling them gives linear colors
+		GLint internalFormat = format;
+		if (image.gamma && format == GL_RGB)
+			internalFormat = GL_SRGB8;
+		else if (image.gamma && format == GL_RGBA)
+			internalFormat = GL_SRGB8_ALPHA8;
+
+		glBindTexture(GL_TEXTURE_2D, image.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void failed(const DecodedImage &image)
+	{
+		TextureUploadSink::failed(image);
+		if (image.layer >= 0)
+			layerDone(image.texture);
+	}
+
+	// texture is a width x height GL_TEXTURE_2D_ARRAY, count of its layers are still to come
+	void expectLayers(unsigned int texture, int width, int height, int count)
+	{
+		PendingArray &array = arrays[texture];
+		array.width = width;
+		array.height = height;
+		array.layers += count;
+	}
+
+private:
+	struct PendingArray {
+		int width = 0, height = 0;
+		int layers = 0;
+	};
+	std::unordered_map<unsigned int, PendingArray> arrays;
+
+	void uploadLayer(const DecodedImage &image)
+	{
+		auto it = arrays.find(image.texture);
+		if (it == arrays.end())
+			return;
+		// the file changed size since the array was planned, the layer keeps the placeholder
+		if (image.width != it->second.width || image.height != it->second.height)
+		{
+			failed(image);
+			return;
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, image.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, image.layer, image.width, image.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		layerDone(image.texture);
+	}
+
+	// the mipmaps cover every layer, so they're built once, after the last one
+	void layerDone(unsigned int texture)
+	{
+		auto it = arrays.find(texture);
+		if (it == arrays.end() || --it->second.layers > 0)
+			return;
+		arrays.erase(it);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+};
+
+inline GLTextureUploadSink& glTextureUploadSink()
+{
+	static GLTextureUploadSink sink;
+	return sink;
+}
+
+// fills texture with a single white texel so it can be sampled before the real image arrives
+inline void uploadPlaceholderTexture(unsigned int texture)
+{
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// the loader used by TextureFromFile and loadTexture, uploads must be processed on the GL thread. it reads the baked
+// files (--bake-textures) the context can take, so the first call has to come from the GL thread as well.
+inline TextureLoader& asyncTextureLoader()
+{
+	static TextureLoader loader(sharedThreadPool(), glTextureUploadSink(), supportedBakedFormats());
+	return loader;
+}
+
+// allocates a texture handle that shows the placeholder until path is decoded and uploaded
+inline unsigned int loadTextureAsync(const std::string &path, bool gamma = false)
+{
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	uploadPlaceholderTexture(texture);
+	asyncTextureLoader().request(texture, path, gamma);
+	return texture;
+}
+#endif
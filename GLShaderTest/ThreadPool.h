@@ -0,0 +1,134 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads pulling tasks from a shared FIFO queue. Nothing in here touches OpenGL,
+// so anything that needs the context must be handed back to the render thread by the caller.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount = defaultThreadCount()) : stopping(false)
+	{
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.emplace_back([this] { workerLoop(); });
+	}
+
+	// finishes the queued tasks, then joins the workers
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// one thread is left for the render thread
+	static unsigned int defaultThreadCount()
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 1;
+	}
+
+	unsigned int size() const { return (unsigned int)workers.size(); }
+
+	void submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		wake.notify_one();
+	}
+
+	// runs body(i) for every i in [0, count) on up to maxThreads threads (0 = all workers) including the calling one,
+	// and returns once all of them are done. The calling thread always takes part, so this can't starve even if the
+	// workers are busy with long running tasks.
+	void parallelFor(size_t count, const std::function<void(size_t)> &body, unsigned int maxThreads = 0)
+	{
+		if (count == 0)
+			return;
+		unsigned int helpers = maxThreads == 0 ? size() : std::min(size(), maxThreads - 1);
+		helpers = (unsigned int)std::min<size_t>(helpers, count - 1);
+
+		// shared so helpers that only get scheduled after everything is done can still look at it safely
+		std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+		state->body = &body;
+		state->count = count;
+		for (unsigned int i = 0; i < helpers; i++)
+			submit([state] { state->run(); });
+		state->run();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&] { return state->completed.load() == count; });
+	}
+
+private:
+	struct ParallelForState {
+		const std::function<void(size_t)> *body = nullptr;
+		size_t count = 0;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> completed{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+
+		void run()
+		{
+			size_t i;
+			while ((i = next.fetch_add(1)) < count)
+			{
+				(*body)(i);
+				if (completed.fetch_add(1) + 1 == count)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					finished.notify_all();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
+
+// the pool shared by loaders and import steps
+inline ThreadPool& sharedThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+#endif
@@ -0,0 +1,272 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Uniform blocks shared by all programs. A shader declaring one of these blocks gets it bound to the block's binding
+// point when it's linked (see Shader::bindUniformBlocks), so a buffer bound there once serves every program.
+//
+//   layout (std140) uniform FrameBlock { mat4 projection; mat4 view; vec3 viewPos; Light light; };
+//   layout (std140) uniform MaterialBlock { vec3 specular; float shininess; vec3 objectColor; } material;
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+
+// binding point for a block name, -1 for blocks nobody binds buffers for
+inline int uniformBlockBinding(const std::string &blockName)
+{
+	if (blockName == "FrameBlock")
+		return (int)FRAME_BLOCK_BINDING;
+	if (blockName == "MaterialBlock")
+		return (int)MATERIAL_BLOCK_BINDING;
+	return -1;
+}
+
+// ------------------------------------------------------------------------
+// Lays values out by the std140 rules, plain CPU code:
+//   scalars align to 4, vec2 to 8, vec3 and vec4 to 16 (a vec3 leaves room for one scalar after it)
+//   array elements and matrix columns align to 16 and are padded to 16
+//   structs align to 16 and their size is padded to 16
+// Every write returns the offset the value landed at.
+class Std140Writer
+{
+public:
+	void reset() { bytes.clear(); }
+	const unsigned char* data() const { return bytes.data(); }
+	size_t size() const { return bytes.size(); }
+
+	size_t writeFloat(float value) { return place(&value, 4, 4); }
+	size_t writeInt(int value) { return place(&value, 4, 4); }
+	size_t writeVec2(const glm::vec2 &value) { return place(&value[0], 8, 8); }
+	size_t writeVec3(const glm::vec3 &value) { return place(&value[0], 12, 16); }
+	size_t writeVec4(const glm::vec4 &value) { return place(&value[0], 16, 16); }
+
+	size_t writeFloatArray(const float *values, size_t count)
+	{
+		size_t offset = align(16);
+		for (size_t i = 0; i < count; i++)
+			place(&values[i], 4, 16);
+		align(16);
+		return offset;
+	}
+	// columns are vec3 padded to vec4
+	size_t writeMat3(const glm::mat3 &value)
+	{
+		size_t offset = align(16);
+		for (int column = 0; column < 3; column++)
+			place(&value[column][0], 12, 16);
+		align(16);
+		return offset;
+	}
+	size_t writeMat4(const glm::mat4 &value) { return place(&value[0][0], 64, 16); }
+
+	size_t beginStruct() { return align(16); }
+	void endStruct() { align(16); }
+
+private:
+	std::vector<unsigned char> bytes;
+
+	// pads with zeros up to the next multiple of alignment, returns the new size
+	size_t align(size_t alignment)
+	{
+		bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+		return bytes.size();
+	}
+
+	size_t place(const void *value, size_t size, size_t alignment)
+	{
+		size_t offset = align(alignment);
+		bytes.resize(offset + size);
+		memcpy(&bytes[offset], value, size);
+		return offset;
+	}
+};
+
+// ------------------------------------------------------------------------
+// CPU side of the blocks above, writeStd140 has to follow the member order of the GLSL declaration
+struct LightUniforms {
+	glm::vec3 position;
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+};
+
+struct FrameUniforms {
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	LightUniforms light;
+};
+
+struct MaterialUniforms {
+	glm::vec3 specular;
+	float shininess;
+	glm::vec3 objectColor;
+};
+
+inline void writeStd140(Std140Writer &writer, const LightUniforms &light)
+{
+	writer.beginStruct();
+	writer.writeVec3(light.position);
+	writer.writeVec3(light.ambient);
+	writer.writeVec3(light.diffuse);
+	writer.writeVec3(light.specular);
+	writer.endStruct();
+}
+
+inline void writeStd140(Std140Writer &writer, const FrameUniforms &frame)
+{
+	writer.writeMat4(frame.projection);
+	writer.writeMat4(frame.view);
+	writer.writeVec3(frame.viewPos);
+	writeStd140(writer, frame.light);
+}
+
+inline void writeStd140(Std140Writer &writer, const MaterialUniforms &material)
+{
+	writer.writeVec3(material.specular);
+	writer.writeFloat(material.shininess);
+	writer.writeVec3(material.objectColor);
+}
+
+// the std140 size of a block, padded to a vec4 like GL_UNIFORM_BLOCK_DATA_SIZE reports it
+template <typename Block>
+inline size_t std140Size(const Block &block)
+{
+	Std140Writer writer;
+	writeStd140(writer, block);
+	return (writer.size() + 15) / 16 * 16;
+}
+
+// ------------------------------------------------------------------------
+// A block whose contents change every frame. The buffer holds regionCount copies and each update writes the next
+// one, so the CPU writes while the GPU may still read the copies of the previous frames. A fence after each frame's
+// use tells when a copy is free again; with three copies waiting on it should never actually block.
+class StreamingUniformBuffer
+{
+public:
+	unsigned int stalls = 0;	// updates that had to wait for the GPU
+
+	StreamingUniformBuffer(GLuint binding, size_t blockSize, unsigned int regionCount = 3)
+		: binding(binding), blockSize(blockSize), fences(regionCount, (GLsync)0), current(regionCount - 1)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		regionSize = (blockSize + alignment - 1) / alignment * alignment;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, regionSize * regionCount, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// deletes the GL objects, like Mesh::releaseGpuData this has to happen while the context is still alive
+	void release()
+	{
+		for (GLsync &fence : fences)
+		{
+			if (fence)
+				glDeleteSync(fence);
+			fence = 0;
+		}
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	StreamingUniformBuffer(const StreamingUniformBuffer&) = delete;
+	StreamingUniformBuffer& operator=(const StreamingUniformBuffer&) = delete;
+
+	// writes the block for this frame and binds it; everything drawn until the next update reads these values
+	template <typename Block>
+	void update(const Block &block)
+	{
+		writer.reset();
+		writeStd140(writer, block);
+		upload(writer.data(), writer.size());
+	}
+
+	void upload(const void *data, size_t size)
+	{
+		// the draws of the previous frame have all been issued by now, fence the copy they read
+		if (fences[current])
+			glDeleteSync(fences[current]);
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		current = (current + 1) % fences.size();
+		if (fences[current])
+		{
+			GLenum result = glClientWaitSync(fences[current], 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			{
+				stalls++;
+				glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+			}
+			glDeleteSync(fences[current]);
+			fences[current] = 0;
+		}
+
+		// unsynchronized: the fence above already made sure the GPU is done with this copy
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		void *target = glMapBufferRange(GL_UNIFORM_BUFFER, current * regionSize, regionSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (target)
+		{
+			memcpy(target, data, size < blockSize ? size : blockSize);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, current * regionSize, blockSize);
+	}
+
+private:
+	GLuint binding;
+	GLuint buffer;
+	size_t blockSize;
+	size_t regionSize;
+	std::vector<GLsync> fences;
+	size_t current;
+	Std140Writer writer;
+};
+
+// ------------------------------------------------------------------------
+// A block that is written once, like the values of one material. bind() makes it the one the shaders read.
+class StaticUniformBuffer
+{
+public:
+	template <typename Block>
+	StaticUniformBuffer(GLuint binding, const Block &block) : binding(binding)
+	{
+		Std140Writer writer;
+		writeStd140(writer, block);
+		size = std140Size(block);
+		std::vector<unsigned char> data(writer.data(), writer.data() + writer.size());
+		data.resize(size, 0);
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, size, data.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	void release()
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	StaticUniformBuffer(const StaticUniformBuffer&) = delete;
+	StaticUniformBuffer& operator=(const StaticUniformBuffer&) = delete;
+
+	void bind() const
+	{
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, 0, size);
+	}
+
+private:
+	GLuint binding;
+	GLuint buffer;
+	size_t size;
+};
+#endif
@@ -0,0 +1,98 @@
+#ifndef UNIFORM_BUFFER_CHECKS_H
+#define UNIFORM_BUFFER_CHECKS_H
+
+// The uniform block layouts of UniformBuffer.h against what the driver reports. Needs a GL context, the checks that
+// don't are in GLShaderTestChecks.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "UniformBuffer.h"
+
+#include <cstdio>
+#include <cstring>
+
+// one member of a uniform block: where GL says it is against what Std140Writer put there
+inline bool checkBlockMember(const Shader &shader, const char *name, const Std140Writer &writer, float expected)
+{
+	GLuint index = GL_INVALID_INDEX;
+	glGetUniformIndices(shader.ID, 1, &name, &index);
+	if (index == GL_INVALID_INDEX)
+	{
+		printf("  %-26s not active, skipped\n", name);
+		return true;
+	}
+	GLint offset = -1;
+	glGetActiveUniformsiv(shader.ID, 1, &index, GL_UNIFORM_OFFSET, &offset);
+	float written = 0.0f;
+	if (offset >= 0 && (size_t)offset + sizeof(float) <= writer.size())
+		memcpy(&written, writer.data() + offset, sizeof(float));
+	bool ok = written == expected;
+	printf("  %-26s GL offset %4d %s\n", name, offset, ok ? "ok" : "MISMATCH");
+	return ok;
+}
+
+inline bool checkBlockSize(const Shader &shader, const char *blockName, size_t size)
+{
+	GLuint block = glGetUniformBlockIndex(shader.ID, blockName);
+	if (block == GL_INVALID_INDEX)
+		return true;
+	GLint dataSize = 0;
+	glGetActiveUniformBlockiv(shader.ID, block, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+	bool ok = (size_t)dataSize == size;
+	printf("  %-26s GL size %6d, std140Size %zu %s\n", blockName, dataSize, size, ok ? "ok" : "MISMATCH");
+	return ok;
+}
+
+// --check-std140: the FrameBlock / MaterialBlock writers against the offsets the driver reports for the scene's shaders.
+// Std140Writer against the std140 rules alone is checked without a context by GLShaderTestChecks. returns false if
+// anything is off.
+inline bool checkStd140Layouts()
+{
+	bool ok = true;
+	Std140Writer writer;
+
+	// every member gets a distinct value so reading it back at GL's offset shows whether the layouts agree
+	FrameUniforms frame = FrameUniforms();
+	frame.projection[0][0] = 1.0f;
+	frame.view[0][0] = 2.0f;
+	frame.viewPos = glm::vec3(3.0f);
+	frame.light.position = glm::vec3(4.0f);
+	frame.light.ambient = glm::vec3(5.0f);
+	frame.light.diffuse = glm::vec3(6.0f);
+	frame.light.specular = glm::vec3(7.0f);
+	MaterialUniforms material;
+	material.specular = glm::vec3(8.0f);
+	material.shininess = 9.0f;
+	material.objectColor = glm::vec3(10.0f);
+
+	Shader envShader("selfDefinedVertexShader.vs", "selfDefinedFragmentShader.fs");
+	Shader skyBoxShader("shaders/skyboxShader/skyboxVertexShader.vs", "shaders/skyboxShader/skyboxFragmentShader.fs");
+	const Shader *shaders[] = { &envShader, &skyBoxShader };
+	const char *names[] = { "envShader", "skyBoxShader" };
+	for (int i = 0; i < 2; i++)
+	{
+		const Shader &shader = *shaders[i];
+		printf("%s\n", names[i]);
+		writer.reset();
+		writeStd140(writer, frame);
+		ok = checkBlockSize(shader, "FrameBlock", std140Size(frame)) && ok;
+		ok = checkBlockMember(shader, "projection", writer, 1.0f) && ok;
+		ok = checkBlockMember(shader, "view", writer, 2.0f) && ok;
+		ok = checkBlockMember(shader, "viewPos", writer, 3.0f) && ok;
+		ok = checkBlockMember(shader, "light.position", writer, 4.0f) && ok;
+		ok = checkBlockMember(shader, "light.ambient", writer, 5.0f) && ok;
+		ok = checkBlockMember(shader, "light.diffuse", writer, 6.0f) && ok;
+		ok = checkBlockMember(shader, "light.specular", writer, 7.0f) && ok;
+		writer.reset();
+		writeStd140(writer, material);
+		ok = checkBlockSize(shader, "MaterialBlock", std140Size(material)) && ok;
+		ok = checkBlockMember(shader, "MaterialBlock.specular", writer, 8.0f) && ok;
+		ok = checkBlockMember(shader, "MaterialBlock.shininess", writer, 9.0f) && ok;
+		ok = checkBlockMember(shader, "MaterialBlock.objectColor", writer, 10.0f) && ok;
+	}
+	printf("%s\n", ok ? "std140 layouts match" : "std140 layouts DON'T match");
+	return ok;
+}
+#endif
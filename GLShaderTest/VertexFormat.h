@@ -0,0 +1,270 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Vertex layouts a Mesh can upload. The float layout is struct Vertex as is (56 bytes); the packed one is
+// PackedVertex (20 bytes) and is decoded by selfDefinedVertexShader.vs when "packedVertices" is set.
+enum VertexLayout {
+	VERTEX_LAYOUT_FLOAT,
+	VERTEX_LAYOUT_PACKED
+};
+
+// all components are 16 bit, the normalized ones are unsigned (GL's signed normalized conversion changed in 4.2)
+struct PackedVertex {
+	uint16_t position[4];	// unorm16 inside the mesh bounds; w is the tangent handedness (0 = -1, 65535 = +1)
+	uint16_t normal[2];		// octahedral, each component mapped from [-1, 1] to unorm16
+	uint16_t tangent[2];	// octahedral, same as normal; the bitangent is cross(normal, tangent) * handedness
+	uint16_t texCoords[2];	// half floats
+};
+
+// ------------------------------------------------------------------------
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t x;
+	memcpy(&x, &value, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = x & 0x7fffff;
+
+	if (((x >> 23) & 0xff) == 0xff)		// inf / nan
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)					// too large, becomes inf
+		return (uint16_t)(sign | 0x7c00);
+	if (exponent <= 0)					// subnormal half (or zero)
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+	// round to nearest even, a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (uint16_t)half;
+}
+
+inline float halfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+	uint32_t x;
+	if (exponent == 0x1f)
+		x = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent != 0)
+		x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		x = sign;
+	else
+	{
+		// renormalize the subnormal
+		exponent = 127 - 15 + 1;
+		while (!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			exponent--;
+		}
+		x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	float value;
+	memcpy(&value, &x, sizeof(value));
+	return value;
+}
+
+// ------------------------------------------------------------------------
+inline uint16_t packUnorm16(float value)
+{
+	if (value < 0.0f)
+		value = 0.0f;
+	if (value > 1.0f)
+		value = 1.0f;
+	return (uint16_t)std::floor(value * 65535.0f + 0.5f);
+}
+
+inline float unpackUnorm16(uint16_t value)
+{
+	return value / 65535.0f;
+}
+
+// ------------------------------------------------------------------------
+// octahedral mapping of a unit vector onto [-1, 1]^2
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+	float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f, 0.0f);
+	n = n * (1.0f / l1);
+	if (n.z < 0.0f)
+	{
+		float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		return glm::vec2(x, y);
+	}
+	return glm::vec2(n.x, n.y);
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+	glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+	if (n.z < 0.0f)
+	{
+		float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = x;
+		n.y = y;
+	}
+	return glm::normalize(n);
+}
+
+inline glm::vec3 unpackOct16(const uint16_t packed[2])
+{
+	return octDecode(glm::vec2(unpackUnorm16(packed[0]) * 2.0f - 1.0f, unpackUnorm16(packed[1]) * 2.0f - 1.0f));
+}
+
+// quantizes with the rounding (up or down per component) that decodes closest to n
+inline void packOct16(glm::vec3 n, uint16_t out[2])
+{
+	if (glm::dot(n, n) == 0.0f)
+	{
+		out[0] = out[1] = packUnorm16(0.5f);
+		return;
+	}
+	n = glm::normalize(n);
+	glm::vec2 e = octEncode(n);
+	float u = (e.x * 0.5f + 0.5f) * 65535.0f;
+	float v = (e.y * 0.5f + 0.5f) * 65535.0f;
+	float best = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		float cu = (i & 1) ? std::ceil(u) : std::floor(u);
+		float cv = (i & 2) ? std::ceil(v) : std::floor(v);
+		uint16_t candidate[2] = { (uint16_t)std::fmin(cu, 65535.0f), (uint16_t)std::fmin(cv, 65535.0f) };
+		float similarity = glm::dot(unpackOct16(candidate), n);
+		if (similarity > best)
+		{
+			best = similarity;
+			out[0] = candidate[0];
+			out[1] = candidate[1];
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+// axis aligned bounds of a set of positions
+struct Bounds {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// bounds of nothing (an instance group without instances): min above max, so merging it into a box changes nothing
+inline Bounds emptyBounds()
+{
+	Bounds bounds;
+	bounds.min = glm::vec3(FLT_MAX);
+	bounds.max = glm::vec3(-FLT_MAX);
+	return bounds;
+}
+
+inline bool isEmpty(const Bounds &bounds)
+{
+	return bounds.min.x > bounds.max.x || bounds.min.y > bounds.max.y || bounds.min.z > bounds.max.z;
+}
+
+template <typename VertexType>
+inline Bounds computeBounds(const VertexType *vertices, size_t count)
+{
+	Bounds bounds;
+	bounds.min = bounds.max = count ? vertices[0].Position : glm::vec3(0.0f);
+	for (size_t i = 1; i < count; i++)
+	{
+		bounds.min = glm::min(bounds.min, vertices[i].Position);
+		bounds.max = glm::max(bounds.max, vertices[i].Position);
+	}
+	return bounds;
+}
+
+// bounds of positions stored as floatsPerVertex floats each, position first (the hand written cube arrays in models.h)
+inline Bounds computeFloatBounds(const float *vertices, size_t count, size_t floatsPerVertex)
+{
+	Bounds bounds;
+	bounds.min = bounds.max = count ? glm::vec3(vertices[0], vertices[1], vertices[2]) : glm::vec3(0.0f);
+	for (size_t i = 1; i < count; i++)
+	{
+		glm::vec3 position(vertices[i * floatsPerVertex], vertices[i * floatsPerVertex + 1], vertices[i * floatsPerVertex + 2]);
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	return bounds;
+}
+
+struct BoundingSphere {
+	glm::vec3 center;
+	float radius;
+};
+
+// centered on the bounds, with the radius of the farthest position: a bit looser than the smallest sphere, but
+// never worse than the half diagonal of the box
+template <typename VertexType>
+inline BoundingSphere computeBoundingSphere(const VertexType *vertices, size_t count, const Bounds &bounds)
+{
+	BoundingSphere sphere;
+	sphere.center = (bounds.min + bounds.max) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 offset = vertices[i].Position - sphere.center;
+		radiusSquared = std::fmax(radiusSquared, glm::dot(offset, offset));
+	}
+	sphere.radius = std::sqrt(radiusSquared);
+	return sphere;
+}
+
+// packs float vertices (anything with Position, Normal, TexCoords, Tangent and Bitangent) relative to bounds
+template <typename VertexType>
+inline std::vector<PackedVertex> packVertices(const VertexType *vertices, size_t count, const Bounds &bounds)
+{
+	glm::vec3 extent = bounds.max - bounds.min;
+	std::vector<PackedVertex> packed(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexType &v = vertices[i];
+		PackedVertex &p = packed[i];
+		for (int c = 0; c < 3; c++)
+			p.position[c] = extent[c] > 0.0f ? packUnorm16((v.Position[c] - bounds.min[c]) / extent[c]) : 0;
+		bool rightHanded = glm::dot(glm::cross(v.Normal, v.Tangent), v.Bitangent) >= 0.0f;
+		p.position[3] = rightHanded ? 65535 : 0;
+		packOct16(v.Normal, p.normal);
+		packOct16(v.Tangent, p.tangent);
+		p.texCoords[0] = floatToHalf(v.TexCoords.x);
+		p.texCoords[1] = floatToHalf(v.TexCoords.y);
+	}
+	return packed;
+}
+
+// what the vertex shader reconstructs from a packed vertex, used to measure the quantization error
+inline glm::vec3 unpackPosition(const PackedVertex &p, const Bounds &bounds)
+{
+	glm::vec3 extent = bounds.max - bounds.min;
+	return bounds.min + glm::vec3(unpackUnorm16(p.position[0]), unpackUnorm16(p.position[1]), unpackUnorm16(p.position[2])) * extent;
+}
+
+inline glm::vec2 unpackTexCoords(const PackedVertex &p)
+{
+	return glm::vec2(halfToFloat(p.texCoords[0]), halfToFloat(p.texCoords[1]));
+}
+#endif
@@ -8,25 +8,52 @@
 #include "Camera.h"
 #include "Model.h"
 #include"models.h"
-
+#include "InstancedModel.h"
+#include "SceneBVH.h"
+#include "ModelBenchmarks.h"
+#include "RenderQueueBenchmarks.h"
+#include "FrustumBenchmarks.h"
+#include "BVHBenchmarks.h"
+#include "InstancedModelBenchmarks.h"
+#include "TextureCompressionBenchmarks.h"
+#include "MipChainBenchmarks.h"
+#include "TextureBakerBenchmarks.h"
+#include "AssetPackageBenchmarks.h"
+#include "CubeMapBenchmarks.h"
+#include "UniformBufferChecks.h"
+#include "GLCallCounter.h"
+#include "Headless.h"
+#include "InputRecording.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "CommandBuffer.h"
+
+#include <functional>
 #include <iostream>
 #include<string>
+#include <cstring>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-void processInput(GLFWwindow *window);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+FrameInput processInput(GLFWwindow *window);
+void applyInput(const FrameInput &input);
 void deConstructModels();
+bool hasArgument(int argc, char** argv, const char* name);
+const char* argumentValue(int argc, char** argv, const char* name);
 
 // settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0; // time per frame spent uploading textures decoded in the background
 
 // camera
 Camera camera(glm::vec3(0.0f, 5.0f, 3.0f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
+FrameInput pendingInput; // what the mouse callbacks gathered since the last frame
 
 // timing
 float deltaTime = 0.0f;
@@ -46,11 +73,70 @@ PlainModel *plant;
 Ball *ball;
 Flowerpot *pot;
 WoodenCase *max_s_o;
+InstancedModel *scatteredPlants = NULL;
+
+// every mesh of the objects above except the skybox, for culling and mouse picking
+SceneBVH sceneBVH;
 
-int main()
+// moves the camera and the ball in fixed steps, on its own thread unless headless
+Simulation simulation;
+
+int main(int argc, char** argv)
 {
+	// --headless renders --frames N frames (300 by default) of --size WxH into an offscreen framebuffer without showing a
+	// window. the camera follows --camera-path <file> (see CameraPath::load) or circles the street, --capture <prefix>
+	// saves every --capture-every'th frame as <prefix>NNNN.png and --timings <file> gets the frame times (timings.json).
+	bool headless = hasArgument(argc, argv, "--headless");
+	unsigned int viewportWidth = SCR_WIDTH, viewportHeight = SCR_HEIGHT;
+	if (const char* size = argumentValue(argc, argv, "--size"))
+		sscanf(size, "%ux%u", &viewportWidth, &viewportHeight);
+
+	// SOIL builds its own mipmaps (SOIL_FLAG_MIPMAPS) on the thread pool
+	installSOILParallelFor();
+
+	const char* packagePath = argumentValue(argc, argv, "--package");
+	if (!packagePath)
+		packagePath = "assets.pack";
+
+	// benchmarks and tools that don't need OpenGL: run before there is a window, so they work without a display or a
+	// GPU, and before the package is opened, so they see the loose files. the checks that don't need OpenGL are the
+	// GLShaderTestChecks project
+	// ------------------------------------------------------------------------------------------------------------------
+	if (hasArgument(argc, argv, "--bench-command-buffer"))
+	{
+		benchmarkCommandBuffers();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-dxt"))
+	{
+		benchmarkDXTCompressors();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-mipmaps"))
+	{
+		benchmarkMipmaps();
+		return 0;
+	}
+	// --bake-textures writes the baked textures the loader prefers (TextureBaker.h) for every image under model/ and pic/,
+	// or only --bake-dir <dir>; --etc1 bakes ETC1 instead of DXT
+	if (hasArgument(argc, argv, "--bake-textures"))
+	{
+		const char* directory = argumentValue(argc, argv, "--bake-dir");
+		return bakeTextures(directory ? vector<string>{ directory } : vector<string>{ "model", "pic" }, hasArgument(argc, argv, "--etc1")) ? 0 : 1;
+	}
+	// --pack-assets packs the shaders, images, baked textures and model caches into --package <file> / assets.pack,
+	// LZ4 compressing the entries that gain from it unless --no-lz4
+	if (hasArgument(argc, argv, "--pack-assets"))
+		return packAssets(packagePath, !hasArgument(argc, argv, "--no-lz4")) ? 0 : 1;
+
 	// glfw: initialize and configure
 	// ------------------------------
+#ifdef GLFW_PLATFORM_NULL
+	// GLFW 3.4 can run without any display: the null platform with a surfaceless EGL context, which Mesa's llvmpipe
+	// provides on machines without a GPU. older versions still need an X server (Xvfb) for the hidden window.
+	if (headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -59,10 +145,17 @@ int main()
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+	if (headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+	}
 
 	// glfw window creation
 	// --------------------
-	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(viewportWidth, viewportHeight, "LearnOpenGL", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -73,9 +166,11 @@ int main()
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
 
 	// tell GLFW to capture our mouse
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless)
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	// glad: load all OpenGL function pointers
 	// ---------------------------------------
@@ -85,6 +180,21 @@ int main()
 		return -1;
 	}
 
+	// assets come out of a package when there is one: --package <file>, else assets.pack (see AssetPackage.h)
+	if (fileExists(packagePath))
+	{
+		if (assetPackage().open(packagePath))
+		{
+			std::cout << "assets from " << packagePath << " (" << assetPackage().entryCount() << " entries)" << std::endl;
+			// files edited since packing win over their entries, --pack-assets again to put them in
+			if (unsigned int edited = assetPackage().skipEditedEntries())
+				std::cout << "WARNING::ASSET_PACKAGE:: " << edited << " files changed since " << packagePath
+					<< " was packed, loading them from the disk" << std::endl;
+		}
+		else
+			std::cout << "WARNING::ASSET_PACKAGE:: could not open " << packagePath << std::endl;
+	}
+
 	// tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
 	//stbi_set_flip_vertically_on_load(true);
 
@@ -92,6 +202,106 @@ int main()
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
 
+	// benchmark modes: run, print the results and quit instead of entering the render loop
+	// -------------------------------------------------------------------------------------
+	if (hasArgument(argc, argv, "--bench-model-cache"))
+	{
+		benchmarkModelCache("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-import-threads"))
+	{
+		benchmarkImportThreads("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-mesh-allocations"))
+	{
+		benchmarkMeshAllocations("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--check-mesh-allocations"))
+	{
+		bool ok = checkMeshAllocations("model");
+		glfwTerminate();
+		return ok ? 0 : 1;
+	}
+	if (hasArgument(argc, argv, "--bench-vertex-format"))
+	{
+		bool ok = benchmarkVertexFormat("model");
+		glfwTerminate();
+		return ok ? 0 : 1;
+	}
+	if (hasArgument(argc, argv, "--bench-vertex-cache"))
+	{
+		benchmarkVertexCache("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-vertex-weld"))
+	{
+		benchmarkVertexWeld("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-render-queue"))
+	{
+		benchmarkRenderQueue();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-instance-packing"))
+	{
+		benchmarkInstancePacking();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-frustum-culling"))
+	{
+		benchmarkFrustumCulling();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-bvh"))
+	{
+		benchmarkBVH();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--lod-report"))
+	{
+		reportModelLods("model");
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-cubemap"))
+	{
+		benchmarkCubeMap();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-baked-textures"))
+	{
+		benchmarkBakedTextures();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--bench-package"))
+	{
+		benchmarkAssetPackage();
+		glfwTerminate();
+		return 0;
+	}
+	if (hasArgument(argc, argv, "--check-std140"))
+	{
+		bool ok = checkStd140Layouts();
+		glfwTerminate();
+		return ok ? 0 : 1;
+	}
+
+
 	// build and compile shaders
 	// -------------------------
 	Shader skyBoxShader("shaders/skyboxShader/skyboxVertexShader.vs", "shaders/skyboxShader/skyboxFragmentShader.fs");
@@ -103,23 +313,192 @@ int main()
 	street = new PlainModel(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), "model/street/Street environment_V01.obj", &envShader);
 	//city = new PlainModel(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), "model/City Islands/City Islands.obj", &envShader);
 	ball = new Ball(glm::vec3(0.0f, 0.20f, 0.0f), glm::vec3(0.0025f, 0.0025f, 0.0025f), "model/football/soccer ball.obj", &envShader);
-	pot = new Flowerpot(glm::vec3(5.0f, 0.6f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), "", NULL);
-	max_s_o = new WoodenCase(glm::vec3(8.0f, 0.6f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), "", NULL);
+	pot = new Flowerpot(glm::vec3(5.0f, 0.6f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), "", &envShader);
+	max_s_o = new WoodenCase(glm::vec3(8.0f, 0.6f, 2.0f), glm::vec3(1.0f, 1.0f, 1.0f), "", &envShader);
 	plant = new PlainModel(glm::vec3(10.0f, 0.1f, 0.0f), glm::vec3(0.1f, 0.1f, 0.1f), "model/plant/indoor plant_02.obj", &envShader);
 
+	// --scatter N puts N more plants around the street, all drawn instanced
+	if (const char* scatter = argumentValue(argc, argv, "--scatter"))
+	{
+		scatteredPlants = new InstancedModel(glm::vec3(0.0f, 0.1f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f), "model/plant/indoor plant_02.obj", &envShader);
+		srand(1);
+		vector<InstanceTransform> instances(atoi(scatter));
+		for (InstanceTransform &instance : instances)
+		{
+			instance.position = glm::vec3((float)(rand() % 4000) / 100.0f - 20.0f, 0.0f, (float)(rand() % 4000) / 100.0f - 20.0f);
+			instance.yaw = (float)(rand() % 360);
+			instance.scale = glm::vec3(0.1f);
+		}
+		scatteredPlants->setInstances(std::move(instances));
+	}
+
+	vector<BaseModel*> sceneObjects = { street, ball, pot, max_s_o, plant };
+	if (scatteredPlants)
+		sceneObjects.push_back(scatteredPlants);
+	sceneBVH.build(sceneObjects);
+
+	// camera and light change every frame and go through a triple buffered uniform block, the one material
+	// everything is drawn with is written once. both are bound at the shared binding points for all programs.
+	StreamingUniformBuffer frameUniforms(FRAME_BLOCK_BINDING, std140Size(FrameUniforms()));
+	MaterialUniforms material;
+	material.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+	material.shininess = 32.0f;
+	material.objectColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	StaticUniformBuffer materialUniforms(MATERIAL_BLOCK_BINDING, material);
+	materialUniforms.bind();
+
+	// uniform handles, looked up once so the render loop does no string work
+	UniformHandle envMaterialDiffuse = envShader.uniform("materialDiffuse");
+	UniformHandle envMaterialDiffuseArray = envShader.uniform("materialDiffuseArray");
+	UniformHandle skyBoxModel = skyBoxShader.uniform("model");
+	// --count-gl-calls prints the GL calls and the render queue stats per frame every second, --render-stats only the
+	// queue stats (draws, culled items, state changes). --no-uniform-cache shows what the calls were without the
+	// uniform cache, --no-culling what gets drawn without frustum culling. --flat-culling tests every queued item
+	// instead of going through the scene BVH. --no-lod draws every mesh at full detail, --lod-error sets how many pixels
+	// a level's error may cover on screen before a finer level is drawn (default 1).
+	bool countGLCalls = hasArgument(argc, argv, "--count-gl-calls");
+	bool renderStats = countGLCalls || hasArgument(argc, argv, "--render-stats");
+	bool frustumCulling = !hasArgument(argc, argv, "--no-culling");
+	bool flatCulling = frustumCulling && hasArgument(argc, argv, "--flat-culling");
+	bool bvhCulling = frustumCulling && !flatCulling;
+	if (countGLCalls)
+		installGLCallCounter();
+	if (hasArgument(argc, argv, "--no-uniform-cache"))
+		Shader::uniformCacheEnabled() = false;
+	lodSettings().enabled = !hasArgument(argc, argv, "--no-lod");
+	if (const char* lodError = argumentValue(argc, argv, "--lod-error"))
+		lodSettings().maxPixelError = (float)atof(lodError);
+	unsigned int countedFrames = 0;
+	float countStart = glfwGetTime();
+
+	// the scene objects are queued every frame, culled against the view frustum, sorted by program, textures, VAO
+	// and depth and then drawn with only the state changes that are left (see RenderQueue.h)
+	RenderQueue renderQueue;
+	GLRenderBackend renderBackend;
+	RenderQueueStats queueStats;
+	// --parallel-record submits the objects on the thread pool, each into a queue of its own, and records the sorted
+	// draws into per-thread command buffers that are then replayed here (see CommandBuffer.h)
+	bool parallelRecord = hasArgument(argc, argv, "--parallel-record");
+	vector<RenderQueue> objectQueues;
+	vector<CommandBuffer> commandBuffers;
+
+	// --replay <file> plays back the input --record <file> wrote in an earlier run instead of the live input, with the
+	// recorded time steps. headless, it also replaces the camera path and runs as many frames as were recorded.
+	InputReplayer inputReplayer;
+	InputRecorder inputRecorder;
+	if (const char* replayPath = argumentValue(argc, argv, "--replay"))
+	{
+		if (inputReplayer.open(replayPath))
+		{
+			inputReplayer.restoreCamera(camera);
+			// the recorded run may have had its textures sooner or later, the replay always has them all
+			asyncTextureLoader().finish();
+		}
+		else
+			std::cout << "ERROR::INPUT:: could not read recording " << replayPath << std::endl;
+	}
+	if (const char* recordPath = argumentValue(argc, argv, "--record"))
+		if (!inputRecorder.open(recordPath, camera))
+			std::cout << "ERROR::INPUT:: could not write recording " << recordPath << std::endl;
+
+	// headless: where the frames go, how the camera moves and what gets measured
+	OffscreenTarget offscreen;
+	FrameTimings frameTimings;
+	CameraPath cameraPath;
+	unsigned int headlessFrames = inputReplayer.frameCount() ? inputReplayer.frameCount() : 300, captureEvery = 1, frameIndex = 0;
+	const char* capturePrefix = argumentValue(argc, argv, "--capture");
+	if (headless)
+	{
+		if (const char* frames = argumentValue(argc, argv, "--frames"))
+			headlessFrames = (unsigned int)atoi(frames);
+		if (const char* every = argumentValue(argc, argv, "--capture-every"))
+			captureEvery = max(1, atoi(every));
+		const char* pathFile = argumentValue(argc, argv, "--camera-path");
+		if (pathFile && !cameraPath.load(pathFile))
+			std::cout << "ERROR::HEADLESS:: could not read camera path " << pathFile << std::endl;
+		if (!pathFile)
+			cameraPath = CameraPath::orbit(glm::vec3(0.0f, 0.0f, 0.0f), 12.0f, 5.0f, headlessFrames * HEADLESS_FRAME_TIME);
+		if (!offscreen.create(viewportWidth, viewportHeight))
+		{
+			std::cout << "ERROR::HEADLESS:: offscreen framebuffer incomplete" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		// every frame should show the real textures, not the placeholders
+		asyncTextureLoader().finish();
+	}
+
+	// --profile <file> writes the CPU and GPU times of the PROFILE_SCOPEs of the last frames as a Chrome trace
+	const char* profilePath = argumentValue(argc, argv, "--profile");
+#ifdef ENABLE_PROFILER
+	if (profilePath)
+		profiler().start();
+#else
+	if (profilePath)
+		std::cout << "ERROR::PROFILER:: built without ENABLE_PROFILER, --profile does nothing" << std::endl;
+#endif
+
+	// a recording is only reproducible if the steps each frame shows follow from the input alone, so recording and
+	// replaying step the simulation inline like headless does; only live play gets the thread
+	simulation.start(camera, ball, !headless && !inputReplayer.isOpen() && !inputRecorder.isOpen(), [](const Camera &simCamera) {
+		// a click goes where the camera looks: the ray through the middle of the screen picks the nearest mesh in the
+		// scene BVH and its object handles the click
+		SceneBVH::Hit hit;
+		return sceneBVH.pick(simCamera.Position, simCamera.Front, 100.0f, hit) ? hit.object : (BaseModel*)NULL;
+	});
+
 	// render loop
 	// -----------
-	while (!glfwWindowShouldClose(window))
+	while (!glfwWindowShouldClose(window) && !(headless && frameIndex >= headlessFrames))
 	{
+		PROFILE_FRAME();
+		PROFILE_SCOPE("Frame");
+
 		// per-frame time logic
 		// --------------------
-		float currentFrame = glfwGetTime();
+		float currentFrame = headless ? frameIndex * HEADLESS_FRAME_TIME : glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		// input
+		// input: the live one, or the next frame of the recording being replayed, which also brings its time step
 		// -----
-		processInput(window);
+		{
+			PROFILE_SCOPE("Input");
+			FrameInput input;
+			input.deltaTime = deltaTime;
+			if (!headless)
+				input = processInput(window);
+			if (inputReplayer.isOpen())
+			{
+				if (!inputReplayer.next(input))
+					break;
+				deltaTime = input.deltaTime;
+			}
+			if (inputRecorder.isOpen())
+				inputRecorder.record(input);
+			applyInput(input);
+		}
+
+		// what the simulation has got to, between its last two steps
+		SimState simState = Simulation::interpolate(simulation.latest());
+		if (headless && !inputReplayer.isOpen())
+			cameraPath.apply(camera, currentFrame);
+		else
+			Simulation::apply(simState, camera);
+		glm::mat4 ballModel = simulation.ballMatrix(simState);
+
+		if (headless)
+		{
+			frameTimings.begin();
+			offscreen.bind();
+		}
+
+		// finish textures the loader threads have decoded since the last frame
+		{
+			PROFILE_SCOPE("Texture uploads");
+			asyncTextureLoader().processUploads(TEXTURE_UPLOAD_BUDGET_MS);
+		}
+
 
 		// render
 		// ------
@@ -129,63 +508,183 @@ int main()
 
 
 		//=========================envShader====================================
-		envShader.use();
-		envShader.setVec3("objectColor", glm::vec3(1.0f, 1.0f, 1.0f));
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		const float farPlane = 100.0f;
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)viewportWidth / (float)viewportHeight, 0.1f, farPlane);
 		glm::mat4 view = camera.GetViewMatrix();
-		envShader.setMat4("projection", projection);
-		envShader.setMat4("view", view);
-		envShader.setVec3("viewPos", camera.Position);
-		envShader.setInt("material.diffuse", 0);
-		envShader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-		envShader.setFloat("material.shininess", 32.0f);
-		envShader.setVec3("light.position", lightPosition);
-		envShader.setVec3("light.ambient", 0.3f, 0.3f, 0.3f);
-		envShader.setVec3("light.diffuse", 0.6f, 0.6f, 0.6f); // յһЩԴ䳡
-		envShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-
-
-
-		envShader.setMat4("model", street->getModel());
-		street->draw();
-
-
-		envShader.setMat4("model", ball->getModel());
-		ball->setOrientation(camera.Front, camera.Right);
-		ball->draw();
-
-		envShader.setMat4("model", pot->getModel());
-		pot->draw();
-
-		envShader.setMat4("model", pot->getModel());
-		max_s_o->draw();
-
-		envShader.setMat4("model", max_s_o->getModel());
-		max_s_o->draw();
-
-		envShader.setMat4("model", plant->getModel());
-		plant->draw();
+		FrameUniforms frame;
+		frame.projection = projection;
+		frame.view = view;
+		frame.viewPos = camera.Position;
+		frame.light.position = lightPosition;
+		frame.light.ambient = glm::vec3(0.3f, 0.3f, 0.3f);
+		frame.light.diffuse = glm::vec3(0.6f, 0.6f, 0.6f); // յһЩԴ䳡
+		frame.light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		{
+			PROFILE_SCOPE("Shader setup");
+			frameUniforms.update(frame);
+			lodSettings().setProjection(camera.Zoom, (float)viewportHeight);
+
+			envShader.use();
+			envShader.setInt(envMaterialDiffuse, 0);
+			envShader.setInt(envMaterialDiffuseArray, MATERIAL_ARRAY_UNIT);
+		}
+
+
+
+		// the ball is the only thing that moves, its boxes are refitted instead of rebuilding the tree
+		Frustum frustum = extractFrustum(projection * view);
+		size_t bvhCulled = 0;
+		if (bvhCulling)
+		{
+			PROFILE_SCOPE("SceneBVH::cull");
+			sceneBVH.refit(ball, ballModel);
+			bvhCulled = sceneBVH.cull(frustum);
+		}
+
+		{
+			PROFILE_SCOPE("Submit");
+			// one entry per object, an object's submissions stay together since they share its level of detail state
+			const std::function<void(RenderQueue&)> submissions[] = {
+				[&](RenderQueue &queue) {
+					street->submit(queue, street->getModel(), camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(street) : NULL);
+				},
+				[&](RenderQueue &queue) {
+					ball->submit(queue, ballModel, camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(ball) : NULL);
+				},
+				[&](RenderQueue &queue) {
+					pot->submit(queue, pot->getModel(), camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(pot) : NULL);
+				},
+				[&](RenderQueue &queue) {
+					// same cube at the pot's place, so the pot's visibility holds for it
+					max_s_o->submit(queue, pot->getModel(), camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(pot) : NULL);
+
+					max_s_o->submit(queue, max_s_o->getModel(), camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(max_s_o) : NULL);
+				},
+				[&](RenderQueue &queue) {
+					plant->submit(queue, plant->getModel(), camera.Position, farPlane, bvhCulling ? sceneBVH.visibleMeshes(plant) : NULL);
+				},
+				[&](RenderQueue &queue) {
+					if (scatteredPlants)
+						scatteredPlants->submit(queue, scatteredPlants->getModel(), camera.Position, farPlane,
+							bvhCulling ? sceneBVH.visibleMeshes(scatteredPlants) : NULL);
+				},
+			};
+			const size_t submissionCount = sizeof(submissions) / sizeof(submissions[0]);
+			if (parallelRecord)
+			{
+				// the instance buffer upload is GL, it can't happen on a worker
+				if (scatteredPlants)
+					scatteredPlants->update();
+				objectQueues.resize(submissionCount);
+				sharedThreadPool().parallelFor(submissionCount, [&](size_t i) { submissions[i](objectQueues[i]); });
+				// appended in a fixed order, so the sort breaks ties the same way every frame
+				for (RenderQueue &queue : objectQueues)
+					renderQueue.append(queue);
+			}
+			else
+			{
+				for (size_t i = 0; i < submissionCount; i++)
+					submissions[i](renderQueue);
+			}
+		}
+
+		if (flatCulling)
+			renderQueue.cull(frustum);
+		renderQueue.sort();
+		RenderQueueStats frameStats;
+		if (parallelRecord)
+		{
+			frameStats = recordRenderQueue(renderQueue, sharedThreadPool(), commandBuffers);
+			replayCommandBuffers(commandBuffers, renderBackend, frameStats);
+		}
+		else
+			frameStats = renderQueue.execute(renderBackend);
+		frameStats.culled += bvhCulled;
+		queueStats += frameStats;
+		renderBackend.finish();
 
 
 		//=====================================skyBoxShader=================================
 		// ưΧ
 		//glDepthFunc(GL_LEQUAL); // Ȳ Сڵ
-		skyBoxShader.use();
-		skyBoxShader.setMat4("projection", projection);
-		skyBoxShader.setMat4("view", view);
-
-
-		skybox->setPosition(camera.Position);
-		skyBoxShader.setMat4("model", skybox->getModel());
-		skybox->draw();
-
+		{
+			PROFILE_SCOPE("Skybox");
+			skyBoxShader.use();
+
+
+			skybox->setPosition(camera.Position);
+			skyBoxShader.setMat4(skyBoxModel, skybox->getModel());
+			skybox->draw();
+		}
+
+
+		if (headless)
+		{
+			frameTimings.end();
+			if (capturePrefix && frameIndex % captureEvery == 0)
+			{
+				char path[1024];
+				snprintf(path, sizeof(path), "%s%04u.png", capturePrefix, frameIndex);
+				if (!offscreen.save(path))
+					std::cout << "ERROR::HEADLESS:: could not save " << path << std::endl;
+			}
+			frameIndex++;
+		}
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
+		if (!headless)
+		{
+			PROFILE_SCOPE("SwapBuffers");
+			glfwSwapBuffers(window);
+		}
 		glfwPollEvents();
+
+		if (renderStats)
+		{
+			countedFrames++;
+			if (glfwGetTime() - countStart >= 1.0)
+			{
+				if (countGLCalls)
+					printGLCallStats(countedFrames);
+				printRenderQueueStats(queueStats, countedFrames);
+				glCallStats().reset();
+				queueStats = RenderQueueStats();
+				countedFrames = 0;
+				countStart = glfwGetTime();
+			}
+		}
 	}
 
+	if (headless)
+	{
+		const char* timingsPath = argumentValue(argc, argv, "--timings");
+		if (!frameTimings.writeJson(timingsPath ? timingsPath : "timings.json", viewportWidth, viewportHeight))
+			std::cout << "ERROR::HEADLESS:: could not write " << (timingsPath ? timingsPath : "timings.json") << std::endl;
+		frameTimings.release();
+		offscreen.release();
+	}
+
+	simulation.stop();
+
+#ifdef ENABLE_PROFILER
+	if (profilePath)
+	{
+		profiler().stop();
+		if (!profiler().writeChromeTrace(profilePath))
+			std::cout << "ERROR::PROFILER:: could not write " << profilePath << std::endl;
+		profiler().release();
+	}
+#endif
+
+	if (!inputRecorder.close())
+		std::cout << "ERROR::INPUT:: could not finish writing the recording" << std::endl;
+
+	frameUniforms.release();
+	materialUniforms.release();
+	if (scatteredPlants)
+		scatteredPlants->release();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -195,6 +694,21 @@ int main()
 	return 0;
 }
 
+bool hasArgument(int argc, char** argv, const char* name) {
+	for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return true;
+	return false;
+}
+
+// the argument following name, NULL if name isn't given or is the last argument
+const char* argumentValue(int argc, char** argv, const char* name) {
+	for (int i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], name) == 0)
+			return argv[i + 1];
+	return NULL;
+}
+
 void deConstructModels() {
 	delete skybox;
 	delete street;
@@ -202,6 +716,7 @@ void deConstructModels() {
 	delete pot;
 	delete max_s_o;
 	delete plant;
+	delete scatteredPlants;
 }
 
 
@@ -212,47 +727,73 @@ void windowProcessInput(GLFWwindow *window) {
 }
 
 //ʱĴ߼
-void cameraProcessInput(GLFWwindow *window) {
+void cameraProcessInput(GLFWwindow *window, FrameInput &input) {
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		camera.ProcessKeyboard(FORWARD, deltaTime);
+		input.keys |= cameraKey(FORWARD);
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
+		input.keys |= cameraKey(BACKWARD);
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		camera.ProcessKeyboard(LEFT, deltaTime);
+		input.keys |= cameraKey(LEFT);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		camera.ProcessKeyboard(RIGHT, deltaTime);
+		input.keys |= cameraKey(RIGHT);
 	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-		camera.ProcessKeyboard(UP, deltaTime);
+		input.keys |= cameraKey(UP);
 	if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
-		camera.ProcessKeyboard(DOWN, deltaTime);
+		input.keys |= cameraKey(DOWN);
 	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-		camera.ProcessKeyboard(SHIFT_PRESS, deltaTime);
-	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE)
-		camera.ProcessKeyboard(SHIFT_RELEASE, deltaTime);
+		input.keys |= cameraKey(SHIFT_PRESS);
 }
 
 //ʱģ[football]Ĵ߼
-void modelFootballProcessInput(GLFWwindow *window) {
+void modelFootballProcessInput(GLFWwindow *window, FrameInput &input) {
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-		ball->ProcessKeyboard(FORWARD, deltaTime);
+		input.keys |= ballKey(FORWARD);
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-		ball->ProcessKeyboard(BACKWARD, deltaTime);
+		input.keys |= ballKey(BACKWARD);
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		ball->ProcessKeyboard(LEFT, deltaTime);
+		input.keys |= ballKey(LEFT);
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		ball->ProcessKeyboard(RIGHT, deltaTime);
+		input.keys |= ballKey(RIGHT);
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// process all input: query GLFW whether relevant keys are pressed/released this frame and collect them with what the
+// mouse callbacks gathered since the last frame. applyInput reacts to it, so a recorded frame can take its place.
 // ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow *window)
+FrameInput processInput(GLFWwindow *window)
 {
 	windowProcessInput(window);
-	cameraProcessInput(window);
-	modelFootballProcessInput(window);
+	FrameInput input = pendingInput;
+	pendingInput = FrameInput();
+	input.deltaTime = deltaTime;
+	cameraProcessInput(window, input);
+	modelFootballProcessInput(window, input);
+	return input;
+}
 
+// hands one frame of input to the simulation, which moves the camera and the ball (Simulation::advance)
+// -----------------------------------------------------------------------------------------------------
+void applyInput(const FrameInput &input)
+{
+	SimInput simInput;
+	simInput.input = input;
 
+	// stepping inline the simulation picks from its own camera. on its thread, which only live play uses, the clicks
+	// are picked here, from the camera of the last frame drawn: the BVH is refitted on this thread
+	if (simulation.threaded())
+	{
+		const MOUSE_EVENT clickEvents[3] = { LCLICK, RCLICK, MCLICK };
+		for (int button = 0; button < 3; button++)
+		{
+			for (int i = 0; i < input.clicks[button]; i++)
+			{
+				SceneBVH::Hit hit;
+				if (sceneBVH.pick(camera.Position, camera.Front, 100.0f, hit))
+					simInput.clicks.push_back(SimClick{ hit.object, clickEvents[button] });
+			}
+		}
+	}
 
+	simulation.submit(std::move(simInput));
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -281,12 +822,33 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	lastX = xpos;
 	lastY = ypos;
 
-	camera.ProcessMouseMovement(xoffset, yoffset);
+	pendingInput.mouseX += xoffset;
+	pendingInput.mouseY += yoffset;
+}
+
+// glfw: a mouse button was pressed. the click is handled with the rest of the frame's input (applyInput).
+// -------------------------------------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (action != GLFW_PRESS)
+		return;
+	int index;
+	if (button == GLFW_MOUSE_BUTTON_LEFT)
+		index = 0;
+	else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+		index = 1;
+	else if (button == GLFW_MOUSE_BUTTON_MIDDLE)
+		index = 2;
+	else
+		return;
+
+	if (pendingInput.clicks[index] < 255)
+		pendingInput.clicks[index]++;
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	camera.ProcessMouseScroll(yoffset);
+	pendingInput.scroll += (float)yoffset;
 }
\ No newline at end of file
@@ -6,10 +6,12 @@
 #include <glm/gtc/type_ptr.hpp>
 #include"Shader.h"
 #include"Model.h"
+#include"CubeMap.h"
 
 
 void loadTexture(char const* path, unsigned int* textureID);
-GLuint loadCubeMapTexture(std::vector<const char*> picFilePathVec,
+GLenum uploadWeldedVertices(const float* vertices, size_t vertexCount, size_t floatsPerVertex, GLuint vbo, GLuint ebo, GLsizei* indexCount);
+GLuint loadCubeMapTexture(const std::vector<std::string>& picFilePathVec,
 	GLint internalFormat = GL_RGB,
 	GLenum picFormat = GL_RGB,
 	GLenum picDataType = GL_UNSIGNED_BYTE,
@@ -43,6 +45,21 @@ public:
 
 	virtual void draw() = 0;
 
+	// queues the draws of the model with the given model matrix instead of drawing right away, see RenderQueue.h.
+	// visibleMeshes has a flag per mesh (see meshCount), NULL submits everything
+	virtual void submit(RenderQueue &queue, const glm::mat4 &modelMatrix, const glm::vec3 &eye, float farPlane, const uint8_t* visibleMeshes) {
+		model->Submit(queue, *shader, modelMatrix, eye, farPlane, visibleMeshes);
+	}
+
+	// the separately culled parts of the object and their local bounds, what the scene BVH is built from
+	virtual size_t meshCount() {
+		return model->meshes.size();
+	}
+
+	virtual Bounds meshBounds(size_t i) {
+		return model->meshes[i].bounds;
+	}
+
 	virtual glm::mat4 getModel() = 0;
 
 	virtual void ProcessKeyboard(Movement direction, float deltaTime) = 0;
@@ -53,6 +70,10 @@ public:
 		this->Position = Position;
 	}
 
+	glm::vec3 getPosition() const {
+		return Position;
+	}
+
 	void setScaleValue(glm::vec3 scale_value) {
 		this->scale_value = scale_value;
 	}
@@ -66,6 +87,26 @@ public:
 		this->model = model;
 	}
 
+protected:
+	// one item for a VAO of indexed vertices with the given local bounds, sorted by its distance to the eye
+	void submitIndexed(RenderQueue &queue, const glm::mat4 &modelMatrix, const glm::vec3 &eye, float farPlane,
+		const RenderMaterial &material, const Bounds &bounds, GLuint vao, GLenum indexType, GLsizei indexCount) {
+		DrawItem item;
+		transformBounds(bounds, modelMatrix, item.center, item.extent);
+		item.key = makeSortKey(0, shader->serial, material.id, vao, glm::length(glm::vec3(modelMatrix[3]) - eye), farPlane);
+		item.shader = shader;
+		item.program = shader->ID;
+		item.material = &material;
+		item.vao = vao;
+		item.indexType = indexType;
+		item.count = indexCount;
+		item.firstIndex = 0;
+		item.model = modelMatrix;
+		item.packedBounds = nullptr;
+		item.instanceCount = 0;
+		queue.submit(item);
+	}
+
 
 
 };
@@ -83,6 +124,7 @@ public:
 	~PlainModel() {}
 
 	void draw() {
+		PROFILE_SCOPE("PlainModel::draw");
 		model->Draw(*shader);
 	}
 
@@ -120,6 +162,7 @@ public:
 	~Ball() {}
 
 	void draw() {
+		PROFILE_SCOPE("Ball::draw");
 		model->Draw(*shader);
 
 	}
@@ -151,6 +194,13 @@ public:
 		return model;
 	}
 
+	// what getModel returns for the given state, for a ball whose state comes from the simulation (Simulation.h)
+	glm::mat4 poseMatrix(const glm::vec3 &position, float angle, const glm::vec3 &rotationAxis) const {
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+		model = glm::scale(model, this->scale_value);
+		return glm::rotate(model, glm::radians(angle), rotationAxis);
+	}
+
 	//ڽֵƽƶ
 	void setOrientation(glm::vec3 front, glm::vec3 right) {
 		Front = glm::normalize(front);
@@ -209,8 +259,12 @@ public:
 			MovementSpeed = SPEED;
 	}
 
+	// clicked: the left button kicks the ball one step away from the camera, the right one pulls it back a step
 	void ProcessMouse(MOUSE_EVENT event) {
-
+		float step = event == LCLICK ? 1.0f : (event == RCLICK ? -1.0f : 0.0f);
+		Position += Front * step;
+		rotateAngle -= step * rotateRate;
+		if (fabs(rotateAngle) > 360) rotateAngle = 0.0f;
 	}
 
 
@@ -286,11 +340,12 @@ public:
 		};
 		glGenVertexArrays(1, &cubeVAO);
 		glGenBuffers(1, &VBO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(cubeVAO);
+		// the 36 corners share 24 distinct vertices, draw those indexed
+		indexType = uploadWeldedVertices(vertices, sizeof(vertices) / sizeof(float) / 8, 8, VBO, EBO, &indexCount);
+		bounds = computeFloatBounds(vertices, sizeof(vertices) / sizeof(float) / 8, 8);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -304,6 +359,8 @@ public:
 		glGenTextures(1, &diffuseMap);
 
 		loadTexture("pic/container2.jpg", &diffuseMap);
+		// the fragment shader reads it as materialDiffuse, which stays on unit 0
+		material = RenderMaterial({ { GL_TEXTURE_2D, diffuseMap, "" } });
 
 
 	}
@@ -312,6 +369,7 @@ public:
 
 	//ģ
 	void draw() {
+		PROFILE_SCOPE("Flowerpot::draw");
 		//ʵֻƵĴд
 			   // bind diffuse map
 		glActiveTexture(GL_TEXTURE0);
@@ -319,8 +377,21 @@ public:
 
 		// render the cube
 		glBindVertexArray(cubeVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+
+	}
+
+	void submit(RenderQueue &queue, const glm::mat4 &modelMatrix, const glm::vec3 &eye, float farPlane, const uint8_t* visibleMeshes) {
+		if (!visibleMeshes || visibleMeshes[0])
+			submitIndexed(queue, modelMatrix, eye, farPlane, material, bounds, cubeVAO, indexType, indexCount);
+	}
+
+	size_t meshCount() {
+		return 1;
+	}
 
+	Bounds meshBounds(size_t i) {
+		return bounds;
 	}
 
 	//õģϵΪĬʵ
@@ -339,8 +410,12 @@ public:
 
 	}
 
-	unsigned int VBO, cubeVAO;
+	unsigned int VBO, EBO, cubeVAO;
 	unsigned int diffuseMap;
+	GLsizei indexCount;
+	GLenum indexType;
+	RenderMaterial material;
+	Bounds bounds;
 
 
 
@@ -408,11 +483,12 @@ public:
 		};
 		glGenVertexArrays(1, &cubeVAO);
 		glGenBuffers(1, &VBO);
-
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(cubeVAO);
+		// the 36 corners share 24 distinct vertices, draw those indexed
+		indexType = uploadWeldedVertices(vertices, sizeof(vertices) / sizeof(float) / 8, 8, VBO, EBO, &indexCount);
+		bounds = computeFloatBounds(vertices, sizeof(vertices) / sizeof(float) / 8, 8);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -426,6 +502,8 @@ public:
 		glGenTextures(1, &diffuseMap);
 
 		loadTexture("pic/container.jpg", &diffuseMap);
+		// the fragment shader reads it as materialDiffuse, which stays on unit 0
+		material = RenderMaterial({ { GL_TEXTURE_2D, diffuseMap, "" } });
 
 
 	}
@@ -434,6 +512,7 @@ public:
 
 	//ģ
 	void draw() {
+		PROFILE_SCOPE("WoodenCase::draw");
 		//ʵֻƵĴд
 			   // bind diffuse map
 		glActiveTexture(GL_TEXTURE0);
@@ -441,8 +520,21 @@ public:
 
 		// render the cube
 		glBindVertexArray(cubeVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+
+	}
+
+	void submit(RenderQueue &queue, const glm::mat4 &modelMatrix, const glm::vec3 &eye, float farPlane, const uint8_t* visibleMeshes) {
+		if (!visibleMeshes || visibleMeshes[0])
+			submitIndexed(queue, modelMatrix, eye, farPlane, material, bounds, cubeVAO, indexType, indexCount);
+	}
+
+	size_t meshCount() {
+		return 1;
+	}
 
+	Bounds meshBounds(size_t i) {
+		return bounds;
 	}
 
 	//õģϵΪĬʵ
@@ -462,8 +554,12 @@ public:
 	}
 
 
-	unsigned int VBO, cubeVAO;
+	unsigned int VBO, EBO, cubeVAO;
 	unsigned int diffuseMap;
+	GLsizei indexCount;
+	GLenum indexType;
+	RenderMaterial material;
+	Bounds bounds;
 
 
 
@@ -581,9 +677,9 @@ public:
 		// Section2 ׼
 		glGenVertexArrays(1, &cubeVAOId);
 		glGenBuffers(1, &cubeVBOId);
+		glGenBuffers(1, &cubeEBOId);
 		glBindVertexArray(cubeVAOId);
-		glBindBuffer(GL_ARRAY_BUFFER, cubeVBOId);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
+		cubeIndexType = uploadWeldedVertices(cubeVertices, sizeof(cubeVertices) / sizeof(GLfloat) / 5, 5, cubeVBOId, cubeEBOId, &cubeIndexCount);
 		// λ
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
 			5 * sizeof(GL_FLOAT), (GLvoid*)0);
@@ -597,9 +693,10 @@ public:
 
 		glGenVertexArrays(1, &skyBoxVAOId);
 		glGenBuffers(1, &skyBoxVBOId);
+		glGenBuffers(1, &skyBoxEBOId);
 		glBindVertexArray(skyBoxVAOId);
-		glBindBuffer(GL_ARRAY_BUFFER, skyBoxVBOId);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
+		// positions only, so the 36 corners collapse into the 8 corners of the box
+		skyBoxIndexType = uploadWeldedVertices(skyboxVertices, sizeof(skyboxVertices) / sizeof(GLfloat) / 3, 3, skyBoxVBOId, skyBoxEBOId, &skyBoxIndexCount);
 		// λ
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
 			3 * sizeof(GL_FLOAT), (GLvoid*)0);
@@ -608,16 +705,12 @@ public:
 
 		// Section3 
 		loadTexture("pic/container.jpg", &cubeTextId);
-		std::vector<const char*> faces;
-		faces.push_back("pic/skyboxes/sky/right.jpg");
-		faces.push_back("pic/skyboxes/sky/left.jpg");
-		faces.push_back("pic/skyboxes/sky/bottom.jpg");
-		faces.push_back("pic/skyboxes/sky/top.jpg");
-		faces.push_back("pic/skyboxes/sky/front.jpg");
-		faces.push_back("pic/skyboxes/sky/back.jpg");
+		// right, left, bottom, top, front, back.jpg
+		std::vector<std::string> faces = cubeMapFaces("pic/skyboxes/sky");
 
 
 		skyBoxTextId = loadCubeMapTexture(faces);
+		skyBoxSampler = shader->uniform("skybox");
 		// Section4 ׼ɫ
 
 		 /*glEnable(GL_DEPTH_TEST);
@@ -630,14 +723,15 @@ public:
 	~SkyBox() {}
 
 	void draw() {
+		PROFILE_SCOPE("SkyBox::draw");
 		/*glEnable(GL_DEPTH_TEST);
 		glEnable(GL_CULL_FACE);*/
 		glDepthFunc(GL_LESS);
 		glBindVertexArray(skyBoxVAOId);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_CUBE_MAP, skyBoxTextId); // ע󶨵CUBE_MAP
-		glUniform1i(glGetUniformLocation(shader->ID, "skybox"), 0);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		shader->setInt(skyBoxSampler, 0);
+		glDrawElements(GL_TRIANGLES, skyBoxIndexCount, skyBoxIndexType, 0);
 
 		glBindVertexArray(0);
 		glUseProgram(0);
@@ -662,10 +756,13 @@ public:
 	}
 
 
-	GLuint cubeVAOId, cubeVBOId;
-	GLuint skyBoxVAOId, skyBoxVBOId;
+	GLuint cubeVAOId, cubeVBOId, cubeEBOId;
+	GLuint skyBoxVAOId, skyBoxVBOId, skyBoxEBOId;
+	GLsizei cubeIndexCount, skyBoxIndexCount;
+	GLenum cubeIndexType, skyBoxIndexType;
 	GLuint cubeTextId;
 	GLuint skyBoxTextId;
+	UniformHandle skyBoxSampler;
 
 };
 
@@ -689,74 +786,39 @@ public:
 
 void loadTexture(char const* path, unsigned int* textureID)
 {
+	// decoded in the background, see TextureLoader.h and TextureUpload.h; the texture is usable (as a placeholder) right away
+	*textureID = loadTextureAsync(path);
+}
 
-	glGenTextures(1, textureID);
 
-	int width, height, nrComponents;
-	unsigned char* data = SOIL_load_image(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, *textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		SOIL_free_image_data(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		SOIL_free_image_data(data);
-	}
+/*
+ * uploads a vertex array written for glDrawArrays(GL_TRIANGLES) as welded vertices (see MeshOptimizer.h) plus
+ * indices into vbo / ebo. The VAO they belong to must be bound; the attribute pointers are set up by the caller as
+ * before, the layout of a vertex doesn't change. Returns the index type for glDrawElements.
+ */
+GLenum uploadWeldedVertices(const float* vertices, size_t vertexCount, size_t floatsPerVertex, GLuint vbo, GLuint ebo, GLsizei* indexCount)
+{
+	std::vector<float> weldedVertices;
+	std::vector<unsigned int> indices;
+	weldFloatVertices(vertices, vertexCount, floatsPerVertex, MODEL_WELD_EPSILON, weldedVertices, indices);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, weldedVertices.size() * sizeof(float), weldedVertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	*indexCount = (GLsizei)indices.size();
+	return uploadIndexBuffer(indices.data(), indices.size(), weldedVertices.size() / floatsPerVertex);
 }
 
 
 /*
  * һcubeMap
  */
-GLuint loadCubeMapTexture(std::vector<const char*> picFilePathVec,
+GLuint loadCubeMapTexture(const std::vector<std::string>& picFilePathVec,
 	GLint internalFormat,
 	GLenum picFormat,
 	GLenum picDataType,
 	int loadChannels)
 {
-	GLuint textId;
-	glGenTextures(1, &textId);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textId);
-	GLubyte *imageData = NULL;
-	int picWidth, picHeight;
-	for (std::vector<const char*>::size_type i = 0; i < picFilePathVec.size(); ++i)
-	{
-		int channels = 0;
-		imageData = SOIL_load_image(picFilePathVec[i], &picWidth,
-			&picHeight, &channels, loadChannels);
-		if (imageData == NULL)
-		{
-			std::cerr << "Error::loadCubeMapTexture could not load texture file:"
-				<< picFilePathVec[i] << std::endl;
-			return 0;
-		}
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-			0, internalFormat, picWidth, picHeight, 0, picFormat, picDataType, imageData);
-		SOIL_free_image_data(imageData);
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-	return textId;
+	// the faces are decoded in parallel, or a baked cubemap is used (CubeMap.h)
+	return loadCubeMap(picFilePathVec, internalFormat, picFormat, picDataType, loadChannels, supportedBakedFormats());
 }
\ No newline at end of file
@@ -8,16 +8,20 @@ in vec3 FragPos;
 uniform sampler2D texture_diffuse1;
 
 uniform vec3 lightColor;
-uniform vec3 objectColor;
-uniform vec3 viewPos;
 
-struct Material {
-    sampler2D diffuse;
+uniform sampler2D materialDiffuse;
+
+// diffuse textures packed into an array (TextureArrays.h) are read from layer materialLayer of materialDiffuseArray,
+// which is on unit 1; a negative layer means the material uses materialDiffuse
+uniform sampler2DArray materialDiffuseArray;
+uniform float materialLayer = -1.0;
+
+// per-material values (MATERIAL_BLOCK_BINDING in UniformBuffer.h)
+layout (std140) uniform MaterialBlock {
     vec3 specular;
     float shininess;
-}; 
-
-uniform Material material;
+    vec3 objectColor;
+} material;
 
 struct Light {
     vec3 position;
@@ -27,18 +31,32 @@ struct Light {
     vec3 specular;
 };
 
-uniform Light light;
+// per-frame values shared by all programs (FRAME_BLOCK_BINDING in UniformBuffer.h)
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
+vec3 diffuseColor()
+{
+	if (materialLayer >= 0.0)
+		return vec3(texture(materialDiffuseArray, vec3(TexCoords, materialLayer)));
+	return vec3(texture(materialDiffuse, TexCoords));
+}
 
 void main()
 { 
+	vec3 albedo = diffuseColor();
 	// ambient
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.ambient * albedo;
 
 	/**/
 	vec3 norm = normalize(Normal);//ѷ׼
 	vec3 lightDir = normalize(light.position - FragPos); //Դ򣺹Դλ - Ƭλ
 	float diff = max(dot(norm, lightDir), 0.0);    //ˣнǷԽͻԽС
-	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+	vec3 diffuse = light.diffuse * diff * albedo;
 
 	/*淴*/
 	vec3 viewDir = normalize(viewPos - FragPos);
@@ -47,7 +65,7 @@ void main()
 	vec3 specular = light.specular * (spec * material.specular);
 
 	/*ϲ*/
-	vec3 result = (ambient + diffuse + specular) * objectColor;
+	vec3 result = (ambient + diffuse + specular) * material.objectColor;
 	FragColor = vec4(result, 1.0);
 
    // FragColor = texture(texture_diffuse1, TexCoords);
@@ -1,5 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
@@ -8,15 +8,51 @@ out vec3 Normal;
 out vec3 FragPos;  
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
+// instanced draws (InstancedModel.h) get one model matrix per instance, model then places the whole group
+uniform bool instanced;
+layout (location = 5) in mat4 instanceModel;
+
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame values shared by all programs (FRAME_BLOCK_BINDING in UniformBuffer.h)
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
+// packed meshes (VERTEX_LAYOUT_PACKED in VertexFormat.h): positions are normalized to the mesh bounds
+// and normals are octahedral encoded, both arrive here as unsigned normalized values
+uniform bool packedVertices;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 octDecode(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
 
 void main()
 {
+	vec3 position = packedVertices ? positionOffset + aPos.xyz * positionScale : aPos.xyz;
+	vec3 normal = packedVertices ? octDecode(aNormal.xy) : aNormal;
+
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-	FragPos = vec3(model * vec4(aPos, 1.0));
+	mat4 world = instanced ? model * instanceModel : model;
+    gl_Position = projection * view * world * vec4(position, 1.0);
+	FragPos = vec3(world * vec4(position, 1.0));
 	//Normal = aNormal;
-	Normal = mat3(transpose(inverse(model))) * aNormal;
-}
\ No newline at end of file
+	Normal = mat3(transpose(inverse(world))) * normal;
+}   
\ No newline at end of file
@@ -3,8 +3,22 @@
 layout(location = 0) in vec3 position;
 
 
-uniform mat4 projection;
-uniform mat4 view;
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame values shared by all programs (FRAME_BLOCK_BINDING in UniformBuffer.h)
+layout (std140) uniform FrameBlock {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    Light light;
+};
+
 uniform mat4 model;
 out vec3 TextCoord;
 void main()
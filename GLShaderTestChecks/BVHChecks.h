@@ -0,0 +1,143 @@
+#ifndef BVH_CHECKS_H
+#define BVH_CHECKS_H
+
+#include <glm/glm.hpp>
+
+#include "BVH.h"
+#include "Check.h"
+#include "Frustum.h"
+#include "FrustumBenchmarks.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+// what queryFrustum has to find: every box that isn't empty and that boxVisible doesn't rule out, in index order
+inline vector<uint32_t> visibleBoxes(const vector<Bounds> &boxes, const Frustum &frustum)
+{
+	vector<uint32_t> visible;
+	for (size_t i = 0; i < boxes.size(); i++)
+		if (!isEmpty(boxes[i]) && boxVisible(frustum, (boxes[i].min + boxes[i].max) * 0.5f, (boxes[i].max - boxes[i].min) * 0.5f))
+			visible.push_back((uint32_t)i);
+	return visible;
+}
+
+// the tree's answers against testing every box, for the frustum and for rays from origin. a ray may pick either of two
+// boxes entered at the same distance. returns the number of queries that differ.
+inline size_t compareBVH(const BVH &bvh, const vector<Bounds> &boxes, const Frustum &frustum, const glm::vec3 &origin, int rays)
+{
+	size_t differences = 0;
+	vector<uint32_t> found;
+	bvh.queryFrustum(frustum, found);
+	sort(found.begin(), found.end());
+	differences += found != visibleBoxes(boxes, frustum);
+
+	for (int ray = 0; ray < rays; ray++)
+	{
+		glm::vec3 direction = glm::normalize(glm::vec3(rand() % 2001 - 1000.0f, rand() % 2001 - 1000.0f, rand() % 2001 - 1000.0f) +
+			glm::vec3(0.001f));
+		glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float nearest = 1000.0f, enter;
+		int expected = -1;
+		for (size_t i = 0; i < boxes.size(); i++)
+			if (!isEmpty(boxes[i]) && rayIntersectsBounds(origin, inverse, boxes[i], nearest, enter) && enter >= 0.0f && enter < nearest)
+			{
+				nearest = enter;
+				expected = (int)i;
+			}
+		uint32_t primitive = 0;
+		float distance = 0.0f;
+		int hit = bvh.raycast(origin, direction, 1000.0f, primitive, distance) ? (int)primitive : -1;
+		if (hit == expected)
+			continue;
+		bool tie = hit >= 0 && expected >= 0 && !isEmpty(boxes[hit]) && rayIntersectsBounds(origin, inverse, boxes[hit], 1000.0f, enter) &&
+			fabs(enter - nearest) < 1e-4f;
+		differences += !tie;
+	}
+	return differences;
+}
+
+// BVH against testing every box: frustum queries and ray picks on random boxes with empty ones among them, before and
+// after refitting boxes that move, that become empty and that were empty at build time; an empty tree and a tree of
+// one box. empty boxes are never found.
+inline bool checkBVH()
+{
+	CheckResult result("bvh");
+	Frustum frustum = sceneFrustum();
+	srand(3);
+	uint32_t primitive;
+	float distance;
+	vector<uint32_t> found;
+
+	BVH empty;
+	empty.build(vector<Bounds>());
+	empty.queryFrustum(frustum, found);
+	result.expect(found.empty() && !empty.raycast(SCENE_EYE, glm::vec3(0.0f, 0.0f, -1.0f), 1000.0f, primitive, distance),
+		"an empty tree finds something");
+	BVH allEmpty;
+	allEmpty.build(vector<Bounds>(5, emptyBounds()));
+	allEmpty.queryFrustum(frustum, found);
+	result.expect(found.empty(), "a tree of empty boxes finds %zu", found.size());
+
+	vector<Bounds> one = { Bounds{ glm::vec3(-1.0f, 4.0f, -11.0f), glm::vec3(1.0f, 6.0f, -9.0f) } };
+	BVH single;
+	single.build(one);
+	result.expect(compareBVH(single, one, frustum, SCENE_EYE, 0) == 0, "one box: query");
+	result.expect(single.raycast(SCENE_EYE, glm::vec3(0.0f, 0.0f, -1.0f), 1000.0f, primitive, distance) && primitive == 0 &&
+		fabs(distance - 12.0f) < 1e-4f, "one box: the ray straight ahead");
+
+	for (size_t count : { 2, 3, 100, 5000 })
+	{
+		vector<Bounds> boxes = randomSceneBoxes(count, 2.0f);
+		// a few empty at build time
+		for (size_t i = 1; i < boxes.size(); i += 7)
+			boxes[i] = emptyBounds();
+		BVH bvh;
+		bvh.build(boxes);
+		result.expect(compareBVH(bvh, boxes, frustum, SCENE_EYE, 500) == 0, "%zu boxes: queries differ from testing every box", count);
+		glm::vec3 inside = count > 3 ? (boxes[3].min + boxes[3].max) * 0.5f : SCENE_EYE;
+		result.expect(compareBVH(bvh, boxes, frustum, inside, 200) == 0, "%zu boxes: rays from inside a box", count);
+
+		// move every third box, empty every fifth, and give the ones that were empty at build time a box again
+		bool rebuild = false;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			Bounds moved = boxes[i];
+			bool wasEmpty = isEmpty(moved);
+			if (wasEmpty)
+			{
+				if (i % 2 == 1)
+					moved = Bounds{ glm::vec3(-1.0f, 4.0f, -21.0f), glm::vec3(1.0f, 6.0f, -19.0f) };
+			}
+			else if (i % 5 == 0)
+				moved = emptyBounds();
+			else if (i % 3 == 0)
+			{
+				glm::vec3 offset((float)(rand() % 2001 - 1000) / 100.0f, 0.0f, (float)(rand() % 2001 - 1000) / 100.0f);
+				moved.min += offset;
+				moved.max += offset;
+			}
+			if (moved.min == boxes[i].min && moved.max == boxes[i].max)
+				continue;
+			boxes[i] = moved;
+			bool refitted = bvh.refit((uint32_t)i, moved);
+			result.expect(refitted == !(wasEmpty && !isEmpty(moved)), "%zu boxes: refit of box %zu returned %d", count, i, (int)refitted);
+			rebuild = rebuild || !refitted;
+		}
+		// what refit couldn't place isn't found until the next build
+		vector<Bounds> placed = boxes;
+		for (size_t i = 1; i < placed.size(); i += 7)
+			if (i % 2 == 1)
+				placed[i] = emptyBounds();
+		result.expect(compareBVH(bvh, placed, frustum, SCENE_EYE, 500) == 0, "%zu boxes: queries differ after refitting", count);
+		result.expect(rebuild, "%zu boxes: refit didn't ask for a rebuild", count);
+		bvh.build(boxes);
+		result.expect(compareBVH(bvh, boxes, frustum, SCENE_EYE, 500) == 0, "%zu boxes: queries differ after building again", count);
+	}
+	return result.finish();
+}
+#endif
@@ -0,0 +1,46 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// What every check shares: a CheckResult collects the failures of one check, printing each as it is found, and ends the
+// check with a line saying whether it passed. Checks are functions returning finish(), listed in main.cpp.
+
+#include <cstdarg>
+#include <cstdio>
+
+class CheckResult
+{
+public:
+	explicit CheckResult(const char *name) : name(name), failures(0) {}
+
+	// prints FAIL and the printf style message if condition is false. returns condition
+	bool expect(bool condition, const char *format, ...)
+	{
+		if (condition)
+			return true;
+		va_list args;
+		va_start(args, format);
+		printf("FAIL ");
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+		failures++;
+		return false;
+	}
+
+	bool ok() const { return failures == 0; }
+
+	// prints "<name>: ok" or how many expectations failed, returns ok()
+	bool finish() const
+	{
+		if (ok())
+			printf("%s: ok\n", name);
+		else
+			printf("%s: FAILED (%d)\n", name, failures);
+		return ok();
+	}
+
+private:
+	const char *name;
+	int failures;
+};
+#endif
@@ -0,0 +1,81 @@
+#ifndef COMMAND_BUFFER_CHECKS_H
+#define COMMAND_BUFFER_CHECKS_H
+
+#include "Check.h"
+#include "CommandBuffer.h"
+#include "RenderQueue.h"
+#include "RenderQueueBenchmarks.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// every call that reaches it, packed into words, so two runs can be compared call by call
+class CommandLogBackend : public RenderBackend
+{
+public:
+	vector<uint64_t> calls;
+
+	void useProgram(const DrawItem &item) { calls.push_back(1ull << 56 | item.program); }
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+	{
+		calls.push_back(2ull << 56 | (uint64_t)(target & 0xffff) << 40 | (uint64_t)unit << 32 | texture);
+	}
+	void setMaterialUniforms(const DrawItem &item) { calls.push_back(3ull << 56 | (uint64_t)(uintptr_t)item.material); }
+	void bindVertexArray(unsigned int vao) { calls.push_back(4ull << 56 | vao); }
+	void draw(const DrawItem &item)
+	{
+		calls.push_back(5ull << 56 | (uint64_t)item.firstIndex << 32 | (uint32_t)item.count);
+		calls.push_back((uint64_t)(uintptr_t)item.material);
+		calls.push_back((uint64_t)item.program << 32 | item.vao);
+		calls.push_back((uint64_t)(uint32_t)item.instanceCount << 32 | item.indexType);
+		uint32_t translation;
+		memcpy(&translation, &item.model[3][0], sizeof(translation));
+		calls.push_back(translation);
+	}
+};
+
+// synthetic frames (with untextured and instanced items) executed straight into a logging
+// backend and recorded into command buffers on 1 to all threads, then merged into another one. Both have to see the
+// same calls and the same state change counts.
+inline bool checkCommandBuffers()
+{
+	const size_t itemCounts[] = { 0, 1, 255, 256, 257, 1000, 4099, 100000 };
+	vector<RenderMaterial> materials = syntheticMaterials(64);
+	vector<unsigned int> threadCounts = benchmarkThreadCounts();
+	threadCounts.push_back(3);
+	CheckResult result("command buffers");
+	for (size_t itemCount : itemCounts)
+	{
+		vector<DrawItem> items = syntheticDrawItems(itemCount, materials, true);
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			RenderQueue queue;
+			for (const DrawItem &item : items)
+				queue.submit(item);
+			if (sorted)
+				queue.sort();
+			CommandLogBackend direct;
+			RenderQueueStats directStats = queue.execute(direct);
+
+			for (unsigned int threads : threadCounts)
+			{
+				for (const DrawItem &item : items)
+					queue.submit(item);
+				if (sorted)
+					queue.sort();
+				vector<CommandBuffer> buffers;
+				RenderQueueStats stats = recordRenderQueue(queue, sharedThreadPool(), buffers, threads);
+				CommandLogBackend replayed;
+				replayCommandBuffers(buffers, replayed, stats);
+				bool same = replayed.calls == direct.calls && stats.items == directStats.items && stats.triangles == directStats.triangles &&
+					stats.programs == directStats.programs && stats.textures == directStats.textures && stats.vaos == directStats.vaos;
+				result.expect(same, "%zu items %s, %u threads (%zu buffers): %zu calls against %zu", itemCount, sorted ? "sorted" : "unsorted",
+					threads, buffers.size(), replayed.calls.size(), direct.calls.size());
+			}
+		}
+	}
+	return result.finish();
+}
+#endif
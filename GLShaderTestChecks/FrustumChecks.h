@@ -0,0 +1,106 @@
+#ifndef FRUSTUM_CHECKS_H
+#define FRUSTUM_CHECKS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Check.h"
+#include "Frustum.h"
+#include "FrustumBenchmarks.h"
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// how far the box is inside the plane it is furthest outside of, from its 8 corners: negative means boxVisible has to
+// say no
+inline float boxPlaneMargin(const Frustum &frustum, const Bounds &box)
+{
+	float margin = 1e30f;
+	for (const glm::vec4 &plane : frustum.planes)
+	{
+		float best = -1e30f;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+			best = max(best, plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w);
+		}
+		margin = min(margin, best);
+	}
+	return margin;
+}
+
+// boxVisible against hand placed boxes around the demo scene's camera and, on random boxes seen from two cameras, against
+// the corners of every box (left out within 1e-3 of a plane, where rounding decides) and BoxBatch::cull, SSE or not,
+// box for box. transformBounds has to enclose the transformed corners exactly.
+inline bool checkFrustum()
+{
+	CheckResult result("frustum");
+	Frustum scene = sceneFrustum();
+	// 13 in front of the camera the frustum is 13 * tan(22.5) * 1920 / 1080 = 9.57 to either side
+	struct { glm::vec3 center; float extent; bool visible; const char *what; } cases[] = {
+		{ glm::vec3(0.0f, 5.0f, -10.0f), 1.0f, true, "in front" },
+		{ glm::vec3(0.0f, 5.0f, 13.0f), 1.0f, false, "behind" },
+		{ glm::vec3(0.0f, 5.0f, 3.0f), 0.5f, true, "around the camera" },
+		{ glm::vec3(0.0f, 5.0f, -107.0f), 1.0f, false, "beyond the far plane" },
+		{ glm::vec3(0.0f, 5.0f, -97.0f), 1.0f, true, "straddling the far plane" },
+		{ glm::vec3(-9.57f, 5.0f, -10.0f), 1.0f, true, "straddling the left plane" },
+		{ glm::vec3(-12.0f, 5.0f, -10.0f), 1.0f, false, "left of it" },
+		{ glm::vec3(0.0f, 30.0f, -10.0f), 1.0f, false, "above" },
+	};
+	for (const auto &box : cases)
+	{
+		result.expect(boxVisible(scene, box.center, glm::vec3(box.extent)) == box.visible, "box %s", box.what);
+		result.expect(sphereVisible(scene, BoundingSphere{ box.center, box.extent }) == box.visible, "sphere %s", box.what);
+	}
+
+	glm::mat4 side = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.5f, 40.0f) *
+		glm::lookAt(glm::vec3(10.0f, 2.0f, 0.0f), glm::vec3(20.0f, 0.0f, 5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const Frustum frustums[] = { scene, extractFrustum(side) };
+	// not a multiple of 4, so the scalar tail of BoxBatch::cull runs too
+	vector<Bounds> boxes = randomSceneBoxes(20003, 3.0f);
+	size_t visible = 0;
+	for (const Frustum &frustum : frustums)
+	{
+		BoxBatch batch;
+		for (const Bounds &box : boxes)
+			batch.add((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f);
+		size_t batchVisible = batch.cull(frustum), mismatches = 0, wrong = 0;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			bool single = boxVisible(frustum, glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]),
+				glm::vec3(batch.extentX[i], batch.extentY[i], batch.extentZ[i]));
+			mismatches += single != (batch.visible[i] != 0);
+			float margin = boxPlaneMargin(frustum, boxes[i]);
+			if (fabs(margin) > 1e-3f)
+				wrong += single != (margin > 0.0f);
+			visible += single;
+		}
+		result.expect(mismatches == 0, "BoxBatch (%s) and boxVisible disagree on %zu of %zu boxes", FRUSTUM_SSE ? "SSE" : "scalar", mismatches,
+			boxes.size());
+		result.expect(wrong == 0, "boxVisible wrong about %zu of %zu boxes", wrong, boxes.size());
+		result.expect(batchVisible > 0 && batchVisible < boxes.size(), "%zu of %zu boxes visible", batchVisible, boxes.size());
+	}
+
+	Bounds local = { glm::vec3(-1.0f, 0.0f, -2.0f), glm::vec3(3.0f, 1.0f, 0.5f) };
+	glm::mat4 model = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(4.0f, -2.0f, 7.0f)), glm::radians(33.0f),
+		glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f))), glm::vec3(2.0f, 0.5f, 1.5f));
+	glm::vec3 low(1e30f), high(-1e30f);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 p(corner & 1 ? local.max.x : local.min.x, corner & 2 ? local.max.y : local.min.y, corner & 4 ? local.max.z : local.min.z);
+		glm::vec3 moved = glm::vec3(model * glm::vec4(p, 1.0f));
+		low = glm::min(low, moved);
+		high = glm::max(high, moved);
+	}
+	glm::vec3 center, extent;
+	transformBounds(local, model, center, extent);
+	glm::vec3 error = glm::abs(center - (low + high) * 0.5f) + glm::abs(extent - (high - low) * 0.5f);
+	result.expect(max(error.x, max(error.y, error.z)) < 1e-4f, "transformBounds off the corners by %g", max(error.x, max(error.y, error.z)));
+
+	printf("frustum: %zu boxes, %zu seen\n", boxes.size() * 2, visible);
+	return result.finish();
+}
+#endif
@@ -0,0 +1,61 @@
+#ifndef LZ4_CHECKS_H
+#define LZ4_CHECKS_H
+
+#include "Check.h"
+#include "FileUtils.h"
+#include "LZ4.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace std;
+
+// round trips through lz4Compress / lz4Decompress for empty, tiny, constant, repetitive, random and real (the shaders)
+// inputs, and damaged blocks that have to be refused
+inline bool checkLZ4()
+{
+	CheckResult result("lz4");
+	vector<vector<unsigned char>> inputs;
+	srand(11);
+	for (size_t size : { 0, 1, 4, 5, 12, 13, 16, 17, 31, 100, 65536 + 300, 300000 })
+	{
+		vector<unsigned char> constant(size, 'a'), random(size), repetitive(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			random[i] = (unsigned char)rand();
+			// runs of a few hundred bytes that come back, some of them further than an offset reaches
+			repetitive[i] = (unsigned char)((i % 397) * 31 + (i / 70000));
+		}
+		inputs.push_back(constant);
+		inputs.push_back(random);
+		inputs.push_back(repetitive);
+	}
+	vector<string> shaders;
+	listFiles(".", { "vs", "fs", "gs" }, shaders);
+	result.expect(!shaders.empty(), "no shaders found, are the assets there?");
+	for (const string &path : shaders)
+	{
+		MappedFile file;
+		if (file.open(path))
+			inputs.push_back(vector<unsigned char>(file.data(), file.data() + file.size()));
+	}
+
+	size_t size = 0, compressedSize = 0;
+	for (const vector<unsigned char> &input : inputs)
+	{
+		vector<unsigned char> compressed = lz4Compress(input.data(), input.size());
+		vector<unsigned char> output(input.size());
+		result.expect(compressed.size() <= lz4CompressBound(input.size()) &&
+			lz4Decompress(compressed.data(), compressed.size(), output.data(), output.size()) && output == input,
+			"round trip of %zu bytes", input.size());
+		// cut short, or expected to decompress to a different size
+		result.expect(input.empty() || (!lz4Decompress(compressed.data(), compressed.size() - 1, output.data(), output.size()) &&
+			!lz4Decompress(compressed.data(), compressed.size(), output.data(), output.size() - 1)), "damaged block of %zu bytes accepted",
+			input.size());
+		size += input.size();
+		compressedSize += compressed.size();
+	}
+	printf("lz4: %zu inputs, %zu -> %zu bytes\n", inputs.size(), size, compressedSize);
+	return result.finish();
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef MIP_CHAIN_CHECKS_H
+#define MIP_CHAIN_CHECKS_H
+
+#include "Check.h"
+#include "MipChain.h"
+#include "TextureCompressionBenchmarks.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+inline float srgbToLinear(unsigned char value)
+{
+	float c = value / 255.0f;
+	return c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float linear)
+{
+	float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * pow(linear, 1.0f / 2.4f) - 0.055f;
+	return c * 255.0f;
+}
+
+// the level after width x height pixels by the 2x2 box filter written out plainly: a 1 pixel wide or high image reuses its
+// only column or row, an odd last column or row is left out, and the sum is rounded. with srgb the color channels (all
+// but the last of 2 and 4) are averaged in linear space and not rounded, the caller allows for the tables SOIL2 uses.
+inline vector<float> referenceMipLevel(const unsigned char *pixels, int width, int height, int channels, bool srgb)
+{
+	int mipWidth = mipSize(width), mipHeight = mipSize(height);
+	int colorChannels = channels % 2 == 0 ? channels - 1 : channels;
+	vector<float> level((size_t)mipWidth * mipHeight * channels);
+	for (int y = 0; y < mipHeight; y++)
+		for (int x = 0; x < mipWidth; x++)
+		{
+			int x0 = min(2 * x, width - 1), x1 = min(2 * x + 1, width - 1), y0 = min(2 * y, height - 1), y1 = min(2 * y + 1, height - 1);
+			const unsigned char *corners[4] = { &pixels[((size_t)y0 * width + x0) * channels], &pixels[((size_t)y0 * width + x1) * channels],
+				&pixels[((size_t)y1 * width + x0) * channels], &pixels[((size_t)y1 * width + x1) * channels] };
+			for (int c = 0; c < channels; c++)
+			{
+				float &out = level[((size_t)y * mipWidth + x) * channels + c];
+				if (srgb && c < colorChannels)
+					out = linearToSrgb((srgbToLinear(corners[0][c]) + srgbToLinear(corners[1][c]) + srgbToLinear(corners[2][c]) +
+						srgbToLinear(corners[3][c])) / 4.0f);
+				else
+					out = (float)((corners[0][c] + corners[1][c] + corners[2][c] + corners[3][c] + 2) >> 2);
+			}
+		}
+	return level;
+}
+
+// buildMipChain on images of awkward sizes with 1 to 4 channels, a facade (see syntheticTexture) and noise over the
+// whole range of a byte: the levels have to halve down to 1 x 1, be the same bytes on one thread as on all of them,
+// and each be the box filter of the level before it. in sRGB the colors may be one step off the exact linear average,
+// alpha never is.
+inline bool checkMipChains()
+{
+	CheckResult result("mipmaps");
+	const int sizes[][2] = { { 1, 1 }, { 2, 2 }, { 1, 7 }, { 9, 1 }, { 5, 3 }, { 64, 64 }, { 257, 129 }, { 300, 200 } };
+	size_t levels = 0;
+	for (const int *size : sizes)
+		for (int channels = 1; channels <= 4; channels++)
+			for (int noise = 0; noise < 2; noise++)
+			{
+				int width = size[0], height = size[1];
+				vector<unsigned char> pixels = syntheticTexture(width, height, channels);
+				if (noise)
+					for (unsigned char &pixel : pixels)
+						pixel = (unsigned char)rand();
+				for (int srgb = 0; srgb < 2; srgb++)
+				{
+					vector<MipLevel> chain = buildMipChain(pixels.data(), width, height, channels, srgb != 0, sharedThreadPool(), 1);
+					vector<MipLevel> parallel = buildMipChain(pixels.data(), width, height, channels, srgb != 0, sharedThreadPool(), 0);
+					const char *image = noise ? "noise" : "facade";
+					bool same = chain.size() == parallel.size();
+					for (size_t i = 0; same && i < chain.size(); i++)
+						same = chain[i].width == parallel[i].width && chain[i].height == parallel[i].height && chain[i].pixels == parallel[i].pixels;
+					result.expect(same, "%dx%d x%d %s%s: levels differ between 1 and all threads", width, height, channels, image,
+						srgb ? ", sRGB" : "");
+
+					const unsigned char *source = pixels.data();
+					int sourceWidth = width, sourceHeight = height;
+					for (size_t i = 0; i < chain.size(); i++)
+					{
+						const MipLevel &level = chain[i];
+						if (!result.expect(level.width == mipSize(sourceWidth) && level.height == mipSize(sourceHeight), "%dx%d x%d: level %zu is %dx%d",
+							width, height, channels, i + 1, level.width, level.height))
+							break;
+						vector<float> reference = referenceMipLevel(source, sourceWidth, sourceHeight, channels, srgb != 0);
+						float worst = 0.0f;
+						for (size_t k = 0; k < reference.size(); k++)
+							worst = max(worst, fabs(level.pixels[k] - reference[k]));
+						// the sRGB tables are 16 bit and round on the way back, the linear path has to be exact
+						result.expect(worst <= (srgb ? 1.0f : 0.0f), "%dx%d x%d %s%s: level %zu is %.2f off the box filter", width, height, channels,
+							image, srgb ? ", sRGB" : "", i + 1, worst);
+						source = level.pixels.data();
+						sourceWidth = level.width;
+						sourceHeight = level.height;
+						levels++;
+					}
+					result.expect(sourceWidth == 1 && sourceHeight == 1, "%dx%d x%d: the chain ends at %dx%d", width, height, channels, sourceWidth,
+						sourceHeight);
+				}
+			}
+
+	// black and white in sRGB average to the grey that looks like their mix, 188, not to 128
+	const unsigned char checker[] = { 0, 255, 255, 0 };
+	vector<MipLevel> linear = buildMipChain(checker, 2, 2, 1, false, sharedThreadPool());
+	vector<MipLevel> srgb = buildMipChain(checker, 2, 2, 1, true, sharedThreadPool());
+	result.expect(linear.size() == 1 && linear[0].pixels[0] == 128, "black and white average to %d", linear.empty() ? -1 : linear[0].pixels[0]);
+	result.expect(srgb.size() == 1 && abs(srgb[0].pixels[0] - 188) <= 1, "black and white average to %d in sRGB",
+		srgb.empty() ? -1 : srgb[0].pixels[0]);
+	printf("mipmaps: %zu levels\n", levels);
+	return result.finish();
+}
+#endif
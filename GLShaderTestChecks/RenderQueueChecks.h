@@ -0,0 +1,130 @@
+#ifndef RENDER_QUEUE_CHECKS_H
+#define RENDER_QUEUE_CHECKS_H
+
+#include <glm/glm.hpp>
+
+#include "Check.h"
+#include "RenderQueue.h"
+#include "RenderQueueBenchmarks.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// a DrawItem of the hand made frame of checkRenderQueue, its material's sort id given rather than taken from the material
+inline DrawItem checkDrawItem(unsigned int program, const RenderMaterial *material, unsigned int materialSortId, unsigned int vao, float depth)
+{
+	DrawItem item = {};
+	item.key = makeSortKey(0, program, materialSortId, vao, depth, 100.0f);
+	item.program = program;
+	item.material = material;
+	item.vao = vao;
+	item.indexType = GL_UNSIGNED_SHORT;
+	item.count = 3;
+	item.model = glm::mat4(1.0f);
+	item.extent = UNBOUNDED_EXTENT;
+	return item;
+}
+
+// RenderQueue against MockRenderBackend. A hand made frame whose draw order and state changes are worked out below,
+// synthetic frames whose sorted order has to be that of std::stable_sort on the keys (and the submission order
+// unsorted) with the mock seeing what the stats say, and the material ids: shared by equal texture sets, also when
+// materials are made on many threads at once, and forgotten with the last material.
+inline bool checkRenderQueue()
+{
+	CheckResult result("render queue");
+
+	// A = texture 10 on unit 0; B = 10 on unit 0 and 11 on unit 1, so going from A to B only binds unit 1.
+	// sorted: program 1 { A vao 1 depth 9, A vao 2 depth 4, B vao 2 depth 1, B vao 2 depth 3 }, program 2 { A vao 1
+	// depth 1, A vao 1 depth 5 }: 2 programs, 2 texture binds (10, then 11; program 2 finds 10 still bound), material
+	// uniforms 3 times (first item, A to B, new program) and 3 VAO binds (1, 2, 1).
+	{
+		RenderMaterial a({ { GL_TEXTURE_2D, 10, "" } });
+		RenderMaterial b({ { GL_TEXTURE_2D, 10, "" }, { GL_TEXTURE_2D, 11, "second" } });
+		vector<DrawItem> items = {
+			checkDrawItem(2, &a, 1, 1, 5.0f), checkDrawItem(1, &b, 2, 2, 3.0f), checkDrawItem(1, &a, 1, 1, 9.0f),
+			checkDrawItem(2, &a, 1, 1, 1.0f), checkDrawItem(1, &b, 2, 2, 1.0f), checkDrawItem(1, &a, 1, 2, 4.0f) };
+		const size_t order[] = { 2, 5, 4, 1, 3, 0 };
+		RenderQueue queue;
+		for (const DrawItem &item : items)
+			queue.submit(item);
+		queue.sort();
+		MockRenderBackend backend(true);
+		RenderQueueStats stats = queue.execute(backend);
+		vector<uint64_t> expected;
+		for (size_t i : order)
+			expected.push_back(items[i].key);
+		result.expect(backend.drawnKeys == expected, "hand made frame: draw order");
+		result.expect(backend.programs == 2 && backend.textures == 2 && backend.materials == 3 && backend.vaos == 3 && backend.draws == 6,
+			"hand made frame: state changes reaching the backend");
+		result.expect(stats.programs == 2 && stats.textures == 2 && stats.vaos == 3 && stats.items == 6, "hand made frame: stats");
+		result.expect(stats.naivePrograms == 6 && stats.naiveTextures == 8 && stats.naiveVaos == 6, "hand made frame: naive stats");
+		result.expect(queue.size() == 0, "hand made frame: queue cleared by execute");
+	}
+
+	// what a unit holds is unknown until the queue bound something there, and a name only means something with its
+	// target. in submission order: an array material (texture 0 on unit 0, as Mesh makes them: both bound, since unit 0
+	// may still hold a texture from before), the same names as GL_TEXTURE_2D (unit 1 again), then two items without a
+	// material, the first of which has to reset the material uniforms (one call) instead of keeping the array's layer.
+	{
+		RenderMaterial array({ { GL_TEXTURE_2D, 0, "" }, { GL_TEXTURE_2D_ARRAY, 7, "" } }, 3.0f);
+		RenderMaterial flat({ { GL_TEXTURE_2D, 0, "" }, { GL_TEXTURE_2D, 7, "" } });
+		vector<DrawItem> items = {
+			checkDrawItem(1, &array, 1, 1, 1.0f), checkDrawItem(1, &flat, 1, 1, 1.0f),
+			checkDrawItem(1, nullptr, 1, 1, 1.0f), checkDrawItem(1, nullptr, 1, 1, 1.0f) };
+		RenderQueue queue;
+		for (const DrawItem &item : items)
+			queue.submit(item);
+		MockRenderBackend backend;
+		RenderQueueStats stats = queue.execute(backend);
+		result.expect(backend.textures == 3 && stats.textures == 3, "texture targets: binds of unknown units and changed targets");
+		result.expect(backend.materials == 3 && backend.untextured == 1, "texture targets: material uniforms reset without a material");
+	}
+
+	vector<RenderMaterial> materials = syntheticMaterials(64);
+	for (size_t itemCount : { 0, 1, 1000, 10000 })
+	{
+		vector<DrawItem> items = syntheticDrawItems(itemCount, materials, true);
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			vector<uint64_t> expected;
+			for (const DrawItem &item : items)
+				expected.push_back(item.key);
+			if (sorted)
+				stable_sort(expected.begin(), expected.end());
+			RenderQueue queue;
+			for (const DrawItem &item : items)
+				queue.submit(item);
+			if (sorted)
+				queue.sort();
+			MockRenderBackend backend(true);
+			RenderQueueStats stats = queue.execute(backend);
+			result.expect(backend.drawnKeys == expected, sorted ? "synthetic frame: sorted order" : "synthetic frame: submission order");
+			result.expect(backend.programs == stats.programs && backend.textures == stats.textures && backend.vaos == stats.vaos &&
+				backend.draws == itemCount && stats.items == itemCount, "synthetic frame: backend calls against stats");
+			result.expect(stats.issued() <= stats.naive(), "synthetic frame: more state changes than drawing each item on its own");
+		}
+	}
+
+	size_t sets = materialIds().size();
+	{
+		RenderMaterial a({ { GL_TEXTURE_2D, 20, "" } }), b({ { GL_TEXTURE_2D, 20, "" } }), c({ { GL_TEXTURE_2D, 21, "" } });
+		RenderMaterial copy = a, none;
+		result.expect(a.id != 0 && a.id == b.id && a.id != c.id && copy.id == a.id && none.id == 0, "material ids of equal and different sets");
+		vector<RenderMaterial> made(1000);
+		sharedThreadPool().parallelFor(made.size(), [&](size_t i) {
+			made[i] = RenderMaterial({ { GL_TEXTURE_2D, 30 + (unsigned int)i % 10, "" } });
+		});
+		bool shared = true;
+		for (size_t i = 10; i < made.size(); i++)
+			shared = shared && made[i].id == made[i % 10].id && made[i].id != made[(i + 1) % 10].id;
+		result.expect(shared, "material ids made on many threads");
+		result.expect(materialIds().size() == sets + 12, "material id sets while the materials live");
+	}
+	result.expect(materialIds().size() == sets, "material id sets after the materials are gone");
+
+	return result.finish();
+}
+#endif
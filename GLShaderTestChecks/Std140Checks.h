@@ -0,0 +1,36 @@
+#ifndef STD140_CHECKS_H
+#define STD140_CHECKS_H
+
+#include <glm/glm.hpp>
+
+#include "Check.h"
+#include "UniformBuffer.h"
+
+// Std140Writer against offsets worked out by hand from the std140 rules. Whether the driver lays the scene's blocks out
+// the same way needs a context: GLShaderTest --check-std140.
+inline bool checkStd140Rules()
+{
+	CheckResult result("std140 rules");
+	Std140Writer writer;
+	const float pair[2] = { 1.0f, 2.0f };
+	struct { size_t actual, expected; const char *what; } rules[] = {
+		{ writer.writeFloat(1.0f), 0, "float" },
+		{ writer.writeVec3(glm::vec3(1.0f)), 16, "vec3 aligns to 16" },
+		{ writer.writeFloat(1.0f), 28, "float packs behind a vec3" },
+		{ writer.writeVec2(glm::vec2(1.0f)), 32, "vec2" },
+		{ writer.writeVec4(glm::vec4(1.0f)), 48, "vec4" },
+		{ writer.writeFloatArray(pair, 2), 64, "float[2], stride 16" },
+		{ writer.writeInt(1), 96, "int after the array" },
+		{ writer.writeMat3(glm::mat3(1.0f)), 112, "mat3, 3 padded columns" },
+		{ writer.writeVec2(glm::vec2(1.0f)), 160, "vec2 after mat3" },
+		{ writer.writeMat4(glm::mat4(1.0f)), 176, "mat4" },
+		{ writer.beginStruct(), 240, "struct" },
+		{ writer.writeFloat(1.0f), 240, "struct member" },
+	};
+	writer.endStruct();
+	for (const auto &rule : rules)
+		result.expect(rule.actual == rule.expected, "%s at %zu, expected %zu", rule.what, rule.actual, rule.expected);
+	result.expect(writer.size() == 256, "block size %zu, expected 256", writer.size());
+	return result.finish();
+}
+#endif
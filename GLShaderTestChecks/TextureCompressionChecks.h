@@ -0,0 +1,41 @@
+#ifndef TEXTURE_COMPRESSION_CHECKS_H
+#define TEXTURE_COMPRESSION_CHECKS_H
+
+#include "Check.h"
+#include "TextureCompression.h"
+#include "TextureCompressionBenchmarks.h"
+
+#include <cstdlib>
+#include <vector>
+using namespace std;
+
+// images of awkward sizes with 1 to 4 channels compressed by every compressor the CPU has, on 1 and on all threads.
+// Everything has to match the scalar compressor byte for byte.
+inline bool checkDXTCompressors()
+{
+	CheckResult result("dxt");
+	const int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 4, 4 }, { 7, 9 }, { 17, 13 }, { 33, 31 }, { 64, 64 }, { 257, 129 }, { 1000, 70 } };
+	int best = set_DXT_compressor(DXT_COMPRESSOR_AVX);
+	for (const int *size : sizes)
+		for (int channels = 1; channels <= 4; channels++)
+		{
+			vector<unsigned char> pixels = syntheticTexture(size[0], size[1], channels);
+			// noise in every byte, so the blocks aren't all alike
+			for (size_t i = 0; i < pixels.size(); i += 3)
+				pixels[i] = (unsigned char)(pixels[i] ^ (rand() & 15));
+			set_DXT_compressor(DXT_COMPRESSOR_SCALAR);
+			vector<unsigned char> reference = compressDXT(pixels.data(), size[0], size[1], channels, sharedThreadPool(), 1);
+			for (int compressor = DXT_COMPRESSOR_SCALAR; compressor <= best; compressor++)
+				for (unsigned int threads : { 1u, 0u })
+				{
+					set_DXT_compressor(compressor);
+					vector<unsigned char> compressed = compressDXT(pixels.data(), size[0], size[1], channels, sharedThreadPool(), threads);
+					result.expect(compressed == reference, "%dx%d, %d channels, %s on %s threads", size[0], size[1], channels,
+						dxtCompressorName(compressor), threads ? "1" : "all");
+				}
+		}
+	set_DXT_compressor(best);
+	printf("dxt: compressors up to %s\n", dxtCompressorName(best));
+	return result.finish();
+}
+#endif
@@ -0,0 +1,111 @@
+#ifndef TEXTURE_LOADER_CHECKS_H
+#define TEXTURE_LOADER_CHECKS_H
+
+#include "SOIL2/SOIL2.h"
+
+#include "Check.h"
+#include "FileUtils.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// what a TextureLoader hands to its sink, kept instead of uploaded
+class RecordingUploadSink : public TextureUploadSink
+{
+public:
+	struct Upload {
+		unsigned int texture;
+		string path;
+		bool gamma, failed;
+		int width, height, channels;
+		uint64_t hash;		// of the pixels
+	};
+	vector<Upload> uploads;
+
+	void upload(const DecodedImage &image) { record(image, false); }
+	void failed(const DecodedImage &image) { record(image, true); }
+
+private:
+	void record(const DecodedImage &image, bool failed)
+	{
+		Upload upload = { image.texture, image.path, image.gamma, failed, 0, 0, 0, 0 };
+		if (!failed)
+		{
+			upload.width = image.width;
+			upload.height = image.height;
+			upload.channels = image.channels;
+			upload.hash = hashBytes(image.pixels, (size_t)image.width * image.height * image.channels);
+		}
+		uploads.push_back(upload);
+	}
+};
+
+// images of pic/ and missing files requested from a TextureLoader with a RecordingUploadSink, each into a handle of its
+// own as loadTextureAsync hands them out. with a budget of 0 every processUploads has to hand over exactly one image,
+// with an unlimited one (finish) all of them. every handle has to get its own image once, the same pixels SOIL decodes,
+// or a failure for the missing files.
+inline bool checkTextureLoader()
+{
+	CheckResult result("texture loader");
+	vector<string> paths;
+	listFiles("pic", { "jpg", "png" }, paths);
+	result.expect(!paths.empty(), "no images under pic/, are the assets there?");
+	if (paths.size() > 6)
+		paths.resize(6);
+	paths.push_back("pic/missing.png");
+	paths.push_back("pic/missing.jpg");
+	const unsigned int firstHandle = 100;
+
+	for (int round = 0; round < 2; round++)
+	{
+		RecordingUploadSink sink;
+		{
+			TextureLoader loader(sharedThreadPool(), sink);
+			for (size_t i = 0; i < paths.size(); i++)
+				loader.request(firstHandle + (unsigned int)i, paths[i], i % 2 == 1);
+			if (round == 0)
+			{
+				// a frame whose budget is used up by the first upload
+				while (sink.uploads.size() < paths.size())
+				{
+					int count = loader.processUploads(0.0);
+					result.expect(count <= 1, "processUploads(0) handed over %d images", count);
+					if (count == 0)
+						this_thread::yield();
+				}
+			}
+			else
+				loader.finish();
+			result.expect(loader.pending() == 0 && loader.processUploads(1e9) == 0, "images left over after the last upload");
+		}
+
+		vector<int> seen(paths.size(), 0);
+		for (const RecordingUploadSink::Upload &upload : sink.uploads)
+		{
+			size_t i = upload.texture - firstHandle;
+			if (!result.expect(i < paths.size() && upload.path == paths[i] && upload.gamma == (i % 2 == 1), "%s arrived for handle %u",
+				upload.path.c_str(), upload.texture))
+				continue;
+			seen[i]++;
+			int width = 0, height = 0, channels = 0;
+			unsigned char *pixels = SOIL_load_image(paths[i].c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+			bool expected = pixels && !upload.failed && upload.width == width && upload.height == height && upload.channels == channels &&
+				upload.hash == hashBytes(pixels, (size_t)width * height * channels);
+			if (!pixels && upload.failed)
+				expected = true;
+			SOIL_free_image_data(pixels);
+			result.expect(expected, "%s: %s %dx%d x%d", paths[i].c_str(), upload.failed ? "failed" : "decoded", upload.width, upload.height,
+				upload.channels);
+		}
+		for (size_t i = 0; i < paths.size(); i++)
+			result.expect(seen[i] == 1, "%s handed over %d times", paths[i].c_str(), seen[i]);
+	}
+	printf("texture loader: %zu images\n", paths.size());
+	return result.finish();
+}
+#endif
@@ -0,0 +1,88 @@
+// The checks of GLShaderTest that don't need OpenGL, built from the same headers: each one runs on the CPU alone,
+// prints what fails and returns false if anything did.
+//
+//   GLShaderTestChecks [--assets <dir>] [check ...]
+//
+// runs the named checks, or all of them, in <dir>: the directory with the shaders and pic/ (../GLShaderTest by
+// default, which is where it is when started from this project's directory). returns 1 if a check failed.
+
+#include <glad/glad.h>
+
+#include "BVHChecks.h"
+#include "Check.h"
+#include "CommandBufferChecks.h"
+#include "FrustumChecks.h"
+#include "LZ4Checks.h"
+#include "MipChainChecks.h"
+#include "RenderQueueChecks.h"
+#include "Std140Checks.h"
+#include "TextureCompressionChecks.h"
+#include "TextureLoaderChecks.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+
+struct NamedCheck {
+	const char *name;
+	bool (*run)();
+};
+
+const NamedCheck checks[] = {
+	{ "lz4", checkLZ4 },
+	{ "std140", checkStd140Rules },
+	{ "dxt", checkDXTCompressors },
+	{ "mipmaps", checkMipChains },
+	{ "render-queue", checkRenderQueue },
+	{ "command-buffer", checkCommandBuffers },
+	{ "texture-loader", checkTextureLoader },
+	{ "frustum", checkFrustum },
+	{ "bvh", checkBVH },
+};
+
+int main(int argc, char** argv)
+{
+	const char *assets = "../GLShaderTest";
+	vector<string> names;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc)
+			assets = argv[++i];
+		else
+			names.push_back(argv[i]);
+	}
+	for (const string &name : names)
+		if (find_if(begin(checks), end(checks), [&](const NamedCheck &check) { return name == check.name; }) == end(checks))
+		{
+			printf("no check called %s, there are:", name.c_str());
+			for (const NamedCheck &check : checks)
+				printf(" %s", check.name);
+			printf("\n");
+			return 1;
+		}
+	if (chdir(assets) != 0)
+	{
+		printf("can't change to %s, pass the GLShaderTest directory with --assets <dir>\n", assets);
+		return 1;
+	}
+
+	int run = 0, failed = 0;
+	for (const NamedCheck &check : checks)
+		if (names.empty() || find(names.begin(), names.end(), check.name) != names.end())
+		{
+			run++;
+			if (!check.run())
+				failed++;
+		}
+	printf("%d of %d checks passed\n", run - failed, run);
+	return failed ? 1 : 0;
+}